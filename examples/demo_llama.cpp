@@ -28,6 +28,8 @@ int main(int argc, char **argv) {
     LLaMAConfig config(tokens_limit, "7B", LLAMAROPE);
     auto model = LLaMAModel(config);
     model.load(model_path);
+    // only the last position of the prompt is sampled from
+    Module::logits_rows = 1;
 
     vector<string> in_strs = {
         "Hello, who are you?",
@@ -56,13 +56,13 @@ int main(int argc, char **argv) {
             .top_k = 50,
             .top_p = 0.F,
         };
+        StreamingDetokenizer streamer(tokenizer);
         model.generate(input_tensor, opt, [&](unsigned int out_token) -> bool {
-            auto out_string = tokenizer.detokenize({out_token});
-            auto [not_end, output_string] = tokenizer.postprocess(out_string);
-            if (!not_end) { return false; }
+            std::string output_string;
+            if (!streamer.put(out_token, output_string)) { return false; }
             std::cout << output_string << std::flush;
             return true;
         });
-        std::cout << "\n";
+        std::cout << streamer.flush() << "\n";
     }
 }
@@ -70,6 +70,7 @@ enum OpType {
     D2H,
     XP_KVCACHE,
     SDPA,
+    MERGEDLINEAR,
 
     // new front-end
     SUPERSILU,
@@ -82,9 +83,9 @@ static const vector<string> OpNames = {
     "SoftMax",
     "SiLU",
     "MatMul",
-    "MatMulINT8",
     "Scale",
     "RoPE",
+    "PositionalEmbedding",
     "RMSNorm",
     "CausalMask",
     "SlidingWindowMask",
@@ -138,6 +139,9 @@ static const vector<string> OpNames = {
     "D2H",
     "XP_KVCACHE",
     "SDPA",
+    "MergedLinear",
+
+    // new front-end
     "SuperSiLU",
 };
 
@@ -169,5 +173,33 @@ enum TensorFuncType {
     FUNC_PHI3V_HD_MERGE,
 };
 
+static const vector<string> TensorFuncNames = {
+    "Add",
+    "Sub",
+    "Mul",
+    "Div",
+    "TTAdd",
+    "TTSub",
+    "TTMul",
+    "TTDiv",
+    "MM",
+    "Norm",
+    "Mean",
+    "Cat",
+    "View",
+    "Transpose",
+    "Flatten",
+    "Clip",
+    "ClipAxis",
+    "Range",
+    "Where",
+    "IndexPut",
+    "Split",
+    "Expand",
+    // models use only
+    "FuyuGatherEmbd",
+    "Phi3VHDMerge",
+};
+
 } // namespace mllm
 #endif
@@ -52,11 +52,14 @@ enum DataType {
     MLLM_TYPE_F16 = 1,
     MLLM_TYPE_Q4_0 = 2,
     MLLM_TYPE_Q4_1 = 3,
+    MLLM_TYPE_Q5_0 = 6,
     MLLM_TYPE_Q8_0 = 8,
     MLLM_TYPE_Q8_1 = 9,
     MLLM_TYPE_Q8_PER_TENSOR = 10,
     // k-quantizations
+    MLLM_TYPE_Q3_K = 11,
     MLLM_TYPE_Q4_K = 12,
+    MLLM_TYPE_Q5_K = 13,
     MLLM_TYPE_Q6_K = 14,
     MLLM_TYPE_Q8_K = 15,
     MLLM_TYPE_I8,
@@ -66,6 +69,7 @@ enum DataType {
     MLLM_TYPE_Q4_0_4_8 = 20,
     MLLM_TYPE_Q4_0_8_8 = 21,
     MLLM_TYPE_Q8_0_4_4,
+    MLLM_TYPE_Q2_K, // ggml's Q2_K id (10) is taken by Q8_PER_TENSOR
     MLLM_TYPE_COUNT,
 };
 
@@ -196,6 +200,46 @@ typedef struct {
 } block_q4_0;
 #pragma pack()
 
+#define QK5_0 32
+#pragma pack(1)
+typedef struct {
+    mllm_fp16_t d;         // delta
+    uint8_t qh[4];         // 5-th bit of quants
+    uint8_t qs[QK5_0 / 2]; // nibbles / quants
+} block_q5_0;
+#pragma pack()
+static_assert(sizeof(block_q5_0) == sizeof(mllm_fp16_t) + sizeof(uint32_t) + QK5_0 / 2, "wrong q5_0 block size/padding");
+
+// The Q2_K, Q3_K and Q5_K layouts below are only implemented for QK_K == 256.
+
+//  2-bit quantization
+//  16 blocks of 16 elements each
+//  weight is represented as x = a * q + b
+//  Effectively 2.625 bits per weight
+#pragma pack(1)
+typedef struct {
+    uint8_t scales[QK_K / 16]; // scales and mins, quantized with 4 bits
+    uint8_t qs[QK_K / 4];      // quants
+    mllm_fp16_t d;             // super-block scale for quantized scales
+    mllm_fp16_t dmin;          // super-block scale for quantized mins
+} block_q2_K;
+#pragma pack()
+static_assert(sizeof(block_q2_K) == 2 * sizeof(mllm_fp16_t) + QK_K / 16 + QK_K / 4, "wrong q2_K block size/padding");
+
+//  3-bit quantization
+//  16 blocks of 16 elements each
+//  weight is represented as x = a * q
+//  Effectively 3.4375 bits per weight
+#pragma pack(1)
+typedef struct {
+    uint8_t hmask[QK_K / 8]; // quants - high bit
+    uint8_t qs[QK_K / 4];    // quants - low 2 bits
+    uint8_t scales[12];      // scales, quantized with 6 bits
+    mllm_fp16_t d;           // super-block scale
+} block_q3_K;
+#pragma pack()
+static_assert(sizeof(block_q3_K) == sizeof(mllm_fp16_t) + QK_K / 4 + QK_K / 8 + 12, "wrong q3_K block size/padding");
+
 //  4-bit quantization
 //  16 blocks of 32 elements each
 //  weight is represented as x = a * q + b
@@ -221,6 +265,21 @@ typedef struct {
 static_assert(sizeof(block_q4_K) == 2 * sizeof(mllm_fp16_t) + K_SCALE_SIZE + QK_K / 2, "wrong q4_K block size/padding");
 #endif
 
+//  5-bit quantization
+//  8 blocks of 32 elements each
+//  weight is represented as x = a * q + b
+//  Effectively 5.5 bits per weight
+#pragma pack(1)
+typedef struct {
+    mllm_fp16_t d;                // super-block scale for quantized scales
+    mllm_fp16_t dmin;             // super-block scale for quantized mins
+    uint8_t scales[K_SCALE_SIZE]; // scales and mins, quantized with 6 bits
+    uint8_t qh[QK_K / 8];         // quants, high bit
+    uint8_t qs[QK_K / 2];         // quants, low 4 bits
+} block_q5_K;
+#pragma pack()
+static_assert(sizeof(block_q5_K) == 2 * sizeof(mllm_fp16_t) + K_SCALE_SIZE + QK_K / 2 + QK_K / 8, "wrong q5_K block size/padding");
+
 #pragma pack(1)
 typedef struct {
     uint8_t ql[QK_K / 2];     // quants, lower 4 bits
@@ -304,8 +363,16 @@ static string DataTypeName(DataType dataType) {
         return "Q8_PER_TENSOR";
     case MLLM_TYPE_Q4_0:
         return "Q4_0";
+    case MLLM_TYPE_Q5_0:
+        return "Q5_0";
+    case MLLM_TYPE_Q2_K:
+        return "Q2_K";
+    case MLLM_TYPE_Q3_K:
+        return "Q3_K";
     case MLLM_TYPE_Q4_K:
         return "Q4_K";
+    case MLLM_TYPE_Q5_K:
+        return "Q5_K";
     case MLLM_TYPE_Q6_K:
         return "Q6_K";
     case MLLM_TYPE_Q8_0:
@@ -344,8 +411,16 @@ static size_t DataTypeSize(DataType dtype, int count = 1) {
         return sizeof(char) * count;
     case MLLM_TYPE_Q4_0:
         return (sizeof(block_q4_0)) * count / (QK4_0);
+    case MLLM_TYPE_Q5_0:
+        return (sizeof(block_q5_0)) * count / (QK5_0);
+    case MLLM_TYPE_Q2_K:
+        return (sizeof(block_q2_K)) * count / (QK_K);
+    case MLLM_TYPE_Q3_K:
+        return (sizeof(block_q3_K)) * count / (QK_K);
     case MLLM_TYPE_Q4_K:
         return (sizeof(block_q4_K)) * count / (QK_K);
+    case MLLM_TYPE_Q5_K:
+        return (sizeof(block_q5_K)) * count / (QK_K);
     case MLLM_TYPE_Q6_K:
         return (sizeof(block_q6_K)) * count / (QK_K);
     case MLLM_TYPE_Q8_PER_TENSOR:
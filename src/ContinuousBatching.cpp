@@ -0,0 +1,129 @@
+#include "ContinuousBatching.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+#include <algorithm>
+
+namespace mllm {
+
+ContinuousBatchingEngine::ContinuousBatchingEngine(Module &model, int max_batch, int max_step_tokens) :
+    model_(model), max_batch_(max_batch), max_step_tokens_(max_step_tokens), slot_used_(max_batch, false) {
+    assert(max_batch_ > 0 && max_step_tokens_ > 0);
+}
+
+int ContinuousBatchingEngine::submit(const vector<unsigned> &prompt, const LlmTextGeneratorOpts &opt, Callback call_back, int end_token) {
+    assert(!prompt.empty());
+    auto sequence = std::make_unique<Sequence>();
+    sequence->tokens = prompt;
+    sequence->prompt_size = prompt.size();
+    sequence->opt = opt;
+    sequence->end_token = end_token;
+    sequence->call_back = std::move(call_back);
+    if (!opt.do_sample) {
+        sequence->generator = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kGreedySearch, opt);
+    } else if (!opt.top_k && opt.top_p != 0.F) {
+        sequence->generator = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kToppSampling, opt);
+    } else {
+        sequence->generator = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kTopkSampling, opt);
+    }
+    sequence->generator->reset(opt, prompt);
+    std::lock_guard<std::mutex> lock(mutex_);
+    sequence->id = next_id_++;
+    int id = sequence->id;
+    waiting_.push_back(std::move(sequence));
+    return id;
+}
+
+size_t ContinuousBatchingEngine::waiting() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return waiting_.size();
+}
+
+void ContinuousBatchingEngine::admit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!waiting_.empty() && (int)running_.size() < max_batch_) {
+        auto slot = std::find(slot_used_.begin(), slot_used_.end(), false) - slot_used_.begin();
+        slot_used_[slot] = true;
+        waiting_.front()->slot = (int)slot;
+        running_.push_back(std::move(waiting_.front()));
+        waiting_.pop_front();
+    }
+}
+
+bool ContinuousBatchingEngine::step() {
+    admit();
+    if (running_.empty()) {
+        return false;
+    }
+    // running sequences get one decode row each, prompts share what is left of the token budget
+    int decode_rows = 0;
+    for (auto &sequence : running_) {
+        decode_rows += sequence->cached + 1 >= sequence->tokens.size();
+    }
+    int prefill_budget = std::max(max_step_tokens_ - decode_rows, 1);
+    SequenceBatch batch;
+    vector<unsigned> rows;
+    vector<int> last_row(running_.size(), -1);
+    for (size_t i = 0; i < running_.size(); ++i) {
+        auto &sequence = running_[i];
+        size_t end = sequence->tokens.size();
+        if (sequence->cached + 1 < end) {
+            // at least one row, a slot missing from a step is taken as finished and its blocks are freed
+            end = std::min(end, sequence->cached + std::max(prefill_budget, 1));
+            prefill_budget -= (int)(end - sequence->cached);
+        }
+        for (size_t pos = sequence->cached; pos < end; ++pos) {
+            batch.slots.push_back(sequence->slot);
+            batch.positions.push_back((int)pos);
+            rows.push_back(sequence->tokens[pos]);
+        }
+        if (end == sequence->tokens.size()) {
+            last_row[i] = (int)rows.size() - 1;
+        }
+        sequence->cached = end;
+    }
+
+    Tensor input_ids(1, 1, (int)rows.size(), 1, Backend::global_backends[MLLM_CPU], true);
+    input_ids.setName("input");
+    Tensor::tensor_status = TENSOR_STATIC_INIT;
+    input_ids.setTtype(INPUT_TENSOR);
+    for (int r = 0; r < (int)rows.size(); ++r) {
+        input_ids.setDataAt<float>(0, 0, r, 0, rows[r]);
+    }
+    auto cpu_backend = dynamic_cast<CPUBackend *>(Backend::global_backends[MLLM_CPU]);
+    cpu_backend->setSequenceBatch(batch);
+    // rows of every sequence are sampled, not just the last one
+    const int logits_rows_before = Module::logits_rows;
+    Module::logits_rows = 0;
+    auto outputs = model_({input_ids});
+    Module::logits_rows = logits_rows_before;
+    cpu_backend->setSequenceBatch({});
+
+    vector<std::unique_ptr<Sequence>> still_running;
+    for (size_t i = 0; i < running_.size(); ++i) {
+        auto &sequence = running_[i];
+        bool finished = false;
+        if (last_row[i] >= 0) {
+            auto token = sequence->generator->generate(outputs[0], last_row[i]);
+            sequence->generated++;
+            finished = !sequence->call_back(token)
+                       || (sequence->end_token != -1 && token == (unsigned)sequence->end_token)
+                       || sequence->generated >= sequence->opt.max_new_tokens;
+            sequence->tokens.push_back(token);
+        }
+        if (finished) {
+            // the slot's KV blocks are released by the next step that does not include it
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot_used_[sequence->slot] = false;
+        } else {
+            still_running.push_back(std::move(sequence));
+        }
+    }
+    running_ = std::move(still_running);
+    return true;
+}
+
+void ContinuousBatchingEngine::run() {
+    while (step()) {}
+    model_.clear_kvcache();
+}
+
+} // namespace mllm
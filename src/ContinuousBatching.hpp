@@ -0,0 +1,88 @@
+//
+// Continuous batching for text generation.
+//
+
+#ifndef MLLM_CONTINUOUSBATCHING_HPP
+#define MLLM_CONTINUOUSBATCHING_HPP
+
+#include "Module.hpp"
+#include "Generate.hpp"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * \brief Serves many generation requests with one model, merging their decode steps into shared forward passes.
+ *
+ * Requests can be submitted at any time. Each step() admits waiting requests into free KV slots, packs the
+ * prompt rows of new sequences and one decode row per running sequence into a single batch-1 input (see
+ * SequenceBatch), runs the model once and samples every sequence from its own last row. Sequences that hit
+ * their end token, max_new_tokens or a callback returning false are retired and their slots reused.
+ *
+ * The model's KV caches must be paged (kv_block_size > 0): every slot keeps its own blocks, so sequences of
+ * different lengths never pad each other.
+ */
+class ContinuousBatchingEngine {
+public:
+    using Callback = std::function<bool(unsigned int)>;
+
+    /**
+     * \param model a loaded model with paged KV caches.
+     * \param max_batch max number of sequences decoded together.
+     * \param max_step_tokens max prompt rows per step; longer prompts are prefilled over several steps.
+     */
+    explicit ContinuousBatchingEngine(Module &model, int max_batch = 8, int max_step_tokens = 512);
+
+    /**
+     * \brief queue a request, safe to call from any thread.
+     * \return id of the request, increasing in order of submission.
+     */
+    int submit(const vector<unsigned> &prompt, const LlmTextGeneratorOpts &opt, Callback call_back, int end_token = -1);
+    /**
+     * \brief run one forward pass over the pending and running sequences.
+     * \return false if there was nothing to do.
+     */
+    bool step();
+    /**
+     * \brief step until every submitted request has finished.
+     */
+    void run();
+
+    size_t waiting();
+    size_t running() const {
+        return running_.size();
+    }
+
+private:
+    struct Sequence {
+        int id;
+        int slot = -1;
+        vector<unsigned> tokens; // prompt followed by the generated tokens
+        size_t prompt_size;
+        size_t cached = 0; // tokens already in the KV cache
+        size_t generated = 0;
+        LlmTextGeneratorOpts opt;
+        int end_token;
+        Callback call_back;
+        std::shared_ptr<LlmTextGenerator> generator;
+    };
+
+    Module &model_;
+    int max_batch_;
+    int max_step_tokens_;
+    int next_id_ = 0;
+    std::mutex mutex_;
+    std::deque<std::unique_ptr<Sequence>> waiting_;
+    vector<std::unique_ptr<Sequence>> running_;
+    vector<bool> slot_used_;
+
+    void admit();
+};
+
+} // namespace mllm
+
+#endif // MLLM_CONTINUOUSBATCHING_HPP
@@ -0,0 +1,355 @@
+#include "GGUFParamLoader.hpp"
+#include "Tensor.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace mllm {
+
+static const char GGUF_MAGIC[4] = {'G', 'G', 'U', 'F'};
+static const uint32_t GGUF_DEFAULT_ALIGNMENT = 32;
+
+// gguf metadata value types
+enum GGUFValueType : uint32_t {
+    GGUF_UINT8 = 0,
+    GGUF_INT8 = 1,
+    GGUF_UINT16 = 2,
+    GGUF_INT16 = 3,
+    GGUF_UINT32 = 4,
+    GGUF_INT32 = 5,
+    GGUF_FLOAT32 = 6,
+    GGUF_BOOL = 7,
+    GGUF_STRING = 8,
+    GGUF_ARRAY = 9,
+    GGUF_UINT64 = 10,
+    GGUF_INT64 = 11,
+    GGUF_FLOAT64 = 12,
+};
+
+/*
+ * ggml type id -> mllm DataType, and the number of elements DataTypeSize needs to return a whole number of bytes.
+ * mllm follows ggml's numbering except for Q2_K, whose id is taken by Q8_PER_TENSOR.
+ */
+static std::pair<DataType, uint64_t> fromGGMLType(uint32_t ggml_type) {
+    switch (ggml_type) {
+    case 0: return {MLLM_TYPE_F32, 1};
+    case 1: return {MLLM_TYPE_F16, 1};
+    case 2: return {MLLM_TYPE_Q4_0, QK4_0};
+    case 6: return {MLLM_TYPE_Q5_0, QK5_0};
+    case 8: return {MLLM_TYPE_Q8_0, QK8_0};
+    case 10: return {MLLM_TYPE_Q2_K, QK_K};
+    case 11: return {MLLM_TYPE_Q3_K, QK_K};
+    case 12: return {MLLM_TYPE_Q4_K, QK_K};
+    case 13: return {MLLM_TYPE_Q5_K, QK_K};
+    case 14: return {MLLM_TYPE_Q6_K, QK_K};
+    case 15: return {MLLM_TYPE_Q8_K, QK_K};
+    case 24: return {MLLM_TYPE_I8, 1};
+    case 25: return {MLLM_TYPE_I16, 1};
+    case 26: return {MLLM_TYPE_I32, 1};
+    case 31: return {MLLM_TYPE_Q4_0_4_4, QK4_0 * 4};
+    case 32: return {MLLM_TYPE_Q4_0_4_8, QK4_0 * 8};
+    case 33: return {MLLM_TYPE_Q4_0_8_8, QK4_0 * 8};
+    default: return {MLLM_TYPE_COUNT, 1};
+    }
+}
+
+namespace {
+// bounds-checked reader over the header, which is parsed with fread so that it works without mmap
+struct GGUFReader {
+    FILE *fp;
+    bool ok = true;
+
+    template <typename T>
+    T read() {
+        T value{};
+        if (ok && fread(&value, sizeof(T), 1, fp) != 1) { ok = false; }
+        return value;
+    }
+    std::string readString() {
+        const auto len = read<uint64_t>();
+        std::string s;
+        // a corrupt length would otherwise ask for terabytes
+        if (!ok || len > (1ull << 30)) {
+            ok = false;
+            return s;
+        }
+        s.resize(len);
+        if (len > 0 && fread(&s[0], 1, len, fp) != len) { ok = false; }
+        return s;
+    }
+    double readNumber(uint32_t type, int64_t &as_int) {
+        switch (type) {
+        case GGUF_UINT8: return (double)(as_int = read<uint8_t>());
+        case GGUF_INT8: return (double)(as_int = read<int8_t>());
+        case GGUF_UINT16: return (double)(as_int = read<uint16_t>());
+        case GGUF_INT16: return (double)(as_int = read<int16_t>());
+        case GGUF_UINT32: return (double)(as_int = read<uint32_t>());
+        case GGUF_INT32: return (double)(as_int = read<int32_t>());
+        case GGUF_BOOL: return (double)(as_int = read<uint8_t>() != 0);
+        case GGUF_UINT64: return (double)(as_int = (int64_t)read<uint64_t>());
+        case GGUF_INT64: return (double)(as_int = read<int64_t>());
+        case GGUF_FLOAT32: {
+            const double f = read<float>();
+            as_int = (int64_t)f;
+            return f;
+        }
+        case GGUF_FLOAT64: {
+            const double f = read<double>();
+            as_int = (int64_t)f;
+            return f;
+        }
+        default: ok = false; return 0;
+        }
+    }
+};
+} // namespace
+
+GGUFParamLoader::GGUFParamLoader(std::string filename, bool use_mmap, GGUFNameMap names) :
+    path_(std::move(filename)), use_mmap_(use_mmap) {
+    fp_ = fopen(path_.c_str(), "rb");
+    if (fp_ == nullptr) { return; }
+    if (!parse()) {
+        MLLM_LOG_ERROR_STREAM << path_ << " is not a GGUF v2/v3 file or is truncated" << std::endl;
+        tensors_.clear();
+        return;
+    }
+    setNames(names);
+    if (use_mmap_) { mmapFile(); }
+}
+
+GGUFParamLoader::~GGUFParamLoader() {
+#ifndef _WIN32
+    if (buffer_ != nullptr) { munmap(buffer_, size_); }
+#endif
+    if (fp_ != nullptr) { fclose(fp_); }
+}
+
+bool GGUFParamLoader::parse() {
+    GGUFReader reader{fp_};
+    char magic[4];
+    if (fread(magic, 1, 4, fp_) != 4 || memcmp(magic, GGUF_MAGIC, 4) != 0) { return false; }
+    const auto version = reader.read<uint32_t>();
+    if (version != 2 && version != 3) { return false; }
+    const auto n_tensors = reader.read<uint64_t>();
+    const auto n_kv = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < n_kv && reader.ok; ++i) {
+        std::string key = reader.readString();
+        Value value;
+        value.type = reader.read<uint32_t>();
+        if (value.type == GGUF_STRING) {
+            value.s = reader.readString();
+        } else if (value.type == GGUF_ARRAY) {
+            const auto elem_type = reader.read<uint32_t>();
+            const auto n = reader.read<uint64_t>();
+            if (elem_type == GGUF_ARRAY) { return false; }
+            for (uint64_t j = 0; j < n && reader.ok; ++j) {
+                if (elem_type == GGUF_STRING) {
+                    value.strs.push_back(reader.readString());
+                } else {
+                    int64_t unused;
+                    value.nums.push_back(reader.readNumber(elem_type, unused));
+                }
+            }
+        } else {
+            value.f = reader.readNumber(value.type, value.i);
+        }
+        kv_[key] = std::move(value);
+    }
+    std::vector<TensorInfo> infos;
+    for (uint64_t i = 0; i < n_tensors && reader.ok; ++i) {
+        TensorInfo info;
+        info.gguf_name = reader.readString();
+        const auto n_dims = reader.read<uint32_t>();
+        if (n_dims > 4) { return false; }
+        uint64_t count = 1;
+        for (uint32_t d = 0; d < n_dims; ++d) {
+            info.ne.push_back(reader.read<uint64_t>());
+            count *= info.ne.back();
+        }
+        info.ggml_type = reader.read<uint32_t>();
+        info.offset = reader.read<uint64_t>();
+        auto [type, blck] = fromGGMLType(info.ggml_type);
+        info.type = type;
+        info.size = type == MLLM_TYPE_COUNT ? 0 : count / blck * DataTypeSize(type, blck);
+        infos.push_back(std::move(info));
+    }
+    if (!reader.ok) { return false; }
+    const uint64_t alignment = std::max<int64_t>(getInt("general.alignment", GGUF_DEFAULT_ALIGNMENT), 1);
+    const uint64_t header_end = ftell(fp_);
+    const uint64_t data_start = (header_end + alignment - 1) / alignment * alignment;
+    for (auto &info : infos) {
+        if (info.type == MLLM_TYPE_COUNT) {
+            MLLM_LOG_ERROR_STREAM << "GGUF tensor " << info.gguf_name << " has ggml type " << info.ggml_type
+                                  << ", which mllm can not run; it is skipped" << std::endl;
+        }
+        info.offset += data_start;
+        tensors_[info.gguf_name] = std::move(info);
+    }
+    return true;
+}
+
+void GGUFParamLoader::mmapFile() {
+#ifdef _WIN32
+    use_mmap_ = false;
+#else
+    struct stat st {};
+    if (fstat(fileno(fp_), &st) != 0 || st.st_size <= 0) {
+        use_mmap_ = false;
+        return;
+    }
+    size_ = st.st_size;
+    // MAP_PRIVATE: ops that rewrite their weights in place only copy the touched pages.
+    void *addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp_), 0);
+    if (addr == MAP_FAILED) {
+        MLLM_LOG_ERROR_STREAM << "mmap " << path_ << " failed, fall back to fread" << std::endl;
+        use_mmap_ = false;
+        size_ = 0;
+        return;
+    }
+    buffer_ = static_cast<uint8_t *>(addr);
+#endif
+}
+
+/*
+ * llama.cpp tensor names -> mllm names:
+ *   token_embd.*            -> token_embd_name.*
+ *   output_norm.*           -> post_norm_name.*
+ *   output.*                -> lm_head_name.*
+ *   blk.N.attn_{q,k,v,output}.* -> blk_name N.attn_base_name {q,k,v,o}_proj_name.*
+ *   blk.N.{attn_norm,ffn_norm}.* -> blk_name N.{attn,ffn}_norm_name.*
+ *   blk.N.ffn_{gate,up,down}.*  -> blk_name N.ffn_base_name {gate,up,down}_proj_name.*
+ * anything else keeps its gguf name.
+ */
+void GGUFParamLoader::setNames(const GGUFNameMap &names) {
+    names_.clear();
+    const std::map<std::string, std::string> block_parts = {
+        {"attn_q", names.attn_base_name + names.q_proj_name},
+        {"attn_k", names.attn_base_name + names.k_proj_name},
+        {"attn_v", names.attn_base_name + names.v_proj_name},
+        {"attn_output", names.attn_base_name + names.o_proj_name},
+        {"attn_norm", names.attn_norm_name},
+        {"ffn_norm", names.ffn_norm_name},
+        {"ffn_gate", names.ffn_base_name + names.gate_proj_name},
+        {"ffn_up", names.ffn_base_name + names.up_proj_name},
+        {"ffn_down", names.ffn_base_name + names.down_proj_name},
+    };
+    const std::map<std::string, std::string> model_parts = {
+        {"token_embd", names.token_embd_name},
+        {"output_norm", names.post_norm_name},
+        {"output", names.lm_head_name},
+    };
+    for (auto &[gguf_name, info] : tensors_) {
+        std::string mllm_name = gguf_name;
+        const auto suffix_pos = gguf_name.rfind('.');
+        const std::string base = suffix_pos == std::string::npos ? gguf_name : gguf_name.substr(0, suffix_pos);
+        const std::string suffix = suffix_pos == std::string::npos ? "" : gguf_name.substr(suffix_pos);
+        if (base.compare(0, 4, "blk.") == 0) {
+            const auto dot = base.find('.', 4);
+            if (dot != std::string::npos) {
+                auto part = block_parts.find(base.substr(dot + 1));
+                if (part != block_parts.end()) {
+                    mllm_name = names.blk_name + base.substr(4, dot - 4) + "." + part->second + suffix;
+                }
+            }
+        } else {
+            auto part = model_parts.find(base);
+            if (part != model_parts.end()) { mllm_name = part->second + suffix; }
+        }
+        names_[mllm_name] = gguf_name;
+    }
+    // tied embeddings: llama.cpp omits output.weight and multiplies by token_embd.weight
+    const std::string lm_head = names.lm_head_name + ".weight";
+    if (tensors_.count("output.weight") == 0 && tensors_.count("token_embd.weight") == 1
+        && names_.count(lm_head) == 0) {
+        names_[lm_head] = "token_embd.weight";
+    }
+}
+
+const GGUFParamLoader::TensorInfo *GGUFParamLoader::find(const std::string &name) const {
+    auto it = names_.find(name);
+    if (it == names_.end()) { return nullptr; }
+    const auto &info = tensors_.at(it->second);
+    return info.type == MLLM_TYPE_COUNT ? nullptr : &info;
+}
+
+bool GGUFParamLoader::load(mllm::Tensor *tensor) {
+    const TensorInfo *info = find(tensor->name());
+    if (info == nullptr) { return false; }
+    const uint64_t copy_size = std::min<uint64_t>(tensor->cntSize(), info->size);
+    if (buffer_ != nullptr) {
+        if (info->offset + info->size > size_) { return false; }
+        uint8_t *data = buffer_ + info->offset;
+        if (reinterpret_cast<uintptr_t>(data) % GGUF_MIN_ALIAS_ALIGNMENT == 0
+            && tensor->cntSize() <= info->size && tensor->masterTensor() == nullptr) {
+            tensor->setExternalHostPtr(data);
+        } else {
+            memcpy(tensor->rawHostPtr(), data, copy_size);
+        }
+        return true;
+    }
+    fseek(fp_, info->offset, SEEK_SET);
+    return fread(tensor->rawHostPtr(), sizeof(uint8_t), copy_size, fp_) == copy_size;
+}
+
+bool GGUFParamLoader::load(std::shared_ptr<mllm::Tensor> tensor) {
+    return load(tensor.get());
+}
+
+size_t GGUFParamLoader::getTensorSize(string name) {
+    const TensorInfo *info = find(name);
+    return info == nullptr ? 0 : info->size;
+}
+
+DataType GGUFParamLoader::getDataType(string name) {
+    const TensorInfo *info = find(name);
+    return info == nullptr ? MLLM_TYPE_COUNT : info->type;
+}
+
+vector<std::string> GGUFParamLoader::getParamNames() {
+    vector<std::string> keys;
+    for (auto &item : names_) {
+        if (find(item.first) != nullptr) { keys.push_back(item.first); }
+    }
+    return keys;
+}
+
+bool GGUFParamLoader::hasKey(const std::string &key) const {
+    return kv_.count(key) != 0;
+}
+
+int64_t GGUFParamLoader::getInt(const std::string &key, int64_t default_value) const {
+    auto it = kv_.find(key);
+    if (it == kv_.end() || it->second.type == GGUF_STRING || it->second.type == GGUF_ARRAY) { return default_value; }
+    return it->second.i;
+}
+
+double GGUFParamLoader::getFloat(const std::string &key, double default_value) const {
+    auto it = kv_.find(key);
+    if (it == kv_.end() || it->second.type == GGUF_STRING || it->second.type == GGUF_ARRAY) { return default_value; }
+    return it->second.f;
+}
+
+std::string GGUFParamLoader::getString(const std::string &key, const std::string &default_value) const {
+    auto it = kv_.find(key);
+    if (it == kv_.end() || it->second.type != GGUF_STRING) { return default_value; }
+    return it->second.s;
+}
+
+std::vector<std::string> GGUFParamLoader::getStringArray(const std::string &key) const {
+    auto it = kv_.find(key);
+    return it == kv_.end() ? std::vector<std::string>() : it->second.strs;
+}
+
+std::vector<double> GGUFParamLoader::getNumberArray(const std::string &key) const {
+    auto it = kv_.find(key);
+    return it == kv_.end() ? std::vector<double>() : it->second.nums;
+}
+
+} // namespace mllm
@@ -0,0 +1,123 @@
+#ifndef MLLM_GGUFPARAMLOADER_H
+#define MLLM_GGUFPARAMLOADER_H
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "ParamLoader.hpp"
+
+// kernels only issue unaligned loads; below this GGUF weights are copied rather than used in place
+#define GGUF_MIN_ALIAS_ALIGNMENT 32
+
+namespace mllm {
+
+/**
+ * \brief mllm names of the llama.cpp tensors, in the layout of LLaMANameConfig. The defaults are the LLAMAROPE
+ *        names, which is also the rotary layout llama.cpp stores q/k weights in.
+ */
+struct GGUFNameMap {
+    std::string blk_name = "layers.";
+    std::string attn_base_name = "attention.";
+    std::string ffn_base_name = "feed_forward.";
+    std::string q_proj_name = "wq";
+    std::string k_proj_name = "wk";
+    std::string v_proj_name = "wv";
+    std::string o_proj_name = "wo";
+    std::string gate_proj_name = "w1";
+    std::string up_proj_name = "w3";
+    std::string down_proj_name = "w2";
+    std::string attn_norm_name = "attention_norm";
+    std::string ffn_norm_name = "ffn_norm";
+    std::string token_embd_name = "tok_embeddings";
+    std::string post_norm_name = "norm";
+    std::string lm_head_name = "output";
+
+    // any name config with the LLaMANameConfig fields, e.g. config.names_config
+    template <typename NameConfig>
+    static GGUFNameMap from(const NameConfig &names) {
+        GGUFNameMap map;
+        map.blk_name = names.blk_name;
+        map.attn_base_name = names._attn_base_name;
+        map.ffn_base_name = names._ffn_base_name;
+        map.q_proj_name = names._q_proj_name;
+        map.k_proj_name = names._k_proj_name;
+        map.v_proj_name = names._v_proj_name;
+        map.o_proj_name = names._o_proj_name;
+        map.gate_proj_name = names._gate_proj_name;
+        map.up_proj_name = names._up_proj_name;
+        map.down_proj_name = names._down_proj_name;
+        map.attn_norm_name = names._attn_norm_name;
+        map.ffn_norm_name = names._ffn_norm_name;
+        map.token_embd_name = names.token_embd_name;
+        map.post_norm_name = names.post_norm_name;
+        map.lm_head_name = names.lm_head_name;
+        return map;
+    }
+};
+
+/**
+ * \brief Loads weights straight from a llama.cpp GGUF file (v2 and v3). Metadata and tensor infos are parsed at
+ *        construction; tensor names are translated through a GGUFNameMap and ggml types onto mllm DataTypes, so
+ *        community-quantized models run without a conversion pass. With `use_mmap`, weights aligned to at least
+ *        GGUF_MIN_ALIAS_ALIGNMENT are used in place from the read-only(copy-on-write) mapping.
+ *        A model without `output.weight` (tied embeddings) serves the lm head from `token_embd.weight`.
+ */
+class GGUFParamLoader : public AbstructLoader {
+public:
+    explicit GGUFParamLoader(std::string filename, bool use_mmap = true, GGUFNameMap names = GGUFNameMap());
+    ~GGUFParamLoader();
+    bool load(mllm::Tensor *tensor) override;
+    bool load(std::shared_ptr<mllm::Tensor> tensor) override;
+    size_t getTensorSize(string name) override;
+    DataType getDataType(string name) override;
+    void setNames(const GGUFNameMap &names);
+    // mllm names of all tensors whose type is supported
+    vector<std::string> getParamNames();
+    bool isAvailible() const {
+        return fp_ != nullptr && !tensors_.empty();
+    }
+    bool isMmaped() const {
+        return buffer_ != nullptr;
+    }
+
+    bool hasKey(const std::string &key) const;
+    int64_t getInt(const std::string &key, int64_t default_value = 0) const;
+    double getFloat(const std::string &key, double default_value = 0) const;
+    std::string getString(const std::string &key, const std::string &default_value = "") const;
+    std::vector<std::string> getStringArray(const std::string &key) const;
+    std::vector<double> getNumberArray(const std::string &key) const;
+
+private:
+    struct TensorInfo {
+        std::string gguf_name;
+        std::vector<uint64_t> ne; // ne[0] is the innermost dimension
+        DataType type;            // MLLM_TYPE_COUNT if the ggml type has no mllm counterpart
+        uint32_t ggml_type;
+        uint64_t offset; // from the start of the file
+        uint64_t size;
+    };
+    struct Value {
+        uint32_t type;
+        int64_t i = 0;
+        double f = 0;
+        std::string s;
+        std::vector<std::string> strs;
+        std::vector<double> nums;
+    };
+
+    bool parse();
+    void mmapFile();
+    const TensorInfo *find(const std::string &name) const;
+
+    FILE *fp_;
+    uint8_t *buffer_ = nullptr;
+    std::string path_;
+    std::uint64_t size_ = 0;
+    bool use_mmap_;
+    std::map<std::string, Value> kv_;
+    std::map<std::string, TensorInfo> tensors_; // by gguf name
+    std::map<std::string, std::string> names_;  // mllm name -> gguf name
+};
+
+} // namespace mllm
+#endif // MLLM_GGUFPARAMLOADER_H
@@ -10,114 +10,206 @@
  */
 #include "Generate.hpp"
 #include <algorithm>
-#include <numeric>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace mllm {
 
-unsigned int _LlmTextGenerateGreedySearchMethod::generate(Tensor &t) {
-    std::vector<float> scores;
-    this->_tensor_to_vec(t, scores);
-    return std::max_element(scores.begin(), scores.end()) - scores.begin();
+namespace {
+float maxOf(const float *x, int n) {
+    float result = -std::numeric_limits<float>::infinity();
+    int i = 0;
+#if defined(__AVX__)
+    if (n >= 8) {
+        __m256 m = _mm256_loadu_ps(x);
+        for (i = 8; i + 8 <= n; i += 8) { m = _mm256_max_ps(m, _mm256_loadu_ps(x + i)); }
+        float lanes[8];
+        _mm256_storeu_ps(lanes, m);
+        result = *std::max_element(lanes, lanes + 8);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (n >= 4) {
+        float32x4_t m = vld1q_f32(x);
+        for (i = 4; i + 4 <= n; i += 4) { m = vmaxq_f32(m, vld1q_f32(x + i)); }
+        result = vmaxvq_f32(m);
+    }
+#endif
+    for (; i < n; ++i) { result = std::max(result, x[i]); }
+    return result;
 }
 
-unsigned int _LlmTextGenerateTopkSamplingMethod::generate(Tensor &t) {
-    auto argmax = [](const std::vector<float> &vec) -> unsigned int {
-        return std::distance(vec.begin(), std::max_element(vec.begin(), vec.end()));
-    };
-
-    if (m_k == 0 || m_k == 1) {
-        std::vector<float> scores;
-        this->_tensor_to_vec(t, scores);
-        return argmax(scores);
+// first index of the largest value, like std::max_element
+unsigned int argmaxOf(const float *x, int n) {
+    const float m = maxOf(x, n);
+    for (int i = 0; i < n; ++i) {
+        if (x[i] == m) { return i; }
     }
+    return 0;
+}
 
-    std::vector<std::pair<float, unsigned int>> scores;
-    this->_tensor_to_vec_with_idx(t, scores);
+// maps floats to unsigned ints of the same order
+inline uint32_t orderKey(float v) {
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    return (u & 0x80000000U) ? ~u : (u | 0x80000000U);
+}
 
-    // find top k
-    std::partial_sort(scores.begin(), scores.begin() + m_k, scores.end(),
-                      [](std::pair<float, unsigned int> a, std::pair<float, unsigned int> b) { return a.first > b.first; });
-    std::vector<float> top_k_elements(m_k, 0.f);
-    std::vector<unsigned int> top_k_elements_idx(m_k, 0);
-    for (int i = 0; i < m_k; ++i) {
-        top_k_elements[i] = scores[i].first;
-        top_k_elements_idx[i] = scores[i].second;
-    }
+// sign, exponent and 3 mantissa bits: values within 12.5% of each other share a bucket
+constexpr int kBucketBits = 12;
+constexpr int kBuckets = 1 << kBucketBits;
+inline uint32_t bucketOf(float v) {
+    return orderKey(v) >> (32 - kBucketBits);
+}
+} // namespace
 
-    // softmax with temperature
-    std::vector<float> softmax(top_k_elements.size(), 0.f);
-    double max_logit = top_k_elements[argmax(top_k_elements)];
-    double sum_exp = 0.f;
+void _LlmTextGenerateMethod::reset(const LlmTextGeneratorOpts &opt) {
+    repetition_penalty_ = opt.repetition_penalty;
+    frequency_penalty_ = opt.frequency_penalty;
+    history_.clear();
+    if (opt.seed >= 0) { rng_.seed((std::mt19937::result_type)opt.seed); }
+}
 
-    for (size_t i = 0; i < top_k_elements.size(); ++i) {
-        softmax[i] = exp((top_k_elements[i] - max_logit) / m_temperature);
-        sum_exp += softmax[i];
+void _LlmTextGenerateMethod::addHistory(unsigned int token, bool generated) {
+    if (repetition_penalty_ == 1.0F && frequency_penalty_ == 0.F) {
+        return;
     }
+    history_[token] += generated ? 1 : 0;
+}
 
-    for (float &value : softmax) {
-        value /= sum_exp;
+float *_LlmTextGenerateMethod::_sampled_row(Tensor &t, bool probabilities) {
+    assert(t.batch() == 1 && "Batch size of result is not 1. Which is not supported for now.");
+    assert(t.head() == 1 && "The 3rd dim of result should be one. e.g.:[1, 1, seq, hidden]");
+    const int n = t.dimension();
+    const int seq = _row_index(t);
+    // the penalties go into a copy, the logits may be read again by the caller
+    row_.resize(n);
+    if (t.dtype() == MLLM_TYPE_F32 && !t.aggregated() && t.hostPtr<float>() != nullptr) {
+        // the dimension is innermost for a single head
+        memcpy(row_.data(), t.ptrAt<float>(0, 0, seq, 0), n * sizeof(float));
+    } else {
+        for (int i = 0; i < n; ++i) { row_[i] = t.dataAt<float>(0, 0, seq, i); }
     }
-
-    // sampling
-    float _sum = std::accumulate(softmax.begin(), softmax.end(), 0.0);
-    for (float &value : softmax) {
-        value /= _sum;
+    float *values = row_.data();
+    if (history_.empty()) {
+        return values;
     }
-
-    auto idx = _sample_element(top_k_elements_idx, softmax);
-    return idx;
+    for (const auto &[token, count] : history_) {
+        if (token >= (unsigned)n) { continue; }
+        float &v = values[token];
+        if (probabilities) {
+            // softmax(logit - f) = p * exp(-f), renormalised below; this keeps the probabilities positive
+            v = v / repetition_penalty_ * std::exp(-frequency_penalty_ * (float)count);
+        } else {
+            v = v > 0 ? v / repetition_penalty_ : v * repetition_penalty_;
+            v -= frequency_penalty_ * (float)count;
+        }
+    }
+    if (probabilities) {
+        double sum = 0;
+        for (int i = 0; i < n; ++i) { sum += values[i]; }
+        if (sum > 0) {
+            const float scale = (float)(1.0 / sum);
+            for (int i = 0; i < n; ++i) { values[i] *= scale; }
+        }
+    }
+    return values;
 }
 
-unsigned int _LlmTextGenerateToppSamplingMethod::generate(Tensor &t) {
-    auto argmax = [](const std::vector<float> &vec) -> unsigned int {
-        return std::distance(vec.begin(), std::max_element(vec.begin(), vec.end()));
-    };
-    std::vector<std::pair<float, unsigned int>> scores;
-    this->_tensor_to_vec_with_idx(t, scores);
-
-    std::sort(scores.begin(), scores.end(), [](std::pair<float, unsigned int> a, std::pair<float, unsigned int> b) { return a.first > b.first; });
-    std::vector<float> top_k_elements;
-    std::vector<unsigned int> top_k_elements_idx;
-
-    if (scores[0].first > 1.f) {
-        throw std::runtime_error("The input tensor t should go through softmax first.(0.f - 1.f is acceptable)");
+void _LlmTextGenerateMethod::_top_k(const float *values, int n, int k, std::vector<unsigned int> &ids) {
+    ids.clear();
+    k = std::min(k, n);
+    // find the bucket holding the k-th largest value, everything above it is in the top k
+    bucket_count_.assign(kBuckets, 0);
+    for (int i = 0; i < n; ++i) { bucket_count_[bucketOf(values[i])]++; }
+    int boundary = kBuckets - 1;
+    for (uint32_t count = 0; boundary > 0; --boundary) {
+        count += bucket_count_[boundary];
+        if (count >= (uint32_t)k) { break; }
     }
-
-    float p = 0.f;
-    size_t idx = 0;
-    while (p < m_p) {
-        top_k_elements.emplace_back(scores[idx].first);
-        top_k_elements_idx.emplace_back(scores[idx].second);
-        p += scores[idx].first;
-        idx++;
+    for (int i = 0; i < n; ++i) {
+        if (bucketOf(values[i]) >= (uint32_t)boundary) { ids.push_back(i); }
     }
+    auto larger = [values](unsigned int a, unsigned int b) { return values[a] > values[b] || (values[a] == values[b] && a < b); };
+    std::partial_sort(ids.begin(), ids.begin() + k, ids.end(), larger);
+    ids.resize(k);
+}
 
-    if (top_k_elements.size() == 1) {
-        return top_k_elements_idx[0];
+void _LlmTextGenerateMethod::_top_p(const float *values, int n, float p, std::vector<unsigned int> &ids) {
+    ids.clear();
+    // find the bucket where the running sum from the top reaches p, the answer lies within the buckets above it
+    bucket_count_.assign(kBuckets, 0);
+    bucket_sum_.assign(kBuckets, 0.0);
+    for (int i = 0; i < n; ++i) {
+        const uint32_t bucket = bucketOf(values[i]);
+        bucket_count_[bucket]++;
+        bucket_sum_[bucket] += values[i];
     }
-
-    // softmax with temperature
-    std::vector<float> softmax(top_k_elements.size(), 0.f);
-    double max_logit = top_k_elements[argmax(top_k_elements)];
-    double sum_exp = 0.f;
-
-    for (size_t i = 0; i < top_k_elements.size(); ++i) {
-        softmax[i] = exp((top_k_elements[i] - max_logit) / m_temperature);
-        sum_exp += softmax[i];
+    int boundary = kBuckets - 1;
+    for (double sum = 0; boundary > 0; --boundary) {
+        sum += bucket_sum_[boundary];
+        if (sum >= p) { break; }
     }
+    for (int i = 0; i < n; ++i) {
+        if (bucketOf(values[i]) >= (uint32_t)boundary) { ids.push_back(i); }
+    }
+    auto larger = [values](unsigned int a, unsigned int b) { return values[a] > values[b] || (values[a] == values[b] && a < b); };
+    std::sort(ids.begin(), ids.end(), larger);
+    float sum = 0.F;
+    size_t kept = 0;
+    while (kept < ids.size() && sum < p) { sum += values[ids[kept++]]; }
+    ids.resize(std::max<size_t>(kept, 1));
+}
 
-    for (float &value : softmax) {
-        value /= sum_exp;
+unsigned int _LlmTextGenerateMethod::_sample(const float *values, const std::vector<unsigned int> &ids, float temperature) {
+    if (ids.size() == 1 || temperature <= 0.F) {
+        return ids[0];
+    }
+    // ids are largest first
+    const float max_value = values[ids[0]];
+    weights_.resize(ids.size());
+    double sum = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        weights_[i] = std::exp((values[ids[i]] - max_value) / temperature);
+        sum += weights_[i];
     }
+    double target = std::uniform_real_distribution<double>(0.0, sum)(rng_);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        target -= weights_[i];
+        if (target < 0) { return ids[i]; }
+    }
+    return ids.back();
+}
 
-    // sampling
-    float _sum = std::accumulate(softmax.begin(), softmax.end(), 0.0);
-    for (float &value : softmax) {
-        value /= _sum;
+unsigned int _LlmTextGenerateGreedySearchMethod::generate(Tensor &t) {
+    const float *values = this->_sampled_row(t);
+    return argmaxOf(values, t.dimension());
+}
+
+unsigned int _LlmTextGenerateTopkSamplingMethod::generate(Tensor &t) {
+    const float *values = this->_sampled_row(t);
+    const int n = t.dimension();
+    if (m_k == 0 || m_k == 1) {
+        return argmaxOf(values, n);
     }
+    this->_top_k(values, n, m_k, ids_);
+    return this->_sample(values, ids_, m_temperature);
+}
 
-    auto ret = _sample_element(top_k_elements_idx, softmax);
-    return ret;
+unsigned int _LlmTextGenerateToppSamplingMethod::generate(Tensor &t) {
+    const float *values = this->_sampled_row(t, true);
+    const int n = t.dimension();
+    if (maxOf(values, n) > 1.f) {
+        throw std::runtime_error("The input tensor t should go through softmax first.(0.f - 1.f is acceptable)");
+    }
+    this->_top_p(values, n, m_p, ids_);
+    return this->_sample(values, ids_, m_temperature);
 }
 
-} // namespace mllm
\ No newline at end of file
+} // namespace mllm
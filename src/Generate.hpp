@@ -16,6 +16,7 @@
 #include <vector>
 #include <random>
 #include <utility>
+#include <unordered_map>
 #include "Tensor.hpp"
 
 namespace mllm {
@@ -30,17 +31,16 @@ struct LlmTextGeneratorOpts {
     bool is_padding = false;
     int seq_before_padding = 0;
     int chunk_size = -1;
+    // > 1 makes the tokens already in the prompt or the output less likely (logit / penalty, or * penalty if negative;
+    // probability / penalty for top-p)
+    float repetition_penalty = 1.0F;
+    // subtracted from a logit once per time its token has been generated (for top-p, the probability is scaled by
+    // exp(-penalty) instead)
+    float frequency_penalty = 0.F;
+    // -1 seeds the sampler from std::random_device
+    int64_t seed = -1;
 };
 
-template <typename T>
-T _sample_element(const std::vector<T> &elements, const std::vector<float> &probabilities) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::discrete_distribution<> dist(probabilities.begin(), probabilities.end());
-    size_t index = dist(gen);
-    return elements[index];
-}
-
 enum class LLmTextGeneratorType : int32_t {
     kNone = 0,
     kGreedySearch,
@@ -53,8 +53,12 @@ class _LlmTextGenerateMethod {
     bool is_padding = false;
     int seq_before_padding = 0;
     int chunk_size = -1;
+    int row = -1;
 
 public:
+    _LlmTextGenerateMethod() :
+        rng_(std::random_device{}()) {
+    }
     virtual ~_LlmTextGenerateMethod() = default;
     virtual unsigned int generate(Tensor &t) = 0;
     inline void setPadding(bool is_padding, int seq_before_padding, int chunk_size) {
@@ -62,19 +66,24 @@ public:
         this->seq_before_padding = seq_before_padding;
         this->chunk_size = chunk_size;
     }
+    // sample from this row of the logits instead of the last one, e.g. one sequence of a packed batch
+    inline void setRow(int row) {
+        this->row = row;
+    }
+    /**
+     * \brief take the penalties and the seed of `opt` and forget the tokens seen so far.
+     */
+    void reset(const LlmTextGeneratorOpts &opt);
+    /**
+     * \brief count `token` for the penalties, done for every sampled token; prompt tokens only count for the
+     * repetition penalty.
+     */
+    void addHistory(unsigned int token, bool generated = true);
     inline void _tensor_to_vec(Tensor &t, std::vector<float> &scores) {
         assert(t.batch() == 1 && "Batch size of result is not 1. Which is not supported for now.");
         assert(t.head() == 1 && "The 3rd dim of result should be one. e.g.:[1, 1, seq, hidden]");
         int _dims = t.dimension();
-        int _seq = t.sequence() - 1;
-        // padding prefill for QNN
-        if (is_padding) {
-            if (chunk_size > 0) {
-                _seq = (seq_before_padding - 1) % chunk_size;
-            } else {
-                _seq = seq_before_padding - 1;
-            }
-        }
+        int _seq = _row_index(t);
         for (int i = 0; i < _dims; ++i) {
             auto value = t.dataAt<float>(0, 0, _seq, i);
             scores.push_back(value);
@@ -85,12 +94,59 @@ public:
         assert(t.batch() == 1 && "Batch size of result is not 1. Which is not supported for now.");
         assert(t.head() == 1 && "The 3rd dim of result should be one. e.g.:[1, 1, seq, hidden]");
         int _dims = t.dimension();
-        int _seq = t.sequence() - 1;
+        int _seq = row >= 0 ? row : t.sequence() - 1;
         for (int i = 0; i < _dims; ++i) {
             auto value = t.dataAt<float>(0, 0, _seq, i);
             scores.push_back(std::make_pair(value, i));
         }
     }
+
+protected:
+    inline int _row_index(Tensor &t) const {
+        int _seq = row >= 0 ? row : t.sequence() - 1;
+        // padding prefill for QNN
+        if (is_padding) {
+            if (chunk_size > 0) {
+                _seq = (seq_before_padding - 1) % chunk_size;
+            } else {
+                _seq = seq_before_padding - 1;
+            }
+        }
+        // a row past the logits, e.g. when Module::logits_rows cut them to fewer rows than the caller samples
+        assert(_seq >= 0 && _seq < t.sequence());
+        return _seq;
+    }
+    /**
+     * \brief a copy of the row sampled from, in reusable scratch, with the penalties applied. When the row holds
+     * `probabilities` (top-p) a penalty scales the probability as shifting the logit would, and the row is
+     * renormalised.
+     */
+    float *_sampled_row(Tensor &t, bool probabilities = false);
+    /**
+     * \brief ids of the k largest of the n values, largest first, found from a histogram of their leading bits
+     * instead of sorting the whole row.
+     */
+    void _top_k(const float *values, int n, int k, std::vector<unsigned int> &ids);
+    /**
+     * \brief ids of the fewest largest values that sum to at least p, largest first.
+     */
+    void _top_p(const float *values, int n, float p, std::vector<unsigned int> &ids);
+    /**
+     * \brief draw one of `ids` with probability softmax(values[id] / temperature).
+     */
+    unsigned int _sample(const float *values, const std::vector<unsigned int> &ids, float temperature);
+
+    std::mt19937 rng_;
+    // scratch reused across tokens
+    std::vector<float> row_;
+    std::vector<unsigned int> ids_;
+    std::vector<float> weights_;
+    std::vector<uint32_t> bucket_count_;
+    std::vector<double> bucket_sum_;
+    // penalties and what they apply to: token -> times generated (0 for prompt only tokens)
+    float repetition_penalty_ = 1.0F;
+    float frequency_penalty_ = 0.F;
+    std::unordered_map<unsigned int, int> history_;
 };
 
 class _LlmTextGenerateGreedySearchMethod : public _LlmTextGenerateMethod {
@@ -169,17 +225,41 @@ public:
         if (opt.is_padding) {
             m_method_class->setPadding(opt.is_padding, opt.seq_before_padding, opt.chunk_size);
         }
+        m_method_class->reset(opt);
+    }
+
+    /**
+     * \brief start a new sequence, see _LlmTextGenerateMethod::reset; `prompt` are its prompt token ids.
+     */
+    inline void reset(const LlmTextGeneratorOpts &opt, const std::vector<unsigned int> &prompt = {}) {
+        m_method_class->reset(opt);
+        for (auto token : prompt) { m_method_class->addHistory(token, false); }
     }
 
     inline unsigned int generate(Tensor &t) {
-        return m_method_class->generate(t);
+        auto token = m_method_class->generate(t);
+        m_method_class->addHistory(token);
+        return token;
     }
 
     inline unsigned int generate(Tensor &t, const LlmTextGeneratorOpts &opt) {
         if (opt.is_padding) {
             m_method_class->setPadding(opt.is_padding, opt.seq_before_padding, opt.chunk_size);
         }
-        return m_method_class->generate(t);
+        auto token = m_method_class->generate(t);
+        m_method_class->addHistory(token);
+        return token;
+    }
+
+    /**
+     * \brief sample the next token from row `row` of the logits.
+     */
+    inline unsigned int generate(Tensor &t, int row) {
+        m_method_class->setRow(row);
+        auto token = m_method_class->generate(t);
+        m_method_class->setRow(-1);
+        m_method_class->addHistory(token);
+        return token;
     }
 
     inline LLmTextGeneratorType type() {
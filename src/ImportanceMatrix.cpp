@@ -0,0 +1,141 @@
+#include "ImportanceMatrix.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+namespace mllm {
+
+// file layout: magic, version, entry count, then per entry the name length, name, rows, cols and cols floats
+static const uint32_t IMATRIX_MAGIC = 0x4D494C4D; // "MLIM"
+static const uint32_t IMATRIX_VERSION = 1;
+
+std::atomic<bool> ImportanceMatrix::enabled_{false};
+
+// never destroyed, the MLLM_IMATRIX exit hook may run after static destructors
+static std::mutex &statsMutex() {
+    static auto *mutex = new std::mutex();
+    return *mutex;
+}
+static std::unordered_map<std::string, ImportanceMatrix::Entry> &stats() {
+    static auto *entries = new std::unordered_map<std::string, ImportanceMatrix::Entry>();
+    return *entries;
+}
+
+void ImportanceMatrix::record(const std::string &weight_name, const float *x, int rows, int cols, int64_t row_stride) {
+    std::lock_guard<std::mutex> lock(statsMutex());
+    auto &entry = stats()[weight_name];
+    if (entry.sum_sq.empty()) {
+        entry.sum_sq.assign(cols, 0.0);
+    } else if ((int)entry.sum_sq.size() != cols) {
+        fprintf(stderr, "ImportanceMatrix: %s was recorded with %zu and %d channels, ignoring the latter\n",
+                weight_name.c_str(), entry.sum_sq.size(), cols);
+        return;
+    }
+    for (int r = 0; r < rows; ++r) {
+        const float *row = x + r * row_stride;
+        for (int c = 0; c < cols; ++c) {
+            entry.sum_sq[c] += (double)row[c] * row[c];
+        }
+    }
+    entry.rows += rows;
+}
+
+std::unordered_map<std::string, ImportanceMatrix::Entry> ImportanceMatrix::entries() {
+    std::lock_guard<std::mutex> lock(statsMutex());
+    return stats();
+}
+
+void ImportanceMatrix::clear() {
+    std::lock_guard<std::mutex> lock(statsMutex());
+    stats().clear();
+}
+
+bool ImportanceMatrix::save(const std::string &path) {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr) {
+        fprintf(stderr, "Can not open importance matrix file %s\n", path.c_str());
+        return false;
+    }
+    // sorted so that the same calibration run always produces the same file
+    std::map<std::string, Entry> sorted;
+    for (auto &item : entries()) {
+        if (item.second.rows > 0) { sorted.emplace(item.first, item.second); }
+    }
+    const uint32_t count = sorted.size();
+    fwrite(&IMATRIX_MAGIC, sizeof(uint32_t), 1, fp);
+    fwrite(&IMATRIX_VERSION, sizeof(uint32_t), 1, fp);
+    fwrite(&count, sizeof(uint32_t), 1, fp);
+    std::vector<float> mean_sq;
+    for (auto &item : sorted) {
+        const uint32_t name_len = item.first.size();
+        const uint32_t cols = item.second.sum_sq.size();
+        fwrite(&name_len, sizeof(uint32_t), 1, fp);
+        fwrite(item.first.data(), sizeof(char), name_len, fp);
+        fwrite(&item.second.rows, sizeof(uint64_t), 1, fp);
+        fwrite(&cols, sizeof(uint32_t), 1, fp);
+        mean_sq.resize(cols);
+        for (uint32_t c = 0; c < cols; ++c) {
+            mean_sq[c] = (float)(item.second.sum_sq[c] / (double)item.second.rows);
+        }
+        fwrite(mean_sq.data(), sizeof(float), cols, fp);
+    }
+    const bool ok = ferror(fp) == 0;
+    fclose(fp);
+    return ok;
+}
+
+bool ImportanceMatrix::load(const std::string &path, std::unordered_map<std::string, std::vector<float>> &importance) {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        fprintf(stderr, "Can not open importance matrix file %s\n", path.c_str());
+        return false;
+    }
+    uint32_t header[3];
+    if (fread(header, sizeof(uint32_t), 3, fp) != 3 || header[0] != IMATRIX_MAGIC || header[1] != IMATRIX_VERSION) {
+        fprintf(stderr, "%s is not an importance matrix file\n", path.c_str());
+        fclose(fp);
+        return false;
+    }
+    for (uint32_t i = 0; i < header[2]; ++i) {
+        uint32_t name_len = 0;
+        uint64_t rows = 0;
+        uint32_t cols = 0;
+        std::string name;
+        bool ok = fread(&name_len, sizeof(uint32_t), 1, fp) == 1;
+        if (ok) {
+            name.resize(name_len);
+            ok = fread(&name[0], sizeof(char), name_len, fp) == name_len
+                 && fread(&rows, sizeof(uint64_t), 1, fp) == 1
+                 && fread(&cols, sizeof(uint32_t), 1, fp) == 1;
+        }
+        if (ok) {
+            auto &values = importance[name];
+            values.resize(cols);
+            ok = fread(values.data(), sizeof(float), cols, fp) == cols;
+        }
+        if (!ok) {
+            fprintf(stderr, "Importance matrix file %s is truncated\n", path.c_str());
+            fclose(fp);
+            return false;
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+namespace {
+struct ImatrixFromEnv {
+    ImatrixFromEnv() {
+        if (std::getenv("MLLM_IMATRIX") != nullptr) {
+            ImportanceMatrix::enable();
+            // only processes that ran a model write the file, so the quantizer can read it with the variable still set
+            std::atexit([] {
+                if (!ImportanceMatrix::entries().empty()) { ImportanceMatrix::save(std::getenv("MLLM_IMATRIX")); }
+            });
+        }
+    }
+} imatrix_from_env;
+} // namespace
+
+} // namespace mllm
@@ -0,0 +1,61 @@
+//
+// Calibration statistics for importance-weighted quantization.
+//
+
+#ifndef MLLM_IMPORTANCEMATRIX_HPP
+#define MLLM_IMPORTANCEMATRIX_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * \brief Accumulates, for every Linear weight, the sum of squared input activations per input channel while a
+ * calibration corpus runs through the model. The quantizer weights each value's rounding error by the mean square
+ * activation of its channel, so channels that carry large activations are rounded more carefully.
+ * The quantize_row_*_weighted functions take this as `quant_weights`: one importance per value of the row, i.e. the
+ * mean square activation of the input channel that value multiplies.
+ *
+ * Setting the MLLM_IMATRIX environment variable to a file path enables collection at startup and saves the
+ * statistics there when the process exits, so any demo can be used to calibrate.
+ */
+class ImportanceMatrix {
+public:
+    struct Entry {
+        std::vector<double> sum_sq; // per input channel
+        uint64_t rows = 0;
+    };
+
+    static void enable(bool on = true) {
+        enabled_.store(on, std::memory_order_relaxed);
+    }
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    /**
+     * \brief add `rows` activation rows of `cols` floats, `row_stride` floats apart, to the statistics of `weight_name`.
+     */
+    static void record(const std::string &weight_name, const float *x, int rows, int cols, int64_t row_stride);
+    static std::unordered_map<std::string, Entry> entries();
+    static void clear();
+
+    /**
+     * \brief write the mean square activation per channel of every recorded weight.
+     */
+    static bool save(const std::string &path);
+    /**
+     * \brief read a file written by save() into `importance`, keyed by weight name.
+     */
+    static bool load(const std::string &path, std::unordered_map<std::string, std::vector<float>> &importance);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_IMPORTANCEMATRIX_HPP
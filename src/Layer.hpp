@@ -15,6 +15,9 @@
 #include "Op.hpp"
 #include "ParamLoader.hpp"
 #include "Backend.hpp"
+#include "Profiler.hpp"
+#include "OpFusion.hpp"
+#include "memory/ActivationMemoryPlanner.hpp"
 
 #include <Module.hpp>
 
@@ -227,10 +230,23 @@ protected:
         case TENSOR_STATIC_INIT: {
             op_->reshape(input_tensors, output_tensors);
             op_->setUp(input_tensors, output_tensors);
+            vector<Tensor *> inputs_ptr, outputs_ptr;
+            for (auto &t : input_tensors) { inputs_ptr.push_back(t.get()); }
+            for (auto &t : output_tensors) { outputs_ptr.push_back(t.get()); }
+            OpFusion::record(op_, (OpType)param_["type"], backend_, inputs_ptr, outputs_ptr);
+            ActivationMemoryPlanner::recordUses(inputs_ptr, outputs_ptr);
             break;
         }
         case TENSOR_STATIC_READY: {
-            op_->execute(input_tensors, output_tensors);
+            bool profile = OpProfiler::enabled();
+            int64_t start_us = profile ? mllm_time_us() : 0;
+            if (!OpFusion::replaced(input_tensors, output_tensors)) { op_->execute(input_tensors, output_tensors); }
+            if (profile) {
+                vector<Tensor *> inputs_ptr, outputs_ptr;
+                for (auto &t : input_tensors) { inputs_ptr.push_back(t.get()); }
+                for (auto &t : output_tensors) { outputs_ptr.push_back(t.get()); }
+                OpProfiler::record(op_->name(), OpNames[(int)param_["type"]], inputs_ptr, outputs_ptr, backend_, start_us);
+            }
             break;
         }
         default: {
@@ -276,6 +292,30 @@ public:
     }
 };
 
+/**
+ * \brief Linears with the given names that all read the same input, run as one op (see CPUMergedLinear).
+ * Returns one output per name; the weights are still loaded by the names of the parts.
+ */
+class MergedLinear final : public Layer {
+public:
+    MergedLinear() = default;
+    explicit MergedLinear(int in_features, const vector<int> &out_features, bool bias, const vector<std::string> &names) {
+        assert(out_features.size() == names.size());
+        param_["in_features"] = in_features;
+        param_["part_num"] = (float)out_features.size();
+        for (size_t i = 0; i < out_features.size(); ++i) {
+            param_["out_features_" + std::to_string(i)] = (float)out_features[i];
+        }
+        param_["bias"] = (float)bias;
+        std::string name;
+        for (const auto &part : names) { name += (name.empty() ? "" : "+") + part; }
+        init(std::move(name), OpType::MERGEDLINEAR);
+    }
+    vector<std::reference_wrapper<Tensor>> operator()(Tensor &input) {
+        return run({input}, (int)param_["part_num"]);
+    }
+};
+
 class SparseIdLinear final : public Layer {
 public:
     SparseIdLinear(int in_dim, int out_dim, std::string name) {
@@ -509,6 +549,9 @@ public:
     void clearCache() {
         return op_->clearCache();
     }
+
+private:
+    friend class KVCache;
 };
 
 class IRoPE final : public Layer {
@@ -561,6 +604,18 @@ public:
         param_["for_xnn"] = for_xnn;
         init(std::move(name), OpType::KVCACHE);
     }
+    /**
+     * \brief paged KVCache: K/V are stored in blocks of `block_size` tokens drawn from a shared
+     * pool, so memory grows with the context instead of being reserved for `cache_max` up front.
+     * The output is read through Tensor::mm (see MultiHeadAttention).
+     */
+    explicit KVCache(int n_rep, int cache_max, int block_size, std::string name) {
+        param_["n_rep"] = n_rep;
+        param_["cache_max"] = cache_max;
+        param_["for_xnn"] = false;
+        param_["block_size"] = block_size;
+        init(std::move(name), OpType::KVCACHE);
+    }
     explicit KVCache(int n_rep, int cache_max, std::string name, bool npuEnbaled) {
         param_["n_rep"] = n_rep;
         param_["cache_max"] = cache_max;
@@ -581,6 +636,47 @@ public:
     void clearCache() {
         return op_->clearCache();
     }
+    /**
+     * \brief drop the last n cached tokens; RoPE layers bound with bindRoPE move back with the cache.
+     */
+    void rollbackCache(int n) {
+        return op_->rollbackCache(n);
+    }
+    /**
+     * \brief when the cache is full, keep the first `sink_size` tokens and evict the oldest of the
+     * others, `evict_size` at a time (StreamingLLM), instead of exiting. Must be set before the first run.
+     */
+    void setEviction(int sink_size, int evict_size) {
+        param_["sink_size"] = sink_size;
+        param_["evict_size"] = evict_size;
+    }
+    /**
+     * \brief store K/V as F32, or quantized to Q8_0 / Q4_0 on append, instead of F16. A quantized cache
+     * keeps kv heads only and must be read by ScaledDotProductAttention. Must be set before the first run.
+     */
+    void setCacheDtype(DataType dtype) {
+        param_["cache_dtype"] = dtype;
+    }
+    bool quantized() {
+        auto it = param_.find("cache_dtype");
+        return it != param_.end() && (it->second == MLLM_TYPE_Q8_0 || it->second == MLLM_TYPE_Q4_0);
+    }
+    /**
+     * \brief let the cache re-base the positions of these RoPE layers when it evicts tokens.
+     * \param k_rope the RoPE that produced the cached keys, they are re-rotated with it.
+     * \param others other RoPE layers sharing the positions, e.g. the one for queries.
+     */
+    void bindRoPE(RoPE &k_rope, vector<RoPE *> others = {}) {
+        if (op_ == nullptr || k_rope.op_ == nullptr) { return; }
+        vector<Op *> rope_ops = {k_rope.op_};
+        for (auto *layer : others) {
+            if (layer->op_ != nullptr) { rope_ops.push_back(layer->op_); }
+        }
+        op_->bindRoPE(rope_ops);
+    }
+
+private:
+    friend class PrefixCache;
 };
 
 class LayerNorm final : public Layer {
@@ -933,15 +1029,30 @@ public:
 
 class ScaledDotProductAttention final : public Layer {
 public:
+    ScaledDotProductAttention() = default;
     explicit ScaledDotProductAttention(std::string name) {
         init(std::move(name), OpType::SDPA);
     }
+    /**
+     * \brief fused softmax(Q K^T / sqrt(D)) V. On CPU this is a tiled flash attention that reads the
+     * KVCache output directly, handles GQA (fewer K/V heads than Q heads) and never builds the score matrix.
+     */
+    explicit ScaledDotProductAttention(bool causal, std::string name) {
+        param_["causal"] = causal;
+        init(std::move(name), OpType::SDPA);
+    }
 
     // Q, K, V
     Tensor &operator()(Tensor &Q, Tensor &K, Tensor &V) {
         auto ts = run({Q, K, V}, 1); // Q, K, V
         return ts[0].get();
     }
+    // Q, K, V and the number of valid keys, e.g. KVCache::getCacheSeqLen()
+    Tensor &operator()(Tensor &Q, Tensor &K, Tensor &V, int kv_len) {
+        auto kv_len_tensor = Tensor(kv_len, backend_);
+        auto ts = run({Q, K, V, kv_len_tensor}, 1);
+        return ts[0].get();
+    }
 };
 //  Only for QNN END
 
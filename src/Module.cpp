@@ -3,6 +3,7 @@
 //
 
 #include "Module.hpp"
+#include "Profiler.hpp"
 #include "Types.hpp"
 
 namespace mllm {
@@ -47,11 +48,19 @@ vector<double> Module::profiling(string name) {
         MLLM_LOG_INFO_STREAM << "  Inference latency: " << mean_time / 1000.0F << " s" << std::endl;
         output = {load_time_s, inference_time_s};
     }
+    if (memory_planner_ != nullptr) {
+        MLLM_LOG_INFO_STREAM << "  Activation arena: " << memory_planner_->arenaBytes() / (1024.0 * 1024.0) << " MB (last step "
+                             << memory_planner_->plannedBytes() / (1024.0 * 1024.0) << " MB of "
+                             << memory_planner_->requestedBytes() / (1024.0 * 1024.0) << " MB requested)" << std::endl;
+    }
     // double sum_time = std::accumulate(std::begin(inference_times_), std::end(inference_times_), 0.0);
     // MLLM_LOG_INFO_STREAM<<sum_time<< " - "<<Tensor::forward_times<<" = "<<sum_time-Tensor::forward_times<<std::endl;
     // MLLM_LOG_INFO_STREAM<<Tensor::forward_times<< " - "<<Tensor::forward_times_2<<" = "<<Tensor::forward_times-Tensor::forward_times_2<<std::endl;
 
     MLLM_LOG_INFO_STREAM << "===========================================" << std::endl;
+    if (OpProfiler::enabled()) {
+        OpProfiler::printSummary();
+    }
 
     prefilling_token_size_ = 0;
     decoding_token_size_ = 0;
@@ -87,13 +96,21 @@ void Module::generate(
         if (!text_generator_ || text_generator_->type() != LLmTextGeneratorType::kTopkSampling)
             text_generator_ = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kTopkSampling, opt);
     }
+    vector<unsigned> prompt(input_ids.sequence());
+    for (int s = 0; s < input_ids.sequence(); ++s) { prompt[s] = (unsigned)input_ids.dataAt<float>(0, 0, s, 0); }
+    text_generator_->reset(opt, prompt);
 
+    // only the last position is sampled from
+    const int logits_rows_before = logits_rows;
+    if (logits_rows == 0) { logits_rows = 1; }
     for (int step = 0; step < opt.max_new_tokens; ++step) {
-        auto _out = (*this)({input_ids});
+        // opt.chunk_size of a padded (QNN) prefill is handled by the model
+        auto _out = step == 0 && !opt.is_padding ? prefill(input_ids, opt.chunk_size) : (*this)({input_ids});
         auto out_token = text_generator_->generate(_out[0]);
         if (!call_back(out_token)) break;
         chatPostProcessing(out_token, input_ids, {});
     }
+    logits_rows = logits_rows_before;
 }
 vector<unsigned> Module::generate(Tensor &input_ids, const LlmTextGeneratorOpts &opt, int end_token) {
     auto chatPostProcessing = [](unsigned token_idx, Tensor &tokens_tensor, const vector<Tensor *> &clean_tensors) {
@@ -120,14 +137,54 @@ vector<unsigned> Module::generate(Tensor &input_ids, const LlmTextGeneratorOpts
         if (!text_generator_ || text_generator_->type() != LLmTextGeneratorType::kTopkSampling)
             text_generator_ = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kTopkSampling, opt);
     }
+    vector<unsigned> prompt(input_ids.sequence());
+    for (int s = 0; s < input_ids.sequence(); ++s) { prompt[s] = (unsigned)input_ids.dataAt<float>(0, 0, s, 0); }
+    text_generator_->reset(opt, prompt);
     vector<unsigned> result;
+    const int logits_rows_before = logits_rows;
+    if (logits_rows == 0) { logits_rows = 1; }
     for (int step = 0; step < opt.max_new_tokens; ++step) {
-        auto _out = (*this)({input_ids});
+        auto _out = step == 0 && !opt.is_padding ? prefill(input_ids, opt.chunk_size) : (*this)({input_ids});
         auto out_token = text_generator_->generate(_out[0]);
         result.push_back(out_token);
         if (end_token != -1 && out_token == end_token) break;
         chatPostProcessing(out_token, input_ids, {});
     }
+    logits_rows = logits_rows_before;
     return result;
 }
-} // namespace mllm
\ No newline at end of file
+
+vector<Tensor> Module::prefill(Tensor &input_ids, int chunk_size) {
+    const int seq = input_ids.sequence();
+    if (chunk_size <= 0 || seq <= chunk_size) {
+        return (*this)({input_ids});
+    }
+    // the causal mask of every chunk is offset by the cached tokens, see CPUSoftMax and CPUFlashAttention
+    vector<Tensor> outputs;
+    // profiling() counts the whole prompt as one prefill step
+    const bool first_step = prefilling_token_size_ == 0;
+    const size_t first_time = inference_times_.size();
+    Tensor chunk(Backend::global_backends[MLLM_CPU]);
+    for (int begin = 0; begin < seq; begin += chunk_size) {
+        const int len = std::min(chunk_size, seq - begin);
+        chunk.reshape(1, 1, len, 1);
+        chunk.alloc();
+        for (int s = 0; s < len; ++s) { chunk.setDataAt<float>(0, 0, s, 0, input_ids.dataAt<float>(0, 0, begin + s, 0)); }
+        chunk.setName(input_ids.name());
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        chunk.setTtype(INPUT_TENSOR);
+        outputs = (*this)({chunk});
+    }
+    chunk.free();
+    if (first_step) {
+        prefilling_token_size_ = seq;
+        decoding_token_size_ = 0;
+    }
+    if (inference_times_.size() > first_time) {
+        const double prefill_time = std::accumulate(inference_times_.begin() + first_time, inference_times_.end(), 0.0);
+        inference_times_.resize(first_time);
+        inference_times_.push_back(prefill_time);
+    }
+    return outputs;
+}
+} // namespace mllm
@@ -8,6 +8,8 @@
 #include "Tensor.hpp"
 #include "Op.hpp"
 #include "ParamLoader.hpp"
+#include "GGUFParamLoader.hpp"
+#include "OpFusion.hpp"
 #include "Backend.hpp"
 #include "Timing.hpp"
 #include "Types.hpp"
@@ -16,6 +18,7 @@
 #include <functional>
 #include <iostream>
 #include <memory/SystemMemoryManager.hpp>
+#include <memory/ActivationMemoryPlanner.hpp>
 #include <memory>
 #include <ostream>
 #include <utility>
@@ -23,6 +26,7 @@
 #include <unordered_map>
 
 namespace mllm {
+class KVCache;
 
 class Module {
 protected:
@@ -33,6 +37,8 @@ protected:
     vector<vector<int>> last_shape_bshd_;
     std::shared_ptr<LlmTextGenerator> text_generator_ = nullptr;
     BackendType device_ = BackendType::MLLM_CPU;
+    std::shared_ptr<ActivationMemoryPlanner> memory_planner_ = nullptr;
+    std::shared_ptr<OpFusion> op_fusion_ = nullptr;
 
 public:
     map<string, shared_ptr<Tensor>> activation_tensors;
@@ -53,6 +59,30 @@ public:
 
     static std::unordered_map<string, shared_ptr<Op>> tensor_func_ops; // use for QNN
 
+    // place the activations of CPU models in one arena planned from their lifetimes
+    static inline bool use_memory_planner = true;
+    // run common op chains of CPU models as fused kernels, see OpFusion
+    static inline bool use_op_fusion = true;
+    // build the q/k/v and gate/up projections of CPU models as one MergedLinear each; read when a model is constructed
+    static inline bool merge_projections = false;
+    // run the final norm and lm_head of the causal LMs on the last `logits_rows` positions only, the ones sampled
+    // from (1 when generating, k + 1 to verify k draft tokens); 0 keeps the logits of every position
+    static inline int logits_rows = 0;
+
+    /**
+     * \brief `x` clipped to the positions the logits are computed for, see logits_rows.
+     */
+    static Tensor logitsRows(Tensor &x) {
+        const int seq = x.sequence();
+        if (logits_rows <= 0 || seq <= logits_rows) {
+            return x;
+        }
+        if (logits_rows == 1) {
+            return x.clip({}, {}, {-1}, {});
+        }
+        return x.clip({}, {}, {seq - logits_rows, seq}, {});
+    }
+
 private:
     template <typename... Args>
     vector<std::any> convertArgsToAnyVector(Args... args) {
@@ -106,9 +136,16 @@ public:
         device_ = type;
     }
 
-    void load(string path) {
+    void load(string path, bool use_mmap = true) {
         // create global loader and save to llm_model_ptr.loader as QNNBackend needs to load weights in runtime
-        loader = new ParamLoader(std::move(path));
+        // with use_mmap, weights alias the mapped file, so the loader must outlive the model.
+        // .gguf files are read with the default (LLAMAROPE) names; other layouts pass a GGUFParamLoader built
+        // with GGUFNameMap::from(names_config) to load(AbstructLoader &).
+        if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".gguf") == 0) {
+            loader = new GGUFParamLoader(std::move(path), use_mmap);
+        } else {
+            loader = new ParamLoader(std::move(path), use_mmap);
+        }
         load(*loader);
     }
     void load(AbstructLoader &param_loader) {
@@ -200,6 +237,13 @@ public:
                             need_setup = true;
                             break;
                         }
+                        // KV caches grow on every step even when the input shape repeats (multi-token verify
+                        // or prefill chunks), and a packed continuous-batching step may mix other sequences
+                        auto cpu_backend = dynamic_cast<CPUBackend *>(Backend::global_backends[MLLM_CPU]);
+                        if (!get_kvcache().empty() || (cpu_backend != nullptr && !cpu_backend->sequenceBatch().empty())) {
+                            need_setup = true;
+                            break;
+                        }
                         need_setup = false;
                     }
                 }
@@ -208,11 +252,42 @@ public:
 
             uint64_t time_start = mllm_time_us();
             if (need_setup) {
-                Forward(inputs, anyArgs);
+                const bool fuse_ops = use_op_fusion && device_ == MLLM_CPU && !OpFusion::recording();
+                if (fuse_ops) {
+                    if (op_fusion_ == nullptr) { op_fusion_ = std::make_shared<OpFusion>(); }
+                    op_fusion_->begin(activation_tensors);
+                } else {
+                    op_fusion_ = nullptr;
+                }
+                auto output_ptrs = [&](vector<Tensor> &outputs) {
+                    vector<Tensor *> ptrs;
+                    for (auto &output : outputs) {
+                        auto it = activation_tensors.find(output.name());
+                        if (it != activation_tensors.end()) { ptrs.push_back(it->second.get()); }
+                    }
+                    return ptrs;
+                };
+                if (use_memory_planner && device_ == MLLM_CPU && !ActivationMemoryPlanner::planning()) {
+                    if (memory_planner_ == nullptr) {
+                        memory_planner_ = std::make_shared<ActivationMemoryPlanner>(Backend::global_backends[MLLM_CPU]);
+                    }
+                    vector<string> input_names;
+                    for (auto &input : inputs) { input_names.push_back(input.name()); }
+                    memory_planner_->begin(activation_tensors, input_names);
+                    auto outputs = Forward(inputs, anyArgs);
+                    // fusion may change the dtype of tensors the planner is about to place
+                    if (fuse_ops) { op_fusion_->finish(output_ptrs(outputs)); }
+                    memory_planner_->finish(output_ptrs(outputs));
+                } else {
+                    auto outputs = Forward(inputs, anyArgs);
+                    if (fuse_ops) { op_fusion_->finish(output_ptrs(outputs)); }
+                }
             }
             Tensor::tensor_status = TENSOR_STATIC_READY;
             // uint64_t time_start = mllm_time_us();
+            if (op_fusion_ != nullptr) { op_fusion_->startReplay(); }
             auto output = Forward(inputs, anyArgs);
+            if (op_fusion_ != nullptr) { op_fusion_->stopReplay(); }
             uint64_t time_end = mllm_time_us();
 
             double inference_time_ = (time_end - time_start) / 1000.0F; // ms
@@ -313,6 +388,13 @@ public:
         activation_tensors.clear();
     }
 
+    /**
+     * \brief the fusions chosen for the last forward, nullptr when op fusion is off.
+     */
+    const OpFusion *opFusion() const {
+        return op_fusion_.get();
+    }
+
     void setNoLoadWeightsDtype(DataType dtype) {
         llm_model_ptr = this;
         Op::noLoadWeightsDtype() = dtype;
@@ -320,11 +402,24 @@ public:
     virtual void clear_kvcache() {
         ;
     }
+    /**
+     * \brief every KVCache of the model in layer order, e.g. to snapshot a prompt prefix (see PrefixCache).
+     */
+    virtual vector<KVCache *> get_kvcache() {
+        return {};
+    }
     vector<double> profiling(string name = "");
     virtual void generate(
         Tensor &input_ids, const LlmTextGeneratorOpts &opt, const std::function<bool(unsigned int)> &call_back = [](unsigned int) -> bool { return true; });
 
     vector<unsigned> generate(Tensor &input_ids, const LlmTextGeneratorOpts &opt, int end_token = -1);
+    /**
+     * \brief run the prompt `input_ids` ([1, 1, seq, 1]) through the model `chunk_size` tokens at a time, each chunk
+     * appending to the KV caches and attending to the tokens cached before it, and return the outputs of the last
+     * chunk. Activations then scale with the chunk size instead of the prompt length. chunk_size <= 0 runs the
+     * prompt at once.
+     */
+    vector<Tensor> prefill(Tensor &input_ids, int chunk_size);
 };
 
 } // namespace mllm
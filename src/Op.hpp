@@ -124,6 +124,35 @@ public:
         assert(type_ == OpType::KVCACHE || type_ == OpType::KVCACHENPU || type_ == OpType::IROPE || type_ == OpType::ROPE);
         std::cout << "only for KVCache" << std::endl;
     }
+    /**
+     * \brief drop the last n cached tokens, e.g. draft tokens rejected by speculative decoding.
+     * Bound RoPE ops move back with the cache.
+     */
+    virtual void rollbackCache(int n) {
+        assert(type_ == OpType::KVCACHE);
+        std::cout << "only for KVCache" << std::endl;
+    }
+    /**
+     * \brief bind the RoPE ops whose positions follow this KVCache, so that they can be re-based when
+     * the cache evicts tokens. rope_ops[0] produced the cached keys and is also used to re-rotate them.
+     */
+    virtual void bindRoPE(vector<Op *> rope_ops) {
+    }
+    /**
+     * \brief copy the cached tokens [begin, end) into `rows` ([batch, head, end - begin, dimension]).
+     */
+    virtual void copyCacheTo(int begin, int end, Tensor &rows) {
+        assert(type_ == OpType::KVCACHE);
+        std::cout << "only for KVCache" << std::endl;
+    }
+    /**
+     * \brief write `rows` back as tokens [begin, begin + rows.sequence()) and make that the cache length.
+     * Bound RoPE ops continue from the new length.
+     */
+    virtual void copyCacheFrom(int begin, Tensor &rows) {
+        assert(type_ == OpType::KVCACHE);
+        std::cout << "only for KVCache" << std::endl;
+    }
 
     static DataType &noLoadWeightsDtype() {
         return no_load_weights_dtype_;
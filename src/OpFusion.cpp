@@ -0,0 +1,320 @@
+#include "OpFusion.hpp"
+#include "Backend.hpp"
+#include "ImportanceMatrix.hpp"
+#include "Op.hpp"
+#include "Tensor.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+#include "backends/cpu/op/CPULinear.hpp"
+#include "backends/cpu/op/CPUMergedLinear.hpp"
+#include "backends/cpu/op/CPURMSNorm.hpp"
+#include "backends/cpu/op/CPUSiLU.hpp"
+#include "backends/cpu/op/CPUSoftMax.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace mllm {
+
+OpFusion *OpFusion::recording_ = nullptr;
+OpFusion *OpFusion::replaying_ = nullptr;
+
+static bool isF32(const Tensor *tensor) {
+    return tensor != nullptr && tensor->dtype() == MLLM_TYPE_F32;
+}
+
+// row-wise kernels read and write each (b, h, s) row of the tensors at the same index
+static bool sameRows(Tensor *a, Tensor *b) {
+    return a->batch() == b->batch() && a->head() == b->head() && a->sequence() == b->sequence()
+           && a->dimension() == b->dimension() && a->ctype() == b->ctype();
+}
+
+static vector<shared_ptr<Tensor>> borrow(const vector<Tensor *> &tensors) {
+    vector<shared_ptr<Tensor>> borrowed;
+    borrowed.reserve(tensors.size());
+    for (auto *tensor : tensors) { borrowed.push_back(std::shared_ptr<Tensor>(tensor, [](Tensor *) {})); }
+    return borrowed;
+}
+
+void OpFusion::begin(const std::map<std::string, std::shared_ptr<Tensor>> &tensors) {
+    tensors_ = &tensors;
+    nodes_.clear();
+    fusions_.clear();
+    last_writer_.clear();
+    std::fill(counts_, counts_ + PATTERN_NUM, 0);
+    recording_ = this;
+}
+
+Tensor *OpFusion::activation(Tensor *tensor) const {
+    if (tensor == nullptr) { return nullptr; }
+    // copies of an activation made by Module::Forward count as the activation of the same name
+    auto it = tensors_->find(tensor->name());
+    return it == tensors_->end() ? nullptr : it->second.get();
+}
+
+void OpFusion::record(Op *op, OpType type, Backend *backend, std::vector<Tensor *> &reads, const std::vector<Tensor *> &outputs) {
+    if (recording_ == nullptr) { return; }
+    Node node;
+    node.op = op;
+    node.type = type;
+    node.backend = backend;
+    if (type == LINEAR && backend->type() == MLLM_CPU) {
+        if (auto *linear = dynamic_cast<CPULinear *>(op)) { node.vec_dot_type = linear->quantizedInputType(); }
+    } else if (type == MERGEDLINEAR && backend->type() == MLLM_CPU) {
+        if (auto *linear = dynamic_cast<CPUMergedLinear *>(op)) { node.vec_dot_type = linear->quantizedInputType(); }
+    }
+    recording_->add(std::move(node), reads, outputs);
+}
+
+void OpFusion::record(TensorFuncType type, const std::vector<float> &args, Backend *backend, std::vector<Tensor *> &reads,
+                      const std::vector<Tensor *> &outputs) {
+    if (recording_ == nullptr) { return; }
+    Node node;
+    node.type = type;
+    node.args = args;
+    node.backend = backend;
+    recording_->add(std::move(node), reads, outputs);
+}
+
+void OpFusion::add(Node node, std::vector<Tensor *> &reads, const std::vector<Tensor *> &outputs) {
+    for (auto *tensor : reads) { node.inputs.push_back(activation(tensor)); }
+    for (auto *tensor : outputs) {
+        auto *resolved = activation(tensor);
+        node.outputs.push_back(resolved != nullptr ? resolved : tensor);
+    }
+    const int index = (int)nodes_.size();
+    nodes_.push_back(std::move(node));
+    match(index, reads);
+    for (auto *tensor : nodes_[index].outputs) { last_writer_[tensor] = index; }
+}
+
+void OpFusion::match(int consumer, std::vector<Tensor *> &reads) {
+    Node &c = nodes_[consumer];
+    if (c.backend == nullptr || c.backend->type() != MLLM_CPU || c.outputs.empty() || !isF32(c.outputs[0])) { return; }
+    auto writer = [&](int input) -> int {
+        if (input >= (int)c.inputs.size() || c.inputs[input] == nullptr) { return -1; }
+        auto it = last_writer_.find(c.inputs[input]);
+        if (it == last_writer_.end()) { return -1; }
+        const Node &p = nodes_[it->second];
+        if (p.fusion >= 0 || p.backend == nullptr || p.backend->type() != MLLM_CPU || p.outputs[0] != c.inputs[input]) { return -1; }
+        for (auto *tensor : p.inputs) {
+            if (!isF32(tensor)) { return -1; } // the fused kernel reads them, so they must be activations
+        }
+        return isF32(p.outputs[0]) ? it->second : -1;
+    };
+    auto add_fusion = [&](Fusion fusion, const std::vector<Tensor *> &extra_reads) {
+        const int index = (int)fusions_.size();
+        nodes_[fusion.producer].fusion = index;
+        c.fusion = index;
+        fusions_.push_back(fusion);
+        reads.insert(reads.end(), extra_reads.begin(), extra_reads.end());
+    };
+    if (c.op == nullptr && c.type == FUNC_TTMUL && reads.size() == 2) {
+        for (int k = 0; k < 2; ++k) {
+            const int p = writer(k);
+            if (p < 0 || nodes_[p].type != SILU || dynamic_cast<CPUSiLU *>(nodes_[p].op) == nullptr) { continue; }
+            Tensor *gate = nodes_[p].inputs[0];
+            Tensor *up = reads[1 - k];
+            if (c.inputs[1 - k] == c.inputs[k] || !isF32(up) || !sameRows(gate, up) || !sameRows(gate, c.outputs[0])) { continue; }
+            add_fusion({SWIGLU, p, consumer, k}, {gate});
+            return;
+        }
+    } else if (c.op != nullptr && c.type == SOFTMAX) {
+        auto *softmax = dynamic_cast<CPUSoftMax *>(c.op);
+        const int p = writer(0);
+        if (softmax == nullptr || softmax->axis() != DIMENSION || p < 0 || nodes_[p].op != nullptr
+            || (nodes_[p].type != FUNC_DIV && nodes_[p].type != FUNC_MUL) || nodes_[p].args.empty()) {
+            return;
+        }
+        const float factor = nodes_[p].args[0];
+        const float scale = nodes_[p].type == FUNC_DIV ? 1.0F / factor : factor;
+        if (!(scale > 0.0F) || !std::isfinite(scale)) { return; }
+        Fusion fusion{SCALED_SOFTMAX, p, consumer};
+        fusion.scale = scale;
+        add_fusion(fusion, {nodes_[p].inputs[0]});
+    } else if (c.op != nullptr && c.type == RMSNORM && reads.size() == 1) {
+        const int p = writer(0);
+        if (dynamic_cast<CPURMSNorm *>(c.op) == nullptr || p < 0 || nodes_[p].op != nullptr || nodes_[p].type != FUNC_TTADD) { return; }
+        Tensor *a = nodes_[p].inputs[0];
+        Tensor *b = nodes_[p].inputs[1];
+        if (!sameRows(a, b) || !sameRows(a, c.outputs[0])) { return; }
+        add_fusion({RESIDUAL_NORM, p, consumer}, {a, b});
+    }
+}
+
+bool OpFusion::validate(const Fusion &fusion, const std::vector<Tensor *> &outputs) const {
+    const Node &p = nodes_[fusion.producer];
+    Tensor *t = p.outputs[0];
+    if (t->masterTensor() != nullptr || !t->childTensors().empty()) { return false; }
+    // between the two, the producer's output is not read and its inputs are not written
+    for (int j = fusion.producer + 1; j < fusion.consumer; ++j) {
+        for (auto *input : nodes_[j].inputs) {
+            if (input == t) { return false; }
+        }
+        for (auto *output : nodes_[j].outputs) {
+            if (output == t || std::find(p.inputs.begin(), p.inputs.end(), output) != p.inputs.end()) { return false; }
+        }
+    }
+    if (fusion.pattern == RESIDUAL_NORM) { return true; } // the norm writes the sum itself
+    // a skipped output is never read after the consumer, until it is written again
+    for (int j = fusion.consumer + 1; j < (int)nodes_.size(); ++j) {
+        for (auto *input : nodes_[j].inputs) {
+            if (input == t) { return false; }
+        }
+        for (auto *output : nodes_[j].outputs) {
+            if (output == t) { return true; }
+        }
+    }
+    return std::find(outputs.begin(), outputs.end(), t) == outputs.end();
+}
+
+void OpFusion::chooseQuantizedNorms(const std::vector<Tensor *> &outputs) {
+    if (ImportanceMatrix::enabled()) { return; } // it collects the Linears' float inputs
+    // per norm output, the vec_dot type every writer agreed on (MLLM_TYPE_COUNT once one did not)
+    std::unordered_map<Tensor *, DataType> choice;
+    std::unordered_map<Tensor *, int> writers;
+    auto reject = [&](Tensor *tensor) { choice[tensor] = MLLM_TYPE_COUNT; };
+    for (int i = 0; i < (int)nodes_.size(); ++i) {
+        const Node &node = nodes_[i];
+        const bool norm = node.op != nullptr && node.type == RMSNORM && node.backend->type() == MLLM_CPU
+                          && dynamic_cast<CPURMSNorm *>(node.op) != nullptr;
+        for (size_t o = 0; o < node.outputs.size(); ++o) {
+            Tensor *t = node.outputs[o];
+            writers[t]++;
+            if (!norm || o != 0 || !isF32(t) || t->masterTensor() != nullptr || !t->childTensors().empty()) {
+                reject(t);
+                continue;
+            }
+            DataType vec_dot_type = MLLM_TYPE_COUNT;
+            bool ok = true, rewritten = false;
+            int readers = 0;
+            for (int j = i + 1; j < (int)nodes_.size() && ok && !rewritten; ++j) {
+                const Node &reader = nodes_[j];
+                if (std::find(reader.inputs.begin(), reader.inputs.end(), t) != reader.inputs.end()) {
+                    readers++;
+                    ok = reader.op != nullptr && (reader.type == LINEAR || reader.type == MERGEDLINEAR) && reader.vec_dot_type != MLLM_TYPE_COUNT
+                         && (vec_dot_type == MLLM_TYPE_COUNT || vec_dot_type == reader.vec_dot_type);
+                    vec_dot_type = reader.vec_dot_type;
+                }
+                rewritten = std::find(reader.outputs.begin(), reader.outputs.end(), t) != reader.outputs.end();
+            }
+            if (!rewritten && std::find(outputs.begin(), outputs.end(), t) != outputs.end()) { ok = false; }
+            ok = ok && readers > 0;
+            auto it = choice.find(t);
+            if (!ok || (it != choice.end() && it->second != vec_dot_type)) {
+                reject(t);
+            } else {
+                choice[t] = vec_dot_type;
+            }
+        }
+    }
+    for (auto &item : choice) {
+        if (item.second == MLLM_TYPE_COUNT) { continue; }
+        item.first->setDtype(item.second);
+        counts_[QUANTIZED_NORM] += writers[item.first];
+    }
+}
+
+void OpFusion::finish(const std::vector<Tensor *> &outputs) {
+    recording_ = nullptr;
+    vector<Tensor *> resolved;
+    for (auto *output : outputs) {
+        auto *tensor = activation(output);
+        resolved.push_back(tensor != nullptr ? tensor : output);
+    }
+    for (auto &fusion : fusions_) {
+        fusion.valid = validate(fusion, resolved);
+        if (fusion.valid) {
+            counts_[fusion.pattern]++;
+        } else {
+            nodes_[fusion.producer].fusion = -1;
+            nodes_[fusion.consumer].fusion = -1;
+        }
+    }
+    chooseQuantizedNorms(resolved);
+    last_writer_.clear();
+}
+
+void OpFusion::startReplay() {
+    outer_ = replaying_;
+    replaying_ = this;
+    next_ = 0;
+    broken_ = false;
+    deferred_.clear();
+}
+
+void OpFusion::stopReplay() {
+    runDeferred();
+    replaying_ = outer_;
+    outer_ = nullptr;
+}
+
+bool OpFusion::replaced(const std::vector<std::shared_ptr<Tensor>> &inputs, const std::vector<std::shared_ptr<Tensor>> &outputs) {
+    if (replaying_ == nullptr) { return false; }
+    vector<Tensor *> input_ptrs, output_ptrs;
+    for (auto &tensor : inputs) { input_ptrs.push_back(tensor.get()); }
+    for (auto &tensor : outputs) { output_ptrs.push_back(tensor.get()); }
+    return replaying_->replay(input_ptrs, output_ptrs);
+}
+
+bool OpFusion::replaced(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs) {
+    if (replaying_ == nullptr) { return false; }
+    return replaying_->replay(inputs, outputs);
+}
+
+bool OpFusion::replay(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs) {
+    if (broken_) { return false; }
+    if (next_ >= (int)nodes_.size() || outputs.empty() || nodes_[next_].outputs[0] != outputs[0]) {
+        MLLM_LOG_ERROR_STREAM << "ops run in another order than during TENSOR_STATIC_INIT, op fusion is off for this forward" << std::endl;
+        runDeferred();
+        broken_ = true;
+        return false;
+    }
+    const int index = next_++;
+    const Node &node = nodes_[index];
+    if (node.fusion < 0) { return false; }
+    const Fusion &fusion = fusions_[node.fusion];
+    if (index == fusion.producer) {
+        deferred_.push_back(index);
+        return true;
+    }
+    deferred_.erase(std::remove(deferred_.begin(), deferred_.end(), fusion.producer), deferred_.end());
+    const Node &producer = nodes_[fusion.producer];
+    switch (fusion.pattern) {
+    case SWIGLU: {
+        static_cast<CPUSiLU *>(producer.op)->executeGated(producer.inputs[0], inputs[1 - fusion.operand], outputs[0]);
+        break;
+    }
+    case SCALED_SOFTMAX: {
+        auto *softmax = static_cast<CPUSoftMax *>(node.op);
+        vector<Tensor *> unscaled = inputs;
+        unscaled[0] = producer.inputs[0];
+        softmax->setInputScale(fusion.scale);
+        softmax->execute(borrow(unscaled), borrow(outputs));
+        softmax->setInputScale(1.0F);
+        break;
+    }
+    case RESIDUAL_NORM: {
+        node.op->execute(borrow(producer.inputs), borrow({outputs[0], producer.outputs[0]}));
+        break;
+    }
+    default: {
+        return false;
+    }
+    }
+    return true;
+}
+
+void OpFusion::runDeferred() {
+    for (int index : deferred_) { run(nodes_[index]); }
+    deferred_.clear();
+}
+
+void OpFusion::run(const Node &node) {
+    if (node.op != nullptr) {
+        node.op->execute(borrow(node.inputs), borrow(node.outputs));
+    } else {
+        node.backend->funcCreate((TensorFuncType)node.type)->execute(node.outputs, node.inputs, node.args);
+    }
+}
+
+} // namespace mllm
@@ -0,0 +1,135 @@
+//
+// Fusion of common transformer op chains into single CPU kernels.
+//
+
+#ifndef MLLM_OPFUSION_HPP
+#define MLLM_OPFUSION_HPP
+
+#include "OpDefined.hpp"
+#include "Types.hpp"
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mllm {
+class Backend;
+class Op;
+class Tensor;
+
+/**
+ * \brief Replaces chains of ops that each make a full pass over an activation with one fused CPU kernel.
+ *
+ * During the TENSOR_STATIC_INIT forward every op and tensor function reports itself through record(); finish()
+ * then fuses these chains of CPU float tensors:
+ *  - SWIGLU: `silu(g) * u` runs as one kernel and the SiLU is skipped.
+ *  - SCALED_SOFTMAX: `softmax(x / c)` or `softmax(x * c)` with c > 0 along DIMENSION scales x as it is read,
+ *    and the scaling is skipped.
+ *  - RESIDUAL_NORM: `rmsnorm(a + b)` adds a and b row by row and writes the sum as well, and the add is skipped.
+ *  - QUANTIZED_NORM: an RMSNorm output read only by Linears whose weights share one quantized vec_dot type is
+ *    written in that type, so the Linears no longer quantize their input (once per Linear).
+ * A skipped op's output must not be read by anything but the fusing op, nothing may write the skipped op's
+ * inputs in between, and module outputs are never skipped.
+ *
+ * The TENSOR_STATIC_READY forward runs the ops in the same order, and each one asks replaced() before it
+ * executes. Skipped ops are deferred and the fusing op runs its fused kernel instead. If the order ever
+ * differs from the recorded one, deferred ops are run and the rest of the forward is not fused.
+ * Tensors a fused kernel reads are reported to the ActivationMemoryPlanner as read by the fusing op, so the
+ * planner keeps them until then.
+ */
+class OpFusion {
+public:
+    enum Pattern {
+        SWIGLU = 0,
+        SCALED_SOFTMAX,
+        RESIDUAL_NORM,
+        QUANTIZED_NORM,
+        PATTERN_NUM,
+    };
+
+    /**
+     * \brief start recording the ops of a forward over the activations in `tensors`.
+     */
+    void begin(const std::map<std::string, std::shared_ptr<Tensor>> &tensors);
+    /**
+     * \brief choose the fusions, `outputs` are read after the forward. Must run before the planner places tensors.
+     */
+    void finish(const std::vector<Tensor *> &outputs);
+    /**
+     * \brief replay the fusions on the TENSOR_STATIC_READY forward between these calls.
+     */
+    void startReplay();
+    void stopReplay();
+
+    /**
+     * \return number of fusions of `pattern` chosen by the last finish().
+     */
+    int count(Pattern pattern) const {
+        return counts_[pattern];
+    }
+
+    static bool recording() {
+        return recording_ != nullptr;
+    }
+    /**
+     * \brief called once per op during the TENSOR_STATIC_INIT forward after setUp; adds to `reads` the tensors
+     * the fused kernel of this op would also read.
+     */
+    static void record(Op *op, OpType type, Backend *backend, std::vector<Tensor *> &reads, const std::vector<Tensor *> &outputs);
+    static void record(TensorFuncType type, const std::vector<float> &args, Backend *backend, std::vector<Tensor *> &reads,
+                       const std::vector<Tensor *> &outputs);
+    /**
+     * \brief called by every op during the TENSOR_STATIC_READY forward.
+     * \return true if the op has been skipped or run fused, false to execute it as usual.
+     */
+    static bool replaced(const std::vector<std::shared_ptr<Tensor>> &inputs, const std::vector<std::shared_ptr<Tensor>> &outputs);
+    static bool replaced(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs);
+
+private:
+    struct Node {
+        Op *op = nullptr; // nullptr for a tensor function
+        int type = 0;     // OpType of an op, TensorFuncType of a function
+        std::vector<float> args;
+        Backend *backend = nullptr;
+        std::vector<Tensor *> inputs;  // nullptr where the input is not an activation
+        std::vector<Tensor *> outputs;
+        DataType vec_dot_type = MLLM_TYPE_COUNT; // of a Linear with quantized weights
+        int fusion = -1;                         // fusion this node produces or consumes
+    };
+    struct Fusion {
+        Pattern pattern;
+        int producer;
+        int consumer;
+        int operand = 0; // input of the consumer written by the producer
+        float scale = 1.0F;
+        bool valid = true;
+    };
+
+    const std::map<std::string, std::shared_ptr<Tensor>> *tensors_ = nullptr;
+    std::vector<Node> nodes_;
+    std::vector<Fusion> fusions_;
+    std::unordered_map<Tensor *, int> last_writer_;
+    int counts_[PATTERN_NUM] = {};
+    // replay state
+    int next_ = 0;
+    bool broken_ = false;
+    std::vector<int> deferred_;
+    OpFusion *outer_ = nullptr;
+
+    static OpFusion *recording_;
+    static OpFusion *replaying_;
+
+    Tensor *activation(Tensor *tensor) const;
+    void add(Node node, std::vector<Tensor *> &reads, const std::vector<Tensor *> &outputs);
+    void match(int consumer, std::vector<Tensor *> &reads);
+    bool validate(const Fusion &fusion, const std::vector<Tensor *> &outputs) const;
+    void chooseQuantizedNorms(const std::vector<Tensor *> &outputs);
+    bool replay(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs);
+    void runDeferred();
+    void run(const Node &node);
+};
+
+} // namespace mllm
+
+#endif // MLLM_OPFUSION_HPP
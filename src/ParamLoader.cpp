@@ -8,6 +8,11 @@
 #include <string>
 #include <tuple>
 #include <utility>
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 // TODO:
 /*
  * ┌───────┬──────┬───────┬────────┬───────────┬─────────┬─────────┬──────┬──────────────────────┬─────────────────────────┐
@@ -30,27 +35,28 @@
 namespace mllm {
 bool ParamLoader::load(mllm::Tensor *tensor) {
     string name = tensor->name();
-#ifndef USE_MMAP
     if (offsets_.find(name) == offsets_.end()) { return false; }
     std::pair<uint64_t, uint64_t> offset = offsets_[name];
-    uint8_t *data = new uint8_t[offset.second];
+    uint64_t copy_size = std::min<uint64_t>(tensor->cntSize(), offset.second);
+    if (buffer_ != nullptr) {
+        uint8_t *data = buffer_ + offset.first;
+        // alias the mapping directly if it is as aligned as Tensor::alloc would be.
+        if (reinterpret_cast<uintptr_t>(data) % MLLM_PARAM_ALIGNMENT == 0
+            && tensor->cntSize() <= offset.second && tensor->masterTensor() == nullptr) {
+            tensor->setExternalHostPtr(data);
+        } else {
+            memcpy(tensor->rawHostPtr(), data, copy_size);
+        }
+        return true;
+    }
     fseek(fp_, offset.first, SEEK_SET);
-    auto _ = fread(data, sizeof(uint8_t), offset.second, fp_);
-    // TODO:Data?
-    //  tenor. = data;
-    auto *p = tensor->hostPtr<char>();
-
-    if (tensor->cntSize() >= offset.second)
-        memcpy(static_cast<void *>(p), static_cast<void *>(data),
-               offset.second); // Cast pointers to void*
-    else
-        memcpy(static_cast<void *>(p), static_cast<void *>(data),
-               tensor->cntSize()); // Cast pointers to void*
-    delete[] data;                 // Free the memory allocated by new
+    auto _ = fread(tensor->rawHostPtr(), sizeof(uint8_t), copy_size, fp_);
     return true;
-#endif
 }
 ParamLoader::~ParamLoader() {
+#ifndef _WIN32
+    if (buffer_ != nullptr) { munmap(buffer_, size_); }
+#endif
     if (fp_ != nullptr) { fclose(fp_); }
 }
 // #ifdef ANDROID_API
@@ -75,11 +81,7 @@ ParamLoader::ParamLoader(std::string filename, bool use_mmap) :
                errorMsg);
         exit(1);
     }
-#ifndef USE_MMAP
-    use_mmap_ = false;
-#endif
     fseek(fp_, 0, SEEK_SET);
-#ifndef USE_MMAP
     int magic = readInt(fp_);
     if (magic != _MAGIC_NUMBER) {
         std::cout << "magic number error" << std::endl;
@@ -105,9 +107,30 @@ ParamLoader::ParamLoader(std::string filename, bool use_mmap) :
 //     offsets_[name] = std::make_pair(len,length);
 //     len+=length; //Align?
 // }
-#endif
+    if (use_mmap_) { mmapFile(); }
     // std::cout << "load param file success" << std::endl;
 }
+void ParamLoader::mmapFile() {
+#ifdef _WIN32
+    use_mmap_ = false;
+#else
+    struct stat st {};
+    if (fstat(fileno(fp_), &st) != 0 || st.st_size <= 0) {
+        use_mmap_ = false;
+        return;
+    }
+    size_ = st.st_size;
+    // MAP_PRIVATE: ops that rewrite their weights in place only copy the touched pages.
+    void *addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp_), 0);
+    if (addr == MAP_FAILED) {
+        MLLM_LOG_ERROR_STREAM << "mmap " << path_ << " failed, fall back to fread" << std::endl;
+        use_mmap_ = false;
+        size_ = 0;
+        return;
+    }
+    buffer_ = static_cast<uint8_t *>(addr);
+#endif
+}
 bool ParamLoader::load(std::shared_ptr<mllm::Tensor> tensor) {
     return load(tensor.get());
 }
@@ -123,10 +146,25 @@ vector<std::string> ParamLoader::getParamNames() {
 std::tuple<uint8_t *, uint64_t> ParamLoader::load(string name) {
     auto [offset, length] = offsets_[name];
     auto *data = new uint8_t[length];
-    fseek(fp_, offset, SEEK_SET);
-    auto _ = fread(data, sizeof(uint8_t), length, fp_);
+    if (buffer_ != nullptr) {
+        memcpy(data, buffer_ + offset, length);
+    } else {
+        fseek(fp_, offset, SEEK_SET);
+        auto _ = fread(data, sizeof(uint8_t), length, fp_);
+    }
     return std::make_tuple(data, length);
 }
+bool ParamLoader::loadRange(const string &name, uint64_t offset, void *dst, uint64_t size) {
+    auto it = offsets_.find(name);
+    if (it == offsets_.end() || offset + size > it->second.second) { return false; }
+    const uint64_t pos = it->second.first + offset;
+    if (buffer_ != nullptr) {
+        memcpy(dst, buffer_ + pos, size);
+        return true;
+    }
+    fseek(fp_, (long)pos, SEEK_SET);
+    return fread(dst, sizeof(uint8_t), size, fp_) == size;
+}
 DataType ParamLoader::getDataType(string name) {
     if (data_type_.count(name) != 1) {
         if (!this->path_.empty() && this->fp_ == nullptr) {
@@ -218,29 +256,24 @@ MultiFileParamLoader::~MultiFileParamLoader() {
 
 bool ParamLoader::partialLoad(mllm::Tensor *tensor, std::set<int> validRow, int rowNum, int colNum) {
     string name = tensor->name();
-#ifndef USE_MMAP
     if (offsets_.find(name) == offsets_.end()) { return false; }
     std::pair<uint64_t, uint64_t> offset = offsets_[name];
     // for data longer then 1 byte
     int perValueLength = offset.second / rowNum / colNum;
-    uint8_t *data = new uint8_t[perValueLength * validRow.size() * colNum];
+    auto *p = tensor->hostPtr<uint8_t>();
     size_t totalBytesRead = 0;
 
     // load begin
     for (auto row : validRow) {
-        fseek(fp_, offset.first + (row * colNum) * perValueLength, SEEK_SET);
-        auto s = fread(data + totalBytesRead, sizeof(uint8_t), perValueLength * colNum, fp_);
+        uint64_t row_offset = offset.first + (uint64_t)(row * colNum) * perValueLength;
+        if (buffer_ != nullptr) {
+            memcpy(p + totalBytesRead, buffer_ + row_offset, perValueLength * colNum);
+        } else {
+            fseek(fp_, row_offset, SEEK_SET);
+            auto s = fread(p + totalBytesRead, sizeof(uint8_t), perValueLength * colNum, fp_);
+        }
         totalBytesRead += perValueLength * colNum;
     }
-
-    auto *p = tensor->hostPtr<char>();
-    // Cast pointers to void*
-    memcpy(static_cast<void *>(p), static_cast<void *>(data),
-           perValueLength * validRow.size() * colNum);
-
-    // Free the memory allocated by new
-    delete[] data;
     return true;
-#endif
 }
 } // namespace mllm
\ No newline at end of file
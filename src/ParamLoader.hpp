@@ -45,6 +45,9 @@ static std::string readString(mllm_file *fp_) {
 }
 
 #define _MAGIC_NUMBER 20012
+// weights are aligned to this in files written by ParamWriter, the same alignment Tensor::alloc uses,
+// so that mmap-ed weights can be used in place.
+#define MLLM_PARAM_ALIGNMENT 128
 /**
  * \brief The AbstructLoader abstract class provides an interface for loading parameters.
  */
@@ -65,16 +68,15 @@ public:
 
 /**
  * \brief The ParamLoader class is the default and only(currently) implementation of the AbstructLoader class.
+ *        With `use_mmap`, the whole file is mapped read-only(copy-on-write) and weights whose offset is
+ *        MLLM_PARAM_ALIGNMENT aligned are used in place by the Tensors, so pages are only read in when touched
+ *        and are shared through the page cache. Other weights are copied out of the mapping once.
  */
 class ParamLoader : public AbstructLoader {
     friend class QuantWriter;
 
 public:
     ParamLoader(std::string filename, bool use_mmap = false);
-
-#ifdef USE_MMAP
-    ParamLoader(void *buffer);
-#endif
 // no param loader for debug
 #ifdef DEBUG
     ParamLoader() {
@@ -87,6 +89,8 @@ public:
     bool partialLoad(mllm::Tensor *tensor, std::set<int> validRow, int rowNum, int colNum);
     vector<std::string> getParamNames();
     std::tuple<uint8_t *, uint64_t> load(string name);
+    // read `size` bytes of `name` starting `offset` bytes in, so that large tensors can be streamed in chunks
+    bool loadRange(const string &name, uint64_t offset, void *dst, uint64_t size);
     DataType getDataType(string name) override;
     bool isAvailible() const {
         return fp_ != nullptr && !offsets_.empty();
@@ -94,12 +98,17 @@ public:
     unsigned int getParamSize() const {
         return offsets_.size();
     }
+    bool isMmaped() const {
+        return buffer_ != nullptr;
+    }
 
 protected:
+    void mmapFile();
+
     mllm_file *fp_;
-    uint8_t *buffer_;
+    uint8_t *buffer_ = nullptr;
     std::string path_;
-    std::uint64_t size_;
+    std::uint64_t size_ = 0;
     std::map<std::string, std::pair<uint64_t, uint64_t>> offsets_; // offsets,length
     std::map<std::string, int> data_type_;
     bool use_mmap_;
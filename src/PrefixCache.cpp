@@ -0,0 +1,119 @@
+#include "PrefixCache.hpp"
+#include <algorithm>
+
+namespace mllm {
+
+PrefixCache::PrefixCache(int chunk_size, size_t max_chunks) :
+    chunk_size_(chunk_size), max_chunks_(max_chunks) {
+    assert(chunk_size_ > 0 && max_chunks_ > 0);
+}
+
+uint64_t PrefixCache::chainKey(uint64_t parent, const unsigned *tokens, int n) {
+    // FNV-1a over the parent key and the chunk's token ids
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&hash](uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(parent);
+    for (int i = 0; i < n; ++i) {
+        mix(tokens[i]);
+    }
+    return hash;
+}
+
+PrefixCache::Entry *PrefixCache::find(uint64_t key, const unsigned *tokens) {
+    auto iter = entries_.find(key);
+    if (iter == entries_.end() || !std::equal(tokens, tokens + chunk_size_, iter->second.tokens.begin())) {
+        return nullptr;
+    }
+    auto &entry = iter->second;
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+    return &entry;
+}
+
+vector<Op *> PrefixCache::cacheOps(Module &model) {
+    vector<Op *> ops;
+    for (auto *cache : model.get_kvcache()) {
+        if (cache->op_ == nullptr) { return {}; } // the model has not run yet
+        ops.push_back(cache->op_);
+    }
+    return ops;
+}
+
+int PrefixCache::restore(Module &model, const vector<unsigned> &tokens) {
+    return restore(cacheOps(model), tokens);
+}
+
+void PrefixCache::store(Module &model, const vector<unsigned> &tokens) {
+    store(cacheOps(model), tokens);
+}
+
+int PrefixCache::restore(const vector<Op *> &caches, const vector<unsigned> &tokens) {
+    for (auto *cache : caches) {
+        // a cache gets its shape and layout on its first run
+        if (cache->getCacheSeqLen() < 0) { return 0; }
+    }
+    if (caches.empty()) { return 0; }
+    std::lock_guard<std::mutex> lock(mutex_);
+    vector<Entry *> chain;
+    uint64_t key = 0;
+    for (int begin = 0; begin + chunk_size_ < (int)tokens.size(); begin += chunk_size_) {
+        key = chainKey(key, tokens.data() + begin, chunk_size_);
+        auto entry = find(key, tokens.data() + begin);
+        if (entry == nullptr) { break; }
+        chain.push_back(entry);
+    }
+    for (size_t i = 0; i < chain.size(); ++i) {
+        for (size_t c = 0; c < caches.size(); ++c) {
+            caches[c]->copyCacheFrom((int)i * chunk_size_, *chain[i]->rows[c]);
+        }
+    }
+    return (int)chain.size() * chunk_size_;
+}
+
+void PrefixCache::store(const vector<Op *> &caches, const vector<unsigned> &tokens) {
+    if (caches.empty()) { return; }
+    int cached = (int)tokens.size();
+    for (auto *cache : caches) {
+        cached = std::min(cached, cache->getCacheSeqLen());
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t key = 0;
+    for (int begin = 0; begin + chunk_size_ <= cached; begin += chunk_size_) {
+        key = chainKey(key, tokens.data() + begin, chunk_size_);
+        if (find(key, tokens.data() + begin) != nullptr) { continue; }
+        if (entries_.count(key)) { break; } // a colliding prefix owns this key
+        Entry entry;
+        entry.key = key;
+        entry.tokens.assign(tokens.begin() + begin, tokens.begin() + begin + chunk_size_);
+        for (auto *cache : caches) {
+            auto rows = std::make_shared<Tensor>(cache->backend());
+            cache->copyCacheTo(begin, begin + chunk_size_, *rows);
+            entry.rows.push_back(rows);
+        }
+        lru_.push_front(key);
+        entry.lru = lru_.begin();
+        entries_.emplace(key, std::move(entry));
+        // least recently used first; a dropped chunk also makes the chunks after it unreachable until re-stored
+        while (entries_.size() > max_chunks_) {
+            entries_.erase(lru_.back());
+            lru_.pop_back();
+        }
+    }
+}
+
+size_t PrefixCache::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void PrefixCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+}
+
+} // namespace mllm
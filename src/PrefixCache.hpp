@@ -0,0 +1,75 @@
+//
+// Reuse of the KV cache of shared prompt prefixes.
+//
+
+#ifndef MLLM_PREFIXCACHE_HPP
+#define MLLM_PREFIXCACHE_HPP
+
+#include "Layer.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * \brief Snapshots of per-layer KV caches keyed by token-id hash chains.
+ *
+ * Prompts are cut into chunks of `chunk_size` tokens. The key of chunk i hashes its tokens together with the
+ * key of chunk i - 1, so a key names a whole prefix. Each entry holds the K/V rows of its own chunk for every
+ * cache of the model; a prefix is restored by following the chain from the first chunk. Entries are plain
+ * copies, so a prefix stored from one session can be restored into any number of other sessions (or model
+ * instances of the same shape) independently.
+ *
+ * Usage:
+ *   model.clear_kvcache();
+ *   int reused = prefix_cache.restore(model, tokens); // tokens [0, reused) are now cached
+ *   ... prefill tokens [reused, end) and generate ...
+ *   prefix_cache.store(model, tokens);                 // after the prompt has been prefilled
+ */
+class PrefixCache {
+public:
+    explicit PrefixCache(int chunk_size = 32, size_t max_chunks = 4096);
+
+    /**
+     * \brief restore the longest stored prefix of `tokens` into the model's caches, which must be empty
+     * and have run at least once. At least the last token is left out, so the caller always has a row
+     * to compute logits from.
+     * \return number of tokens restored.
+     */
+    int restore(Module &model, const vector<unsigned> &tokens);
+    /**
+     * \brief store the full chunks of `tokens` that the model's caches hold and this cache does not.
+     */
+    void store(Module &model, const vector<unsigned> &tokens);
+
+    int restore(const vector<Op *> &caches, const vector<unsigned> &tokens);
+    void store(const vector<Op *> &caches, const vector<unsigned> &tokens);
+
+    size_t size();
+    void clear();
+
+private:
+    struct Entry {
+        uint64_t key;
+        vector<unsigned> tokens; // guards against hash collisions
+        vector<std::shared_ptr<Tensor>> rows; // one per cache
+        std::list<uint64_t>::iterator lru;
+    };
+    int chunk_size_;
+    size_t max_chunks_;
+    std::unordered_map<uint64_t, Entry> entries_;
+    std::list<uint64_t> lru_; // most recently used first
+    std::mutex mutex_;
+
+    static uint64_t chainKey(uint64_t parent, const unsigned *tokens, int n);
+    Entry *find(uint64_t key, const unsigned *tokens);
+    static vector<Op *> cacheOps(Module &model);
+};
+
+} // namespace mllm
+
+#endif // MLLM_PREFIXCACHE_HPP
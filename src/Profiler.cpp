@@ -0,0 +1,187 @@
+#include "Profiler.hpp"
+#include "Tensor.hpp"
+#include "Backend.hpp"
+#include "Timing.hpp"
+#include "Log.h"
+#include "backends/cpu/CPUBackend.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+namespace mllm {
+
+std::atomic<bool> OpProfiler::enabled_{false};
+
+// never destroyed, the MLLM_OP_TRACE exit hook may run after static destructors
+static std::mutex &registryMutex() {
+    static auto *mutex = new std::mutex();
+    return *mutex;
+}
+
+std::vector<std::shared_ptr<OpProfiler::ThreadBuffer>> &OpProfiler::registry() {
+    // buffers are shared with their threads so events survive a thread exiting before export
+    static auto *buffers = new std::vector<std::shared_ptr<ThreadBuffer>>();
+    return *buffers;
+}
+
+OpProfiler::ThreadBuffer &OpProfiler::threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (buffer == nullptr) {
+        buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex());
+        buffer->tid = (int)registry().size();
+        registry().push_back(buffer);
+    }
+    return *buffer;
+}
+
+std::vector<std::shared_ptr<OpProfiler::ThreadBuffer>> OpProfiler::buffers() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    return registry();
+}
+
+static std::string shapesString(const std::vector<Tensor *> &tensors) {
+    std::string result;
+    for (auto *tensor : tensors) {
+        if (!result.empty()) { result += ","; }
+        result += "[" + std::to_string(tensor->batch()) + "," + std::to_string(tensor->head()) + ","
+                  + std::to_string(tensor->sequence()) + "," + std::to_string(tensor->dimension()) + "]";
+    }
+    return result;
+}
+
+void OpProfiler::record(const std::string &name, const std::string &type, const std::vector<Tensor *> &inputs,
+                        const std::vector<Tensor *> &outputs, Backend *backend, int64_t start_us) {
+    Event event;
+    event.dur_us = mllm_time_us() - start_us;
+    event.start_us = start_us;
+    event.name = name;
+    event.type = type;
+    event.input_shapes = shapesString(inputs);
+    event.output_shapes = shapesString(outputs);
+    if (!outputs.empty()) { event.dtype = outputs[0]->dtype(); }
+    if (backend != nullptr && backend->type() == MLLM_CPU) { event.threads = CPUBackend::cpu_threads; }
+    for (auto *tensor : inputs) { event.bytes += tensor->cntSize(); }
+    for (auto *tensor : outputs) { event.bytes += tensor->cntSize(); }
+    record(std::move(event));
+}
+
+void OpProfiler::record(Event event) {
+    auto &buffer = threadBuffer();
+    event.tid = buffer.tid;
+    buffer.events.push_back(std::move(event));
+}
+
+std::vector<OpProfiler::Event> OpProfiler::events() {
+    std::vector<Event> result;
+    for (auto &buffer : buffers()) {
+        result.insert(result.end(), buffer->events.begin(), buffer->events.end());
+    }
+    std::stable_sort(result.begin(), result.end(), [](const Event &a, const Event &b) { return a.start_us < b.start_us; });
+    return result;
+}
+
+std::vector<OpProfiler::Summary> OpProfiler::summary() {
+    std::map<std::string, Summary> by_type;
+    for (auto &buffer : buffers()) {
+        for (auto &event : buffer->events) {
+            auto &row = by_type[event.type];
+            row.type = event.type;
+            row.count++;
+            row.total_us += event.dur_us;
+            row.bytes += event.bytes;
+        }
+    }
+    std::vector<Summary> result;
+    for (auto &item : by_type) { result.push_back(item.second); }
+    std::sort(result.begin(), result.end(), [](const Summary &a, const Summary &b) { return a.total_us > b.total_us; });
+    return result;
+}
+
+void OpProfiler::printSummary() {
+    auto rows = summary();
+    int64_t total_us = 0;
+    for (auto &row : rows) { total_us += row.total_us; }
+    char line[160];
+    MLLM_LOG_INFO_STREAM << "===========================================" << std::endl;
+    snprintf(line, sizeof(line), "%-20s %8s %12s %10s %7s %10s", "op type", "count", "total ms", "avg us", "%", "GB/s");
+    MLLM_LOG_INFO_STREAM << line << std::endl;
+    MLLM_LOG_INFO_STREAM << "-------------------------------------------" << std::endl;
+    for (auto &row : rows) {
+        double avg_us = (double)row.total_us / (double)row.count;
+        double percent = total_us > 0 ? 100.0 * (double)row.total_us / (double)total_us : 0.0;
+        double gb_s = row.total_us > 0 ? (double)row.bytes / (double)row.total_us / 1e3 : 0.0;
+        snprintf(line, sizeof(line), "%-20s %8zu %12.3f %10.1f %7.2f %10.2f", row.type.c_str(), row.count,
+                 (double)row.total_us / 1000.0, avg_us, percent, gb_s);
+        MLLM_LOG_INFO_STREAM << line << std::endl;
+    }
+    MLLM_LOG_INFO_STREAM << "===========================================" << std::endl;
+}
+
+static std::string jsonEscape(const std::string &str) {
+    std::string result;
+    for (char c : str) {
+        switch (c) {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", c);
+                result += code;
+            } else {
+                result += c;
+            }
+        }
+    }
+    return result;
+}
+
+bool OpProfiler::exportChromeTrace(const std::string &path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        MLLM_LOG_ERROR_STREAM << "Can not open trace file " << path << std::endl;
+        return false;
+    }
+    auto all = events();
+    int64_t origin = all.empty() ? 0 : all.front().start_us;
+    out << "{\"traceEvents\":[";
+    for (size_t i = 0; i < all.size(); ++i) {
+        auto &event = all[i];
+        out << (i ? ",\n" : "\n");
+        out << "{\"name\":\"" << jsonEscape(event.name) << "\",\"cat\":\"" << jsonEscape(event.type)
+            << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.tid << ",\"ts\":" << event.start_us - origin
+            << ",\"dur\":" << event.dur_us << ",\"args\":{\"inputs\":\"" << event.input_shapes
+            << "\",\"outputs\":\"" << event.output_shapes << "\",\"dtype\":\"" << DataTypeName(event.dtype)
+            << "\",\"threads\":" << event.threads << ",\"bytes\":" << event.bytes << "}}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out.good();
+}
+
+void OpProfiler::clear() {
+    for (auto &buffer : buffers()) {
+        buffer->events.clear();
+    }
+}
+
+namespace {
+struct TraceFromEnv {
+    TraceFromEnv() {
+        if (std::getenv("MLLM_OP_TRACE") != nullptr) {
+            OpProfiler::enable();
+            std::atexit([] {
+                OpProfiler::printSummary();
+                OpProfiler::exportChromeTrace(std::getenv("MLLM_OP_TRACE"));
+            });
+        }
+    }
+} trace_from_env;
+} // namespace
+
+} // namespace mllm
@@ -0,0 +1,89 @@
+//
+// Per-op tracing.
+//
+
+#ifndef MLLM_PROFILER_HPP
+#define MLLM_PROFILER_HPP
+
+#include "Types.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mllm {
+class Tensor;
+class Backend;
+
+/**
+ * \brief Records one event per executed op or tensor function, switched on and off at runtime.
+ *
+ * Events are appended to a buffer owned by the recording thread, so recording takes no lock; buffers are only
+ * read by events(), summary() and exportChromeTrace(), which must not run concurrently with inference.
+ * Setting the MLLM_OP_TRACE environment variable to a file path enables the profiler at startup and writes
+ * the Chrome trace there (plus a summary to the log) when the process exits.
+ */
+class OpProfiler {
+public:
+    struct Event {
+        std::string name;
+        std::string type;
+        std::string input_shapes;  // "[b,h,s,d],[b,h,s,d]"
+        std::string output_shapes;
+        DataType dtype = MLLM_TYPE_F32; // of the first output
+        int threads = 1;
+        int tid = 0; // index of the recording thread
+        int64_t start_us = 0;
+        int64_t dur_us = 0;
+        size_t bytes = 0; // bytes of all input and output tensors
+    };
+    struct Summary {
+        std::string type;
+        size_t count = 0;
+        int64_t total_us = 0;
+        size_t bytes = 0;
+    };
+
+    static void enable(bool on = true) {
+        enabled_.store(on, std::memory_order_relaxed);
+    }
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    /**
+     * \brief record an op that started at `start_us` (mllm_time_us) and has just finished.
+     */
+    static void record(const std::string &name, const std::string &type, const std::vector<Tensor *> &inputs,
+                       const std::vector<Tensor *> &outputs, Backend *backend, int64_t start_us);
+    static void record(Event event);
+
+    /**
+     * \return every recorded event, ordered by start time.
+     */
+    static std::vector<Event> events();
+    /**
+     * \return time and bytes per op type, most expensive first.
+     */
+    static std::vector<Summary> summary();
+    static void printSummary();
+    /**
+     * \brief write the events as Chrome trace JSON, viewable in chrome://tracing or Perfetto.
+     */
+    static bool exportChromeTrace(const std::string &path);
+    static void clear();
+
+private:
+    struct ThreadBuffer {
+        int tid;
+        std::vector<Event> events;
+    };
+    static std::atomic<bool> enabled_;
+    static ThreadBuffer &threadBuffer();
+    static std::vector<std::shared_ptr<ThreadBuffer>> &registry();
+    static std::vector<std::shared_ptr<ThreadBuffer>> buffers();
+};
+
+} // namespace mllm
+
+#endif // MLLM_PROFILER_HPP
@@ -0,0 +1,120 @@
+#include "SpeculativeDecoding.hpp"
+#include "Layer.hpp"
+#include <algorithm>
+
+namespace mllm {
+
+static std::shared_ptr<LlmTextGenerator> makeGenerator(const LlmTextGeneratorOpts &opt) {
+    if (!opt.do_sample) {
+        return std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kGreedySearch, opt);
+    }
+    if (!opt.top_k && opt.top_p != 0.F) {
+        return std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kToppSampling, opt);
+    }
+    return std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kTopkSampling, opt);
+}
+
+SpeculativeDecoder::SpeculativeDecoder(Module &target, Module &draft, int num_draft_tokens) :
+    target_(target), draft_(draft), num_draft_tokens_(num_draft_tokens) {
+    assert(num_draft_tokens_ > 0);
+}
+
+Tensor SpeculativeDecoder::tokensToInput(const vector<unsigned> &tokens) {
+    Tensor input_ids(1, 1, (int)tokens.size(), 1, Backend::global_backends[MLLM_CPU], true);
+    input_ids.setName("input");
+    Tensor::tensor_status = TENSOR_STATIC_INIT;
+    input_ids.setTtype(INPUT_TENSOR);
+    for (int r = 0; r < (int)tokens.size(); ++r) {
+        input_ids.setDataAt<float>(0, 0, r, 0, tokens[r]);
+    }
+    return input_ids;
+}
+
+void SpeculativeDecoder::rollback(Module &model, int n) {
+    if (n <= 0) {
+        return;
+    }
+    for (auto *cache : model.get_kvcache()) {
+        cache->rollbackCache(n);
+    }
+}
+
+vector<unsigned> SpeculativeDecoder::generate(Tensor &input_ids, const LlmTextGeneratorOpts &opt, const Callback &call_back, int end_token) {
+    if (target_.get_kvcache().empty() || draft_.get_kvcache().empty()) {
+        std::cerr << "SpeculativeDecoder needs models exposing their KV caches" << std::endl;
+        exit(1);
+    }
+    auto target_generator = makeGenerator(opt);
+    auto draft_generator = makeGenerator(opt);
+    proposed_ = accepted_ = 0;
+    vector<unsigned> result;
+    bool running = true;
+    auto emit = [&](unsigned token) {
+        result.push_back(token);
+        running = call_back(token) && (end_token == -1 || token != (unsigned)end_token)
+                  && result.size() < opt.max_new_tokens;
+    };
+
+    // every pass samples its last row, except the verify pass which samples all of them
+    const int logits_rows_before = Module::logits_rows;
+    Module::logits_rows = 1;
+
+    // prefill both models, the target gives the first token
+    auto target_out = target_({input_ids})[0];
+    draft_({input_ids});
+    emit(target_generator->generate(target_out));
+    // tokens the draft has not seen yet, ending with the last accepted token
+    vector<unsigned> draft_pending = {result.back()};
+
+    while (running) {
+        int k = std::min<int>(num_draft_tokens_, (int)(opt.max_new_tokens - result.size()));
+        vector<unsigned> drafts;
+        for (int i = 0; i < k; ++i) {
+            auto draft_input = tokensToInput(draft_pending);
+            auto draft_out = draft_({draft_input})[0];
+            drafts.push_back(draft_generator->generate(draft_out));
+            draft_pending = {drafts.back()};
+        }
+
+        // score the last accepted token and every draft in one pass
+        vector<unsigned> verify = {result.back()};
+        verify.insert(verify.end(), drafts.begin(), drafts.end());
+        auto verify_input = tokensToInput(verify);
+        Module::logits_rows = k + 1;
+        target_out = target_({verify_input})[0];
+        Module::logits_rows = 1;
+
+        int m = 0;
+        unsigned next = 0;
+        for (; m <= k; ++m) {
+            next = target_generator->generate(target_out, m);
+            if (m == k || next != drafts[m]) {
+                break;
+            }
+        }
+        proposed_ += k;
+        accepted_ += m;
+        for (int i = 0; i < m && running; ++i) {
+            emit(drafts[i]);
+        }
+        if (running) {
+            emit(next);
+        }
+
+        // keep the caches at the accepted prefix: the target holds k+1 new rows of which m+1 are kept,
+        // the draft holds k-1 new rows (the last draft was never fed back)
+        rollback(target_, k - m);
+        if (m < k) {
+            rollback(draft_, k - 1 - m);
+            draft_pending = {next};
+        } else {
+            draft_pending = {drafts.back(), next};
+        }
+    }
+    Module::logits_rows = logits_rows_before;
+    target_.clear_kvcache();
+    draft_.clear_kvcache();
+    return result;
+}
+
+} // namespace mllm
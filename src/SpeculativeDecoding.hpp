@@ -0,0 +1,59 @@
+//
+// Speculative decoding with a draft model.
+//
+
+#ifndef MLLM_SPECULATIVEDECODING_HPP
+#define MLLM_SPECULATIVEDECODING_HPP
+
+#include "Module.hpp"
+#include "Generate.hpp"
+#include <functional>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * \brief Generates text with a large target model, using a small draft model to propose tokens ahead.
+ *
+ * Every round the draft decodes `num_draft_tokens` tokens one by one, then the target scores the last accepted
+ * token plus all drafts in one forward pass. Drafts are accepted while they match what the target samples at
+ * the same position; the first mismatch is replaced by the target's own token, and if every draft matches the
+ * target's next token comes for free. Both models then roll their KV caches back to the accepted prefix.
+ *
+ * With greedy decoding the output is exactly what the target alone would produce. Both models must share a
+ * tokenizer and expose their caches through Module::get_kvcache().
+ */
+class SpeculativeDecoder {
+public:
+    using Callback = std::function<bool(unsigned int)>;
+
+    SpeculativeDecoder(Module &target, Module &draft, int num_draft_tokens = 4);
+
+    /**
+     * \brief generate up to opt.max_new_tokens tokens after the prompt in `input_ids`.
+     * \param call_back called for every accepted token in order, returning false stops generation.
+     * \return the generated tokens.
+     */
+    vector<unsigned> generate(Tensor &input_ids, const LlmTextGeneratorOpts &opt, const Callback &call_back, int end_token = -1);
+
+    /**
+     * \brief ratio of accepted draft tokens over proposed ones in the last generate().
+     */
+    float acceptanceRate() const {
+        return proposed_ == 0 ? 0.F : (float)accepted_ / (float)proposed_;
+    }
+
+private:
+    Module &target_;
+    Module &draft_;
+    int num_draft_tokens_;
+    size_t proposed_ = 0;
+    size_t accepted_ = 0;
+
+    static Tensor tokensToInput(const vector<unsigned> &tokens);
+    static void rollback(Module &model, int n);
+};
+
+} // namespace mllm
+
+#endif // MLLM_SPECULATIVEDECODING_HPP
@@ -6,8 +6,11 @@
 #include <express/ExpressBase.hpp>
 #include "Backend.hpp"
 #include "OpDefined.hpp"
+#include "OpFusion.hpp"
+#include "Profiler.hpp"
 #include "Timing.hpp"
 #include "Types.hpp"
+#include "memory/ActivationMemoryPlanner.hpp"
 #include <Module.hpp>
 #include <memory>
 #include <string>
@@ -70,10 +73,12 @@ void Tensor::alloc() {
     assert(backend_ != nullptr);
     if (masterTensor() != nullptr) { return; }
     if (!shape_offset_.empty() && !shape_master_.empty()) { return; }
+    if (ActivationMemoryPlanner::deferAlloc(this)) { return; }
     if (allocated_ != count_) {
         if (host_ptr_ != nullptr) {
-            backend_->free(host_ptr_);
+            if (!external_host_ptr_) { backend_->free(host_ptr_); }
             host_ptr_ = nullptr;
+            external_host_ptr_ = false;
         }
         if (count_ > 0) {
             // Arm neon should be 16B
@@ -93,8 +98,9 @@ void Tensor::dealloc() {
     assert(backend_ != nullptr);
     if (masterTensor() != nullptr) { return; }
     if (!shape_offset_.empty() && !shape_master_.empty()) { return; }
-    backend_->free(host_ptr_);
+    if (!external_host_ptr_) { backend_->free(host_ptr_); }
     host_ptr_ = nullptr;
+    external_host_ptr_ = false;
     allocated_ = 0;
     count_ = 0;
 }
@@ -188,10 +194,20 @@ Tensor &Tensor::getFunc(const std::string &suffix, const TensorFuncType type,
     switch (Tensor::tensor_status) {
     case TENSOR_STATIC_INIT: {
         func->setup({module_tensors[next_name].get()}, tensorPtrs, float_args);
+        auto reads = tensorPtrs;
+        OpFusion::record(type, float_args, backend_, reads, {module_tensors[next_name].get()});
+        ActivationMemoryPlanner::recordUses(reads, {module_tensors[next_name].get()});
         break;
     }
     case TENSOR_STATIC_READY: {
-        func->execute({module_tensors[next_name].get()}, tensorPtrs, float_args);
+        bool profile = OpProfiler::enabled();
+        int64_t start_us = profile ? mllm_time_us() : 0;
+        if (!OpFusion::replaced(tensorPtrs, {module_tensors[next_name].get()})) {
+            func->execute({module_tensors[next_name].get()}, tensorPtrs, float_args);
+        }
+        if (profile) {
+            OpProfiler::record(next_name, TensorFuncNames[type], tensorPtrs, {module_tensors[next_name].get()}, backend_, start_us);
+        }
         break;
     }
     default: {
@@ -254,10 +270,18 @@ std::vector<std::reference_wrapper<Tensor>> Tensor::getStaticFunc(vector<std::st
     switch (Tensor::tensor_status) {
     case TENSOR_STATIC_INIT: {
         func->setup(outPtrs, input_tensors, float_args);
+        auto reads = input_tensors;
+        OpFusion::record(type, float_args, backend_h, reads, outPtrs);
+        ActivationMemoryPlanner::recordUses(reads, outPtrs);
         break;
     }
     case TENSOR_STATIC_READY: {
-        func->execute(outPtrs, input_tensors, float_args);
+        bool profile = OpProfiler::enabled();
+        int64_t start_us = profile ? mllm_time_us() : 0;
+        if (!OpFusion::replaced(input_tensors, outPtrs)) { func->execute(outPtrs, input_tensors, float_args); }
+        if (profile) {
+            OpProfiler::record(out_names[0], TensorFuncNames[type], input_tensors, outPtrs, backend_h, start_us);
+        }
         break;
     }
     default: {
@@ -391,10 +415,12 @@ Tensor &Tensor::cat(vector<Tensor> input_tensors, Chl axis) {
     return getStaticFunc({input_tensors[0].name() + "-cat"}, FUNC_CAT, {(float)axis}, inputs)[0].get();
 }
 
-Tensor &Tensor::mm(Tensor &input0, Tensor &input1) {
+Tensor &Tensor::mm(Tensor &input0, Tensor &input1, bool transpose1) {
     Module *module = input0.module();
+    vector<float> args = {};
+    if (transpose1) { args.push_back(1); }
     return getStaticFunc(
-               {input0.name() + "-mm-" + input1.name()}, FUNC_MM, {},
+               {input0.name() + "-mm-" + input1.name()}, FUNC_MM, args,
                {module->activation_tensors[input0.name()].get(), module->activation_tensors[input1.name()].get()})[0]
         .get();
 }
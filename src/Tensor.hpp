@@ -23,6 +23,7 @@
 namespace mllm {
 class Backend;
 class Module;
+class ActivationMemoryPlanner;
 
 /* Tensor is the baseic data structure of mllm. It is used to store the data of the model's weights and activations(the intermediate data of the calculation).
  * The Tensor class contained 3 kinds of Tensors: BasicTensor, ChildTensor. AggregatedTensor.
@@ -78,6 +79,7 @@ public:
     static TensorStatus tensor_status;
 
 private:
+    friend class ActivationMemoryPlanner;
     std::map<Chl, int> chls_ = {{BATCH, 0}, {SEQUENCE, 1}, {HEAD, 2}, {DIMENSION, 3}, {CHANNLE, 1}, {TIME, 2}, {HEIGHT, 3}, {WIDTH, 4}};
     string name_;
     DataType dtype_;
@@ -91,6 +93,7 @@ private:
     int capacity_{};
     int count_{};
     int allocated_ = 0;
+    bool external_host_ptr_ = false; // host_ptr_ is not owned by this Tensor, e.g. mmap-ed weights
     bool transed_ = false;
     bool should_in_graphs_ = true;
 
@@ -168,8 +171,9 @@ public:
     void free() {
         if (aggregated_) { return; }
         if (host_ptr_ != nullptr && masterTensor() == nullptr) {
-            backend_->free(host_ptr_);
+            if (!external_host_ptr_) { backend_->free(host_ptr_); }
             host_ptr_ = nullptr;
+            external_host_ptr_ = false;
             allocated_ = 0;
         }
     }
@@ -855,7 +859,11 @@ public:
     Tensor &clip(Chl keep_axis, vector<int> b, vector<int> h, vector<int> s, vector<int> d);
     Tensor &expand(int b, int h, int s, int d);
     static Tensor &cat(vector<Tensor> input_tensors, Chl dims);
-    static Tensor &mm(Tensor &input0, Tensor &input1);
+    /**
+     * \brief matrix multiplication of the last two dims.
+     * \param transpose1 multiply by input1^T, reading input1 as is (e.g. a paged KV cache).
+     */
+    static Tensor &mm(Tensor &input0, Tensor &input1, bool transpose1 = false);
     Tensor &norm(int L_n);
     Tensor &where(float value, Chl axis);
     static Tensor &range(int start, int end);
@@ -1765,6 +1773,24 @@ public:
 
     void forceResetHostPointer(void *ptr);
 
+    /**
+     * \brief let the Tensor use external memory (e.g. a mmap-ed weights file) as its data.
+     *        the buffer allocated before is released, and the external memory is never freed by this Tensor.
+     * \param ptr start address of the external memory, which should hold at least cntSize() bytes.
+     */
+    void setExternalHostPtr(void *ptr) {
+        assert(!aggregated_ && masterTensor() == nullptr);
+        if (host_ptr_ != nullptr && !external_host_ptr_) {
+            backend_->free(host_ptr_);
+        }
+        host_ptr_ = ptr;
+        external_host_ptr_ = true;
+        allocated_ = count_;
+    }
+    bool isExternalHostPtr() const {
+        return external_host_ptr_;
+    }
+
 public:
     float i8_scale = 1.f;
 };
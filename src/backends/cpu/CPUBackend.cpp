@@ -24,6 +24,7 @@
 #include "op/CPUEmbedding.hpp"
 #include "op/CPUMul.hpp"
 #include "op/CPUKVCache.hpp"
+#include "op/CPUFlashAttention.hpp"
 #include "op/CPUReLU.hpp"
 #include "op/CPUReLU2.hpp"
 #include "op/CPUGELU.hpp"
@@ -50,6 +51,7 @@
 #include "op/CPUSparseIdLinear.hpp"
 #include "op/CPUSparseLinear.hpp"
 #include "op/CPUElasticLinear.hpp"
+#include "op/CPUMergedLinear.hpp"
 #include "op/CPUQuantize.hpp"
 #include "op/CPUMergeOutput.hpp"
 #include "op/CPULinearINT8Shadow.hpp"
@@ -102,6 +104,13 @@ CPUBackend::CPUBackend(shared_ptr<MemoryManager> &mm) :
     type_ = BackendType::MLLM_CPU;
     registerOps();
     registerFuncs();
+    // grows on demand if cpu_threads is raised after the backend is created
+    thread_pool_ = std::make_unique<ThreadPool>(cpu_threads);
+    ThreadPool::setCurrent(thread_pool_.get());
+}
+
+CPUBackend::~CPUBackend() {
+    if (&ThreadPool::current() == thread_pool_.get()) { ThreadPool::setCurrent(nullptr); }
 }
 
 Op *CPUBackend::opCreate(const OpParam &op_param, string name, int threadCount) {
@@ -131,6 +140,7 @@ void CPUBackend::registerOps() {
     addCreator(MUL, (CPUBackend::Creator *)(new CPUMulCreator()));
     addCreator(VIEW, (CPUBackend::Creator *)(new CPUViewCreator()));
     addCreator(KVCACHE, (CPUBackend::Creator *)(new CPUKVCacheCreator()));
+    addCreator(SDPA, (CPUBackend::Creator *)(new CPUFlashAttentionCreator()));
     addCreator(KVCACHENPU, (CPUBackend::Creator *)(new CPUKVCacheNPUCreator()));
     addCreator(RELU, (CPUBackend::Creator *)(new CPUReLUCreator()));
     addCreator(RELU2, (CPUBackend::Creator *)(new CPUReLU2Creator()));
@@ -157,6 +167,7 @@ void CPUBackend::registerOps() {
     addCreator(SPARSELINEAR, (CPUBackend::Creator *)(new CPUSparseLinearCreator()));
     addCreator(SPARSEIDLINEAR, (CPUBackend::Creator *)(new CPUSparseIdLinearCreator()));
     addCreator(ELASTICLINEAR, (CPUBackend::Creator *)(new CPUElasticLinearCreator()));
+    addCreator(MERGEDLINEAR, (CPUBackend::Creator *)(new CPUMergedLinearCreator()));
     addCreator(POSITION, (CPUBackend::Creator *)(new CPUPositionCreator()));
     addCreator(QUANTIZE, (CPUBackend::Creator *)(new CPUQuantizeCreator()));
     addCreator(MERGEOUTPUT, (CPUBackend::Creator *)(new CPUMergeOutputCreator()));
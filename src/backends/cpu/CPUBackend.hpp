@@ -5,12 +5,49 @@
 #include "Op.hpp"
 #include "Types.hpp"
 #include "quantize/Quantize.hpp"
+#include "compute/ThreadPool.hpp"
 
 namespace mllm {
+
+/**
+ * \brief Row layout of a packed multi-sequence step (continuous batching).
+ *
+ * All tokens of the step are packed along SEQUENCE of a batch-1 input. Row r is token positions[r]
+ * of the sequence held in KV slot slots[r]; the rows of a slot are contiguous and their positions
+ * consecutive. Ops that keep per-sequence state (KVCache, RoPE, attention) read it from CPUBackend.
+ */
+struct SequenceBatch {
+    vector<int> slots;
+    vector<int> positions;
+
+    bool empty() const {
+        return slots.empty();
+    }
+    int rows() const {
+        return (int)slots.size();
+    }
+    /// slots in order of first appearance, with their cache length after the step.
+    vector<std::pair<int, int>> slotLengths() const {
+        vector<std::pair<int, int>> lengths;
+        for (int r = 0; r < rows(); ++r) {
+            if (lengths.empty() || lengths.back().first != slots[r]) {
+                lengths.emplace_back(slots[r], 0);
+            }
+            lengths.back().second = positions[r] + 1;
+        }
+        return lengths;
+    }
+    int maxLength() const {
+        int len = 0;
+        for (auto p : positions) { len = std::max(len, p + 1); }
+        return len;
+    }
+};
+
 class CPUBackend final : public Backend {
 public:
     explicit CPUBackend(shared_ptr<MemoryManager> &mm);
-    ~CPUBackend() override = default;
+    ~CPUBackend() override;
 
     class Creator {
     public:
@@ -31,6 +68,12 @@ public:
     void registerFuncs() override;
 
     static int cpu_threads;
+    /**
+     * \brief workers the ops of this backend run on; installed as ThreadPool::current() while the backend lives.
+     */
+    ThreadPool &threadPool() {
+        return *thread_pool_;
+    }
 
     // #ifdef USE_QNN
     void setSequenceLength(int sequence_length) {
@@ -52,6 +95,16 @@ public:
         return execution_type;
     }
     // #endif
+
+    /**
+     * \brief set the packed row layout of the next steps; an empty batch restores single-sequence mode.
+     */
+    void setSequenceBatch(SequenceBatch batch) {
+        sequence_batch_ = std::move(batch);
+    }
+    const SequenceBatch &sequenceBatch() const {
+        return sequence_batch_;
+    }
 private:
     std::map<OpType, CPUBackend::Creator *> map_creator_;
     std::map<TensorFuncType, TensorFunction *> map_function_;
@@ -60,6 +113,8 @@ private:
     bool isSwitchingStage = false;
     ExecutionType execution_type = PROMPT;
     // #endif
+    SequenceBatch sequence_batch_;
+    std::unique_ptr<ThreadPool> thread_pool_;
 };
 
 } // namespace mllm
@@ -26,6 +26,30 @@ void mllm_vec_silu_f32(const int n, float *y, const float *x) {
     }
 }
 
+void mllm_vec_swiglu_f32(const int n, float *y, const float *gate, const float *up) {
+    int i = 0;
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+    for (; i + 15 < n; i += 16) {
+        _mm512_storeu_ps(y + i, _mm512_mul_ps(mllm_v_silu(_mm512_loadu_ps(gate + i)), _mm512_loadu_ps(up + i)));
+    }
+#elif defined(__AVX2__) && defined(__FMA__)
+    for (; i + 7 < n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(mllm_v_silu(_mm256_loadu_ps(gate + i)), _mm256_loadu_ps(up + i)));
+    }
+#elif defined(__SSE2__)
+    for (; i + 3 < n; i += 4) {
+        _mm_storeu_ps(y + i, _mm_mul_ps(mllm_v_silu(_mm_loadu_ps(gate + i)), _mm_loadu_ps(up + i)));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 3 < n; i += 4) {
+        vst1q_f32(y + i, vmulq_f32(mllm_v_silu(vld1q_f32(gate + i)), vld1q_f32(up + i)));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] = mllm_silu_f32(gate[i]) * up[i];
+    }
+}
+
 float mllm_vec_soft_max_f32(const int n, float *y, const float *x, float max) {
     int i = 0;
     float sum = 0;
@@ -203,6 +203,9 @@ inline static __m128 mllm_v_silu(__m128 x) {
 
 void mllm_vec_silu_f32(const int n, float *y, const float *x);
 
+// y = silu(gate) * up, the gated MLP activation in one pass
+void mllm_vec_swiglu_f32(const int n, float *y, const float *gate, const float *up);
+
 float mllm_vec_soft_max_f32(const int n, float *y, const float *x, float max);
 
 } // namespace mllm
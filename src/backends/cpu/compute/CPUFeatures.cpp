@@ -0,0 +1,168 @@
+#include "CPUFeatures.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+#if defined(__aarch64__) && defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+namespace mllm {
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+static void cpuid(unsigned leaf, unsigned sub, unsigned regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int *)regs, (int)leaf, (int)sub);
+#else
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+static void probeX86(CPUFeatures &f) {
+    unsigned r[4];
+    cpuid(0, 0, r);
+    const unsigned max_leaf = r[0];
+    cpuid(1, 0, r);
+    const unsigned ecx1 = r[2];
+    f.sse4_2 = ecx1 & (1u << 20);
+    const bool osxsave = ecx1 & (1u << 27);
+    const unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+    const bool ymm_state = (xcr0 & 0x6) == 0x6;           // SSE + AVX
+    const bool zmm_state = ymm_state && (xcr0 & 0xE0) == 0xE0; // opmask + upper ZMM
+    f.avx = ymm_state && (ecx1 & (1u << 28));
+    f.fma = f.avx && (ecx1 & (1u << 12));
+    f.f16c = f.avx && (ecx1 & (1u << 29));
+    if (max_leaf < 7) { return; }
+    cpuid(7, 0, r);
+    const unsigned ebx7 = r[1], ecx7 = r[2], max_sub7 = r[0];
+    f.avx2 = f.avx && (ebx7 & (1u << 5));
+    f.avx512f = zmm_state && (ebx7 & (1u << 16));
+    f.avx512bw = f.avx512f && (ebx7 & (1u << 30));
+    f.avx512vl = f.avx512f && (ebx7 & (1u << 31));
+    f.avx512_vnni = f.avx512f && (ecx7 & (1u << 11));
+    if (max_sub7 >= 1) {
+        cpuid(7, 1, r);
+        f.avx_vnni = f.avx2 && (r[0] & (1u << 4));
+    }
+}
+#endif
+
+#if defined(__aarch64__) || defined(__arm__)
+static void probeARM(CPUFeatures &f) {
+#if defined(__aarch64__) && defined(__linux__)
+    // bit values from <asm/hwcap.h>, which older NDKs lack
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+    const unsigned long hwcap2 = getauxval(AT_HWCAP2);
+    f.neon = hwcap & (1ul << 1);     // HWCAP_ASIMD
+    f.dotprod = hwcap & (1ul << 20); // HWCAP_ASIMDDP
+    f.sve = hwcap & (1ul << 22);     // HWCAP_SVE
+    f.i8mm = hwcap2 & (1ul << 13);   // HWCAP2_I8MM
+#elif defined(__aarch64__) && defined(__APPLE__)
+    auto sysctl_flag = [](const char *name) {
+        int value = 0;
+        size_t size = sizeof(value);
+        return sysctlbyname(name, &value, &size, nullptr, 0) == 0 && value != 0;
+    };
+    f.neon = true;
+    f.dotprod = sysctl_flag("hw.optional.arm.FEAT_DotProd");
+    f.i8mm = sysctl_flag("hw.optional.arm.FEAT_I8MM");
+#else
+    // no probe available, trust the compile flags
+#if defined(__ARM_NEON)
+    f.neon = true;
+#endif
+#if defined(__ARM_FEATURE_DOTPROD)
+    f.dotprod = true;
+#endif
+#if defined(__ARM_FEATURE_MATMUL_INT8)
+    f.i8mm = true;
+#endif
+#if defined(__ARM_FEATURE_SVE)
+    f.sve = true;
+#endif
+#endif
+}
+#endif
+
+const CPUFeatures &cpuFeatures() {
+    static const CPUFeatures features = [] {
+        CPUFeatures f;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+        probeX86(f);
+#elif defined(__aarch64__) || defined(__arm__)
+        probeARM(f);
+#endif
+        return f;
+    }();
+    return features;
+}
+
+const char *cpuKernelISAName(CPUKernelISA isa) {
+    switch (isa) {
+    case CPU_ISA_AVXVNNI: return "avxvnni";
+    case CPU_ISA_AVX512VNNI: return "avx512vnni";
+    default: return "baseline";
+    }
+}
+
+CPUKernelISA cpuKernelISACap() {
+    const char *env = std::getenv("MLLM_CPU_ISA");
+    if (env == nullptr || *env == '\0') { return CPU_ISA_AVX512VNNI; }
+    if (strcmp(env, "avx512vnni") == 0 || strcmp(env, "avx512") == 0) { return CPU_ISA_AVX512VNNI; }
+    if (strcmp(env, "avxvnni") == 0) { return CPU_ISA_AVXVNNI; }
+    if (strcmp(env, "baseline") != 0 && strcmp(env, "avx2") != 0) {
+        fprintf(stderr, "MLLM_CPU_ISA=%s is not one of baseline, avx2, avxvnni, avx512vnni; using baseline\n", env);
+    }
+    return CPU_ISA_BASELINE;
+}
+
+void checkCPUBaseline() {
+    const CPUFeatures &f = cpuFeatures();
+    const char *missing = nullptr;
+#if defined(__AVX2__)
+    if (!f.avx2) { missing = "AVX2"; }
+#endif
+#if defined(__F16C__)
+    if (!f.f16c) { missing = "F16C"; }
+#endif
+#if defined(__FMA__)
+    if (!f.fma) { missing = "FMA"; }
+#endif
+#if defined(__AVX512F__)
+    if (!f.avx512f) { missing = "AVX-512F"; }
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_DOTPROD) && (defined(__linux__) || defined(__APPLE__))
+    if (!f.dotprod) { missing = "dotprod"; }
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_MATMUL_INT8) && (defined(__linux__) || defined(__APPLE__))
+    if (!f.i8mm) { missing = "i8mm"; }
+#endif
+    if (missing != nullptr) {
+        fprintf(stderr, "mllm was compiled for CPUs with %s, which this CPU does not support. "
+                        "Rebuild without -march=native or for an older target.\n",
+                missing);
+        std::exit(1);
+    }
+}
+
+} // namespace mllm
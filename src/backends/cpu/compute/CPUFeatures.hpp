@@ -0,0 +1,74 @@
+//
+// Runtime CPU feature detection and kernel dispatch.
+//
+
+#ifndef MLLM_CPUFEATURES_HPP
+#define MLLM_CPUFEATURES_HPP
+
+#include "VecDotType.hpp"
+
+namespace mllm {
+
+/**
+ * \brief instruction set extensions of the host, probed once with cpuid/xgetbv on x86 and hwcaps on ARM.
+ * x86 vector extensions are only reported when the OS saves their register state.
+ */
+struct CPUFeatures {
+    // x86
+    bool sse4_2 = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool f16c = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512vl = false;
+    bool avx512_vnni = false;
+    bool avx_vnni = false;
+    // ARM
+    bool neon = false;
+    bool dotprod = false;
+    bool i8mm = false;
+    bool sve = false;
+};
+
+const CPUFeatures &cpuFeatures();
+/**
+ * \brief exit with an error if the host lacks an instruction set the binary was compiled to assume,
+ * so a mismatched host fails with a message instead of SIGILL.
+ */
+void checkCPUBaseline();
+
+/**
+ * \brief kernel sets that can be swapped into type_traits, in increasing order of preference.
+ * Baseline is whatever the binary was compiled for (AVX2 on x86, the -march flags on ARM).
+ */
+enum CPUKernelISA {
+    CPU_ISA_BASELINE = 0,
+    CPU_ISA_AVXVNNI,
+    CPU_ISA_AVX512VNNI,
+};
+
+const char *cpuKernelISAName(CPUKernelISA isa);
+/**
+ * \brief the highest kernel set allowed by the MLLM_CPU_ISA environment variable
+ * (baseline/avx2, avxvnni, avx512vnni), CPU_ISA_AVX512VNNI when unset.
+ */
+CPUKernelISA cpuKernelISACap();
+/**
+ * \brief point the hot int8 entries of type_traits (Q4_0/Q8_0 vec_dot, Q4_0_4_4/4_8/8_8 gemv and gemm) and
+ * tinyBLAS (llamafile_sgemm, including its Q4_K/Q6_K tiles) at the best kernel set the host supports, up to `cap`.
+ * Runs once at startup, after checkCPUBaseline(); calling it again re-dispatches.
+ * Everything else, e.g. the K-quant vec_dots and the activations, stays compiled for the baseline, and on ARM the
+ * baseline includes dotprod.
+ * \return the kernel set in use.
+ */
+CPUKernelISA dispatchCPUKernels(CPUKernelISA cap = cpuKernelISACap());
+
+} // namespace mllm
+
+// per-ISA builds of the x86 kernels (GEMM_x86_*.cpp), false if the compiler could not build that set
+bool mllm_x86_kernels_avxvnni(type_traits_t *traits);
+bool mllm_x86_kernels_avx512vnni(type_traits_t *traits);
+
+#endif // MLLM_CPUFEATURES_HPP
@@ -1,4 +1,5 @@
 #include "GEMM_AArch64.hpp"
+#include "CPUFeatures.hpp"
 #include "Types.hpp"
 #include <assert.h>
 #include <cstdlib>
@@ -8,20 +9,16 @@
 #include <stdlib.h> // for qsort
 #include <string.h>
 
+int mllm_cpu_has_neon(void) {
+    return cpuFeatures().neon;
+}
+
 int mllm_cpu_has_sve(void) {
-#if defined(__ARM_FEATURE_SVE)
-    return 1;
-#else
-    return 0;
-#endif
+    return cpuFeatures().sve;
 }
 
 int mllm_cpu_has_matmul_int8(void) {
-#if defined(__ARM_FEATURE_MATMUL_INT8)
-    return 1;
-#else
-    return 0;
-#endif
+    return cpuFeatures().i8mm;
 }
 
 // Functions to create the interleaved data layout formats
@@ -363,6 +360,10 @@ size_t quantize_q4_0_8x8(const float *__restrict src, void *__restrict dst, int6
     return 0;
 }
 
+#if defined(__AVX2__)
+#include "GEMM_x86.hpp"
+#endif
+
 void mllm_gemv_q4_0_4x4_q8_0(int n, float *__restrict s, size_t bs, const void *__restrict vx,
                              const void *__restrict vy, int nr, int nc,
                              const void *__restrict bias) {
@@ -456,6 +457,8 @@ void mllm_gemv_q4_0_4x4_q8_0(int n, float *__restrict s, size_t bs, const void *
                          : [a_ptr] "r"(a_ptr), [nb] "r"(nb)
                          : "memory", "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24",
                            "v25", "v26", "v27", "v28", "v29", "v30", "v31", "x20", "x21", "x22");
+#elif defined(__AVX2__)
+    gemv_q4_0_x86<4, 4, block_q4_0x4>(n, s, bs, vx, vy, nr, nc, nullptr);
 #else
     float sumf[4];
     int sumi;
@@ -588,6 +591,8 @@ void _mllm_gemv_q4_0_4x4_q8_0_bias(int n, float *__restrict s, size_t bs, const
         : [a_ptr] "r"(a_ptr), [nb] "r"(nb)
         : "memory", "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24", "v25", "v26",
           "v27", "v28", "v29", "v30", "v31", "x20", "x21", "x22");
+#elif defined(__AVX2__)
+    gemv_q4_0_x86<4, 4, block_q4_0x4>(n, s, bs, vx, vy, nr, nc, bias);
 #else
     float sumf[4];
     int sumi;
@@ -730,6 +735,8 @@ void mllm_gemv_q4_0_4x8_q8_0(int n, float *__restrict s, size_t bs, const void *
            && "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the "
               "Q4_0_4_4 quantization format for optimal "
               "performance");
+#elif defined(__AVX2__)
+    gemv_q4_0_x86<4, 8, block_q4_0x4>(n, s, bs, vx, vy, nr, nc, nullptr);
 #else
     float sumf[4];
     int sumi;
@@ -867,6 +874,8 @@ void _mllm_gemv_q4_0_4x8_q8_0_bias(int n, float *__restrict s, size_t bs, const
            && "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the "
               "Q4_0_4_4 quantization format for optimal "
               "performance");
+#elif defined(__AVX2__)
+    gemv_q4_0_x86<4, 8, block_q4_0x4>(n, s, bs, vx, vy, nr, nc, bias);
 #else
     float sumf[4];
     int sumi;
@@ -1018,6 +1027,8 @@ void mllm_gemv_q4_0_8x8_q8_0(int n, float *__restrict s, size_t bs, const void *
            && "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the "
               "Q4_0_4_4 quantization format for optimal "
               "performance");
+#elif defined(__AVX2__)
+    gemv_q4_0_x86<8, 8, block_q4_0x8>(n, s, bs, vx, vy, nr, nc, nullptr);
 #else
     float sumf[8];
     int sumi;
@@ -1168,6 +1179,8 @@ void _mllm_gemv_q4_0_8x8_q8_0_bias(int n, float *__restrict s, size_t bs, const
            && "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the "
               "Q4_0_4_4 quantization format for optimal "
               "performance");
+#elif defined(__AVX2__)
+    gemv_q4_0_x86<8, 8, block_q4_0x8>(n, s, bs, vx, vy, nr, nc, bias);
 #else
     float sumf[8];
     int sumi;
@@ -1708,6 +1721,8 @@ void mllm_gemm_q4_0_4x4_q8_0(int n, float *__restrict s, size_t bs, const void *
           "v12", "v13", "v14", "v15", "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24",
           "v25", "v26", "v27", "v28", "v29", "v30", "v31", "x9", "x10", "x20", "x21", "x22", "x23",
           "x24", "x25", "x26", "x27", "x28");
+#elif defined(__AVX2__)
+    gemm_q4_0_x86<4, 4, block_q4_0x4>(n, s, bs, vx, vy, nr, nc, nullptr);
 #else
     float sumf[4][4];
     int sumi;
@@ -2251,6 +2266,8 @@ void _mllm_gemm_q4_0_4x4_q8_0_bias(int n, float *__restrict s, size_t bs, const
           "v12", "v13", "v14", "v15", "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24",
           "v25", "v26", "v27", "v28", "v29", "v30", "v31", "x9", "x10", "x20", "x21", "x22", "x23",
           "x24", "x25", "x26", "x27", "x28");
+#elif defined(__AVX2__)
+    gemm_q4_0_x86<4, 4, block_q4_0x4>(n, s, bs, vx, vy, nr, nc, bias);
 #else
     float sumf[4][4];
     int sumi;
@@ -2739,6 +2756,8 @@ void mllm_gemm_q4_0_4x8_q8_0(int n, float *__restrict s, size_t bs, const void *
            && "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the "
               "Q4_0_4_4 quantization format for optimal "
               "performance");
+#elif defined(__AVX2__)
+    gemm_q4_0_x86<4, 8, block_q4_0x4>(n, s, bs, vx, vy, nr, nc, nullptr);
 #else
     float sumf[4][4];
     int sumi;
@@ -3216,6 +3235,8 @@ void _mllm_gemm_q4_0_4x8_q8_0_bias(int n, float *__restrict s, size_t bs, const
            && "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the "
               "Q4_0_4_4 quantization format for optimal "
               "performance");
+#elif defined(__AVX2__)
+    gemm_q4_0_x86<4, 8, block_q4_0x4>(n, s, bs, vx, vy, nr, nc, bias);
 #else
     float sumf[4][4];
     int sumi;
@@ -3728,6 +3749,8 @@ void mllm_gemm_q4_0_8x8_q8_0(int n, float *__restrict s, size_t bs, const void *
            && "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the "
               "Q4_0_4_4 quantization format for optimal "
               "performance");
+#elif defined(__AVX2__)
+    gemm_q4_0_x86<8, 8, block_q4_0x8>(n, s, bs, vx, vy, nr, nc, nullptr);
 #else
     float sumf[4][8];
     int sumi;
@@ -4229,6 +4252,8 @@ void _mllm_gemm_q4_0_8x8_q8_0_bias(int n, float *__restrict s, size_t bs, const
            && "__ARM_FEATURE_SVE and __ARM_FEATURE_MATMUL_INT8 not defined, use the "
               "Q4_0_4_4 quantization format for optimal "
               "performance");
+#elif defined(__AVX2__)
+    gemm_q4_0_x86<8, 8, block_q4_0x8>(n, s, bs, vx, vy, nr, nc, bias);
 #else
     float sumf[4][8];
     int sumi;
@@ -4,6 +4,11 @@
 #include "VecDot.hpp"
 using namespace mllm;
 
+// runtime probes of the host, see CPUFeatures.hpp
+int mllm_cpu_has_neon(void);
+int mllm_cpu_has_sve(void);
+int mllm_cpu_has_matmul_int8(void);
+
 // Quantization
 void quantize_q8_0_4x4(const float *__restrict x, void *__restrict y, int64_t k);
 void quantize_q8_0_4x8(const float *__restrict x, void *__restrict y, int64_t k);
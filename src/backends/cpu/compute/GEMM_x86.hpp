@@ -0,0 +1,276 @@
+#ifndef MLLM_GEMM_X86_HPP
+#define MLLM_GEMM_X86_HPP
+
+// x86 bodies of the interleaved Q4_0 kernels and of the Q4_0/Q8_0 dot products.
+//
+// Everything here is static, so every file including this header gets its own copy built for its own target:
+// GEMM_AArch64.cpp builds the baseline (AVX2) copy, GEMM_x86_avxvnni.cpp and GEMM_x86_avx512.cpp build the
+// VNNI copies that dispatchCPUKernels() swaps into type_traits when the host has them. Those files switch the
+// target with #pragma GCC target, which does not define the ISA macros, so they pick the int8 dot instruction
+// by setting MLLM_X86_DPBUSD (0: maddubs, 1: AVX-VNNI, 2: AVX512-VNNI) before including this header.
+
+#include "Types.hpp"
+#include "VecDotType.hpp"
+#include "../quantize/Quantize.hpp"
+#include <immintrin.h>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef MLLM_X86_DPBUSD
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+#define MLLM_X86_DPBUSD 2
+#elif defined(__AVXVNNI__)
+#define MLLM_X86_DPBUSD 1
+#else
+#define MLLM_X86_DPBUSD 0
+#endif
+#endif
+
+// A 32-byte piece of a block_q4_0x4/x8 holds, in each 4-byte lane, 4 consecutive quants of one column whose
+// low nibbles pair with activation elements [4g, 4g + 4) and high nibbles with [4g + 16, 4g + 20). One dword
+// permute of the activation block lines it up with a piece, so every piece is decoded once per block and
+// reused for all activation rows. Lanes accumulate in float and are folded into columns at the end.
+
+// activation dword (group) of the low nibbles of lane w of piece p, and the column the lane belongs to
+template <int ncols_interleaved, int blocklen>
+static inline void q4_0_lane_layout(int p, int w, int &group, int &col) {
+    const int byte = p * 32 + w * 4;
+    const int k = byte / (ncols_interleaved * blocklen);
+    col = byte % (ncols_interleaved * blocklen) / blocklen;
+    group = (k * blocklen + byte % blocklen) / 4;
+}
+
+// sign-form nibbles (xor 0x88 at repack time) to int8
+static inline void q4_0_decode_piece(const uint8_t *qs, __m256i &lo, __m256i &hi) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, -8, -7, -6, -5, -4, -3, -2, -1,
+                                         0, 1, 2, 3, 4, 5, 6, 7, -8, -7, -6, -5, -4, -3, -2, -1);
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i bytes = _mm256_loadu_si256((const __m256i *)qs);
+    lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(bytes, mask));
+    hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask));
+}
+
+// acc + per-lane int32 sums of u * s, u unsigned
+static inline __m256i x86_dpbusd(__m256i acc, __m256i u, __m256i s) {
+#if MLLM_X86_DPBUSD == 2
+    return _mm256_dpbusd_epi32(acc, u, s);
+#elif MLLM_X86_DPBUSD == 1
+    return _mm256_dpbusd_avx_epi32(acc, u, s);
+#else
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(u, s), _mm256_set1_epi16(1)));
+#endif
+}
+
+// per-lane int32 sums of lo * a_lo + hi * a_hi
+static inline __m256i q4_0_dot_lanes(__m256i lo, __m256i a_lo, __m256i hi, __m256i a_hi) {
+#if MLLM_X86_DPBUSD
+    __m256i acc = x86_dpbusd(_mm256_setzero_si256(), _mm256_sign_epi8(lo, lo), _mm256_sign_epi8(a_lo, lo));
+    return x86_dpbusd(acc, _mm256_sign_epi8(hi, hi), _mm256_sign_epi8(a_hi, hi));
+#else
+    // |q4| <= 8, so the int16 pair sums of both halves cannot saturate
+    const __m256i dot = _mm256_add_epi16(_mm256_maddubs_epi16(_mm256_sign_epi8(lo, lo), _mm256_sign_epi8(a_lo, lo)),
+                                         _mm256_maddubs_epi16(_mm256_sign_epi8(hi, hi), _mm256_sign_epi8(a_hi, hi)));
+    return _mm256_madd_epi16(dot, _mm256_set1_epi16(1));
+#endif
+}
+
+// acc + a * b; every VNNI host has FMA
+static inline __m256 x86_fma(__m256 acc, __m256 a, __m256 b) {
+#if MLLM_X86_DPBUSD || defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, acc);
+#else
+    return _mm256_add_ps(acc, _mm256_mul_ps(a, b));
+#endif
+}
+
+static inline __m256 q4_0_load_scales(const mllm_fp16_t *d, int count) {
+#if defined(__F16C__)
+    if (count == 8) { return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)d)); }
+    return _mm256_cvtph_ps(_mm_loadl_epi64((const __m128i *)d));
+#else
+    float tmp[8] = {0};
+    for (int i = 0; i < count; i++) { tmp[i] = MLLM_FP16_TO_FP32(d[i]); }
+    return _mm256_loadu_ps(tmp);
+#endif
+}
+
+// s[m * bs + col] = rows[m] . column col (+ bias[col]) for nrows plain Q8_0 rows of nb blocks
+template <int ncols_interleaved, int blocklen, typename block_q4_0xN>
+static void gemm_q4_0_interleaved_x86(int nb, float *__restrict s, size_t bs, const block_q4_0xN *__restrict vx,
+                                      const int8_t *const *a_qs, const float *const *a_d, int nrows, int nc,
+                                      const float *__restrict bias) {
+    constexpr int pieces = ncols_interleaved * QK4_0 / 2 / 32;
+    constexpr int classes = ncols_interleaved / 4; // pieces of a class cover the same 4 columns
+    __m256i idx_lo[pieces], idx_hi[pieces];
+    __m256i scale_idx[classes];
+    int lane_col[pieces][8];
+    for (int p = 0; p < pieces; p++) {
+        int group[8];
+        for (int w = 0; w < 8; w++) { q4_0_lane_layout<ncols_interleaved, blocklen>(p, w, group[w], lane_col[p][w]); }
+        idx_lo[p] = _mm256_loadu_si256((const __m256i *)group);
+        idx_hi[p] = _mm256_add_epi32(idx_lo[p], _mm256_set1_epi32(4));
+        scale_idx[lane_col[p][0] / 4] = _mm256_loadu_si256((const __m256i *)lane_col[p]);
+    }
+    for (int x = 0; x < nc / ncols_interleaved; x++) {
+        const block_q4_0xN *b_ptr = vx + x * nb;
+        for (int m0 = 0; m0 < nrows; m0 += 4) {
+            const int rows = nrows - m0 < 4 ? nrows - m0 : 4;
+            __m256 acc[4][classes];
+            for (int m = 0; m < 4; m++) {
+                for (int c = 0; c < classes; c++) { acc[m][c] = _mm256_setzero_ps(); }
+            }
+            for (int l = 0; l < nb; l++) {
+                const __m256 d_b = q4_0_load_scales(b_ptr[l].d, ncols_interleaved);
+                __m256 lane_d[classes];
+                for (int c = 0; c < classes; c++) { lane_d[c] = _mm256_permutevar8x32_ps(d_b, scale_idx[c]); }
+                __m256i sums[4][classes];
+                for (int m = 0; m < rows; m++) {
+                    for (int c = 0; c < classes; c++) { sums[m][c] = _mm256_setzero_si256(); }
+                }
+                for (int p = 0; p < pieces; p++) {
+                    __m256i lo, hi;
+                    q4_0_decode_piece(b_ptr[l].qs + p * 32, lo, hi);
+                    const int c = lane_col[p][0] / 4;
+                    for (int m = 0; m < rows; m++) {
+                        const __m256i a = _mm256_loadu_si256((const __m256i *)(a_qs[m0 + m] + l * QK8_0));
+                        sums[m][c] = _mm256_add_epi32(sums[m][c], q4_0_dot_lanes(lo, _mm256_permutevar8x32_epi32(a, idx_lo[p]),
+                                                                                 hi, _mm256_permutevar8x32_epi32(a, idx_hi[p])));
+                    }
+                }
+                for (int m = 0; m < rows; m++) {
+                    const __m256 d_a = _mm256_set1_ps(a_d[m0 + m][l]);
+                    for (int c = 0; c < classes; c++) {
+                        acc[m][c] = x86_fma(acc[m][c], _mm256_cvtepi32_ps(sums[m][c]), _mm256_mul_ps(lane_d[c], d_a));
+                    }
+                }
+            }
+            for (int m = 0; m < rows; m++) {
+                float sumf[ncols_interleaved];
+                for (int j = 0; j < ncols_interleaved; j++) {
+                    sumf[j] = bias != nullptr ? bias[x * ncols_interleaved + j] : 0.0F;
+                }
+                for (int c = 0; c < classes; c++) {
+                    float lanes[8];
+                    _mm256_storeu_ps(lanes, acc[m][c]);
+                    for (int p = 0; p < pieces; p++) {
+                        if (lane_col[p][0] / 4 != c) { continue; }
+                        // pieces of a class share lanes, fold them once
+                        for (int w = 0; w < 8; w++) { sumf[lane_col[p][w]] += lanes[w]; }
+                        break;
+                    }
+                }
+                for (int j = 0; j < ncols_interleaved; j++) {
+                    s[(m0 + m) * bs + x * ncols_interleaved + j] = sumf[j];
+                }
+            }
+        }
+    }
+}
+
+// gemv/gemm take the mllm_gemv_func/mllm_gemm_func signature so the VNNI builds can go straight into type_traits.
+// Scratch buffers come from malloc: std containers instantiated here could be merged with the baseline ones at
+// link time while carrying VNNI instructions.
+template <int ncols_interleaved, int blocklen, typename block_q4_0xN>
+static void gemv_q4_0_x86(int n, float *__restrict s, size_t bs, const void *__restrict vx, const void *__restrict vy,
+                          int nr, int nc, const void *__restrict bias) {
+    const int nb = n / QK8_0;
+    const block_q8_0 *a_ptr = (const block_q8_0 *)vy;
+    int8_t *qs = (int8_t *)malloc(nb * QK8_0);
+    float *d = (float *)malloc(nb * sizeof(float));
+    for (int l = 0; l < nb; l++) {
+        memcpy(qs + l * QK8_0, a_ptr[l].qs, QK8_0);
+        d[l] = MLLM_FP16_TO_FP32(a_ptr[l].d);
+    }
+    const int8_t *a_qs = qs;
+    const float *a_d = d;
+    gemm_q4_0_interleaved_x86<ncols_interleaved, blocklen>(nb, s, 0, (const block_q4_0xN *)vx, &a_qs, &a_d, 1, nc,
+                                                           (const float *)bias);
+    free(qs);
+    free(d);
+}
+
+// activations come as block_q8_0x4 (4 rows interleaved in blocks of blocklen bytes)
+template <int ncols_interleaved, int blocklen, typename block_q4_0xN>
+static void gemm_q4_0_x86(int n, float *__restrict s, size_t bs, const void *__restrict vx, const void *__restrict vy,
+                          int nr, int nc, const void *__restrict bias) {
+    const int nb = n / QK8_0;
+    int8_t *qs = (int8_t *)malloc(4 * nb * QK8_0);
+    float *d = (float *)malloc(4 * nb * sizeof(float));
+    int8_t *a_qs[4];
+    float *a_d[4];
+    for (int m = 0; m < 4; m++) {
+        a_qs[m] = qs + m * nb * QK8_0;
+        a_d[m] = d + m * nb;
+    }
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 *a_ptr = (const block_q8_0x4 *)vy + y * nb;
+        for (int l = 0; l < nb; l++) {
+            for (int m = 0; m < 4; m++) {
+                for (int c = 0; c < QK8_0 / blocklen; c++) {
+                    memcpy(a_qs[m] + l * QK8_0 + c * blocklen, a_ptr[l].qs + (c * 4 + m) * blocklen, blocklen);
+                }
+                a_d[m][l] = MLLM_FP16_TO_FP32(a_ptr[l].d[m]);
+            }
+        }
+        gemm_q4_0_interleaved_x86<ncols_interleaved, blocklen>(nb, s + y * 4 * bs, bs, (const block_q4_0xN *)vx, a_qs,
+                                                               a_d, 4, nc, (const float *)bias);
+    }
+    free(qs);
+    free(d);
+}
+
+#ifdef MLLM_X86_KERNEL_SET
+// plain-layout dot products, only the VNNI builds replace the VecDot.cpp ones
+static inline float x86_hsum(__m256 x) {
+    __m128 res = _mm_add_ps(_mm256_extractf128_ps(x, 1), _mm256_castps256_ps128(x));
+    res = _mm_add_ps(res, _mm_movehl_ps(res, res));
+    res = _mm_add_ss(res, _mm_movehdup_ps(res));
+    return _mm_cvtss_f32(res);
+}
+
+static void vec_dot_q8_0_q8_0_x86(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy) {
+    const block_q8_0 *x = (const block_q8_0 *)vx;
+    const block_q8_0 *y = (const block_q8_0 *)vy;
+    __m256 acc = _mm256_setzero_ps();
+    for (int i = 0; i < n / QK8_0; i++) {
+        const __m256 d = _mm256_set1_ps(MLLM_FP16_TO_FP32(x[i].d) * MLLM_FP16_TO_FP32(y[i].d));
+        const __m256i qx = _mm256_loadu_si256((const __m256i *)x[i].qs);
+        const __m256i qy = _mm256_loadu_si256((const __m256i *)y[i].qs);
+        const __m256i dot = x86_dpbusd(_mm256_setzero_si256(), _mm256_sign_epi8(qx, qx), _mm256_sign_epi8(qy, qx));
+        acc = x86_fma(acc, d, _mm256_cvtepi32_ps(dot));
+    }
+    *s = x86_hsum(acc);
+}
+
+static void vec_dot_q4_0_q8_0_x86(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy) {
+    const block_q4_0 *x = (const block_q4_0 *)vx;
+    const block_q8_0 *y = (const block_q8_0 *)vy;
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i off = _mm256_set1_epi8(8);
+    __m256 acc = _mm256_setzero_ps();
+    for (int i = 0; i < n / QK8_0; i++) {
+        const __m256 d = _mm256_set1_ps(MLLM_FP16_TO_FP32(x[i].d) * MLLM_FP16_TO_FP32(y[i].d));
+        const __m128i tmp = _mm_loadu_si128((const __m128i *)x[i].qs);
+        const __m256i nibbles = _mm256_and_si256(_mm256_inserti128_si256(_mm256_castsi128_si256(tmp), _mm_srli_epi16(tmp, 4), 1), mask);
+        const __m256i qx = _mm256_sub_epi8(nibbles, off);
+        const __m256i qy = _mm256_loadu_si256((const __m256i *)y[i].qs);
+        const __m256i dot = x86_dpbusd(_mm256_setzero_si256(), _mm256_sign_epi8(qx, qx), _mm256_sign_epi8(qy, qx));
+        acc = x86_fma(acc, d, _mm256_cvtepi32_ps(dot));
+    }
+    *s = x86_hsum(acc);
+}
+
+// point the hot int8 entries of `traits` at this file's build of the kernels
+static void x86_kernel_set(type_traits_t *traits) {
+    traits[MLLM_TYPE_Q4_0].vec_dot = vec_dot_q4_0_q8_0_x86;
+    traits[MLLM_TYPE_Q8_0].vec_dot = vec_dot_q8_0_q8_0_x86;
+    traits[MLLM_TYPE_Q4_0_4_4].gemv = gemv_q4_0_x86<4, 4, block_q4_0x4>;
+    traits[MLLM_TYPE_Q4_0_4_4].gemm = gemm_q4_0_x86<4, 4, block_q4_0x4>;
+    traits[MLLM_TYPE_Q4_0_4_8].gemv = gemv_q4_0_x86<4, 8, block_q4_0x4>;
+    traits[MLLM_TYPE_Q4_0_4_8].gemm = gemm_q4_0_x86<4, 8, block_q4_0x4>;
+    traits[MLLM_TYPE_Q4_0_8_8].gemv = gemv_q4_0_x86<8, 8, block_q4_0x8>;
+    traits[MLLM_TYPE_Q4_0_8_8].gemm = gemm_q4_0_x86<8, 8, block_q4_0x8>;
+}
+#endif
+
+#endif // MLLM_GEMM_X86_HPP
@@ -0,0 +1,33 @@
+#include "CPUFeatures.hpp"
+
+// AVX512-VNNI build of GEMM_x86.hpp, using the 256-bit VL forms, and of SGEMM.cpp, whose tinyBLAS tiles go 512-bit.
+// Headers with inline code are included before the target switch so that only the kernels themselves may use AVX-512.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ >= 8)
+#include "Types.hpp"
+#include "VecDotType.hpp"
+#include "../quantize/Quantize.hpp"
+#include "SGEMM.hpp"
+#include <immintrin.h>
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma,f16c,avx512f,avx512bw,avx512vl,avx512vnni")
+#define MLLM_X86_DPBUSD 2
+#define MLLM_X86_KERNEL_SET
+#include "GEMM_x86.hpp"
+// and of tinyBLAS
+#define MLLM_SGEMM_KERNEL(name) name##_avx512vnni
+#define MLLM_SGEMM_KERNEL_SET
+#include "SGEMM.cpp"
+#pragma GCC pop_options
+#define MLLM_X86_AVX512VNNI_BUILT 1
+#endif
+
+bool mllm_x86_kernels_avx512vnni(type_traits_t *traits) {
+#ifdef MLLM_X86_AVX512VNNI_BUILT
+    x86_kernel_set(traits);
+    set_llamafile_sgemm(llamafile_sgemm_avx512vnni, check_llamafile_sgemm_avx512vnni);
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,33 @@
+#include "CPUFeatures.hpp"
+
+// AVX-VNNI build of GEMM_x86.hpp and SGEMM.cpp. Headers with inline code are included before the target switch so
+// that only the kernels themselves may use VNNI.
+#if (defined(__x86_64__) || defined(__i386__)) && ((defined(__clang__) && __clang_major__ >= 12) || (!defined(__clang__) && __GNUC__ >= 11))
+#include "Types.hpp"
+#include "VecDotType.hpp"
+#include "../quantize/Quantize.hpp"
+#include "SGEMM.hpp"
+#include <immintrin.h>
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma,f16c,avxvnni")
+#define MLLM_X86_DPBUSD 1
+#define MLLM_X86_KERNEL_SET
+#include "GEMM_x86.hpp"
+// and of tinyBLAS
+#define MLLM_SGEMM_KERNEL(name) name##_avxvnni
+#define MLLM_SGEMM_KERNEL_SET
+#include "SGEMM.cpp"
+#pragma GCC pop_options
+#define MLLM_X86_AVXVNNI_BUILT 1
+#endif
+
+bool mllm_x86_kernels_avxvnni(type_traits_t *traits) {
+#ifdef MLLM_X86_AVXVNNI_BUILT
+    x86_kernel_set(traits);
+    set_llamafile_sgemm(llamafile_sgemm_avxvnni, check_llamafile_sgemm_avxvnni);
+    return true;
+#else
+    return false;
+#endif
+}
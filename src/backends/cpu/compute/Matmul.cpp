@@ -6,6 +6,9 @@
 #include "Types.hpp"
 #include "VecDotType.hpp"
 #include "SGEMM.hpp"
+#include "../CPUBackend.hpp"
+#include "ThreadPool.hpp"
+#include <cmath>
 #include <cassert>
 
 #ifdef __ARM_NEON
@@ -43,29 +46,27 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
     if (check_llamafile_sgemm(N, M, K / blck_size(src0->dtype()), src1->dtype(), src0->dtype(), dst->dtype(), ld_src1 / src1_blck_size, ld_src0 / src0_blck_size, ld_dst / blck_size(dst->dtype()))
         && dst->aggregatedTensors().empty()) {
         int is_0 = (src1->batch() == 1 && src1->head() == 1 && src1->batch() != src0->batch()) ? 0 : 1;
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int64_t b = 0; b < dst->batch(); b++) {
-            for (int64_t h = 0; h < dst->head(); h++) {
-                for (int id = 0; id < thread_count; id++) {
-                    llamafile_sgemm(
-                        N, M, K / blck_size(src0->dtype()),
-                        (char *)src1->rawHostPtr()
-                            + src1->offset(b * is_0, h * is_0, 0, 0) * src1_type_size
-                                  / src1_blck_size,
-                        ld_src1 / src1_blck_size,
-                        (char *)src0->rawHostPtr()
-                            + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
-                        ld_src0 / src0_blck_size,
-                        (char *)dst->rawHostPtr()
-                            + dst->offset(b, h, 0, 0) * type_size(dst->dtype())
-                                  / blck_size(dst->dtype()),
-                        ld_dst / blck_size(dst->dtype()), id, thread_count, src1->dtype(),
-                        src0->dtype(), dst->dtype(),
-                        /*bias=*/support_bias ? bias->hostPtr<float>() : nullptr,
-                        /*BiasType=*/support_bias ? bias->dtype() : DataType::MLLM_TYPE_F32);
-                }
-            }
-        }
+        const int64_t H = dst->head();
+        parallel_for(dst->batch() * H * thread_count, thread_count, [&](int64_t i) {
+            const int64_t b = i / (H * thread_count), h = i / thread_count % H;
+            const int id = (int)(i % thread_count);
+            llamafile_sgemm(
+                N, M, K / blck_size(src0->dtype()),
+                (char *)src1->rawHostPtr()
+                    + src1->offset(b * is_0, h * is_0, 0, 0) * src1_type_size
+                          / src1_blck_size,
+                ld_src1 / src1_blck_size,
+                (char *)src0->rawHostPtr()
+                    + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
+                ld_src0 / src0_blck_size,
+                (char *)dst->rawHostPtr()
+                    + dst->offset(b, h, 0, 0) * type_size(dst->dtype())
+                          / blck_size(dst->dtype()),
+                ld_dst / blck_size(dst->dtype()), id, thread_count, src1->dtype(),
+                src0->dtype(), dst->dtype(),
+                /*bias=*/support_bias ? bias->hostPtr<float>() : nullptr,
+                /*BiasType=*/support_bias ? bias->dtype() : DataType::MLLM_TYPE_F32);
+        }, 1);
         return MLLM_NO_ERROR;
     }
 #endif
@@ -83,30 +84,27 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
         if ((from_float_to_mat != nullptr) && (gemv != nullptr) && dst->masterTensor() == nullptr) {
             for (int b = 0; b < src0->batch(); b++) {
                 for (int h = 0; h < src0->head(); h++) {
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-                    for (int64_t s = 0; s < src0->sequence() - src0->sequence() % 4; s += 4) {
+                    parallel_for(src0->sequence() / 4, thread_count, [&](int64_t s4) {
+                        const int64_t s = s4 * 4;
                         from_float_to_mat(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
                                           (char *)to->rawHostPtr()
                                               + to->offset(b, h, s, 0) * type_size(to->dtype())
                                                     / blck_size(to->dtype()),
                                           4, src0->dimension(), blck_size_interleave);
-                    }
+                    });
                     i_processed = src0->sequence() - src0->sequence() % 4;
                 }
             }
         }
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int b = 0; b < src0->batch(); b++) {
-            for (int h = 0; h < src0->head(); h++) {
-                for (int s = i_processed; s < src0->sequence(); s++) {
-                    x_to_vec_dot_type(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
-                                      (char *)to->rawHostPtr()
-                                          + to->offset(b, h, s, 0) * type_size(to->dtype())
-                                                / blck_size(to->dtype()),
-                                      src0->dimension());
-                }
-            }
-        }
+        const int64_t H = src0->head(), S = src0->sequence() - i_processed;
+        parallel_for(src0->batch() * H * S, thread_count, [&](int64_t i) {
+            const int b = (int)(i / (H * S)), h = (int)(i / S % H), s = (int)(i_processed + i % S);
+            x_to_vec_dot_type(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                              (char *)to->rawHostPtr()
+                                  + to->offset(b, h, s, 0) * type_size(to->dtype())
+                                        / blck_size(to->dtype()),
+                              src0->dimension());
+        });
         src0 = to.get();
         src0_dtype = src0->dtype();
         src0_type_size = type_size(src0->dtype());
@@ -121,37 +119,34 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
                               dst->dtype(), ld_src1 / src1_blck_size, ld_src0 / src0_blck_size, ld_dst / blck_size(dst->dtype()))
         && dst->dtypeAt(0, 0, 0, 0) == MLLM_TYPE_F32 && dst->ctype() == BSHD
         && dst->aggregatedTensors().empty()) {
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int64_t b = 0; b < dst->batch(); b++) {
-            for (int64_t h = 0; h < dst->head(); h++) {
-                for (int id = 0; id < thread_count; id++) {
-                    llamafile_sgemm(
-                        N, M, K / blck_size(src1->dtype()),
-                        (char *)src1->rawHostPtr()
-                            + src1->offset(b, h, 0, 0) * src1_type_size / src1_blck_size,
-                        ld_src1 / src1_blck_size,
-                        (char *)src0->rawHostPtr()
-                            + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
-                        ld_src0 / src0_blck_size,
-                        (char *)dst->rawHostPtr()
-                            + dst->offset(b, h, 0, 0) * type_size(dst->dtype())
-                                  / blck_size(dst->dtype()),
-                        ld_dst / blck_size(dst->dtype()), id, thread_count, src1->dtype(),
-                        src0->dtype(), dst->dtype(),
-                        /*bias=*/
-                        support_bias ? bias->hostPtr<float>() + bias->offset(b, h, 0, 0) : nullptr,
-                        /*BiasType=*/support_bias ? bias->dtype() : DataType::MLLM_TYPE_F32);
-                }
-            }
-        }
+        const int64_t H = dst->head();
+        parallel_for(dst->batch() * H * thread_count, thread_count, [&](int64_t i) {
+            const int64_t b = i / (H * thread_count), h = i / thread_count % H;
+            const int id = (int)(i % thread_count);
+            llamafile_sgemm(
+                N, M, K / blck_size(src1->dtype()),
+                (char *)src1->rawHostPtr()
+                    + src1->offset(b, h, 0, 0) * src1_type_size / src1_blck_size,
+                ld_src1 / src1_blck_size,
+                (char *)src0->rawHostPtr()
+                    + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
+                ld_src0 / src0_blck_size,
+                (char *)dst->rawHostPtr()
+                    + dst->offset(b, h, 0, 0) * type_size(dst->dtype())
+                          / blck_size(dst->dtype()),
+                ld_dst / blck_size(dst->dtype()), id, thread_count, src1->dtype(),
+                src0->dtype(), dst->dtype(),
+                /*bias=*/
+                support_bias ? bias->hostPtr<float>() + bias->offset(b, h, 0, 0) : nullptr,
+                /*BiasType=*/support_bias ? bias->dtype() : DataType::MLLM_TYPE_F32);
+        }, 1);
         return MLLM_NO_ERROR;
     }
 #endif
     if ((gemv != nullptr) && dst->dtypeAt(0, 0, 0, 0) == MLLM_TYPE_F32) {
         int nth = thread_count;
         if (!support_bias) {
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-            for (int ith = 0; ith < nth; ith++) {
+            parallel_for(nth, thread_count, [&](int64_t ith) {
                 int64_t i_processed = 0;
                 int64_t seq_start = (ith * N) / nth;
                 int64_t seq_end = ((ith + 1) * N) / nth;
@@ -170,10 +165,9 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
                              + src0->offset(0, 0, iter, 0) * src0_type_size / src0_blck_size,
                          1, N / nth, /*bias=*/nullptr);
                 }
-            }
+            }, 1);
         } else {
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-            for (int ith = 0; ith < nth; ith++) {
+            parallel_for(nth, thread_count, [&](int64_t ith) {
                 int64_t i_processed = 0;
                 int64_t seq_start = (ith * N) / nth;
                 int64_t seq_end = ((ith + 1) * N) / nth;
@@ -196,7 +190,7 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
                          /*bias=*/bias->hostPtr<float>()
                              + bias->offset(/*b=*/0, /*h=*/0, /*s=*/0, /*d=*/seq_start));
                 }
-            }
+            }, 1);
         }
 
         return MLLM_NO_ERROR;
@@ -206,60 +200,56 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
     Tensor *src1_cal = src1;
     const int64_t blck_0 = 16;
     int is_0 = (src1->batch() == 1 && src1->head() == 1 && src1->batch() != src0->batch()) ? 0 : 1;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int b = 0; b < src0->batch(); b++) {
-        for (int h = 0; h < src0->head(); h++) {
-            for (int m = 0; m < M; m++) {
-                for (int block = 0; block < N / blck_0 + 1; block++) {
-                    for (int n = block * blck_0; n < (block + 1) * blck_0 && n < N; n++) {
-                        int s_1;
-                        int d_1;
-                        int s_0;
-                        int d_0;
-                        if (!transpose0 && transpose1) {
-                            s_1 = n;
-                            d_1 = 0;
-                            s_0 = m;
-                            d_0 = 0;
-                        } else if (!transpose0 && !transpose1) {
-                            s_1 = 0;
-                            d_1 = n;
-                            s_0 = m;
-                            d_0 = 0;
-                        } else {
-                            s_1 = 0;
-                            d_1 = n;
-                            s_0 = 0;
-                            d_0 = m;
-                        }
-                        float tmp = 0;
-                        vec_dot(K, &tmp,
-                                (char *)src1_cal->rawHostPtr()
-                                    + src1_cal->offset(b * is_0, h * is_0, s_1, d_1)
-                                          * src1_type_size / src1_blck_size,
-                                (char *)src0_cal->rawHostPtr()
-                                    + src0_cal->offset(b, h, s_0, d_0) * src0_type_size
-                                          / src0_blck_size);
-                        if (dst->dtypeAt(b, h, m, n) == MLLM_TYPE_F32) {
-                            dst->setDataAt<float>(b, h, m, n, tmp);
-                            if (support_bias) {
-                                *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
-                            }
-                        } else if (dst->dtypeAt(b, h, m, n) == MLLM_TYPE_F16) {
-                            if (support_bias) {
-                                *dst->ptrAt<mllm_fp16_t>(b, h, m, n) =
-                                    MLLM_FP32_TO_FP16(tmp + bias->dataAt<float>(0, 0, 0, n));
-                            } else {
-                                *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp);
-                            }
-                        } else {
-                            std::cout << "Not support type [Matmul]" << std::endl;
-                        }
-                    }
+    const int64_t H = src0->head(), NB = N / blck_0 + 1;
+    parallel_for(src0->batch() * H * M * NB, thread_count, [&](int64_t i) {
+        const int b = (int)(i / (H * M * NB)), h = (int)(i / (M * NB) % H);
+        const int m = (int)(i / NB % M), block = (int)(i % NB);
+        for (int n = block * blck_0; n < (block + 1) * blck_0 && n < N; n++) {
+            int s_1;
+            int d_1;
+            int s_0;
+            int d_0;
+            if (!transpose0 && transpose1) {
+                s_1 = n;
+                d_1 = 0;
+                s_0 = m;
+                d_0 = 0;
+            } else if (!transpose0 && !transpose1) {
+                s_1 = 0;
+                d_1 = n;
+                s_0 = m;
+                d_0 = 0;
+            } else {
+                s_1 = 0;
+                d_1 = n;
+                s_0 = 0;
+                d_0 = m;
+            }
+            float tmp = 0;
+            vec_dot(K, &tmp,
+                    (char *)src1_cal->rawHostPtr()
+                        + src1_cal->offset(b * is_0, h * is_0, s_1, d_1)
+                              * src1_type_size / src1_blck_size,
+                    (char *)src0_cal->rawHostPtr()
+                        + src0_cal->offset(b, h, s_0, d_0) * src0_type_size
+                              / src0_blck_size);
+            if (dst->dtypeAt(b, h, m, n) == MLLM_TYPE_F32) {
+                dst->setDataAt<float>(b, h, m, n, tmp);
+                if (support_bias) {
+                    *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
+                }
+            } else if (dst->dtypeAt(b, h, m, n) == MLLM_TYPE_F16) {
+                if (support_bias) {
+                    *dst->ptrAt<mllm_fp16_t>(b, h, m, n) =
+                        MLLM_FP32_TO_FP16(tmp + bias->dataAt<float>(0, 0, 0, n));
+                } else {
+                    *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp);
                 }
+            } else {
+                std::cout << "Not support type [Matmul]" << std::endl;
             }
         }
-    }
+    });
     return MLLM_NO_ERROR;
 }
 
@@ -285,6 +275,77 @@ ErrorCode mat_mul_i8(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias,
     return MLLM_NO_ERROR;
 }
 
+ErrorCode mat_mul_paged(Tensor *src0, Tensor *src1, Tensor *dst, bool transpose1, int thread_count,
+                        const SequenceBatch *seq_batch) {
+    // src0 = q or qk (F32, BSHD), src1 = paged KV cache: AggregatedTensor over SEQUENCE of F16 blocks
+    // transpose1=true:  dst = src0 * src1^T  (q * k^T)
+    // transpose1=false: dst = src0 * src1    (qk * v)
+    assert(src1->aggregated());
+    assert(src0->dtype() == MLLM_TYPE_F32);
+    auto &blocks = src1->aggregatedTensors();
+    const int B = src0->batch();
+    const int H = src0->head();
+    const int M = src0->sequence();
+    const int D = src1->dimension();
+    const int n_rep = H / src1->head();
+    assert(H % src1->head() == 0);
+    // blocks [row_block_begin[m], ...) hold the keys row m attends to, row_keys[m] of them
+    vector<int> row_block_begin(M, 0);
+    vector<int> row_keys(M, src1->sequence());
+    if (seq_batch != nullptr) {
+        assert(B == 1 && M == seq_batch->rows());
+        int block = 0;
+        int m = 0;
+        for (auto &slot : seq_batch->slotLengths()) {
+            const int begin = block;
+            for (int len = 0; len < slot.second; len += blocks[block]->sequence(), ++block) {}
+            for (; m < M && seq_batch->slots[m] == slot.first; ++m) {
+                row_block_begin[m] = begin;
+                row_keys[m] = seq_batch->positions[m] + 1;
+            }
+        }
+    }
+    const int N = transpose1 ? dst->dimension() : 0;
+    // f16 copy of the query row, one per thread
+    const int slots = std::max(thread_count, ThreadPool::current().size());
+    vector<mllm_fp16_t> rows_f16(transpose1 ? (size_t)slots * D : 0);
+    parallel_for((int64_t)B * H * M, thread_count, [&](int64_t idx) {
+        const int b = (int)(idx / (H * M));
+        const int h = (int)(idx / M % H);
+        const int m = (int)(idx % M);
+        const int kv_h = h / n_rep;
+        const float *row = src0->ptrAt<float>(b, h, m, 0);
+        float *out = dst->ptrAt<float>(b, h, m, 0);
+        const int keys = row_keys[m];
+        int n = 0;
+        if (transpose1) {
+            mllm_fp16_t *row_f16 = rows_f16.data() + (size_t)ThreadPool::threadIndex() * D;
+            for (int d = 0; d < D; d++) {
+                row_f16[d] = MLLM_FP32_TO_FP16(row[d]);
+            }
+            for (int i = row_block_begin[m]; n < keys; i++) {
+                auto &block = blocks[i];
+                for (int t = 0; t < block->sequence() && n < keys; t++, n++) {
+                    vec_dot_fp16(D, out + n, row_f16, block->ptrAt<mllm_fp16_t>(b, kv_h, t, 0));
+                }
+            }
+            for (; n < N; n++) {
+                out[n] = -INFINITY;
+            }
+        } else {
+            memset(out, 0, D * sizeof(float));
+            for (int i = row_block_begin[m]; n < keys; i++) {
+                auto &block = blocks[i];
+                for (int t = 0; t < block->sequence() && n < keys; t++, n++) {
+                    if (row[n] == 0.0F) { continue; } // masked by softmax
+                    vec_mad_fp16(D, out, block->ptrAt<mllm_fp16_t>(b, kv_h, t, 0), row[n]);
+                }
+            }
+        }
+    });
+    return MLLM_NO_ERROR;
+}
+
 #ifdef __ARM_NEON
 namespace mllm::armv8 {
 
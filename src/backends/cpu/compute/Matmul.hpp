@@ -12,6 +12,19 @@ ErrorCode mat_mul(Tensor *src0_, Tensor *src1, Tensor *dst, bool support_bias, T
 
 ErrorCode mat_mul_i8(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Tensor *bias = nullptr, bool transpose0 = false, bool transpose1 = false, int thread_count = 4, float scale1 = 1.0f, float scale2 = 1.0f);
 
+namespace mllm {
+struct SequenceBatch;
+}
+/**
+ * \brief matmul against a paged KV cache (an AggregatedTensor of F16 blocks along SEQUENCE).
+ * Heads of src0 are mapped onto the cache's kv heads, so GQA caches need not be replicated.
+ * With a packed continuous-batching step (seq_batch), src1 holds the slots of the step one after the
+ * other and row r of src0 only sees the first positions[r] + 1 keys of its own slot: q * k^T writes
+ * them to columns [0, positions[r] + 1) and -INFINITY to the rest of the row.
+ */
+ErrorCode mat_mul_paged(Tensor *src0, Tensor *src1, Tensor *dst, bool transpose1, int thread_count = 4,
+                        const SequenceBatch *seq_batch = nullptr);
+
 #ifdef __ARM_NEON
 
 #ifndef __ARM_NEON
@@ -50,6 +50,11 @@
 
 #include "SGEMM.hpp"
 
+// GEMM_x86_*.cpp include this file again under #pragma GCC target, renaming the entry points with MLLM_SGEMM_KERNEL
+#ifndef MLLM_SGEMM_KERNEL
+#define MLLM_SGEMM_KERNEL(name) name##_baseline
+#endif
+
 #ifdef _MSC_VER
 #define NOINLINE __declspec(noinline)
 #else
@@ -875,6 +880,435 @@ private:
 };
 #endif // __AVX__
 
+#if QK_K == 256
+// Q4_K and Q6_K are tiled like the Q0 kernels: every weight row of a tile is unpacked once per super-block
+// into unsigned quants, one scale per 16 quants and an offset term, then reused for every activation column.
+// With y the Q8_K row,
+//     x . y = d * dy * sum_g scale_g * (q_g . y_g) - dmin * dy * sum_g offset_g * bsum_g
+// where Q4_K has offset = min and Q6_K (quants stored +32) has offset = 32 * scale and dmin = d.
+inline void unpack_q4_K_scales(const block_q4_K *x, uint8_t sc[8], uint8_t mn[8]) {
+    const uint32_t kmask1 = 0x3f3f3f3f;
+    const uint32_t kmask2 = 0x0f0f0f0f;
+    const uint32_t kmask3 = 0x03030303;
+    uint32_t utmp[4];
+    memcpy(utmp, x->scales, 12);
+    utmp[3] = ((utmp[2] >> 4) & kmask2) | (((utmp[1] >> 6) & kmask3) << 4);
+    const uint32_t uaux = utmp[1] & kmask1;
+    utmp[1] = (utmp[2] & kmask2) | (((utmp[0] >> 6) & kmask3) << 4);
+    utmp[2] = uaux;
+    utmp[0] &= kmask1;
+    memcpy(sc, utmp, 8);
+    memcpy(mn, utmp + 2, 8);
+}
+#endif
+
+#if defined(__AVX2__) && QK_K == 256
+struct block_qK_unpacked {
+    __m256i q[QK_K / 32];      // unsigned quants
+    __m256i scales[QK_K / 32]; // int16 scale of each 16 quants of q[c]
+    __m256i offsets;           // int16 offset of each 16 quants
+    float d;
+    float dmin;
+};
+
+template <typename TA>
+class tinyBLAS_QK_AVX {
+public:
+    tinyBLAS_QK_AVX(int64_t k,
+                    const TA *A, int64_t lda,
+                    const block_q8_K *B, int64_t ldb,
+                    float *C, int64_t ldc,
+                    int ith, int nth, const float *bias = nullptr) :
+        A(A),
+        B(B), C(C), k(k), lda(lda), ldb(ldb), ldc(ldc), ith(ith), nth(nth), bias(bias) {
+    }
+
+    void matmul(int64_t m, int64_t n) {
+        mnpack(0, m, 0, n);
+    }
+
+private:
+    void mnpack(int64_t m0, int64_t m, int64_t n0, int64_t n) {
+        int64_t mc, nc, mp, np;
+        switch ((MIN(m - m0, 4) << 4) | MIN(n - n0, 4)) {
+        case 0x44:
+            mc = 4;
+            nc = 4;
+            gemm<4, 4>(m0, m, n0, n);
+            break;
+        case 0x43:
+            mc = 4;
+            nc = 3;
+            gemm<4, 3>(m0, m, n0, n);
+            break;
+        case 0x34:
+            mc = 3;
+            nc = 4;
+            gemm<3, 4>(m0, m, n0, n);
+            break;
+        case 0x33:
+            mc = 3;
+            nc = 3;
+            gemm<3, 3>(m0, m, n0, n);
+            break;
+        case 0x42:
+            mc = 4;
+            nc = 2;
+            gemm<4, 2>(m0, m, n0, n);
+            break;
+        case 0x24:
+            mc = 2;
+            nc = 4;
+            gemm<2, 4>(m0, m, n0, n);
+            break;
+        case 0x32:
+            mc = 3;
+            nc = 2;
+            gemm<3, 2>(m0, m, n0, n);
+            break;
+        case 0x23:
+            mc = 2;
+            nc = 3;
+            gemm<2, 3>(m0, m, n0, n);
+            break;
+        case 0x41:
+            mc = 4;
+            nc = 1;
+            gemm<4, 1>(m0, m, n0, n);
+            break;
+        case 0x22:
+            mc = 2;
+            nc = 2;
+            gemm<2, 2>(m0, m, n0, n);
+            break;
+        case 0x14:
+            mc = 1;
+            nc = 4;
+            gemm<1, 4>(m0, m, n0, n);
+            break;
+        case 0x31:
+            mc = 3;
+            nc = 1;
+            gemm<3, 1>(m0, m, n0, n);
+            break;
+        case 0x13:
+            mc = 1;
+            nc = 3;
+            gemm<1, 3>(m0, m, n0, n);
+            break;
+        case 0x21:
+            mc = 2;
+            nc = 1;
+            gemm<2, 1>(m0, m, n0, n);
+            break;
+        case 0x12:
+            mc = 1;
+            nc = 2;
+            gemm<1, 2>(m0, m, n0, n);
+            break;
+        case 0x11:
+            mc = 1;
+            nc = 1;
+            gemm<1, 1>(m0, m, n0, n);
+            break;
+        default:
+            return;
+        }
+        mp = m0 + (m - m0) / mc * mc;
+        np = n0 + (n - n0) / nc * nc;
+        mnpack(mp, m, n0, np);
+        mnpack(m0, m, np, n);
+    }
+
+    // the unpacked rows live in L1, only the RN x RM accumulators stay in registers
+    template <int RM, int RN>
+    NOINLINE void gemm(int64_t m0, int64_t m, int64_t n0, int64_t n) {
+        int64_t ytiles = (m - m0) / RM;
+        int64_t xtiles = (n - n0) / RN;
+        int64_t tiles = xtiles * ytiles;
+        int64_t duty = (tiles + nth - 1) / nth;
+        int64_t start = duty * ith;
+        int64_t end = start + duty;
+        if (end > tiles)
+            end = tiles;
+        block_qK_unpacked a[RM];
+        for (int64_t job = start; job < end; ++job) {
+            int64_t ii = m0 + job / xtiles * RM;
+            int64_t jj = n0 + job % xtiles * RN;
+            __m256 Cv[RN][RM] = {};
+            for (int64_t l = 0; l < k; ++l) {
+                for (int64_t i = 0; i < RM; ++i)
+                    unpack(A + lda * (ii + i) + l, a[i]);
+                for (int64_t j = 0; j < RN; ++j) {
+                    const block_q8_K *b = B + ldb * (jj + j) + l;
+                    const __m256i bsums = _mm256_loadu_si256((const __m256i *)b->bsums);
+                    for (int64_t i = 0; i < RM; ++i) {
+                        __m256i sumi = _mm256_setzero_si256();
+                        for (int c = 0; c < QK_K / 32; ++c) {
+                            const __m256i p = _mm256_maddubs_epi16(a[i].q[c], _mm256_loadu_si256((const __m256i *)(b->qs + 32 * c)));
+                            sumi = _mm256_add_epi32(sumi, _mm256_madd_epi16(p, a[i].scales[c]));
+                        }
+                        const __m256i offs = _mm256_madd_epi16(bsums, a[i].offsets);
+                        Cv[j][i] = madd(_mm256_set1_ps(a[i].d * b->d), _mm256_cvtepi32_ps(sumi), Cv[j][i]);
+                        Cv[j][i] = madd(_mm256_set1_ps(-a[i].dmin * b->d), _mm256_cvtepi32_ps(offs), Cv[j][i]);
+                    }
+                }
+            }
+            if (bias) {
+                for (int64_t j = 0; j < RN; ++j)
+                    for (int64_t i = 0; i < RM; ++i)
+                        C[ldc * (jj + j) + (ii + i)] = bias[ii + i] + hsum(Cv[j][i]);
+            } else {
+                for (int64_t j = 0; j < RN; ++j)
+                    for (int64_t i = 0; i < RM; ++i)
+                        C[ldc * (jj + j) + (ii + i)] = hsum(Cv[j][i]);
+            }
+        }
+    }
+
+    static inline void unpack(const block_q4_K *x, block_qK_unpacked &u) {
+        uint8_t sc[8], mn[8];
+        unpack_q4_K_scales(x, sc, mn);
+        const __m256i m4 = _mm256_set1_epi8(0x0F);
+        for (int p = 0; p < QK_K / 64; ++p) {
+            const __m256i bytes = _mm256_loadu_si256((const __m256i *)(x->qs + 32 * p));
+            u.q[2 * p] = _mm256_and_si256(bytes, m4);
+            u.q[2 * p + 1] = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), m4);
+            u.scales[2 * p] = _mm256_set1_epi16(sc[2 * p]);
+            u.scales[2 * p + 1] = _mm256_set1_epi16(sc[2 * p + 1]);
+        }
+        int16_t offsets[QK_K / 16];
+        for (int g = 0; g < QK_K / 16; ++g)
+            offsets[g] = mn[g / 2];
+        u.offsets = _mm256_loadu_si256((const __m256i *)offsets);
+        u.d = unhalf(x->d);
+        u.dmin = unhalf(x->dmin);
+    }
+
+    static inline void unpack(const block_q6_K *x, block_qK_unpacked &u) {
+        const __m256i m4 = _mm256_set1_epi8(0x0F);
+        const __m256i m2 = _mm256_set1_epi8(0x03);
+        for (int h = 0; h < QK_K / 128; ++h) {
+            const __m256i ql0 = _mm256_loadu_si256((const __m256i *)(x->ql + 64 * h));
+            const __m256i ql1 = _mm256_loadu_si256((const __m256i *)(x->ql + 64 * h + 32));
+            const __m256i qh = _mm256_loadu_si256((const __m256i *)(x->qh + 32 * h));
+            // the 2 high bits are <= 3, so the 16-bit shifts never carry into the next byte
+            u.q[4 * h] = _mm256_or_si256(_mm256_and_si256(ql0, m4), _mm256_slli_epi16(_mm256_and_si256(qh, m2), 4));
+            u.q[4 * h + 1] = _mm256_or_si256(_mm256_and_si256(ql1, m4),
+                                             _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(qh, 2), m2), 4));
+            u.q[4 * h + 2] = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(ql0, 4), m4),
+                                             _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(qh, 4), m2), 4));
+            u.q[4 * h + 3] = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(ql1, 4), m4),
+                                             _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_epi16(qh, 6), m2), 4));
+        }
+        int16_t offsets[QK_K / 16];
+        for (int c = 0; c < QK_K / 32; ++c)
+            u.scales[c] = MM256_SET_M128I(_mm_set1_epi16(x->scales[2 * c + 1]), _mm_set1_epi16(x->scales[2 * c]));
+        for (int g = 0; g < QK_K / 16; ++g)
+            offsets[g] = 32 * x->scales[g];
+        u.offsets = _mm256_loadu_si256((const __m256i *)offsets);
+        u.d = unhalf(x->d);
+        u.dmin = u.d;
+    }
+
+    const TA *const A;
+    const block_q8_K *const B;
+    const float *const bias;
+    float *const C;
+    const int64_t k;
+    const int64_t lda;
+    const int64_t ldb;
+    const int64_t ldc;
+    const int ith;
+    const int nth;
+};
+#endif // __AVX2__
+
+#if defined(__ARM_FEATURE_DOTPROD) && QK_K == 256
+struct block_qK_unpacked {
+    int8x16_t q[QK_K / 16];    // unsigned quants, all < 64
+    int16_t scales[QK_K / 16]; // scale of each 16 quants
+    int16x8_t offsets[2];      // offset of each 16 quants
+    float d;
+    float dmin;
+};
+
+template <typename TA>
+class tinyBLAS_QK_ARM {
+public:
+    tinyBLAS_QK_ARM(int64_t k,
+                    const TA *A, int64_t lda,
+                    const block_q8_K *B, int64_t ldb,
+                    float *C, int64_t ldc,
+                    int ith, int nth, const float *bias = nullptr) :
+        A(A),
+        B(B), C(C), k(k), lda(lda), ldb(ldb), ldc(ldc), ith(ith), nth(nth), bias(bias) {
+    }
+
+    void matmul(int64_t m, int64_t n) {
+        mnpack(0, m, 0, n);
+    }
+
+private:
+    NOINLINE void mnpack(int64_t m0, int64_t m, int64_t n0, int64_t n) {
+        int64_t mc, nc, mp, np;
+        switch ((MIN(m - m0, 3) << 4) | MIN(n - n0, 3ll)) {
+        case 0x33:
+            mc = 3;
+            nc = 3;
+            gemm<3, 3>(m0, m, n0, n);
+            break;
+        case 0x32:
+            mc = 3;
+            nc = 2;
+            gemm<3, 2>(m0, m, n0, n);
+            break;
+        case 0x23:
+            mc = 2;
+            nc = 3;
+            gemm<2, 3>(m0, m, n0, n);
+            break;
+        case 0x22:
+            mc = 2;
+            nc = 2;
+            gemm<2, 2>(m0, m, n0, n);
+            break;
+        case 0x31:
+            mc = 3;
+            nc = 1;
+            gemm<3, 1>(m0, m, n0, n);
+            break;
+        case 0x13:
+            mc = 1;
+            nc = 3;
+            gemm<1, 3>(m0, m, n0, n);
+            break;
+        case 0x21:
+            mc = 2;
+            nc = 1;
+            gemm<2, 1>(m0, m, n0, n);
+            break;
+        case 0x12:
+            mc = 1;
+            nc = 2;
+            gemm<1, 2>(m0, m, n0, n);
+            break;
+        case 0x11:
+            mc = 1;
+            nc = 1;
+            gemm<1, 1>(m0, m, n0, n);
+            break;
+        default:
+            return;
+        }
+        mp = m0 + (m - m0) / mc * mc;
+        np = n0 + (n - n0) / nc * nc;
+        mnpack(mp, m, n0, np);
+        mnpack(m0, m, np, n);
+    }
+
+    template <int RM, int RN>
+    NOINLINE void gemm(int64_t m0, int64_t m, int64_t n0, int64_t n) {
+        int64_t ytiles = (m - m0) / RM;
+        int64_t xtiles = (n - n0) / RN;
+        int64_t tiles = xtiles * ytiles;
+        int64_t duty = (tiles + nth - 1) / nth;
+        int64_t start = duty * ith;
+        int64_t end = start + duty;
+        if (end > tiles)
+            end = tiles;
+        block_qK_unpacked a[RM];
+        for (int64_t job = start; job < end; ++job) {
+            int64_t ii = m0 + job / xtiles * RM;
+            int64_t jj = n0 + job % xtiles * RN;
+            float Cv[RN][RM] = {};
+            for (int64_t l = 0; l < k; ++l) {
+                for (int64_t i = 0; i < RM; ++i)
+                    unpack(A + lda * (ii + i) + l, a[i]);
+                for (int64_t j = 0; j < RN; ++j) {
+                    const block_q8_K *b = B + ldb * (jj + j) + l;
+                    const int16x8_t bsums0 = vld1q_s16(b->bsums);
+                    const int16x8_t bsums1 = vld1q_s16(b->bsums + 8);
+                    for (int64_t i = 0; i < RM; ++i) {
+                        int32x4_t sumi = vdupq_n_s32(0);
+                        for (int g = 0; g < QK_K / 16; ++g)
+                            sumi = vmlaq_n_s32(sumi, vdotq_s32(vdupq_n_s32(0), a[i].q[g], vld1q_s8(b->qs + 16 * g)),
+                                               a[i].scales[g]);
+                        int32x4_t offs = vmull_s16(vget_low_s16(bsums0), vget_low_s16(a[i].offsets[0]));
+                        offs = vmlal_s16(offs, vget_high_s16(bsums0), vget_high_s16(a[i].offsets[0]));
+                        offs = vmlal_s16(offs, vget_low_s16(bsums1), vget_low_s16(a[i].offsets[1]));
+                        offs = vmlal_s16(offs, vget_high_s16(bsums1), vget_high_s16(a[i].offsets[1]));
+                        Cv[j][i] += b->d * (a[i].d * vaddvq_s32(sumi) - a[i].dmin * vaddvq_s32(offs));
+                    }
+                }
+            }
+            for (int64_t j = 0; j < RN; ++j)
+                for (int64_t i = 0; i < RM; ++i)
+                    C[ldc * (jj + j) + (ii + i)] = (bias ? bias[ii + i] : 0.0f) + Cv[j][i];
+        }
+    }
+
+    static inline void unpack(const block_q4_K *x, block_qK_unpacked &u) {
+        uint8_t sc[8], mn[8];
+        unpack_q4_K_scales(x, sc, mn);
+        const uint8x16_t m4 = vdupq_n_u8(0x0F);
+        int16_t offsets[QK_K / 16];
+        for (int p = 0; p < QK_K / 64; ++p) {
+            const uint8x16_t bytes0 = vld1q_u8(x->qs + 32 * p);
+            const uint8x16_t bytes1 = vld1q_u8(x->qs + 32 * p + 16);
+            u.q[4 * p] = vreinterpretq_s8_u8(vandq_u8(bytes0, m4));
+            u.q[4 * p + 1] = vreinterpretq_s8_u8(vandq_u8(bytes1, m4));
+            u.q[4 * p + 2] = vreinterpretq_s8_u8(vshrq_n_u8(bytes0, 4));
+            u.q[4 * p + 3] = vreinterpretq_s8_u8(vshrq_n_u8(bytes1, 4));
+            u.scales[4 * p] = u.scales[4 * p + 1] = sc[2 * p];
+            u.scales[4 * p + 2] = u.scales[4 * p + 3] = sc[2 * p + 1];
+            offsets[4 * p] = offsets[4 * p + 1] = mn[2 * p];
+            offsets[4 * p + 2] = offsets[4 * p + 3] = mn[2 * p + 1];
+        }
+        u.offsets[0] = vld1q_s16(offsets);
+        u.offsets[1] = vld1q_s16(offsets + 8);
+        u.d = unhalf(x->d);
+        u.dmin = unhalf(x->dmin);
+    }
+
+    static inline void unpack(const block_q6_K *x, block_qK_unpacked &u) {
+        const uint8x16_t m4 = vdupq_n_u8(0x0F);
+        const uint8x16_t m2 = vdupq_n_u8(0x03);
+        for (int h = 0; h < QK_K / 128; ++h) {
+            for (int half = 0; half < 2; ++half) {
+                const uint8x16_t ql0 = vld1q_u8(x->ql + 64 * h + 16 * half);
+                const uint8x16_t ql1 = vld1q_u8(x->ql + 64 * h + 32 + 16 * half);
+                const uint8x16_t qh = vld1q_u8(x->qh + 32 * h + 16 * half);
+                u.q[8 * h + half] = vreinterpretq_s8_u8(vorrq_u8(vandq_u8(ql0, m4), vshlq_n_u8(vandq_u8(qh, m2), 4)));
+                u.q[8 * h + 2 + half] = vreinterpretq_s8_u8(vorrq_u8(vandq_u8(ql1, m4), vshlq_n_u8(vandq_u8(vshrq_n_u8(qh, 2), m2), 4)));
+                u.q[8 * h + 4 + half] = vreinterpretq_s8_u8(vorrq_u8(vshrq_n_u8(ql0, 4), vshlq_n_u8(vandq_u8(vshrq_n_u8(qh, 4), m2), 4)));
+                u.q[8 * h + 6 + half] = vreinterpretq_s8_u8(vorrq_u8(vshrq_n_u8(ql1, 4), vshlq_n_u8(vshrq_n_u8(qh, 6), 4)));
+            }
+        }
+        int16_t offsets[QK_K / 16];
+        for (int g = 0; g < QK_K / 16; ++g) {
+            u.scales[g] = x->scales[g];
+            offsets[g] = 32 * x->scales[g];
+        }
+        u.offsets[0] = vld1q_s16(offsets);
+        u.offsets[1] = vld1q_s16(offsets + 8);
+        u.d = unhalf(x->d);
+        u.dmin = u.d;
+    }
+
+    const TA *const A;
+    const block_q8_K *const B;
+    const float *const bias;
+    float *const C;
+    const int64_t k;
+    const int64_t lda;
+    const int64_t ldb;
+    const int64_t ldc;
+    const int ith;
+    const int nth;
+};
+#endif // __ARM_FEATURE_DOTPROD
+
 } // namespace
 
 /**
@@ -910,7 +1344,7 @@ private:
  * @return true if this function was able to service the matmul request
  */
 // TODOYRJ
-bool llamafile_sgemm(int64_t m, int64_t n, int64_t k, const void *A, int64_t lda, const void *B, int64_t ldb, void *C, int64_t ldc,
+bool MLLM_SGEMM_KERNEL(llamafile_sgemm)(int64_t m, int64_t n, int64_t k, const void *A, int64_t lda, const void *B, int64_t ldb, void *C, int64_t ldc,
                      int ith, int nth,
                      DataType Atype, DataType Btype, DataType Ctype, void *bias, DataType BiasType) {
     assert(m >= 0);
@@ -1072,6 +1506,49 @@ bool llamafile_sgemm(int64_t m, int64_t n, int64_t k, const void *A, int64_t lda
 #endif
     }
 
+    case MLLM_TYPE_Q4_K:
+    case MLLM_TYPE_Q6_K: {
+        if (Btype != MLLM_TYPE_Q8_K)
+            return false;
+#if defined(__AVX2__) && QK_K == 256
+        if (Atype == MLLM_TYPE_Q4_K) {
+            tinyBLAS_QK_AVX<block_q4_K> tb{
+                k, (const block_q4_K *)A, lda,
+                (const block_q8_K *)B, ldb,
+                (float *)C, ldc,
+                ith, nth, (float *)bias};
+            tb.matmul(m, n);
+        } else {
+            tinyBLAS_QK_AVX<block_q6_K> tb{
+                k, (const block_q6_K *)A, lda,
+                (const block_q8_K *)B, ldb,
+                (float *)C, ldc,
+                ith, nth, (float *)bias};
+            tb.matmul(m, n);
+        }
+        return true;
+#elif defined(__ARM_FEATURE_DOTPROD) && QK_K == 256
+        if (Atype == MLLM_TYPE_Q4_K) {
+            tinyBLAS_QK_ARM<block_q4_K> tb{
+                k, (const block_q4_K *)A, lda,
+                (const block_q8_K *)B, ldb,
+                (float *)C, ldc,
+                ith, nth, (float *)bias};
+            tb.matmul(m, n);
+        } else {
+            tinyBLAS_QK_ARM<block_q6_K> tb{
+                k, (const block_q6_K *)A, lda,
+                (const block_q8_K *)B, ldb,
+                (float *)C, ldc,
+                ith, nth, (float *)bias};
+            tb.matmul(m, n);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
     default:
         return false;
     }
@@ -1092,7 +1569,7 @@ bool llamafile_sgemm(int64_t m, int64_t n, int64_t k, const void *A, int64_t lda
     (void)Ctype;
 }
 
-bool check_llamafile_sgemm(int64_t m, int64_t n, int64_t k, DataType Atype, DataType Btype, DataType Ctype, int64_t lda, int64_t ldb, int64_t ldc) {
+bool MLLM_SGEMM_KERNEL(check_llamafile_sgemm)(int64_t m, int64_t n, int64_t k, DataType Atype, DataType Btype, DataType Ctype, int64_t lda, int64_t ldb, int64_t ldc) {
     int ith = 0;
     int nth = 1;
     assert(m >= 0);
@@ -1191,7 +1668,39 @@ bool check_llamafile_sgemm(int64_t m, int64_t n, int64_t k, DataType Atype, Data
 #endif
     }
 
+    case MLLM_TYPE_Q4_K:
+    case MLLM_TYPE_Q6_K: {
+        if (Btype != MLLM_TYPE_Q8_K)
+            return false;
+#if (defined(__AVX2__) || defined(__ARM_FEATURE_DOTPROD)) && QK_K == 256
+        // a single row is not worth unpacking the weights for, the vec_dot path is as fast
+        return n > 1;
+#else
+        return false;
+#endif
+    }
+
     default:
         return false;
     }
 }
+
+#ifndef MLLM_SGEMM_KERNEL_SET
+static llamafile_sgemm_func sgemm_kernel = llamafile_sgemm_baseline;
+static check_llamafile_sgemm_func check_sgemm_kernel = check_llamafile_sgemm_baseline;
+
+void set_llamafile_sgemm(llamafile_sgemm_func sgemm, check_llamafile_sgemm_func check) {
+    sgemm_kernel = sgemm;
+    check_sgemm_kernel = check;
+}
+
+bool llamafile_sgemm(int64_t m, int64_t n, int64_t k, const void *A, int64_t lda, const void *B, int64_t ldb, void *C, int64_t ldc,
+                     int ith, int nth,
+                     DataType Atype, DataType Btype, DataType Ctype, void *bias, DataType BiasType) {
+    return sgemm_kernel(m, n, k, A, lda, B, ldb, C, ldc, ith, nth, Atype, Btype, Ctype, bias, BiasType);
+}
+
+bool check_llamafile_sgemm(int64_t m, int64_t n, int64_t k, DataType Atype, DataType Btype, DataType Ctype, int64_t lda, int64_t ldb, int64_t ldc) {
+    return check_sgemm_kernel(m, n, k, Atype, Btype, Ctype, lda, ldb, ldc);
+}
+#endif
@@ -14,4 +14,17 @@ bool llamafile_sgemm(int64_t m, int64_t n, int64_t k, const void *A, int64_t lda
 
 bool check_llamafile_sgemm(int64_t m, int64_t n, int64_t k, DataType Atype, DataType Btype, DataType Ctype, int64_t lda, int64_t ldb, int64_t ldc);
 
+typedef bool (*llamafile_sgemm_func)(int64_t m, int64_t n, int64_t k, const void *A, int64_t lda, const void *B, int64_t ldb, void *C, int64_t ldc,
+                                     int ith, int nth, DataType Atype, DataType Btype, DataType Ctype, void *bias, DataType BiasType);
+typedef bool (*check_llamafile_sgemm_func)(int64_t m, int64_t n, int64_t k, DataType Atype, DataType Btype, DataType Ctype, int64_t lda, int64_t ldb, int64_t ldc);
+// tinyBLAS as compiled for the baseline; GEMM_x86_*.cpp build it again per ISA
+bool llamafile_sgemm_baseline(int64_t m, int64_t n, int64_t k, const void *A, int64_t lda, const void *B, int64_t ldb, void *C, int64_t ldc,
+                              int ith, int nth, DataType Atype, DataType Btype, DataType Ctype, void *bias, DataType BiasType);
+bool check_llamafile_sgemm_baseline(int64_t m, int64_t n, int64_t k, DataType Atype, DataType Btype, DataType Ctype, int64_t lda, int64_t ldb, int64_t ldc);
+/**
+ * \brief point llamafile_sgemm() and check_llamafile_sgemm() at one build of tinyBLAS. The pair must come from the
+ * same build, since the checks differ per ISA. Called by dispatchCPUKernels().
+ */
+void set_llamafile_sgemm(llamafile_sgemm_func sgemm, check_llamafile_sgemm_func check);
+
 #endif // MLLM_GEMM_HPP
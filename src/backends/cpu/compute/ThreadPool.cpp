@@ -0,0 +1,193 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace mllm {
+
+// polling before a worker sleeps (tens to hundreds of us), longer than the gap between two ops of a decode step
+static const int SPIN_ITERATIONS = 1 << 14;
+static const int MAX_THREADS = 256;
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static thread_local bool in_job = false;
+static thread_local int thread_index = 0;
+
+// cores this process may run on, fastest first, so big.LITTLE parts pin workers to the big cores
+static std::vector<int> pinOrder() {
+    std::vector<int> cores;
+#if defined(__linux__)
+    const char *env = std::getenv("MLLM_THREAD_PIN");
+    if (env != nullptr && strcmp(env, "0") == 0) { return cores; }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) { return cores; }
+    std::vector<std::pair<long, int>> by_freq;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &set)) { continue; }
+        long freq = 0;
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        if (FILE *fp = fopen(path, "r")) {
+            if (fscanf(fp, "%ld", &freq) != 1) { freq = 0; }
+            fclose(fp);
+        }
+        by_freq.emplace_back(-freq, cpu);
+    }
+    std::stable_sort(by_freq.begin(), by_freq.end(),
+                     [](const std::pair<long, int> &a, const std::pair<long, int> &b) { return a.first < b.first; });
+    for (auto &item : by_freq) { cores.push_back(item.second); }
+#endif
+    return cores;
+}
+
+static int availableCPUs() {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) { return std::max(1, CPU_COUNT(&set)); }
+#endif
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool::ThreadPool(int thread_count) :
+    cores_(pinOrder()), cpus_(availableCPUs()) {
+    grow(thread_count);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+        state_.fetch_add(1ull << 16);
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) { worker.join(); }
+}
+
+void ThreadPool::grow(int thread_count) {
+    thread_count = std::min(thread_count, MAX_THREADS);
+    while (size() < thread_count) {
+        const int index = (int)workers_.size();
+        workers_.emplace_back(&ThreadPool::workerLoop, this, index, state_.load());
+        // with more threads than CPUs a spinning thread only delays the one it waits for
+        spin_.store(size() <= cpus_ ? SPIN_ITERATIONS : 0);
+#if defined(__linux__)
+        // cores_[0] is left free for the caller, which is not pinned; with more threads than cores leave placement
+        // to the scheduler
+        if (!cores_.empty() && thread_count <= (int)cores_.size()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cores_[index + 1], &set);
+            pthread_setaffinity_np(workers_.back().native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+}
+
+void ThreadPool::work() {
+    const int64_t n = n_, grain = grain_;
+    for (int64_t begin = next_.fetch_add(grain); begin < n; begin = next_.fetch_add(grain)) {
+        fn_(ctx_, begin, std::min(n, begin + grain));
+    }
+}
+
+void ThreadPool::workerLoop(int index, uint64_t seen) {
+    in_job = true;
+    thread_index = index + 1;
+    while (true) {
+        uint64_t state = state_.load(std::memory_order_acquire);
+        const int spin = spin_.load(std::memory_order_relaxed);
+        for (int i = 0; state == seen && i < spin; ++i) {
+            cpuRelax();
+            state = state_.load(std::memory_order_acquire);
+        }
+        if (state == seen) {
+            // sleepers_ is raised before re-checking state_, so dispatch() either sees a sleeper or we see its job
+            sleepers_.fetch_add(1);
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_.wait(lock, [&] { return state_.load() != seen; });
+            state = state_.load(std::memory_order_acquire);
+            sleepers_.fetch_sub(1);
+        }
+        seen = state;
+        if (stop_) { return; }
+        const int participants = (int)(state & 0xFFFF);
+        if (index + 1 < participants) {
+            work();
+            pending_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+}
+
+void ThreadPool::dispatch(int64_t n, int thread_count, int64_t grain, RangeFn fn, const void *ctx) {
+    if (n <= 0) { return; }
+    thread_count = std::max(1, std::min(thread_count, MAX_THREADS));
+    if (grain <= 0) { grain = std::max<int64_t>(1, n / (thread_count * 4)); }
+    const int participants = (int)std::min<int64_t>(thread_count, (n + grain - 1) / grain);
+    if (participants <= 1 || in_job) {
+        fn(ctx, 0, n);
+        return;
+    }
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    grow(participants);
+    fn_ = fn;
+    ctx_ = ctx;
+    n_ = n;
+    grain_ = grain;
+    next_.store(0, std::memory_order_relaxed);
+    pending_.store(participants - 1, std::memory_order_relaxed);
+    const uint64_t generation = (state_.load() >> 16) + 1;
+    state_.store(generation << 16 | (uint64_t)participants);
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_.notify_all();
+    }
+    in_job = true;
+    work();
+    in_job = false;
+    const int spin = spin_.load(std::memory_order_relaxed);
+    for (int i = 0; pending_.load(std::memory_order_acquire) != 0;) {
+        if (i < spin) {
+            cpuRelax();
+            ++i;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static std::atomic<ThreadPool *> current_pool{nullptr};
+
+ThreadPool &ThreadPool::current() {
+    ThreadPool *pool = current_pool.load(std::memory_order_acquire);
+    if (pool != nullptr) { return *pool; }
+    // never destroyed, ops may run from static destructors
+    static auto *fallback = new ThreadPool(1);
+    return *fallback;
+}
+
+int ThreadPool::threadIndex() {
+    return thread_index;
+}
+
+void ThreadPool::setCurrent(ThreadPool *pool) {
+    current_pool.store(pool, std::memory_order_release);
+}
+
+} // namespace mllm
@@ -0,0 +1,101 @@
+//
+// Persistent worker threads for the CPU ops.
+//
+
+#ifndef MLLM_THREADPOOL_HPP
+#define MLLM_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * \brief A fixed set of worker threads that stay alive between ops, replacing a fork/join OpenMP region per op.
+ * The calling thread takes part in every job, so `thread_count` threads run it on `thread_count - 1` workers.
+ * Work is handed out in chunks from an atomic counter; idle workers spin for a while before sleeping on a
+ * condition variable, so back-to-back ops of a decode step never pay a wake-up. Workers are pinned to cores,
+ * fastest first, unless MLLM_THREAD_PIN=0.
+ *
+ * A job started from inside a job runs inline on the calling thread.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(int thread_count);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * \brief call fn(begin, end) over chunks of [0, n) on up to `thread_count` threads and wait for all of them.
+     * \param grain chunk size, 0 picks about four chunks per thread.
+     */
+    template <typename F>
+    void run(int64_t n, int thread_count, F &&fn, int64_t grain = 0) {
+        using Fn = std::remove_reference_t<F>;
+        dispatch(n, thread_count, grain, [](const void *ctx, int64_t begin, int64_t end) {
+            (*static_cast<Fn *>(const_cast<void *>(ctx)))(begin, end);
+        }, &fn);
+    }
+    // threads a job can use, counting the caller
+    int size() const {
+        return (int)workers_.size() + 1;
+    }
+
+    /**
+     * \brief the pool of the live CPUBackend, or a process-wide one that grows to the largest thread_count asked for.
+     */
+    static ThreadPool &current();
+    static void setCurrent(ThreadPool *pool);
+    /**
+     * \brief index of the calling thread, 0 outside the workers and worker i + 1 otherwise; always below the size()
+     * of its pool, so jobs can index per-thread scratch with it.
+     */
+    static int threadIndex();
+
+private:
+    using RangeFn = void (*)(const void *ctx, int64_t begin, int64_t end);
+    void dispatch(int64_t n, int thread_count, int64_t grain, RangeFn fn, const void *ctx);
+    void grow(int thread_count);
+    void workerLoop(int index, uint64_t state);
+    void work();
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_; // one job at a time
+    // job of the current generation; written by the caller before it publishes state_
+    RangeFn fn_ = nullptr;
+    const void *ctx_ = nullptr;
+    int64_t n_ = 0;
+    int64_t grain_ = 1;
+    std::atomic<int64_t> next_{0};
+    std::atomic<int> pending_{0};
+    // generation << 16 | participating threads, so a worker sees both in one load
+    std::atomic<uint64_t> state_{0};
+    std::atomic<int> sleepers_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::vector<int> cores_; // pinning order, empty to not pin
+    int cpus_;
+    std::atomic<int> spin_{0};
+};
+
+/**
+ * \brief fn(i) for every i in [0, n) on up to `thread_count` threads of ThreadPool::current(),
+ * `grain` indices at a time (0: about four chunks per thread).
+ */
+template <typename F>
+inline void parallel_for(int64_t n, int thread_count, F &&fn, int64_t grain = 0) {
+    ThreadPool::current().run(n, thread_count, [&fn](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) { fn(i); }
+    }, grain);
+}
+
+} // namespace mllm
+
+#endif // MLLM_THREADPOOL_HPP
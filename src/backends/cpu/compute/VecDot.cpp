@@ -1350,6 +1350,474 @@ void vec_dot_q6_K_q8_K(const void *__restrict src0, const void *__restrict src1,
     dst->setDataAt<float>({batch, head, src0_inf, sec1_outf}, value);
 }
 
+void vec_dot_q5_0_q8_0(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+
+    assert(n % qk == 0);
+    assert(qk == QK5_0);
+
+    const block_q5_0 *__restrict x = (const block_q5_0 *)vx;
+    const block_q8_0 *__restrict y = (const block_q8_0 *)vy;
+
+#if defined(__AVX2__)
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int i = 0; i < nb; i++) {
+        const __m256 d = _mm256_set1_ps(MLLM_FP16_TO_FP32(x[i].d) * MLLM_FP16_TO_FP32(y[i].d));
+
+        // low nibbles, with the 5-th bit spread to 0xFF/0x00 per byte; a clear 5-th bit turns the byte into q - 16
+        __m256i qx = bytes_from_nibbles_32(x[i].qs);
+        __m256i bxhi = bytes_from_bits_32(x[i].qh);
+        bxhi = _mm256_andnot_si256(bxhi, _mm256_set1_epi8((char)0xF0));
+        qx = _mm256_or_si256(qx, bxhi);
+
+        const __m256i qy = _mm256_loadu_si256((const __m256i *)y[i].qs);
+        const __m256 q = mul_sum_i8_pairs_float(qx, qy);
+
+        acc = _mm256_fmadd_ps(d, q, acc);
+    }
+
+    *s = hsum_float_8(acc);
+#else
+    float sumf = 0.0;
+
+    for (int i = 0; i < nb; i++) {
+        uint32_t qh;
+        memcpy(&qh, x[i].qh, sizeof(qh));
+
+        int sumi = 0;
+
+        for (int j = 0; j < qk / 2; ++j) {
+            const uint8_t xh_0 = ((qh & (1u << (j + 0))) >> (j + 0)) << 4;
+            const uint8_t xh_1 = ((qh & (1u << (j + 16))) >> (j + 12));
+
+            const int32_t x0 = ((x[i].qs[j] & 0x0F) | xh_0) - 16;
+            const int32_t x1 = ((x[i].qs[j] >> 4) | xh_1) - 16;
+
+            sumi += (x0 * y[i].qs[j]) + (x1 * y[i].qs[j + qk / 2]);
+        }
+
+        sumf += (MLLM_FP16_TO_FP32(x[i].d) * MLLM_FP16_TO_FP32(y[i].d)) * sumi;
+    }
+
+    *s = sumf;
+#endif
+}
+
+#ifdef __AVX2__
+// per 32 quants, broadcast the int16 scales of their two groups of 16 (from both 128-bit halves of `scales`)
+static inline __m256i get_scale_shuffle_q3k(int i) {
+    static const uint8_t k_shuffle[128] = {
+        0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3,
+        4, 5, 4, 5, 4, 5, 4, 5, 4, 5, 4, 5, 4, 5, 4, 5, 6, 7, 6, 7, 6, 7, 6, 7, 6, 7, 6, 7, 6, 7, 6, 7,
+        8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11,
+        12, 13, 12, 13, 12, 13, 12, 13, 12, 13, 12, 13, 12, 13, 12, 13, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15};
+    return _mm256_loadu_si256((const __m256i *)k_shuffle + i);
+}
+#endif
+
+void vec_dot_q2_K_q8_K(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy) {
+    assert(n % QK_K == 0);
+    assert(QK_K == 256);
+
+    const block_q2_K *__restrict x = (const block_q2_K *)vx;
+    const block_q8_K *__restrict y = (const block_q8_K *)vy;
+
+    const int nb = n / QK_K;
+
+#ifdef __AVX2__
+    const __m256i m3 = _mm256_set1_epi8(3);
+    const __m128i m4 = _mm_set1_epi8(0xF);
+
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int i = 0; i < nb; ++i) {
+        const float d = y[i].d * MLLM_FP16_TO_FP32(x[i].d);
+        const float dmin = -y[i].d * MLLM_FP16_TO_FP32(x[i].dmin);
+
+        const uint8_t *__restrict q2 = x[i].qs;
+        const int8_t *__restrict q8 = y[i].qs;
+
+        const __m128i mins_and_scales = _mm_loadu_si128((const __m128i *)x[i].scales);
+        const __m128i scales8 = _mm_and_si128(mins_and_scales, m4);
+        const __m128i mins8 = _mm_and_si128(_mm_srli_epi16(mins_and_scales, 4), m4);
+        const __m256i mins = _mm256_cvtepi8_epi16(mins8);
+        const __m256i prod = _mm256_madd_epi16(mins, _mm256_loadu_si256((const __m256i *)y[i].bsums));
+
+        acc = _mm256_fmadd_ps(_mm256_broadcast_ss(&dmin), _mm256_cvtepi32_ps(prod), acc);
+
+        const __m256i all_scales = _mm256_cvtepi8_epi16(scales8);
+        const __m128i l_scales = _mm256_extracti128_si256(all_scales, 0);
+        const __m128i h_scales = _mm256_extracti128_si256(all_scales, 1);
+        const __m256i scales[2] = {MM256_SET_M128I(l_scales, l_scales), MM256_SET_M128I(h_scales, h_scales)};
+
+        __m256i sumi = _mm256_setzero_si256();
+
+        for (int j = 0; j < QK_K / 128; ++j) {
+            const __m256i q2bits = _mm256_loadu_si256((const __m256i *)q2);
+            q2 += 32;
+
+            const __m256i q8_0 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+            const __m256i q8_1 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+            const __m256i q8_2 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+            const __m256i q8_3 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+
+            const __m256i q2_0 = _mm256_and_si256(q2bits, m3);
+            const __m256i q2_1 = _mm256_and_si256(_mm256_srli_epi16(q2bits, 2), m3);
+            const __m256i q2_2 = _mm256_and_si256(_mm256_srli_epi16(q2bits, 4), m3);
+            const __m256i q2_3 = _mm256_and_si256(_mm256_srli_epi16(q2bits, 6), m3);
+
+            __m256i p0 = _mm256_maddubs_epi16(q2_0, q8_0);
+            __m256i p1 = _mm256_maddubs_epi16(q2_1, q8_1);
+            __m256i p2 = _mm256_maddubs_epi16(q2_2, q8_2);
+            __m256i p3 = _mm256_maddubs_epi16(q2_3, q8_3);
+
+            p0 = _mm256_madd_epi16(_mm256_shuffle_epi8(scales[j], get_scale_shuffle_q3k(0)), p0);
+            p1 = _mm256_madd_epi16(_mm256_shuffle_epi8(scales[j], get_scale_shuffle_q3k(1)), p1);
+            p2 = _mm256_madd_epi16(_mm256_shuffle_epi8(scales[j], get_scale_shuffle_q3k(2)), p2);
+            p3 = _mm256_madd_epi16(_mm256_shuffle_epi8(scales[j], get_scale_shuffle_q3k(3)), p3);
+
+            p0 = _mm256_add_epi32(p0, p1);
+            p2 = _mm256_add_epi32(p2, p3);
+
+            sumi = _mm256_add_epi32(sumi, _mm256_add_epi32(p0, p2));
+        }
+
+        acc = _mm256_fmadd_ps(_mm256_broadcast_ss(&d), _mm256_cvtepi32_ps(sumi), acc);
+    }
+
+    *s = hsum_float_8(acc);
+#else
+    float sumf = 0;
+
+    for (int i = 0; i < nb; ++i) {
+        const uint8_t *__restrict q2 = x[i].qs;
+        const int8_t *__restrict q8 = y[i].qs;
+        const uint8_t *__restrict sc = x[i].scales;
+
+        int summs = 0;
+        for (int j = 0; j < 16; ++j) {
+            summs += y[i].bsums[j] * (sc[j] >> 4);
+        }
+
+        const float dall = y[i].d * MLLM_FP16_TO_FP32(x[i].d);
+        const float dmin = y[i].d * MLLM_FP16_TO_FP32(x[i].dmin);
+
+        int isum = 0;
+        int is = 0;
+        int d;
+        for (int k = 0; k < QK_K / 128; ++k) {
+            int shift = 0;
+            for (int j = 0; j < 4; ++j) {
+                d = sc[is++] & 0xF;
+                int isuml = 0;
+                for (int l = 0; l < 16; ++l) isuml += q8[l] * ((q2[l] >> shift) & 3);
+                isum += d * isuml;
+                d = sc[is++] & 0xF;
+                isuml = 0;
+                for (int l = 16; l < 32; ++l) isuml += q8[l] * ((q2[l] >> shift) & 3);
+                isum += d * isuml;
+                shift += 2;
+                q8 += 32;
+            }
+            q2 += 32;
+        }
+        sumf += dall * isum - dmin * summs;
+    }
+    *s = sumf;
+#endif
+}
+
+void vec_dot_q3_K_q8_K(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy) {
+    assert(n % QK_K == 0);
+    assert(QK_K == 256);
+
+    const uint32_t kmask1 = 0x03030303;
+    const uint32_t kmask2 = 0x0f0f0f0f;
+
+    const block_q3_K *__restrict x = (const block_q3_K *)vx;
+    const block_q8_K *__restrict y = (const block_q8_K *)vy;
+
+    const int nb = n / QK_K;
+
+#ifdef __AVX2__
+    const __m256i m3 = _mm256_set1_epi8(3);
+    const __m256i mone = _mm256_set1_epi8(1);
+    const __m128i m32 = _mm_set1_epi8(32);
+
+    __m256 acc = _mm256_setzero_ps();
+
+    uint32_t aux[3];
+
+    for (int i = 0; i < nb; ++i) {
+        const float d = y[i].d * MLLM_FP16_TO_FP32(x[i].d);
+
+        const uint8_t *__restrict q3 = x[i].qs;
+        const int8_t *__restrict q8 = y[i].qs;
+
+        // 16 6-bit scales, stored as low nibbles in scales[0..7], high nibbles in scales[0..7] and 2-bit tops in scales[8..11]
+        memcpy(aux, x[i].scales, 12);
+        __m128i scales128 = _mm_set_epi32(
+            ((aux[1] >> 4) & kmask2) | (((aux[2] >> 6) & kmask1) << 4),
+            ((aux[0] >> 4) & kmask2) | (((aux[2] >> 4) & kmask1) << 4),
+            (aux[1] & kmask2) | (((aux[2] >> 2) & kmask1) << 4),
+            (aux[0] & kmask2) | (((aux[2] >> 0) & kmask1) << 4));
+        scales128 = _mm_sub_epi8(scales128, m32);
+        const __m256i all_scales = _mm256_cvtepi8_epi16(scales128);
+        const __m128i l_scales = _mm256_extracti128_si256(all_scales, 0);
+        const __m128i h_scales = _mm256_extracti128_si256(all_scales, 1);
+        const __m256i scales[2] = {MM256_SET_M128I(l_scales, l_scales), MM256_SET_M128I(h_scales, h_scales)};
+
+        const __m256i hbits = _mm256_loadu_si256((const __m256i *)x[i].hmask);
+
+        __m256i sumi = _mm256_setzero_si256();
+
+        int bit = 0;
+
+        for (int j = 0; j < QK_K / 128; ++j) {
+            const __m256i q3bits = _mm256_loadu_si256((const __m256i *)q3);
+            q3 += 32;
+
+            // low 2 bits, and 4 wherever the high bit is clear
+            const __m256i q3l_0 = _mm256_and_si256(q3bits, m3);
+            const __m256i q3h_0 = _mm256_slli_epi16(_mm256_srli_epi16(_mm256_andnot_si256(hbits, _mm256_slli_epi16(mone, bit)), bit), 2);
+            ++bit;
+
+            const __m256i q3l_1 = _mm256_and_si256(_mm256_srli_epi16(q3bits, 2), m3);
+            const __m256i q3h_1 = _mm256_slli_epi16(_mm256_srli_epi16(_mm256_andnot_si256(hbits, _mm256_slli_epi16(mone, bit)), bit), 2);
+            ++bit;
+
+            const __m256i q3l_2 = _mm256_and_si256(_mm256_srli_epi16(q3bits, 4), m3);
+            const __m256i q3h_2 = _mm256_slli_epi16(_mm256_srli_epi16(_mm256_andnot_si256(hbits, _mm256_slli_epi16(mone, bit)), bit), 2);
+            ++bit;
+
+            const __m256i q3l_3 = _mm256_and_si256(_mm256_srli_epi16(q3bits, 6), m3);
+            const __m256i q3h_3 = _mm256_slli_epi16(_mm256_srli_epi16(_mm256_andnot_si256(hbits, _mm256_slli_epi16(mone, bit)), bit), 2);
+            ++bit;
+
+            const __m256i q8_0 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+            const __m256i q8_1 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+            const __m256i q8_2 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+            const __m256i q8_3 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+
+            // maddubs needs an unsigned operand, so the low and high parts are multiplied separately and subtracted
+            __m256i q8s_0 = _mm256_maddubs_epi16(q3h_0, q8_0);
+            __m256i q8s_1 = _mm256_maddubs_epi16(q3h_1, q8_1);
+            __m256i q8s_2 = _mm256_maddubs_epi16(q3h_2, q8_2);
+            __m256i q8s_3 = _mm256_maddubs_epi16(q3h_3, q8_3);
+
+            __m256i p16_0 = _mm256_maddubs_epi16(q3l_0, q8_0);
+            __m256i p16_1 = _mm256_maddubs_epi16(q3l_1, q8_1);
+            __m256i p16_2 = _mm256_maddubs_epi16(q3l_2, q8_2);
+            __m256i p16_3 = _mm256_maddubs_epi16(q3l_3, q8_3);
+
+            p16_0 = _mm256_sub_epi16(p16_0, q8s_0);
+            p16_1 = _mm256_sub_epi16(p16_1, q8s_1);
+            p16_2 = _mm256_sub_epi16(p16_2, q8s_2);
+            p16_3 = _mm256_sub_epi16(p16_3, q8s_3);
+
+            p16_0 = _mm256_madd_epi16(_mm256_shuffle_epi8(scales[j], get_scale_shuffle_q3k(0)), p16_0);
+            p16_1 = _mm256_madd_epi16(_mm256_shuffle_epi8(scales[j], get_scale_shuffle_q3k(1)), p16_1);
+            p16_2 = _mm256_madd_epi16(_mm256_shuffle_epi8(scales[j], get_scale_shuffle_q3k(2)), p16_2);
+            p16_3 = _mm256_madd_epi16(_mm256_shuffle_epi8(scales[j], get_scale_shuffle_q3k(3)), p16_3);
+
+            p16_0 = _mm256_add_epi32(p16_0, p16_1);
+            p16_2 = _mm256_add_epi32(p16_2, p16_3);
+            sumi = _mm256_add_epi32(sumi, _mm256_add_epi32(p16_0, p16_2));
+        }
+
+        acc = _mm256_fmadd_ps(_mm256_broadcast_ss(&d), _mm256_cvtepi32_ps(sumi), acc);
+    }
+
+    *s = hsum_float_8(acc);
+#else
+    uint32_t aux[4];
+    const int8_t *scales = (const int8_t *)aux;
+    int8_t aux8[QK_K];
+
+    float sumf = 0;
+    for (int i = 0; i < nb; ++i) {
+        const uint8_t *__restrict q3 = x[i].qs;
+        const uint8_t *__restrict hm = x[i].hmask;
+        const int8_t *__restrict q8 = y[i].qs;
+
+        int8_t *__restrict a = aux8;
+        uint8_t m = 1;
+        for (int j = 0; j < QK_K; j += 128) {
+            for (int shift = 0; shift < 8; shift += 2) {
+                for (int l = 0; l < 32; ++l) a[l] = (int8_t)((q3[l] >> shift) & 3) - ((hm[l] & m) ? 0 : 4);
+                a += 32;
+                m <<= 1;
+            }
+            q3 += 32;
+        }
+
+        memcpy(aux, x[i].scales, 12);
+        uint32_t tmp = aux[2];
+        aux[2] = ((aux[0] >> 4) & kmask2) | (((tmp >> 4) & kmask1) << 4);
+        aux[3] = ((aux[1] >> 4) & kmask2) | (((tmp >> 6) & kmask1) << 4);
+        aux[0] = (aux[0] & kmask2) | (((tmp >> 0) & kmask1) << 4);
+        aux[1] = (aux[1] & kmask2) | (((tmp >> 2) & kmask1) << 4);
+
+        int sumi = 0;
+        for (int j = 0; j < QK_K / 16; ++j) {
+            int isum = 0;
+            for (int l = 0; l < 16; ++l) isum += q8[16 * j + l] * aux8[16 * j + l];
+            sumi += (scales[j] - 32) * isum;
+        }
+        sumf += MLLM_FP16_TO_FP32(x[i].d) * y[i].d * sumi;
+    }
+    *s = sumf;
+#endif
+}
+
+void vec_dot_q5_K_q8_K(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy) {
+    assert(n % QK_K == 0);
+    assert(QK_K == 256);
+
+    const block_q5_K *__restrict x = (const block_q5_K *)vx;
+    const block_q8_K *__restrict y = (const block_q8_K *)vy;
+
+    const int nb = n / QK_K;
+
+    static const uint32_t Kmask1 = 0x3f3f3f3f;
+    static const uint32_t Kmask2 = 0x0f0f0f0f;
+    static const uint32_t Kmask3 = 0x03030303;
+
+    uint32_t utmp[4];
+
+#ifdef __AVX2__
+    const __m256i m4 = _mm256_set1_epi8(0xF);
+    const __m128i mzero = _mm_setzero_si128();
+    const __m256i mone = _mm256_set1_epi8(1);
+
+    __m256 acc = _mm256_setzero_ps();
+
+    float summs = 0.F;
+
+    for (int i = 0; i < nb; ++i) {
+        const uint8_t *__restrict q5 = x[i].qs;
+        const int8_t *__restrict q8 = y[i].qs;
+
+        const float d = y[i].d * MLLM_FP16_TO_FP32(x[i].d);
+        const float dmin = -y[i].d * MLLM_FP16_TO_FP32(x[i].dmin);
+
+        memcpy(utmp, x[i].scales, 12);
+        utmp[3] = ((utmp[2] >> 4) & Kmask2) | (((utmp[1] >> 6) & Kmask3) << 4);
+        const uint32_t uaux = utmp[1] & Kmask1;
+        utmp[1] = (utmp[2] & Kmask2) | (((utmp[0] >> 6) & Kmask3) << 4);
+        utmp[2] = uaux;
+        utmp[0] &= Kmask1;
+
+        const __m256i mins_and_scales = _mm256_cvtepu8_epi16(_mm_set_epi32(utmp[3], utmp[2], utmp[1], utmp[0]));
+
+        const __m256i q8sums = _mm256_loadu_si256((const __m256i *)y[i].bsums);
+        const __m128i q8s = _mm_hadd_epi16(_mm256_extracti128_si256(q8sums, 0), _mm256_extracti128_si256(q8sums, 1));
+        const __m128i prod = _mm_madd_epi16(_mm256_extracti128_si256(mins_and_scales, 1), q8s);
+        const __m128i hsum = _mm_hadd_epi32(_mm_hadd_epi32(prod, mzero), mzero);
+        summs += dmin * _mm_extract_epi32(hsum, 0);
+
+        const __m128i sc128 = _mm256_extracti128_si256(mins_and_scales, 0);
+        const __m256i scales = MM256_SET_M128I(sc128, sc128);
+
+        const __m256i hbits = _mm256_loadu_si256((const __m256i *)x[i].qh);
+        __m256i hmask = mone;
+
+        __m256i sumi = _mm256_setzero_si256();
+
+        int bit = 0;
+
+        for (int j = 0; j < QK_K / 64; ++j) {
+            const __m256i scale_0 = _mm256_shuffle_epi8(scales, get_scale_shuffle_k4(2 * j + 0));
+            const __m256i scale_1 = _mm256_shuffle_epi8(scales, get_scale_shuffle_k4(2 * j + 1));
+
+            const __m256i q5bits = _mm256_loadu_si256((const __m256i *)q5);
+            q5 += 32;
+
+            const __m256i q5l_0 = _mm256_and_si256(q5bits, m4);
+            const __m256i q5h_0 = _mm256_slli_epi16(_mm256_srli_epi16(_mm256_and_si256(hbits, hmask), bit++), 4);
+            const __m256i q5_0 = _mm256_add_epi8(q5l_0, q5h_0);
+            hmask = _mm256_slli_epi16(hmask, 1);
+
+            const __m256i q5l_1 = _mm256_and_si256(_mm256_srli_epi16(q5bits, 4), m4);
+            const __m256i q5h_1 = _mm256_slli_epi16(_mm256_srli_epi16(_mm256_and_si256(hbits, hmask), bit++), 4);
+            const __m256i q5_1 = _mm256_add_epi8(q5l_1, q5h_1);
+            hmask = _mm256_slli_epi16(hmask, 1);
+
+            const __m256i q8_0 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+            const __m256i q8_1 = _mm256_loadu_si256((const __m256i *)q8);
+            q8 += 32;
+
+            __m256i p16_0 = _mm256_maddubs_epi16(q5_0, q8_0);
+            __m256i p16_1 = _mm256_maddubs_epi16(q5_1, q8_1);
+
+            p16_0 = _mm256_madd_epi16(scale_0, p16_0);
+            p16_1 = _mm256_madd_epi16(scale_1, p16_1);
+
+            sumi = _mm256_add_epi32(sumi, _mm256_add_epi32(p16_0, p16_1));
+        }
+
+        __m256 vd = _mm256_set1_ps(d);
+        acc = _mm256_fmadd_ps(vd, _mm256_cvtepi32_ps(sumi), acc);
+    }
+
+    *s = hsum_float_8(acc) + summs;
+#else
+    const uint8_t *scales = (const uint8_t *)&utmp[0];
+    const uint8_t *mins = (const uint8_t *)&utmp[2];
+
+    int8_t aux8[QK_K];
+
+    float sumf = 0;
+    for (int i = 0; i < nb; ++i) {
+        const uint8_t *__restrict q4 = x[i].qs;
+        const uint8_t *__restrict hm = x[i].qh;
+        const int8_t *__restrict q8 = y[i].qs;
+
+        int8_t *__restrict a = aux8;
+        uint8_t m = 1;
+        for (int j = 0; j < QK_K / 64; ++j) {
+            for (int l = 0; l < 32; ++l) a[l] = (int8_t)(q4[l] & 0xF) + (hm[l] & m ? 16 : 0);
+            a += 32;
+            m <<= 1;
+            for (int l = 0; l < 32; ++l) a[l] = (int8_t)(q4[l] >> 4) + (hm[l] & m ? 16 : 0);
+            a += 32;
+            m <<= 1;
+            q4 += 32;
+        }
+
+        memcpy(utmp, x[i].scales, 12);
+        utmp[3] = ((utmp[2] >> 4) & Kmask2) | (((utmp[1] >> 6) & Kmask3) << 4);
+        const uint32_t uaux = utmp[1] & Kmask1;
+        utmp[1] = (utmp[2] & Kmask2) | (((utmp[0] >> 6) & Kmask3) << 4);
+        utmp[2] = uaux;
+        utmp[0] &= Kmask1;
+
+        int sumi = 0;
+        for (int j = 0; j < QK_K / 16; ++j) sumi += y[i].bsums[j] * mins[j / 2];
+
+        int isum = 0;
+        for (int j = 0; j < QK_K / 32; ++j) {
+            int isuml = 0;
+            for (int l = 0; l < 32; ++l) isuml += q8[32 * j + l] * aux8[32 * j + l];
+            isum += scales[j] * isuml;
+        }
+        sumf += MLLM_FP16_TO_FP32(x[i].d) * y[i].d * isum - MLLM_FP16_TO_FP32(x[i].dmin) * y[i].d * sumi;
+    }
+    *s = sumf;
+#endif
+}
+
 void vec_dot_q8_0_q8_0(int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy) {
     const int qk = QK8_0;
     const int nb = n / qk; // number of blocks
@@ -1493,6 +1961,28 @@ void vec_dot_i8_i8(const int n, float *__restrict s, const void *__restrict vx,
 #endif
 }
 
+// y[i] += v * x[i], x in fp16, y accumulated in fp32
+void vec_mad_fp16(const int n, float *__restrict y, const mllm_fp16_t *__restrict x, const float v) {
+    int i = 0;
+#if defined(__AVX2__) && defined(__F16C__)
+    const __m256 vv = _mm256_set1_ps(v);
+    for (; i + 8 <= n; i += 8) {
+        __m256 ax = MLLM_F32Cx8_LOAD(x + i);
+        __m256 ay = _mm256_loadu_ps(y + i);
+        _mm256_storeu_ps(y + i, MLLM_F32x8_FMA(ay, ax, vv));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t vv = vdupq_n_f32(v);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t ax = vcvt_f32_f16(vld1_f16((const __fp16 *)(x + i)));
+        vst1q_f32(y + i, vfmaq_f32(vld1q_f32(y + i), ax, vv));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] += v * MLLM_FP16_TO_FP32(x[i]);
+    }
+}
+
 #ifdef __AVX2__
 static void vec_value_dot_fp32_avx2(const int n, float *__restrict s, const float *__restrict x, const float *__restrict y, bool addition) {
     float sumf = 0.0F;
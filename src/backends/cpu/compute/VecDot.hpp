@@ -256,6 +256,16 @@ static inline void __avx_f32cx8_store(MLLM_fp16_t *x, __m256 y) {
 #define MLLM_F16_VEC_MUL MLLM_F32Cx8_MUL
 #define MLLM_F16_VEC_REDUCE MLLM_F32Cx8_REDUCE
 
+// Spread 32 bits into 32 bytes: 0xFF where the bit is set, 0x00 otherwise
+static inline __m256i bytes_from_bits_32(const uint8_t *x) {
+    uint32_t x32;
+    memcpy(&x32, x, sizeof(uint32_t));
+    const __m256i shuf_mask = _mm256_set_epi64x(0x0303030303030303, 0x0202020202020202, 0x0101010101010101, 0x0000000000000000);
+    __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(x32), shuf_mask);
+    const __m256i bit_mask = _mm256_set1_epi64x(0x7fbfdfeff7fbfdfe);
+    bytes = _mm256_or_si256(bytes, bit_mask);
+    return _mm256_cmpeq_epi8(bytes, _mm256_set1_epi64x(-1));
+}
 // Unpack 32 4-bit fields into 32 bytes
 // The output vector contains 32 bytes, each one in [ 0 .. 15 ] interval
 static inline __m256i bytes_from_nibbles_32(const uint8_t *rsi) {
@@ -391,9 +401,15 @@ void vec_dot_q6_K_q8_K(const void *__restrict src0, const void *__restrict src1,
 void vec_dot_q4_K_q8_K(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy);
 void vec_dot_q6_K_q8_K(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy);
 void vec_dot_q4_0_q8_0(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy);
+void vec_dot_q5_0_q8_0(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy);
+void vec_dot_q2_K_q8_K(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy);
+void vec_dot_q3_K_q8_K(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy);
+void vec_dot_q5_K_q8_K(const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy);
 void vec_dot_fp32(const int n, float *__restrict s, const float *__restrict vx, const float *__restrict vy);
 void vec_dot_fp16(const int n, float *__restrict s, const mllm_fp16_t *__restrict vx, const mllm_fp16_t *__restrict vy);
 void vec_dot_q8_0_q8_0(int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy);
+// y += v * x, used to accumulate fp16 rows (e.g. paged V cache) into fp32
+void vec_mad_fp16(const int n, float *__restrict y, const mllm_fp16_t *__restrict x, const float v);
 
 // for sparse linear
 void vec_value_dot_fp32(const int n, float *__restrict s, const float x, const float *__restrict vy, bool addition);
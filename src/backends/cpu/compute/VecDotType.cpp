@@ -31,9 +31,14 @@
 #include "VecDotType.hpp"
 #include "Types.hpp"
 #include "quantize/Quantize.hpp"
+#include "quantize/QuantizeQ2.hpp"
+#include "quantize/QuantizeQ3.hpp"
+#include "quantize/QuantizeQ5.hpp"
 #include "quantize/QuantizeQ6.hpp"
 #include "compute/VecDot.hpp"
 #include "compute/GEMM_AArch64.hpp"
+#include "compute/CPUFeatures.hpp"
+#include "compute/SGEMM.hpp"
 
 void fp32_add_row_to(int n, const float *MLLM_RESTRICT src, float *MLLM_RESTRICT dst, float alpha) {
     int i = 0;
@@ -193,6 +198,51 @@ void q6_k_add_row_to(int n, const block_q6_K *MLLM_RESTRICT src, float *MLLM_RES
     }
 }
 
+// Q5_0 and the 2/3/5-bit k-quants go through one dequantized block at a time
+void q5_0_add_row_to(int n, const block_q5_0 *MLLM_RESTRICT src, float *MLLM_RESTRICT dst, float alpha) {
+    assert(n % QK5_0 == 0);
+    float tmp[QK5_0];
+    for (int i = 0; i < n / QK5_0; ++i) {
+        dequantize_row_q5_0(src + i, tmp, QK5_0);
+        for (int j = 0; j < QK5_0; ++j) {
+            dst[i * QK5_0 + j] += alpha * tmp[j];
+        }
+    }
+}
+
+void q2_k_add_row_to(int n, const block_q2_K *MLLM_RESTRICT src, float *MLLM_RESTRICT dst, float alpha) {
+    assert(n % QK_K == 0);
+    float tmp[QK_K];
+    for (int i = 0; i < n / QK_K; ++i) {
+        dequantize_row_q2_K(src + i, tmp, QK_K);
+        for (int j = 0; j < QK_K; ++j) {
+            dst[i * QK_K + j] += alpha * tmp[j];
+        }
+    }
+}
+
+void q3_k_add_row_to(int n, const block_q3_K *MLLM_RESTRICT src, float *MLLM_RESTRICT dst, float alpha) {
+    assert(n % QK_K == 0);
+    float tmp[QK_K];
+    for (int i = 0; i < n / QK_K; ++i) {
+        dequantize_row_q3_K(src + i, tmp, QK_K);
+        for (int j = 0; j < QK_K; ++j) {
+            dst[i * QK_K + j] += alpha * tmp[j];
+        }
+    }
+}
+
+void q5_k_add_row_to(int n, const block_q5_K *MLLM_RESTRICT src, float *MLLM_RESTRICT dst, float alpha) {
+    assert(n % QK_K == 0);
+    float tmp[QK_K];
+    for (int i = 0; i < n / QK_K; ++i) {
+        dequantize_row_q5_K(src + i, tmp, QK_K);
+        for (int j = 0; j < QK_K; ++j) {
+            dst[i * QK_K + j] += alpha * tmp[j];
+        }
+    }
+}
+
 void q8_0_add_row_to(int n, const block_q8_0 *MLLM_RESTRICT src, float *MLLM_RESTRICT dst, float alpha) {
     static const int qk = QK8_0;
 
@@ -256,7 +306,15 @@ type_traits_t type_traits[] = {
     },
     {},
     {},
-    {},
+    /*[MLLM_TYPE_Q5_0] = */ {
+        .size = sizeof(block_q5_0),
+        .blck_size = QK5_0,
+        .to_float = (mllm_to_float_func)dequantize_row_q5_0,
+        .from_float = (mllm_from_float_func)quantize_row_q5_0,
+        .vec_dot = (mllm_vec_dot_func)vec_dot_q5_0_q8_0,
+        .vec_dot_type = MLLM_TYPE_Q8_0,
+        .add_row_to = (mllm_vec_add_row_func)q5_0_add_row_to,
+    },
     {},
     /*[MLLM_TYPE_Q8_0] = */ {
         .size = sizeof(block_q8_0),
@@ -269,8 +327,16 @@ type_traits_t type_traits[] = {
         .add_row_to = (mllm_vec_add_row_func)q8_0_add_row_to,
     },
     /*[MLLM_TYPE_Q8_1] = */ {},
-    {},
-    {},
+    /*[MLLM_TYPE_Q8_PER_TENSOR] = */ {},
+    /*[MLLM_TYPE_Q3_K] = */ {
+        .size = sizeof(block_q3_K),
+        .blck_size = QK_K,
+        .to_float = (mllm_to_float_func)dequantize_row_q3_K,
+        .from_float = (mllm_from_float_func)quantize_row_q3_K,
+        .vec_dot = (mllm_vec_dot_func)vec_dot_q3_K_q8_K,
+        .vec_dot_type = MLLM_TYPE_Q8_K,
+        .add_row_to = (mllm_vec_add_row_func)q3_k_add_row_to,
+    },
     /*[MLLM_TYPE_Q4_K] = */ {
         .size = sizeof(block_q4_K),
         .blck_size = QK_K,
@@ -280,7 +346,15 @@ type_traits_t type_traits[] = {
         .vec_dot_type = MLLM_TYPE_Q8_K,
         .add_row_to = (mllm_vec_add_row_func)q4_k_add_row_to,
     },
-    {},
+    /*[MLLM_TYPE_Q5_K] = */ {
+        .size = sizeof(block_q5_K),
+        .blck_size = QK_K,
+        .to_float = (mllm_to_float_func)dequantize_row_q5_K,
+        .from_float = (mllm_from_float_func)quantize_row_q5_K,
+        .vec_dot = (mllm_vec_dot_func)vec_dot_q5_K_q8_K,
+        .vec_dot_type = MLLM_TYPE_Q8_K,
+        .add_row_to = (mllm_vec_add_row_func)q5_k_add_row_to,
+    },
     /*[MLLM_TYPE_Q6_K] = */ {
         .size = sizeof(block_q6_K),
         .blck_size = QK_K,
@@ -343,6 +417,45 @@ type_traits_t type_traits[] = {
         .gemv = (mllm_gemv_func)mllm_gemv_q4_0_8x8_q8_0,
         .gemm = (mllm_gemm_func)mllm_gemm_q4_0_8x8_q8_0,
     },
-    {},
+    /*[MLLM_TYPE_Q8_0_4_4] = */ {},
+    /*[MLLM_TYPE_Q2_K] = */ {
+        .size = sizeof(block_q2_K),
+        .blck_size = QK_K,
+        .to_float = (mllm_to_float_func)dequantize_row_q2_K,
+        .from_float = (mllm_from_float_func)quantize_row_q2_K,
+        .vec_dot = (mllm_vec_dot_func)vec_dot_q2_K_q8_K,
+        .vec_dot_type = MLLM_TYPE_Q8_K,
+        .add_row_to = (mllm_vec_add_row_func)q2_k_add_row_to,
+    },
     // TODO: add support to more type
 };
+static_assert(sizeof(type_traits) / sizeof(type_traits[0]) == MLLM_TYPE_COUNT, "type_traits must have one entry per DataType");
+
+// the entries dispatchCPUKernels() may replace, as compiled for the baseline
+static void resetTypeTraitsKernels() {
+    type_traits[MLLM_TYPE_Q4_0].vec_dot = (mllm_vec_dot_func)vec_dot_q4_0_q8_0;
+    type_traits[MLLM_TYPE_Q8_0].vec_dot = (mllm_vec_dot_func)vec_dot_q8_0_q8_0;
+    type_traits[MLLM_TYPE_Q4_0_4_4].gemv = (mllm_gemv_func)mllm_gemv_q4_0_4x4_q8_0;
+    type_traits[MLLM_TYPE_Q4_0_4_4].gemm = (mllm_gemm_func)mllm_gemm_q4_0_4x4_q8_0;
+    type_traits[MLLM_TYPE_Q4_0_4_8].gemv = (mllm_gemv_func)mllm_gemv_q4_0_4x8_q8_0;
+    type_traits[MLLM_TYPE_Q4_0_4_8].gemm = (mllm_gemm_func)mllm_gemm_q4_0_4x8_q8_0;
+    type_traits[MLLM_TYPE_Q4_0_8_8].gemv = (mllm_gemv_func)mllm_gemv_q4_0_8x8_q8_0;
+    type_traits[MLLM_TYPE_Q4_0_8_8].gemm = (mllm_gemm_func)mllm_gemm_q4_0_8x8_q8_0;
+    set_llamafile_sgemm(llamafile_sgemm_baseline, check_llamafile_sgemm_baseline);
+}
+
+CPUKernelISA mllm::dispatchCPUKernels(CPUKernelISA cap) {
+    const CPUFeatures &f = cpuFeatures();
+    resetTypeTraitsKernels();
+    if (cap >= CPU_ISA_AVX512VNNI && f.avx512_vnni && f.avx512vl && f.avx512bw && f.fma && f.f16c
+        && mllm_x86_kernels_avx512vnni(type_traits)) {
+        return CPU_ISA_AVX512VNNI;
+    }
+    if (cap >= CPU_ISA_AVXVNNI && f.avx_vnni && f.fma && f.f16c && mllm_x86_kernels_avxvnni(type_traits)) {
+        return CPU_ISA_AVXVNNI;
+    }
+    return CPU_ISA_BASELINE;
+}
+
+// type_traits is constant-initialized, so this runs after the table is filled and before any op reads it
+[[maybe_unused]] static const CPUKernelISA dispatched_isa = (checkCPUBaseline(), dispatchCPUKernels());
@@ -26,15 +26,14 @@ public:
         float data = (float)args[0];
         auto input = inputs[0];
         auto output = outputs[0];
-#pragma omp parallel for collapse(3) num_threads(CPUBackend::cpu_threads)
-        for (int n = 0; n < input->batch(); ++n) {
-            for (int c = 0; c < input->head(); ++c) {
-                for (int h = 0; h < input->sequence(); ++h) {
-                    mllm_add_fp32(input->ptrAt<float>(n, c, h, 0), data,
-                                  outputs[0]->ptrAt<float>(n, c, h, 0), input->dimension());
-                }
-            }
-        }
+        const int64_t H = input->head(), S = input->sequence();
+        parallel_for(input->batch() * H * S, CPUBackend::cpu_threads, [&](int64_t i) {
+            const int n = (int)(i / (H * S));
+            const int c = (int)(i / S % H);
+            const int h = (int)(i % S);
+            mllm_add_fp32(input->ptrAt<float>(n, c, h, 0), data,
+                          outputs[0]->ptrAt<float>(n, c, h, 0), input->dimension());
+        });
     }
 };
 class CPUsubFunction : public TensorFunction {
@@ -50,15 +49,14 @@ public:
         float data = (float)args[0];
         auto input = inputs[0];
         auto output = outputs[0];
-#pragma omp parallel for collapse(3) num_threads(CPUBackend::cpu_threads)
-        for (int n = 0; n < input->batch(); ++n) {
-            for (int c = 0; c < input->head(); ++c) {
-                for (int h = 0; h < input->sequence(); ++h) {
-                    mllm_sub_fp32(input->ptrAt<float>(n, c, h, 0), data,
-                                  outputs[0]->ptrAt<float>(n, c, h, 0), input->dimension());
-                }
-            }
-        }
+        const int64_t H = input->head(), S = input->sequence();
+        parallel_for(input->batch() * H * S, CPUBackend::cpu_threads, [&](int64_t i) {
+            const int n = (int)(i / (H * S));
+            const int c = (int)(i / S % H);
+            const int h = (int)(i % S);
+            mllm_sub_fp32(input->ptrAt<float>(n, c, h, 0), data,
+                          outputs[0]->ptrAt<float>(n, c, h, 0), input->dimension());
+        });
     }
 };
 class CPUmulFunction : public TensorFunction {
@@ -74,15 +72,14 @@ public:
         float data = (float)args[0];
         auto input = inputs[0];
         auto output = outputs[0];
-#pragma omp parallel for collapse(3) num_threads(CPUBackend::cpu_threads)
-        for (int n = 0; n < input->batch(); ++n) {
-            for (int c = 0; c < input->head(); ++c) {
-                for (int h = 0; h < input->sequence(); ++h) {
-                    mllm_mul_fp32(input->ptrAt<float>(n, c, h, 0), data,
-                                  outputs[0]->ptrAt<float>(n, c, h, 0), input->dimension());
-                }
-            }
-        }
+        const int64_t H = input->head(), S = input->sequence();
+        parallel_for(input->batch() * H * S, CPUBackend::cpu_threads, [&](int64_t i) {
+            const int n = (int)(i / (H * S));
+            const int c = (int)(i / S % H);
+            const int h = (int)(i % S);
+            mllm_mul_fp32(input->ptrAt<float>(n, c, h, 0), data,
+                          outputs[0]->ptrAt<float>(n, c, h, 0), input->dimension());
+        });
     }
 };
 class CPUdivFunction : public TensorFunction {
@@ -98,15 +95,14 @@ public:
         float data = (float)args[0];
         auto input = inputs[0];
         auto output = outputs[0];
-#pragma omp parallel for collapse(3) num_threads(CPUBackend::cpu_threads)
-        for (int n = 0; n < input->batch(); ++n) {
-            for (int c = 0; c < input->head(); ++c) {
-                for (int h = 0; h < input->sequence(); ++h) {
-                    mllm_div_fp32(input->ptrAt<float>(n, c, h, 0), data,
-                                  outputs[0]->ptrAt<float>(n, c, h, 0), input->dimension());
-                }
-            }
-        }
+        const int64_t H = input->head(), S = input->sequence();
+        parallel_for(input->batch() * H * S, CPUBackend::cpu_threads, [&](int64_t i) {
+            const int n = (int)(i / (H * S));
+            const int c = (int)(i / S % H);
+            const int h = (int)(i % S);
+            mllm_div_fp32(input->ptrAt<float>(n, c, h, 0), data,
+                          outputs[0]->ptrAt<float>(n, c, h, 0), input->dimension());
+        });
     }
 };
 
@@ -125,14 +121,14 @@ public:
         for (int n = 0; n < batch_; ++n) {
             auto n_0 = std::min(n, input0->batch() - 1);
             auto n_1 = std::min(n, input1->batch() - 1);
-#pragma omp parallel for collapse(2) num_threads(CPUBackend::cpu_threads)
-            for (int c = 0; c < input0->head(); ++c) {
-                for (int h = 0; h < input0->sequence(); ++h) {
-                    mllm_add_fp32(input0->ptrAt<float>(n_0, c, h, 0),
-                                  input1->ptrAt<float>(n_1, c, h, 0),
-                                  outputs[0]->ptrAt<float>(n, c, h, 0), input0->dimension());
-                }
-            }
+            const int64_t S = input0->sequence();
+            parallel_for(input0->head() * S, CPUBackend::cpu_threads, [&](int64_t i) {
+                const int c = (int)(i / S);
+                const int h = (int)(i % S);
+                mllm_add_fp32(input0->ptrAt<float>(n_0, c, h, 0),
+                              input1->ptrAt<float>(n_1, c, h, 0),
+                              outputs[0]->ptrAt<float>(n, c, h, 0), input0->dimension());
+            });
         }
     };
 };
@@ -151,14 +147,14 @@ public:
         for (int n = 0; n < batch_; ++n) {
             auto n_0 = std::min(n, input0->batch() - 1);
             auto n_1 = std::min(n, input1->batch() - 1);
-#pragma omp parallel for collapse(2) num_threads(CPUBackend::cpu_threads)
-            for (int c = 0; c < input0->head(); ++c) {
-                for (int h = 0; h < input0->sequence(); ++h) {
-                    mllm_sub_fp32(input0->ptrAt<float>(n_0, c, h, 0),
-                                  input1->ptrAt<float>(n_1, c, h, 0),
-                                  outputs[0]->ptrAt<float>(n, c, h, 0), input0->dimension());
-                }
-            }
+            const int64_t S = input0->sequence();
+            parallel_for(input0->head() * S, CPUBackend::cpu_threads, [&](int64_t i) {
+                const int c = (int)(i / S);
+                const int h = (int)(i % S);
+                mllm_sub_fp32(input0->ptrAt<float>(n_0, c, h, 0),
+                              input1->ptrAt<float>(n_1, c, h, 0),
+                              outputs[0]->ptrAt<float>(n, c, h, 0), input0->dimension());
+            });
         }
     };
 };
@@ -177,14 +173,14 @@ public:
         for (int n = 0; n < batch_; ++n) {
             auto n_0 = std::min(n, input0->batch() - 1);
             auto n_1 = std::min(n, input1->batch() - 1);
-#pragma omp parallel for collapse(2) num_threads(CPUBackend::cpu_threads)
-            for (int c = 0; c < input0->head(); ++c) {
-                for (int h = 0; h < input0->sequence(); ++h) {
-                    mllm_mul_fp32(input0->ptrAt<float>(n_0, c, h, 0),
-                                  input1->ptrAt<float>(n_1, c, h, 0),
-                                  outputs[0]->ptrAt<float>(n, c, h, 0), input0->dimension());
-                }
-            }
+            const int64_t S = input0->sequence();
+            parallel_for(input0->head() * S, CPUBackend::cpu_threads, [&](int64_t i) {
+                const int c = (int)(i / S);
+                const int h = (int)(i % S);
+                mllm_mul_fp32(input0->ptrAt<float>(n_0, c, h, 0),
+                              input1->ptrAt<float>(n_1, c, h, 0),
+                              outputs[0]->ptrAt<float>(n, c, h, 0), input0->dimension());
+            });
         }
     };
 };
@@ -203,14 +199,14 @@ public:
         for (int n = 0; n < batch_; ++n) {
             auto n_0 = std::min(n, input0->batch() - 1);
             auto n_1 = std::min(n, input1->batch() - 1);
-#pragma omp parallel for collapse(2) num_threads(CPUBackend::cpu_threads)
-            for (int c = 0; c < input0->head(); ++c) {
-                for (int h = 0; h < input0->sequence(); ++h) {
-                    mllm_div_fp32(input0->ptrAt<float>(n_0, c, h, 0),
-                                  input1->ptrAt<float>(n_1, c, h, 0),
-                                  outputs[0]->ptrAt<float>(n, c, h, 0), input0->dimension());
-                }
-            }
+            const int64_t S = input0->sequence();
+            parallel_for(input0->head() * S, CPUBackend::cpu_threads, [&](int64_t i) {
+                const int c = (int)(i / S);
+                const int h = (int)(i % S);
+                mllm_div_fp32(input0->ptrAt<float>(n_0, c, h, 0),
+                              input1->ptrAt<float>(n_1, c, h, 0),
+                              outputs[0]->ptrAt<float>(n, c, h, 0), input0->dimension());
+            });
         }
     };
 };
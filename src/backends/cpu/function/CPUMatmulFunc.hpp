@@ -61,19 +61,46 @@ class CPUmmFunction : public TensorFunction {
         }
     }
 
+    // packed continuous-batching rows, only meaningful against a paged KV cache
+    static const SequenceBatch *sequenceBatch(Tensor *input0, Tensor *input1) {
+        auto cpu_backend = dynamic_cast<CPUBackend *>(input0->backend());
+        if (!input1->aggregated() || cpu_backend == nullptr || cpu_backend->sequenceBatch().empty()
+            || cpu_backend->sequenceBatch().rows() != input0->sequence()) {
+            return nullptr;
+        }
+        return &cpu_backend->sequenceBatch();
+    }
+
 public:
+    // args[0]: inputs[1] is used transposed (q * k^T) without materializing the transpose
     void setup(vector<Tensor *> outputs, vector<Tensor *> inputs, vector<float> args) override {
-        if (inputs[1]->chls()[SEQUENCE] != 3) {
-            tranTensorChl(*inputs[1]);
+        bool transpose1 = !args.empty() && args[0] > 0;
+        auto seq_batch = sequenceBatch(inputs[0], inputs[1]);
+        if (transpose1) {
+            assert(inputs[0]->dimension() == inputs[1]->dimension());
+            // packed rows get one column per key of the longest sequence of the step
+            int keys = seq_batch != nullptr ? seq_batch->maxLength() : inputs[1]->sequence();
+            outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), keys);
+        } else {
+            if (!inputs[1]->aggregated() && inputs[1]->chls()[SEQUENCE] != 3) {
+                tranTensorChl(*inputs[1]);
+            }
+            assert(seq_batch != nullptr || inputs[0]->dimension() == inputs[1]->sequence());
+            outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[1]->dimension());
         }
-        assert(inputs[0]->dimension() == inputs[1]->sequence());
-        outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[1]->dimension());
         outputs[0]->setDtype(inputs[0]->dtype());
         outputs[0]->alloc();
     }
     void execute(vector<Tensor *> outputs, vector<Tensor *> inputs, vector<float> args) override {
-        bool isSame = std::equal(inputs[0]->chls().begin(), inputs[0]->chls().end(), inputs[1]->chls().begin());
+        bool transpose1 = !args.empty() && args[0] > 0;
         assert(inputs[0]->dtype() == MLLM_TYPE_F32);
+        if (inputs[1]->aggregated()) {
+            // paged KV cache
+            mat_mul_paged(inputs[0], inputs[1], outputs[0], transpose1, CPUBackend::cpu_threads,
+                          sequenceBatch(inputs[0], inputs[1]));
+            return;
+        }
+        bool isSame = transpose1 || std::equal(inputs[0]->chls().begin(), inputs[0]->chls().end(), inputs[1]->chls().begin());
         mat_mul(inputs[0], inputs[1], outputs[0], false, nullptr, false, isSame, CPUBackend::cpu_threads);
     }
 };
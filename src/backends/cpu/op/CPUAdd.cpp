@@ -31,13 +31,13 @@ ErrorCode CPUAdd::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<T
     for (int n = 0; n < batch_; ++n) {
         auto n_0 = std::min(n, input0->batch() - 1);
         auto n_1 = std::min(n, input1->batch() - 1);
-#pragma omp parallel for collapse(2) num_threads(CPUBackend::cpu_threads)
-        for (int c = 0; c < input0->head(); ++c) {
-            for (int h = 0; h < input0->sequence(); ++h) {
-                mllm_add_fp32(input0->ptrAt<float>(n_0, c, h, 0), input1->ptrAt<float>(n_0, c, h, 0),
-                              outputs[0]->ptrAt<float>(n_0, c, h, 0), input0->dimension());
-            }
-        }
+        const int64_t S = input0->sequence();
+        parallel_for(input0->head() * S, CPUBackend::cpu_threads, [&](int64_t i) {
+            const int c = (int)(i / S);
+            const int h = (int)(i % S);
+            mllm_add_fp32(input0->ptrAt<float>(n_0, c, h, 0), input1->ptrAt<float>(n_0, c, h, 0),
+                          outputs[0]->ptrAt<float>(n_0, c, h, 0), input0->dimension());
+        });
     }
     return Op::execute(inputs, outputs);
     /*
@@ -53,17 +53,17 @@ ErrorCode CPUAdd::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<T
                 auto in0_ptr = inputs[0]->ptrAt<float>(n_0, 0, 0, 0);
                 auto in1_ptr = inputs[1]->ptrAt<float>(n_1, 0, 0, 0);
                 auto out_ptr = outputs[0]->ptrAt<float>(n, 0, 0, 0);
-    #pragma omp parallel for num_threads(thread_count)
-                for (int is = 0; is < copy_size; ++is) {
+                parallel_for(copy_size, thread_count, [&](int64_t i) {
+                    const int is = (int)i;
                     out_ptr[is] = in0_ptr[is] + in1_ptr[is];
-                }
+                });
             } else {
                 for (int c = 0; c < C; ++c) {
                     for (int h = 0; h < H; ++h) {
-    #pragma omp parallel for num_threads(thread_count)
-                        for (int w = 0; w < W; ++w) {
+                        parallel_for(W, thread_count, [&](int64_t i) {
+                            const int w = (int)i;
                             outputs[0]->setDataAt<float>(n, c, h, w, inputs[0]->dataAt<float>(n_0, c, h, w) + inputs[1]->dataAt<float>(n_1, c, h, w));
-                        }
+                        });
                     }
                 }
             }
@@ -44,12 +44,12 @@ ErrorCode CPUEmbedding::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
     case MLLM_TYPE_F32: {
         for (int batch = 0; batch < input->batch(); ++batch) {
             for (int head = 0; head < input->head(); ++head) { // NOLINT(*-use-default-none)
-#pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
+                parallel_for(input->sequence(), thread_count, [&](int64_t i) {
+                    const int seq = (int)i;
 #ifdef USE_QNN
                     if ((int)input->dataAt<float>(batch, head, seq, 0) == vocabSize_) {
                         memset(output->hostPtr<float>() + output->offset(batch, head, seq, 0), 0, output->dimension() * sizeof(float));
-                        continue;
+                        return;
                     }
 #endif
                     auto seq__ = input->dataAt<float>(batch, head, seq, 0);
@@ -58,7 +58,7 @@ ErrorCode CPUEmbedding::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
                                weight_.hostPtr<float>() + weight_.offset(0, 0, (int)seq__, 0),
                                weight_.dtypeSize() * hiddenSize_);
                     }
-                }
+                });
             }
         }
         break;
@@ -66,15 +66,15 @@ ErrorCode CPUEmbedding::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
     case MLLM_TYPE_Q4_0: {
         for (int batch = 0; batch < input->batch(); ++batch) {
             for (int head = 0; head < input->head(); ++head) {
-#pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
+                parallel_for(input->sequence(), thread_count, [&](int64_t i) {
+                    const int seq = (int)i;
                     auto seq__ = input->dataAt<float>(batch, head, seq, 0);
                     if (seq__ >= 0) {
                         dequantize_row_q4_0(weight_.hostPtr<block_q4_0>() + weight_.offset(0, 0, (int)seq__, 0) / (QK4_0),
                                             output->hostPtr<float>() + output->offset(batch, head, seq, 0),
                                             hiddenSize_);
                     }
-                }
+                });
             }
         }
         break;
@@ -82,15 +82,15 @@ ErrorCode CPUEmbedding::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
     case MLLM_TYPE_Q4_K: {
         for (int batch = 0; batch < input->batch(); ++batch) {
             for (int head = 0; head < input->head(); ++head) {
-#pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
+                parallel_for(input->sequence(), thread_count, [&](int64_t i) {
+                    const int seq = (int)i;
                     auto seq__ = input->dataAt<float>(batch, head, seq, 0);
                     if (seq__ >= 0) {
                         dequantize_row_q4_K(weight_.hostPtr<block_q4_K>() + weight_.offset(0, 0, (int)seq__, 0) / (QK_K),
                                             outputs[0]->hostPtr<float>() + outputs[0]->offset(batch, head, seq, 0),
                                             hiddenSize_);
                     }
-                }
+                });
             }
         }
         break;
@@ -98,15 +98,15 @@ ErrorCode CPUEmbedding::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
     case MLLM_TYPE_Q8_0: {
         for (int batch = 0; batch < input->batch(); ++batch) {
             for (int head = 0; head < input->head(); ++head) {
-#pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
+                parallel_for(input->sequence(), thread_count, [&](int64_t i) {
+                    const int seq = (int)i;
                     auto seq__ = input->dataAt<float>(batch, head, seq, 0);
                     if (seq__ >= 0) {
                         dequantize_row_q8_0(weight_.hostPtr<block_q8_0>() + weight_.offset(0, 0, (int)seq__, 0) / (QK8_0),
                                             output->hostPtr<float>() + output->offset(batch, head, seq, 0),
                                             hiddenSize_);
                     }
-                }
+                });
             }
         }
         break;
@@ -114,15 +114,15 @@ ErrorCode CPUEmbedding::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
     case MLLM_TYPE_Q8_K: {
         for (int batch = 0; batch < input->batch(); ++batch) {
             for (int head = 0; head < input->head(); ++head) {
-#pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
+                parallel_for(input->sequence(), thread_count, [&](int64_t i) {
+                    const int seq = (int)i;
                     auto seq__ = input->dataAt<float>(batch, head, seq, 0);
                     if (seq__ >= 0) {
                         dequantize_row_q8_K(weight_.hostPtr<block_q8_K>() + weight_.offset(0, 0, (int)seq__, 0) / (QK_K),
                                             output->hostPtr<float>() + output->offset(batch, head, seq, 0),
                                             hiddenSize_);
                     }
-                }
+                });
             }
         }
         break;
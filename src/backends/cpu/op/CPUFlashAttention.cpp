@@ -0,0 +1,194 @@
+#include "CPUFlashAttention.hpp"
+#include "../compute/VecDot.hpp"
+#include <cmath>
+
+namespace mllm {
+
+// query rows sharing one pass over a tile of keys, and keys per tile
+#define FA_TILE_Q 4
+#define FA_TILE_KV 64
+
+CPUFlashAttention::CPUFlashAttention(Backend *bn, string opName, bool causal, int threadCount) :
+    thread_count(threadCount), Op(bn, opName) {
+    causal_ = causal;
+}
+
+ErrorCode CPUFlashAttention::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs.size() >= 3);
+    assert(outputs.size() == 1);
+    auto &q = inputs[0];
+    assert(q->dimension() == inputs[1]->dimension() && q->dimension() == inputs[2]->dimension());
+    assert(q->head() % inputs[1]->head() == 0);
+    outputs[0]->reshape(q->batch(), q->head(), q->sequence(), q->dimension());
+    outputs[0]->setDtype(MLLM_TYPE_F32);
+    return Op::reshape(inputs, outputs);
+}
+
+// row n of head h of t, for the tokens of plain and aggregated (paged KVCache) tensors alike
+static void tokenRows(Tensor *t, int b, int h, vector<const char *> &rows) {
+    rows.clear();
+    vector<Tensor *> parts;
+    if (t->aggregated()) {
+        for (auto &part : t->aggregatedTensors()) { parts.push_back(part.get()); }
+    } else {
+        parts.push_back(t);
+    }
+    for (auto *part : parts) {
+        assert(part->ctype() == BSHD || part->ctype() == SBHD);
+        for (int n = 0; n < part->sequence(); ++n) {
+            rows.push_back((const char *)part->rawHostPtr() + DataTypeSize(part->dtype(), part->offset(b, h, n, 0)));
+        }
+    }
+}
+
+ErrorCode CPUFlashAttention::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    auto &q = inputs[0];
+    auto &k = inputs[1];
+    auto &v = inputs[2];
+    auto &o = outputs[0];
+    assert(q->dtype() == MLLM_TYPE_F32);
+    const int B = q->batch();
+    const int H = q->head();
+    const int S = q->sequence();
+    const int D = q->dimension();
+    const int H_kv = k->head();
+    const int n_rep = H / H_kv;
+    const float scale = 1.0F / std::sqrt((float)D);
+    const DataType k_type = k->aggregated() ? k->aggregatedTensors()[0]->dtype() : k->dtype();
+    const DataType v_type = v->aggregated() ? v->aggregatedTensors()[0]->dtype() : v->dtype();
+    // quantized K is dotted with the query quantized to Q8_0, quantized V rows are dequantized as they are read
+    const bool k_quantized = k_type == MLLM_TYPE_Q8_0 || k_type == MLLM_TYPE_Q4_0;
+    const bool v_quantized = v_type == MLLM_TYPE_Q8_0 || v_type == MLLM_TYPE_Q4_0;
+    assert(k_quantized || k_type == MLLM_TYPE_F16 || k_type == MLLM_TYPE_F32);
+    assert(v_quantized || v_type == MLLM_TYPE_F16 || v_type == MLLM_TYPE_F32);
+    assert(!k_quantized || D % QK8_0 == 0);
+    int kv_len = inputs.size() > 3 ? (int)inputs[3]->dataAt<float>(0, 0, 0, 0) : k->sequence();
+    kv_len = std::min(kv_len, k->sequence());
+
+    // keys [key_begin[s], key_begin[s] + key_count[s]) are visible to query row s
+    vector<int> key_begin(S, 0);
+    vector<int> key_count(S, kv_len);
+    auto cpu_backend = dynamic_cast<CPUBackend *>(backend());
+    if (cpu_backend != nullptr && !cpu_backend->sequenceBatch().empty() && k->aggregated()
+        && cpu_backend->sequenceBatch().rows() == S && B == 1) {
+        // packed continuous-batching step: the cache holds the slots of the step one after the other
+        auto &seq_batch = cpu_backend->sequenceBatch();
+        int slot_begin = 0;
+        int s = 0;
+        for (auto &slot : seq_batch.slotLengths()) {
+            for (; s < S && seq_batch.slots[s] == slot.first; ++s) {
+                key_begin[s] = slot_begin;
+                key_count[s] = seq_batch.positions[s] + 1;
+            }
+            slot_begin += slot.second;
+        }
+    } else if (causal_) {
+        for (int s = 0; s < S; ++s) {
+            key_count[s] = std::min(kv_len, kv_len - S + s + 1);
+        }
+    }
+
+    vector<vector<const char *>> k_rows(B * H_kv);
+    vector<vector<const char *>> v_rows(B * H_kv);
+    for (int b = 0; b < B; ++b) {
+        for (int h = 0; h < H_kv; ++h) {
+            tokenRows(k.get(), b, h, k_rows[b * H_kv + h]);
+            tokenRows(v.get(), b, h, v_rows[b * H_kv + h]);
+        }
+    }
+
+    const int q_tiles = (S + FA_TILE_Q - 1) / FA_TILE_Q;
+    parallel_for((int64_t)B * H * q_tiles, thread_count, [&](int64_t idx) {
+        const int b = (int)(idx / (H * q_tiles));
+        const int h = (int)(idx / q_tiles % H);
+        const int tile = (int)(idx % q_tiles);
+        const auto &k_head = k_rows[b * H_kv + h / n_rep];
+        const auto &v_head = v_rows[b * H_kv + h / n_rep];
+        const int s_begin = tile * FA_TILE_Q;
+        const int rows = std::min(FA_TILE_Q, S - s_begin);
+        float row_max[FA_TILE_Q];
+        float row_sum[FA_TILE_Q];
+        float scores[FA_TILE_KV];
+        vector<float> acc(rows * D, 0.0F);
+        vector<mllm_fp16_t> q_f16(k_type == MLLM_TYPE_F16 ? rows * D : 0);
+        vector<block_q8_0> q_q8(k_quantized ? rows * D / QK8_0 : 0);
+        vector<float> v_row_f32(v_quantized ? D : 0);
+        int tile_begin = INT32_MAX;
+        int tile_end = 0;
+        for (int i = 0; i < rows; ++i) {
+            row_max[i] = -INFINITY;
+            row_sum[i] = 0.0F;
+            const float *q_row = q->ptrAt<float>(b, h, s_begin + i, 0);
+            if (k_type == MLLM_TYPE_F16) {
+                for (int d = 0; d < D; ++d) {
+                    q_f16[i * D + d] = MLLM_FP32_TO_FP16(q_row[d]);
+                }
+            } else if (k_quantized) {
+                quantize_row_q8_0(q_row, q_q8.data() + i * D / QK8_0, D);
+            }
+            tile_begin = std::min(tile_begin, key_begin[s_begin + i]);
+            tile_end = std::max(tile_end, key_begin[s_begin + i] + key_count[s_begin + i]);
+        }
+        for (int n0 = tile_begin; n0 < tile_end; n0 += FA_TILE_KV) {
+            for (int i = 0; i < rows; ++i) {
+                const int s = s_begin + i;
+                const int lo = std::max(n0, key_begin[s]);
+                const int hi = std::min(n0 + FA_TILE_KV, key_begin[s] + key_count[s]);
+                if (lo >= hi) { continue; }
+                float tile_max = -INFINITY;
+                for (int n = lo; n < hi; ++n) {
+                    float dot;
+                    if (k_type == MLLM_TYPE_F16) {
+                        vec_dot_fp16(D, &dot, q_f16.data() + i * D, (const mllm_fp16_t *)k_head[n]);
+                    } else if (k_type == MLLM_TYPE_Q8_0) {
+                        vec_dot_q8_0_q8_0(D, &dot, k_head[n], q_q8.data() + i * D / QK8_0);
+                    } else if (k_type == MLLM_TYPE_Q4_0) {
+                        vec_dot_q4_0_q8_0(D, &dot, k_head[n], q_q8.data() + i * D / QK8_0);
+                    } else {
+                        vec_dot_fp32(D, &dot, q->ptrAt<float>(b, h, s, 0), (const float *)k_head[n]);
+                    }
+                    scores[n - lo] = dot * scale;
+                    tile_max = std::max(tile_max, scores[n - lo]);
+                }
+                // online softmax: rescale what was accumulated under the previous max
+                const float new_max = std::max(row_max[i], tile_max);
+                const float correction = std::exp(row_max[i] - new_max);
+                float *acc_row = acc.data() + i * D;
+                if (correction != 1.0F) {
+                    row_sum[i] *= correction;
+                    vec_scale_f32(D, acc_row, correction);
+                }
+                row_max[i] = new_max;
+                for (int n = lo; n < hi; ++n) {
+                    const float p = std::exp(scores[n - lo] - new_max);
+                    row_sum[i] += p;
+                    if (v_type == MLLM_TYPE_F16) {
+                        vec_mad_fp16(D, acc_row, (const mllm_fp16_t *)v_head[n], p);
+                    } else {
+                        const float *v_row = (const float *)v_head[n];
+                        if (v_type == MLLM_TYPE_Q8_0) {
+                            dequantize_row_q8_0(v_head[n], v_row_f32.data(), D);
+                            v_row = v_row_f32.data();
+                        } else if (v_type == MLLM_TYPE_Q4_0) {
+                            dequantize_row_q4_0(v_head[n], v_row_f32.data(), D);
+                            v_row = v_row_f32.data();
+                        }
+                        for (int d = 0; d < D; ++d) {
+                            acc_row[d] += p * v_row[d];
+                        }
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < rows; ++i) {
+            float *out = o->ptrAt<float>(b, h, s_begin + i, 0);
+            const float inv_sum = row_sum[i] > 0 ? 1.0F / row_sum[i] : 0.0F;
+            for (int d = 0; d < D; ++d) {
+                out[d] = acc[i * D + d] * inv_sum;
+            }
+        }
+    });
+    return Op::execute(inputs, outputs);
+}
+
+} // namespace mllm
@@ -0,0 +1,39 @@
+#ifndef MLLM_CPUFLASHATTENTION_H
+#define MLLM_CPUFLASHATTENTION_H
+
+#include "Op.hpp"
+#include "../CPUBackend.hpp"
+
+namespace mllm {
+
+/**
+ * \brief fused softmax(Q K^T / sqrt(D)) V for the SDPA op type.
+ *
+ * inputs: Q [B, H, S, D] F32, K and V [B, H_kv, N, D] F32/F16/Q8_0/Q4_0 (e.g. a KVCache output, contiguous or paged),
+ * optional inputs[3] holding the number of valid keys (the contiguous KVCache pads its output).
+ * Q heads are mapped onto H / H_kv shared kv heads. Keys are visited in tiles with an online softmax, so
+ * the S x N score matrix is never materialized and memory stays O(S).
+ */
+class CPUFlashAttention final : public Op {
+public:
+    CPUFlashAttention(Backend *bn, string opName, bool causal, int threadCount);
+    virtual ~CPUFlashAttention() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+
+private:
+    int thread_count = 4;
+    bool causal_ = true;
+};
+
+class CPUFlashAttentionCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        bool causal = (op_param.find("causal") == op_param.end()) ? true : (bool)op_param["causal"];
+        return new CPUFlashAttention(bn, name, causal, threadCount);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPUFLASHATTENTION_H
@@ -3,19 +3,75 @@
 #include "CPUKVCache.hpp"
 #include "ParamLoader.hpp"
 #include "Types.hpp"
+#include "CPURoPE.hpp"
+#include "../quantize/QuantizeQ8.hpp"
+#include "../quantize/QuantizeQ4.hpp"
 
 int n_pack = 16;
 #define KVCache_TYPE_16
-// #define KVCache_TYPE_8  //TODO: Q8_0 KVCache can not use!!
 namespace mllm {
-CPUKVCache::CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max, int threadCount) :
+
+// write row src_s of head h of src into row dst_s of a BSHD/SBHD cache tensor, converting or quantizing it
+// to the dtype of dst
+static void storeCacheRow(Tensor *dst, int dst_s, Tensor *src, int src_s, int b, int h) {
+    const int dimension = src->dimension();
+    void *dst_ptr = (char *)dst->rawHostPtr() + DataTypeSize(dst->dtype(), dst->offset(b, h, dst_s, 0));
+    if (src->dtype() == dst->dtype() && src->ctype() == BSHD) {
+        memcpy(dst_ptr, (char *)src->rawHostPtr() + DataTypeSize(src->dtype(), src->offset(b, h, src_s, 0)),
+               DataTypeSize(dst->dtype(), dimension));
+        return;
+    }
+    const float *row;
+    vector<float> row_buf;
+    if (src->dtype() == MLLM_TYPE_F32 && src->ctype() == BSHD) {
+        row = src->ptrAt<float>(b, h, src_s, 0);
+    } else if (src->dtype() == MLLM_TYPE_F16) {
+        row_buf.resize(dimension);
+        row = row_buf.data();
+        for (int d = 0; d < dimension; ++d) {
+            row_buf[d] = MLLM_FP16_TO_FP32(src->dataAt<mllm_fp16_t>(b, h, src_s, d));
+        }
+    } else {
+        row_buf.resize(dimension);
+        row = row_buf.data();
+        for (int d = 0; d < dimension; ++d) {
+            row_buf[d] = src->dataAt<float>(b, h, src_s, d);
+        }
+    }
+    switch (dst->dtype()) {
+    case MLLM_TYPE_F32:
+        memcpy(dst_ptr, row, dimension * sizeof(float));
+        break;
+    case MLLM_TYPE_F16:
+        for (int d = 0; d < dimension; ++d) {
+            ((mllm_fp16_t *)dst_ptr)[d] = MLLM_FP32_TO_FP16(row[d]);
+        }
+        break;
+    case MLLM_TYPE_Q8_0:
+        quantize_row_q8_0(row, dst_ptr, dimension);
+        break;
+    case MLLM_TYPE_Q4_0:
+        quantize_row_q4_0(row, dst_ptr, dimension);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+// dequantize row s of head h of a quantized cache tensor
+static void loadCacheRow(float *row, Tensor *src, int s, int b, int h) {
+    const void *src_ptr = (char *)src->rawHostPtr() + DataTypeSize(src->dtype(), src->offset(b, h, s, 0));
+    if (src->dtype() == MLLM_TYPE_Q8_0) {
+        dequantize_row_q8_0(src_ptr, row, src->dimension());
+    } else {
+        dequantize_row_q4_0(src_ptr, row, src->dimension());
+    }
+}
+CPUKVCache::CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max, int threadCount, int block_size) :
     thread_count(threadCount), Op(bn, opName) {
     cache_.setBackend(bn);
 #if defined(KVCache_TYPE_16)
     cache_.setDtype(MLLM_TYPE_F16);
-#elif defined(KVCache_TYPE_8)
-    cache_.setDtype(MLLM_TYPE_Q8_0);
-    n_pack = QK8_0;
 #else
     cache_.setDtype(MLLM_TYPE_F32);
 #endif
@@ -24,38 +80,46 @@ CPUKVCache::CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max, int
 #endif
     cache_limit_ = cache_max;
     n_rep_ = n_rep;
+    block_size_ = block_size;
+}
+
+CPUKVCache::~CPUKVCache() {
+    releaseBlocks();
 }
 
 ErrorCode CPUKVCache::reshape(vector<shared_ptr<Tensor>> inputs,
                               vector<shared_ptr<Tensor>> outputs) {
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
+    if (block_size_ > 0) {
+        return reshapePaged(inputs, outputs);
+    }
+    if (sequenceBatch() != nullptr) {
+        MLLM_LOG_ERROR_STREAM << "[ERROR]: " << name() << ": continuous batching needs a paged KVCache (block_size > 0)" << std::endl;
+        exit(1);
+    }
     if (cache_seq_len_ < 0) {
         if (for_xnn_) cache_.setDtype(MLLM_TYPE_F32);
+        if (quantized()) {
+            assert(inputs[0]->dimension() % QK8_0 == 0);
+            n_rep_ = 1;
+        }
 
         cache_.reshape(inputs[0]->batch(), inputs[0]->head() * n_rep_, cache_limit_,
                        inputs[0]->dimension());
         cache_.setName(name() + ".Cache");
         cache_.alloc();
-
-        switch (cache_.dtype()) {
-        case MLLM_TYPE_F32:
-            memset(cache_.hostPtr<float>(), 0, cache_.count() * sizeof(float));
-            break;
-        case MLLM_TYPE_F16:
-            memset(cache_.hostPtr<mllm_fp16_t>(), 0, cache_.count() * sizeof(mllm_fp16_t));
-            break;
-        case MLLM_TYPE_Q8_0:
-            memset((char *)cache_.rawHostPtr(), 0, cache_.count() * sizeof(block_q8_0) / QK8_0);
-            break;
-        default:
-            break;
-        };
+        memset(cache_.rawHostPtr(), 0, cache_.cntSize());
         cache_seq_len_ = 0;
     }
+    if (evict_size_ > 0 && inputs[0]->sequence() + cache_seq_len_ > cache_limit_
+        && inputs[0]->sequence() <= cache_limit_ - sink_size_) {
+        int overflow = inputs[0]->sequence() + cache_seq_len_ - cache_limit_;
+        evict(std::max(overflow, std::min(evict_size_, cache_seq_len_ - sink_size_)));
+    }
     int sequence = inputs[0]->sequence() + cache_seq_len_;
 #ifdef LLAMAFILE_SGEMM
-    if (!for_xnn_ && sequence % n_pack != 0) sequence = ((sequence + (n_pack - 1)) / n_pack) * n_pack;
+    if (!for_xnn_ && !quantized() && sequence % n_pack != 0) sequence = ((sequence + (n_pack - 1)) / n_pack) * n_pack;
 #endif
     outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head() * n_rep_, sequence,
                         inputs[0]->dimension());
@@ -77,69 +141,72 @@ ErrorCode CPUKVCache::load(AbstructLoader &loader) {
 
 ErrorCode CPUKVCache::execute(vector<shared_ptr<Tensor>> inputs,
                               vector<shared_ptr<Tensor>> outputs) {
+    if (block_size_ > 0) {
+        return executePaged(inputs, outputs);
+    }
     int cache_seq_len_old = cache_seq_len_;
     cache_seq_len_ += inputs[0]->sequence();
-    if (n_rep_ > 1) {
+    if (quantized()) {
+        // the input keeps its own buffer, its rows are quantized into the cache
+        auto &input = inputs[0];
+        const int64_t H = input->head(), S = input->sequence();
+        parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+            const int b = (int)(i / (H * S));
+            const int h = (int)(i / S % H);
+            const int s = (int)(i % S);
+            storeCacheRow(&cache_, cache_seq_len_old + s, input.get(), s, b, h);
+        });
+    } else if (n_rep_ > 1) {
+        // the input is a view of cache heads [0, head), so heads are replicated from the last one down; rows
+        // (BSHD) and channels (BHDS) are independent, which gives one parallel job instead of one per head
         if (cache_.ctype() == BSHD) {
-            for (int b = 0; b < cache_.batch(); ++b) {
+            const int64_t S = cache_seq_len_ - cache_seq_len_old;
+            parallel_for(cache_.batch() * S, thread_count, [&](int64_t i) {
+                const int b = (int)(i / S);
+                const int seq = cache_seq_len_old + (int)(i % S);
                 for (int h = inputs[0]->head() - 1; h >= 0; --h) {
-#pragma omp parallel for collapse(2) num_threads(thread_count)
-                    for (int seq = cache_seq_len_old; seq < cache_seq_len_; ++seq) {
-                        for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
-                            auto cache_head = h * n_rep_ + i_rep;
-                            if (cache_.dtype() == MLLM_TYPE_F32) {
-                                auto src_ptr =
-                                    inputs[0]->ptrAt<float>(b, h, seq - cache_seq_len_old, 0);
-                                auto dest_ptr = cache_.ptrAt<float>(b, cache_head, seq, 0);
-                                int copy_size = cache_.dimension();
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
-                            } else if (cache_.dtype() == MLLM_TYPE_F16) {
-                                auto src_ptr =
-                                    inputs[0]->ptrAt<mllm_fp16_t>(b, h, seq - cache_seq_len_old, 0);
-                                auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, seq, 0);
-                                int copy_size = cache_.dimension();
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
-                            } else if (cache_.dtype() == MLLM_TYPE_Q8_0) {
-                                auto src_ptr =
-                                    (char *)inputs[0]->rawHostPtr() + inputs[0]->offset(b, h, seq - cache_seq_len_old, 0) * sizeof(block_q8_0) / QK8_0;
-                                auto dest_ptr = (char *)cache_.rawHostPtr() + cache_.offset(b, cache_head, seq, 0) * sizeof(block_q8_0) / QK8_0;
-                                int copy_size = cache_.dimension();
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(block_q8_0) / QK8_0);
-                            }
+                    for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
+                        auto cache_head = h * n_rep_ + i_rep;
+                        if (cache_.dtype() == MLLM_TYPE_F32) {
+                            auto src_ptr =
+                                inputs[0]->ptrAt<float>(b, h, seq - cache_seq_len_old, 0);
+                            auto dest_ptr = cache_.ptrAt<float>(b, cache_head, seq, 0);
+                            int copy_size = cache_.dimension();
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
+                        } else if (cache_.dtype() == MLLM_TYPE_F16) {
+                            auto src_ptr =
+                                inputs[0]->ptrAt<mllm_fp16_t>(b, h, seq - cache_seq_len_old, 0);
+                            auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, seq, 0);
+                            int copy_size = cache_.dimension();
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
                         }
                     }
                 }
-            }
+            });
         } else if (cache_.ctype() == BHDS) {
-            for (int b = 0; b < cache_.batch(); ++b) {
+            const int64_t D = inputs[0]->dimension();
+            parallel_for(cache_.batch() * D, thread_count, [&](int64_t i) {
+                const int b = (int)(i / D);
+                const int d = (int)(i % D);
                 for (int h = inputs[0]->head() - 1; h >= 0; --h) {
-#pragma omp parallel for collapse(2) num_threads(thread_count)
-                    for (int d = 0; d < inputs[0]->dimension(); ++d) {
-                        for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
-                            auto cache_head = h * n_rep_ + i_rep;
-                            if (cache_.dtype() == MLLM_TYPE_F32) {
-                                auto src_ptr = inputs[0]->ptrAt<float>(b, h, 0, d);
-                                auto dest_ptr =
-                                    cache_.ptrAt<float>(b, cache_head, cache_seq_len_old, d);
-                                int copy_size = cache_seq_len_ - cache_seq_len_old;
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
-                            } else if (cache_.dtype() == MLLM_TYPE_F16) {
-                                auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, 0, d);
-                                auto dest_ptr =
-                                    cache_.ptrAt<mllm_fp16_t>(b, cache_head, cache_seq_len_old, d);
-                                int copy_size = cache_seq_len_ - cache_seq_len_old;
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
-                            } else if (cache_.dtype() == MLLM_TYPE_Q8_0) {
-                                auto src_ptr =
-                                    (char *)inputs[0]->rawHostPtr() + inputs[0]->offset(b, h, 0, d) * sizeof(block_q8_0) / QK8_0;
-                                auto dest_ptr = (char *)cache_.rawHostPtr() + cache_.offset(b, cache_head, cache_seq_len_old, d) * sizeof(block_q8_0) / QK8_0;
-                                int copy_size = cache_.dimension();
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(block_q8_0) / QK8_0);
-                            }
+                    for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
+                        auto cache_head = h * n_rep_ + i_rep;
+                        if (cache_.dtype() == MLLM_TYPE_F32) {
+                            auto src_ptr = inputs[0]->ptrAt<float>(b, h, 0, d);
+                            auto dest_ptr =
+                                cache_.ptrAt<float>(b, cache_head, cache_seq_len_old, d);
+                            int copy_size = cache_seq_len_ - cache_seq_len_old;
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
+                        } else if (cache_.dtype() == MLLM_TYPE_F16) {
+                            auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, 0, d);
+                            auto dest_ptr =
+                                cache_.ptrAt<mllm_fp16_t>(b, cache_head, cache_seq_len_old, d);
+                            int copy_size = cache_seq_len_ - cache_seq_len_old;
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
                         }
                     }
                 }
-            }
+            });
         } else {
             std::cout << "ERROR Ctype in KVCcache;" << std::endl;
         }
@@ -154,13 +221,304 @@ ErrorCode CPUKVCache::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
 ErrorCode CPUKVCache::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
+    if (block_size_ > 0) {
+        return setUpPaged(inputs, outputs);
+    }
     outputs[0]->setDtype(cache_.dtype());
     outputs[0]->deepCopyFrom(cache_, false, {0, 0, cache_seq_len_ / cache_limit_, 0});
     if (inputs[0]->sequence() + cache_seq_len_ > cache_limit_) {
         outputs[0]->deepCopyFrom(cache_, false, {0, 0, cache_seq_len_ % cache_limit_ + 1, 0});
     }
+    if (quantized()) {
+        return MLLM_NO_ERROR;
+    }
     if (inputs[0]->masterTensor() == nullptr) { inputs[0]->free(); }
     inputs[0]->deepCopyFrom(cache_, false, {0, 0, cache_seq_len_ % cache_limit_, 0});
     return MLLM_NO_ERROR;
 }
-} // namespace mllm
\ No newline at end of file
+
+void CPUKVCache::evict(int n) {
+    // drop tokens [sink, sink + n) and compact the window in place so the cache stays in token order
+    const int window_begin = sink_size_ + n;
+    const int window_len = cache_seq_len_ - window_begin;
+    const DataType dtype = cache_.dtype();
+    const int type_size = cache_.dtypeSize();
+    if (window_len > 0) {
+        if (cache_.ctype() == BSHD) {
+            for (int b = 0; b < cache_.batch(); ++b) {
+                auto base = (char *)cache_.rawHostPtr();
+                memmove(base + DataTypeSize(dtype, cache_.offset(b, 0, sink_size_, 0)),
+                        base + DataTypeSize(dtype, cache_.offset(b, 0, window_begin, 0)),
+                        DataTypeSize(dtype, window_len * cache_.head() * cache_.dimension()));
+            }
+        } else if (cache_.ctype() == BHDS) {
+            assert(!quantized());
+            const int64_t H = cache_.head(), D = cache_.dimension();
+            parallel_for(cache_.batch() * H * D, thread_count, [&](int64_t i) {
+                const int b = (int)(i / (H * D));
+                const int h = (int)(i / D % H);
+                const int d = (int)(i % D);
+                auto base = (char *)cache_.rawHostPtr();
+                memmove(base + (size_t)cache_.offset(b, h, sink_size_, d) * type_size,
+                        base + (size_t)cache_.offset(b, h, window_begin, d) * type_size,
+                        (size_t)window_len * type_size);
+            });
+        }
+    }
+    cache_seq_len_ -= n;
+    // StreamingLLM: positions are re-based to the cache slots, so the kept keys move back by n
+    // and the RoPE of the following tokens continues from the new cache length.
+    if (!rope_ops_.empty()) {
+        auto rope = dynamic_cast<CPURoPE *>(rope_ops_[0]);
+        if (rope != nullptr && quantized()) {
+            // rotate a dequantized copy of the kept window and quantize it back
+            Tensor window(backend());
+            window.setDtype(MLLM_TYPE_F32);
+            window.reshape(cache_.batch(), cache_.head(), cache_seq_len_ - sink_size_, cache_.dimension());
+            window.alloc();
+            for (int b = 0; b < cache_.batch(); ++b) {
+                for (int h = 0; h < cache_.head(); ++h) {
+                    for (int s = 0; s < window.sequence(); ++s) {
+                        loadCacheRow(window.ptrAt<float>(b, h, s, 0), &cache_, sink_size_ + s, b, h);
+                    }
+                }
+            }
+            rope->rotateRows(window, 0, window.sequence(), -n);
+            for (int b = 0; b < cache_.batch(); ++b) {
+                for (int h = 0; h < cache_.head(); ++h) {
+                    for (int s = 0; s < window.sequence(); ++s) {
+                        storeCacheRow(&cache_, sink_size_ + s, &window, s, b, h);
+                    }
+                }
+            }
+        } else if (rope != nullptr) {
+            rope->rotateRows(cache_, sink_size_, cache_seq_len_, -n);
+        }
+        for (auto op : rope_ops_) {
+            auto rope_op = dynamic_cast<CPURoPE *>(op);
+            if (rope_op != nullptr) { rope_op->shiftPosition(-n); }
+        }
+    }
+}
+
+std::pair<Tensor *, int> CPUKVCache::cacheRow(int pos) {
+    if (block_size_ > 0) {
+        return {sequences_[0].blocks[pos / block_size_].get(), pos % block_size_};
+    }
+    return {&cache_, pos};
+}
+
+static void copyCacheRow(Tensor *dst, int dst_s, Tensor *src, int src_s, int b, int h) {
+    const DataType dtype = src->dtype();
+    const size_t type_size = src->dtypeSize();
+    const int dimension = src->dimension();
+    auto dst_ptr = (char *)dst->rawHostPtr();
+    auto src_ptr = (char *)src->rawHostPtr();
+    if ((src->ctype() == BSHD || src->ctype() == SBHD) && (dst->ctype() == BSHD || dst->ctype() == SBHD)) {
+        // byte offsets through DataTypeSize, quantized rows are whole blocks
+        memcpy(dst_ptr + DataTypeSize(dtype, dst->offset(b, h, dst_s, 0)),
+               src_ptr + DataTypeSize(dtype, src->offset(b, h, src_s, 0)), DataTypeSize(dtype, dimension));
+    } else {
+        // e.g. a V cache transposed to BHDS by the matmul
+        assert(dtype == MLLM_TYPE_F16 || dtype == MLLM_TYPE_F32);
+        for (int d = 0; d < dimension; ++d) {
+            memcpy(dst_ptr + (size_t)dst->offset(b, h, dst_s, d) * type_size,
+                   src_ptr + (size_t)src->offset(b, h, src_s, d) * type_size, type_size);
+        }
+    }
+}
+
+void CPUKVCache::rollbackCache(int n) {
+    n = std::min(n, std::max(cache_seq_len_, 0));
+    cache_seq_len_ -= n;
+    if (block_size_ > 0 && sequences_.count(0)) {
+        releaseSequence(sequences_[0], cache_seq_len_);
+    }
+    for (auto op : rope_ops_) {
+        auto rope_op = dynamic_cast<CPURoPE *>(op);
+        if (rope_op != nullptr) { rope_op->shiftPosition(-n); }
+    }
+}
+
+void CPUKVCache::copyCacheTo(int begin, int end, Tensor &rows) {
+    assert(begin >= 0 && end <= cache_seq_len_);
+    Tensor *first = cacheRow(begin).first;
+    rows.setDtype(first->dtype());
+    rows.reshape(first->batch(), first->head(), end - begin, first->dimension());
+    rows.alloc();
+    for (int pos = begin; pos < end; ++pos) {
+        auto row = cacheRow(pos);
+        for (int b = 0; b < rows.batch(); ++b) {
+            for (int h = 0; h < rows.head(); ++h) {
+                copyCacheRow(&rows, pos - begin, row.first, row.second, b, h);
+            }
+        }
+    }
+}
+
+void CPUKVCache::copyCacheFrom(int begin, Tensor &rows) {
+    if (rows.sequence() == 0) { return; }
+    const int old_len = cache_seq_len_;
+    const int len = begin + rows.sequence();
+    if (block_size_ > 0) {
+        auto &sequence = sequences_[0];
+        releaseSequence(sequence, begin);
+        reserveBlocks(sequence, len, rows.batch(), rows.head(), rows.dimension());
+        sequence.length = len;
+    } else if (cache_seq_len_ < 0 || len > cache_limit_ || cache_.head() != rows.head()) {
+        // the contiguous cache gets its shape and layout on the first run
+        MLLM_LOG_ERROR_STREAM << "[ERROR]: " << name() << ": cannot restore " << len << " tokens into this cache" << std::endl;
+        return;
+    }
+    assert(rows.dtype() == cacheRow(0).first->dtype());
+    for (int pos = begin; pos < len; ++pos) {
+        auto row = cacheRow(pos);
+        for (int b = 0; b < rows.batch(); ++b) {
+            for (int h = 0; h < rows.head(); ++h) {
+                copyCacheRow(row.first, row.second, &rows, pos - begin, b, h);
+            }
+        }
+    }
+    cache_seq_len_ = len;
+    for (auto op : rope_ops_) {
+        auto rope_op = dynamic_cast<CPURoPE *>(op);
+        if (rope_op != nullptr) { rope_op->shiftPosition(len - std::max(old_len, 0)); }
+    }
+}
+
+void CPUKVCache::releaseBlocks() {
+    for (auto &iter : sequences_) {
+        releaseSequence(iter.second);
+    }
+    sequences_.clear();
+}
+
+void CPUKVCache::releaseSequence(PagedSequence &sequence, int keep_tokens) {
+    // blocks past the first keep_tokens go back to the pool
+    const int keep_blocks = (keep_tokens + block_size_ - 1) / block_size_;
+    while ((int)sequence.block_table.size() > keep_blocks) {
+        pool_->freeBlock(sequence.block_table.back());
+        sequence.block_table.pop_back();
+        sequence.blocks.pop_back();
+    }
+    sequence.length = std::min(sequence.length, keep_tokens);
+}
+
+vector<shared_ptr<Tensor>> CPUKVCache::reserveBlocks(PagedSequence &sequence, int tokens, int batch, int head, int dimension) {
+    if (pool_ == nullptr) {
+        pool_ = &KVCachePool::get(backend(), DataTypeSize(cache_.dtype(), block_size_ * batch * head * dimension));
+    }
+    while ((int)sequence.block_table.size() * block_size_ < tokens) {
+        int block_id = pool_->allocBlock();
+        sequence.block_table.push_back(block_id);
+        // SBHD keeps the row offsets of a block independent of how many tokens it currently holds
+        auto block = std::make_shared<Tensor>(backend());
+        block->setName(name() + ".Cache.block" + std::to_string(block_id));
+        block->setDtype(cache_.dtype());
+        block->setCtype(SBHD);
+        block->reshape(batch, head, block_size_, dimension);
+        block->setExternalHostPtr(pool_->blockPtr(block_id));
+        sequence.blocks.push_back(block);
+    }
+    vector<shared_ptr<Tensor>> filled;
+    for (int i = 0; i * block_size_ < tokens; ++i) {
+        sequence.blocks[i]->reshape(batch, head, std::min(block_size_, tokens - i * block_size_), dimension);
+        filled.push_back(sequence.blocks[i]);
+    }
+    return filled;
+}
+
+const SequenceBatch *CPUKVCache::sequenceBatch() {
+    auto cpu_backend = dynamic_cast<CPUBackend *>(backend());
+    if (cpu_backend == nullptr || cpu_backend->sequenceBatch().empty()) {
+        return nullptr;
+    }
+    return &cpu_backend->sequenceBatch();
+}
+
+ErrorCode CPUKVCache::reshapePaged(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    if (cache_seq_len_ < 0) {
+        cache_seq_len_ = 0;
+    }
+    // no n_pack rounding and no head replication: the paged matmul maps q heads onto kv heads
+    int sequence = inputs[0]->sequence() + cache_seq_len_;
+    if (auto batch = sequenceBatch()) {
+        // the output is every slot of the step concatenated in order of first appearance
+        sequence = 0;
+        for (auto &slot : batch->slotLengths()) {
+            sequence += slot.second;
+        }
+    }
+    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), sequence, inputs[0]->dimension());
+    return MLLM_NO_ERROR;
+}
+
+ErrorCode CPUKVCache::setUpPaged(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    const int batch = inputs[0]->batch();
+    const int head = inputs[0]->head();
+    const int dimension = inputs[0]->dimension();
+    vector<shared_ptr<Tensor>> filled;
+    if (auto seq_batch = sequenceBatch()) {
+        assert(batch == 1 && inputs[0]->sequence() == seq_batch->rows());
+        auto slot_lengths = seq_batch->slotLengths();
+        // slots that are not part of the step have finished, their blocks go back to the pool
+        for (auto iter = sequences_.begin(); iter != sequences_.end();) {
+            bool active = false;
+            for (auto &slot : slot_lengths) {
+                active = active || slot.first == iter->first;
+            }
+            if (active) {
+                ++iter;
+            } else {
+                releaseSequence(iter->second);
+                iter = sequences_.erase(iter);
+            }
+        }
+        int row = 0;
+        for (auto &slot : slot_lengths) {
+            auto &sequence = sequences_[slot.first];
+            // the step writes from its first position on, anything cached past it is dropped
+            releaseSequence(sequence, seq_batch->positions[row]);
+            row += slot.second - seq_batch->positions[row];
+            auto blocks = reserveBlocks(sequence, slot.second, batch, head, dimension);
+            filled.insert(filled.end(), blocks.begin(), blocks.end());
+        }
+    } else {
+        filled = reserveBlocks(sequences_[0], inputs[0]->sequence() + cache_seq_len_, batch, head, dimension);
+    }
+    outputs[0]->setDtype(cache_.dtype());
+    outputs[0]->addTensors(filled, SEQUENCE);
+    return MLLM_NO_ERROR;
+}
+
+ErrorCode CPUKVCache::executePaged(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    auto &input = inputs[0];
+    auto seq_batch = sequenceBatch();
+    vector<PagedSequence *> row_sequences(input->sequence());
+    vector<int> row_positions(input->sequence());
+    for (int s = 0; s < input->sequence(); ++s) {
+        if (seq_batch != nullptr) {
+            row_sequences[s] = &sequences_[seq_batch->slots[s]];
+            row_positions[s] = seq_batch->positions[s];
+        } else {
+            row_sequences[s] = &sequences_[0];
+            row_positions[s] = cache_seq_len_ + s;
+        }
+    }
+    if (seq_batch == nullptr) {
+        cache_seq_len_ += input->sequence();
+    }
+    const int64_t H = input->head(), S = input->sequence();
+    parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+        const int b = (int)(i / (H * S));
+        const int h = (int)(i / S % H);
+        const int s = (int)(i % S);
+        const int pos = row_positions[s];
+        storeCacheRow(row_sequences[s]->blocks[pos / block_size_].get(), pos % block_size_, input.get(), s, b, h);
+    });
+    for (int s = 0; s < input->sequence(); ++s) {
+        row_sequences[s]->length = std::max(row_sequences[s]->length, row_positions[s] + 1);
+    }
+    return MLLM_NO_ERROR;
+}
+} // namespace mllm
@@ -5,13 +5,15 @@
 #include "Op.hpp"
 #include "../CPUBackend.hpp"
 #include "ParamLoader.hpp"
+#include "memory/KVCachePool.hpp"
+#include <map>
 
 namespace mllm {
 
 class CPUKVCache final : public Op {
 public:
-    CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max = 100, int threadCount = 4);
-    virtual ~CPUKVCache() = default;
+    CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max = 100, int threadCount = 4, int block_size = 0);
+    virtual ~CPUKVCache();
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode load(AbstructLoader &loader) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
@@ -25,11 +27,34 @@ public:
     }
     void clearCache() override {
         cache_seq_len_ = 0;
+        releaseBlocks();
     }
 
     void setForXnn(bool for_xnn) {
         for_xnn_ = for_xnn;
     }
+    /**
+     * \brief store K/V as `dtype`: F16 (default), F32, or Q8_0 / Q4_0 quantized row by row on append.
+     * A quantized cache keeps kv heads only (no n_rep replication) and is read by the SDPA op.
+     */
+    void setCacheDtype(DataType dtype) {
+        assert(dtype == MLLM_TYPE_F16 || dtype == MLLM_TYPE_F32 || dtype == MLLM_TYPE_Q8_0 || dtype == MLLM_TYPE_Q4_0);
+        cache_.setDtype(dtype);
+    }
+    /**
+     * \brief keep the first sink_size tokens and drop the oldest of the rest, evict_size at a time,
+     * when the cache is full instead of exiting (StreamingLLM). evict_size <= 0 disables eviction.
+     */
+    void setEviction(int sink_size, int evict_size) {
+        sink_size_ = sink_size;
+        evict_size_ = evict_size;
+    }
+    void bindRoPE(vector<Op *> rope_ops) override {
+        rope_ops_ = rope_ops;
+    }
+    void rollbackCache(int n) override;
+    void copyCacheTo(int begin, int end, Tensor &rows) override;
+    void copyCacheFrom(int begin, Tensor &rows) override;
 
 private:
     int thread_count = 4;
@@ -39,6 +64,35 @@ private:
 
     bool for_xnn_ = false;
     int cache_limit_;
+
+    int sink_size_ = 0;
+    int evict_size_ = 0;
+    vector<Op *> rope_ops_;
+    bool quantized() const {
+        return cache_.dtype() == MLLM_TYPE_Q8_0 || cache_.dtype() == MLLM_TYPE_Q4_0;
+    }
+    void evict(int n);
+    // where token pos of the single-sequence cache lives: (tensor, row)
+    std::pair<Tensor *, int> cacheRow(int pos);
+
+    // paged mode (block_size_ > 0): K/V of kv heads only are kept in fixed-size blocks of the cache dtype drawn from
+    // a shared KVCachePool, and the output is an AggregatedTensor of the filled blocks along SEQUENCE.
+    // Each KV slot of a continuous batch owns its own blocks; slot 0 is the single-sequence cache.
+    struct PagedSequence {
+        vector<int> block_table;
+        vector<shared_ptr<Tensor>> blocks;
+        int length = 0;
+    };
+    int block_size_ = 0;
+    KVCachePool *pool_ = nullptr;
+    std::map<int, PagedSequence> sequences_;
+    void releaseBlocks();
+    void releaseSequence(PagedSequence &sequence, int keep_tokens = 0);
+    vector<shared_ptr<Tensor>> reserveBlocks(PagedSequence &sequence, int tokens, int batch, int head, int dimension);
+    const SequenceBatch *sequenceBatch();
+    ErrorCode reshapePaged(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs);
+    ErrorCode setUpPaged(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs);
+    ErrorCode executePaged(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs);
 };
 
 class CPUKVCacheCreator : public CPUBackend::Creator {
@@ -47,8 +101,15 @@ public:
         int n_rep = (int)op_param["n_rep"];
         int cache_max = (int)op_param["cache_max"];
         bool for_xnn = (bool)op_param["for_xnn"];
-        auto ret = new CPUKVCache(bn, name, n_rep, cache_max, threadCount);
+        int block_size = (op_param.find("block_size") == op_param.end()) ? 0 : (int)op_param["block_size"];
+        auto ret = new CPUKVCache(bn, name, n_rep, cache_max, threadCount, block_size);
         ret->setForXnn(for_xnn);
+        if (op_param.find("cache_dtype") != op_param.end()) {
+            ret->setCacheDtype((DataType)op_param["cache_dtype"]);
+        }
+        if (op_param.find("evict_size") != op_param.end()) {
+            ret->setEviction((int)op_param["sink_size"], (int)op_param["evict_size"]);
+        }
         return ret;
     }
 };
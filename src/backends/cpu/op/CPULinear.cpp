@@ -1,6 +1,8 @@
 
 #include "CPULinear.hpp"
 #include "Types.hpp"
+#include "ImportanceMatrix.hpp"
+#include "../compute/VecDotType.hpp"
 #include <iostream>
 
 namespace mllm {
@@ -77,6 +79,14 @@ ErrorCode CPULinear::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
     if (inputs[0]->count() == 0) {
         return Op::execute(inputs, outputs);
     }
+    if (ImportanceMatrix::enabled() && inputs[0]->dtype() == MLLM_TYPE_F32 && inputs[0]->ctype() == BSHD) {
+        auto *input = inputs[0].get();
+        const int64_t row_stride = input->sequence() > 1 ? input->offset(0, 0, 1, 0) - input->offset(0, 0, 0, 0) : 0;
+        for (int b = 0; b < input->batch(); b++) {
+            ImportanceMatrix::record(weight_.name(), input->hostPtr<float>() + input->offset(b, 0, 0, 0),
+                                     input->sequence(), in_features_, row_stride);
+        }
+    }
     // TODO: Q8_0 KVCache can not use!!
     if (outputs[0]->dtype() == MLLM_TYPE_Q8_0) {
         auto tmp_out = std::make_shared<Tensor>(outputs[0]->backend());
@@ -92,29 +102,27 @@ ErrorCode CPULinear::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
         tmp_out->alloc();
         mat_mul(inputs[0].get(), &weight_, tmp_out.get(), support_bias_, &bias_, false, true, thread_count);
         if (tmp_out->ctype() == BSHD) {
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-            for (int b = 0; b < tmp_out->batch(); b++) {
-                for (int h = 0; h < tmp_out->head(); h++) {
-                    for (int s = 0; s < tmp_out->sequence(); s++) {
-                        quantize_row_q8_0(tmp_out->hostPtr<float>() + tmp_out->offset(b, h, s, 0),
-                                          (char *)outputs[0]->rawHostPtr()
-                                              + outputs[0]->offset(b, h, s, 0) * sizeof(block_q8_0) / QK8_0,
-                                          tmp_out->dimension());
-                    }
-                }
-            }
+            const int64_t H = tmp_out->head(), S = tmp_out->sequence();
+            parallel_for(tmp_out->batch() * H * S, thread_count, [&](int64_t i) {
+                const int b = (int)(i / (H * S));
+                const int h = (int)(i / S % H);
+                const int s = (int)(i % S);
+                quantize_row_q8_0(tmp_out->hostPtr<float>() + tmp_out->offset(b, h, s, 0),
+                                  (char *)outputs[0]->rawHostPtr()
+                                      + outputs[0]->offset(b, h, s, 0) * sizeof(block_q8_0) / QK8_0,
+                                  tmp_out->dimension());
+            });
         } else { // BHDS
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-            for (int b = 0; b < tmp_out->batch(); b++) {
-                for (int h = 0; h < tmp_out->head(); h++) {
-                    for (int d = 0; d < tmp_out->dimension(); d++) {
-                        quantize_row_q8_0(tmp_out->hostPtr<float>() + tmp_out->offset(b, h, 0, d),
-                                          (char *)outputs[0]->rawHostPtr()
-                                              + outputs[0]->offset(b, h, 0, d) * sizeof(block_q8_0) / QK8_0,
-                                          outputs[0]->sequence());
-                    }
-                }
-            }
+            const int64_t H = tmp_out->head(), D = tmp_out->dimension();
+            parallel_for(tmp_out->batch() * H * D, thread_count, [&](int64_t i) {
+                const int b = (int)(i / (H * D));
+                const int h = (int)(i / D % H);
+                const int d = (int)(i % D);
+                quantize_row_q8_0(tmp_out->hostPtr<float>() + tmp_out->offset(b, h, 0, d),
+                                  (char *)outputs[0]->rawHostPtr()
+                                      + outputs[0]->offset(b, h, 0, d) * sizeof(block_q8_0) / QK8_0,
+                                  outputs[0]->sequence());
+            });
         }
     } else {
         mat_mul(inputs[0].get(), &weight_, outputs[0].get(), support_bias_, &bias_, false, true, thread_count);
@@ -147,6 +155,15 @@ ErrorCode CPULinear::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
     //    printf("exec time: %ld us\n", end - start);
     return Op::execute(inputs, outputs);
 }
+DataType CPULinear::quantizedInputType() const {
+    const DataType vec_dot_type = type_traits[weight_.dtype()].vec_dot_type;
+    // repacked weights (gemv) take their input interleaved, not row by row
+    if (vec_dot_type == MLLM_TYPE_F32 || vec_dot_type == MLLM_TYPE_F16 || type_traits[vec_dot_type].from_float == nullptr
+        || type_traits[weight_.dtype()].gemv != nullptr) {
+        return MLLM_TYPE_COUNT;
+    }
+    return vec_dot_type;
+}
 ErrorCode CPULinear::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     weight_.free();
     if (support_bias_) {
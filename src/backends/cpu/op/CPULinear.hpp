@@ -17,6 +17,11 @@ public:
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
 
+    /**
+     * \brief the quantized dtype an input can already be in so that mat_mul reads it as is,
+     * MLLM_TYPE_COUNT if the input has to be float.
+     */
+    DataType quantizedInputType() const;
     Tensor &weight() {
         return weight_;
     }
@@ -0,0 +1,206 @@
+#include "CPUMergedLinear.hpp"
+#include "Types.hpp"
+#include "ImportanceMatrix.hpp"
+#include "../compute/VecDotType.hpp"
+#include <cstring>
+#include <numeric>
+
+namespace mllm {
+
+CPUMergedLinear::CPUMergedLinear(Backend *bn, string opName, int in_features, vector<int> out_features, bool bias, int threadCount) :
+    thread_count(threadCount),
+    Op(bn, opName) {
+    in_features_ = in_features;
+    out_features_ = std::move(out_features);
+    support_bias_ = bias;
+    size_t begin = 0;
+    for (size_t end = opName.find('+'); begin <= opName.size(); end = opName.find('+', begin)) {
+        if (end == string::npos) { end = opName.size(); }
+        part_names_.push_back(opName.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    assert(part_names_.size() == out_features_.size());
+    weight_.setBackend(bn);
+    bias_.setBackend(bn);
+    merged_out_.setBackend(bn);
+    quantized_in_.setBackend(bn);
+}
+
+ErrorCode CPUMergedLinear::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs.size() == 1);
+    assert(outputs.size() == out_features_.size());
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (inputs[0]->count() == 0) {
+            outputs[i]->reshape(0, 0, 0, 0);
+            continue;
+        }
+        assert(inputs[0]->head() == 1);
+        assert(in_features_ == inputs[0]->dimension());
+        outputs[i]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), out_features_[i]);
+    }
+    return Op::reshape(inputs, outputs);
+}
+
+ErrorCode CPUMergedLinear::load(AbstructLoader &loader) {
+    vector<DataType> dtypes;
+    for (const auto &part : part_names_) { dtypes.push_back(loader.getDataType(part + ".weight")); }
+    merged_ = std::all_of(dtypes.begin(), dtypes.end(), [&](DataType t) { return t == dtypes[0]; });
+    const int total = std::accumulate(out_features_.begin(), out_features_.end(), 0);
+    if (merged_) {
+        weight_.setName(name() + ".weight");
+        weight_.reshape(1, 1, total, in_features_);
+        weight_.setDtype(dtypes[0] != MLLM_TYPE_COUNT ? dtypes[0] : Op::noLoadWeightsDtype());
+        weight_.alloc();
+        if (support_bias_) {
+            bias_.setName(name() + ".bias");
+            bias_.reshape(1, 1, 1, total);
+            bias_.setDtype(MLLM_TYPE_F32);
+            bias_.alloc();
+        }
+        if (dtypes[0] != MLLM_TYPE_COUNT) {
+            // rows are independent in every weight format (repacked ones interleave whole groups of rows),
+            // so the parts are copied one after the other
+            size_t weight_offset = 0;
+            size_t bias_offset = 0;
+            for (size_t i = 0; i < part_names_.size(); ++i) {
+                Tensor part(backend());
+                part.setName(part_names_[i] + ".weight");
+                part.reshape(1, 1, out_features_[i], in_features_);
+                part.setDtype(weight_.dtype());
+                part.alloc();
+                loader.load(&part);
+                memcpy((char *)weight_.rawHostPtr() + weight_offset, part.rawHostPtr(), part.cntSize());
+                weight_offset += part.cntSize();
+                part.free();
+                if (support_bias_) {
+                    const size_t bias_size = out_features_[i] * sizeof(float);
+                    if (loader.getDataType(part_names_[i] + ".bias") != MLLM_TYPE_COUNT) {
+                        Tensor part_bias(backend());
+                        part_bias.setName(part_names_[i] + ".bias");
+                        part_bias.reshape(1, 1, 1, out_features_[i]);
+                        part_bias.setDtype(MLLM_TYPE_F32);
+                        part_bias.alloc();
+                        loader.load(&part_bias);
+                        memcpy((char *)bias_.rawHostPtr() + bias_offset, part_bias.rawHostPtr(), bias_size);
+                        part_bias.free();
+                    } else {
+                        // a part without a bias adds nothing
+                        memset((char *)bias_.rawHostPtr() + bias_offset, 0, bias_size);
+                    }
+                    bias_offset += bias_size;
+                }
+            }
+        }
+        return Op::load(loader);
+    }
+    for (size_t i = 0; i < part_names_.size(); ++i) {
+        auto weight = std::make_shared<Tensor>(backend());
+        weight->setName(part_names_[i] + ".weight");
+        weight->reshape(1, 1, out_features_[i], in_features_);
+        weight->setDtype(dtypes[i] != MLLM_TYPE_COUNT ? dtypes[i] : Op::noLoadWeightsDtype());
+        weight->alloc();
+        if (dtypes[i] != MLLM_TYPE_COUNT) { loader.load(weight); }
+        weights_.push_back(weight);
+        auto bias = std::make_shared<Tensor>(backend());
+        if (support_bias_) {
+            bias->setName(part_names_[i] + ".bias");
+            bias->reshape(1, 1, 1, out_features_[i]);
+            bias->setDtype(MLLM_TYPE_F32);
+            bias->alloc();
+            if (loader.getDataType(bias->name()) != MLLM_TYPE_COUNT) {
+                loader.load(bias);
+            } else {
+                memset(bias->rawHostPtr(), 0, bias->cntSize());
+            }
+        }
+        biases_.push_back(bias);
+    }
+    return Op::load(loader);
+}
+
+ErrorCode CPUMergedLinear::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    auto *input = inputs[0].get();
+    if (input->count() == 0) {
+        return Op::execute(inputs, outputs);
+    }
+    const int B = input->batch(), S = input->sequence();
+    if (ImportanceMatrix::enabled() && input->dtype() == MLLM_TYPE_F32 && input->ctype() == BSHD) {
+        const int64_t row_stride = S > 1 ? input->offset(0, 0, 1, 0) - input->offset(0, 0, 0, 0) : 0;
+        for (const auto &part : part_names_) {
+            for (int b = 0; b < B; b++) {
+                ImportanceMatrix::record(part + ".weight", input->hostPtr<float>() + input->offset(b, 0, 0, 0),
+                                         S, in_features_, row_stride);
+            }
+        }
+    }
+    if (merged_) {
+        const int total = weight_.sequence();
+        merged_out_.reshape(B, 1, S, total);
+        merged_out_.setDtype(MLLM_TYPE_F32);
+        merged_out_.alloc();
+        mat_mul(input, &weight_, &merged_out_, support_bias_, &bias_, false, true, thread_count);
+        // each row of the wide output holds the rows of all parts side by side
+        const int64_t parts = (int64_t)outputs.size();
+        vector<int> column(parts, 0);
+        for (int64_t p = 1; p < parts; ++p) { column[p] = column[p - 1] + out_features_[p - 1]; }
+        parallel_for((int64_t)B * S * parts, thread_count, [&](int64_t i) {
+            const int b = (int)(i / (S * parts)), s = (int)(i / parts % S), p = (int)(i % parts);
+            memcpy(outputs[p]->ptrAt<float>(b, 0, s, 0), merged_out_.ptrAt<float>(b, 0, s, column[p]),
+                   out_features_[p] * sizeof(float));
+        });
+        return Op::execute(inputs, outputs);
+    }
+    // the parts could not be concatenated, but they can still share the quantized input
+    Tensor *x = input;
+    const DataType vec_dot_type = quantizedInputType();
+    if (vec_dot_type != MLLM_TYPE_COUNT && input->dtype() == MLLM_TYPE_F32 && input->ctype() == BSHD) {
+        quantized_in_.reshape(B, 1, S, in_features_);
+        quantized_in_.setDtype(vec_dot_type);
+        quantized_in_.alloc();
+        auto from_float = type_traits[vec_dot_type].from_float;
+        parallel_for((int64_t)B * S, thread_count, [&](int64_t i) {
+            const int b = (int)(i / S), s = (int)(i % S);
+            from_float(input->hostPtr<float>() + input->offset(b, 0, s, 0),
+                       (char *)quantized_in_.rawHostPtr()
+                           + quantized_in_.offset(b, 0, s, 0) * type_size(vec_dot_type) / blck_size(vec_dot_type),
+                       in_features_);
+        });
+        x = &quantized_in_;
+    }
+    for (size_t p = 0; p < outputs.size(); ++p) {
+        mat_mul(x, weights_[p].get(), outputs[p].get(), support_bias_, biases_[p].get(), false, true, thread_count);
+    }
+    return Op::execute(inputs, outputs);
+}
+
+DataType CPUMergedLinear::quantizedInputType() const {
+    vector<DataType> weight_types;
+    if (merged_) {
+        weight_types.push_back(weight_.dtype());
+    } else {
+        for (const auto &weight : weights_) { weight_types.push_back(weight->dtype()); }
+    }
+    DataType result = MLLM_TYPE_COUNT;
+    for (size_t i = 0; i < weight_types.size(); ++i) {
+        const DataType vec_dot_type = type_traits[weight_types[i]].vec_dot_type;
+        // see CPULinear::quantizedInputType
+        if (vec_dot_type == MLLM_TYPE_F32 || vec_dot_type == MLLM_TYPE_F16 || type_traits[vec_dot_type].from_float == nullptr
+            || type_traits[weight_types[i]].gemv != nullptr || (i > 0 && vec_dot_type != result)) {
+            return MLLM_TYPE_COUNT;
+        }
+        result = vec_dot_type;
+    }
+    return result;
+}
+
+ErrorCode CPUMergedLinear::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    weight_.free();
+    bias_.free();
+    for (auto &weight : weights_) { weight->free(); }
+    for (auto &bias : biases_) { bias->free(); }
+    merged_out_.free();
+    quantized_in_.free();
+    return Op::free(inputs, outputs);
+}
+
+} // namespace mllm
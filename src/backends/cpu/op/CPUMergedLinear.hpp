@@ -0,0 +1,70 @@
+#ifndef MLLM_CPUMERGEDLINEAR_H
+#define MLLM_CPUMERGEDLINEAR_H
+
+#include "Op.hpp"
+#include "../CPUBackend.hpp"
+#include "../compute/Matmul.hpp"
+
+namespace mllm {
+
+class Tensor;
+/**
+ * \brief Several Linears reading the same input (q/k/v, gate/up), one output per part.
+ *
+ * The op name is the names of the parts joined by '+', and each part loads `<part name>.weight` (and `.bias`).
+ * When all parts share a dtype their weights are concatenated into one tensor at load, so the input is
+ * quantized once and a single mat_mul computes every part; its rows are then split into the outputs.
+ * Otherwise (e.g. mixed quantization types) the parts keep their own weights and only share the quantized input.
+ */
+class CPUMergedLinear final : public Op {
+public:
+    CPUMergedLinear(Backend *bn, string opName, int in_features, vector<int> out_features, bool bias, int threadCount);
+    virtual ~CPUMergedLinear() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode load(AbstructLoader &loader) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+
+    /**
+     * \brief see CPULinear::quantizedInputType, MLLM_TYPE_COUNT unless all parts agree.
+     */
+    DataType quantizedInputType() const;
+    /**
+     * \return true if the weights of all parts were concatenated into one tensor.
+     */
+    bool merged() const {
+        return merged_;
+    }
+
+private:
+    int in_features_;
+    vector<int> out_features_;
+    vector<string> part_names_;
+    bool support_bias_;
+    int thread_count = 4;
+    bool merged_ = false;
+    Tensor weight_; // [sum of out_features, in_features] when merged
+    Tensor bias_;   // [1, sum of out_features] when merged
+    vector<shared_ptr<Tensor>> weights_; // one per part when not merged
+    vector<shared_ptr<Tensor>> biases_;
+    Tensor merged_out_;
+    Tensor quantized_in_;
+};
+
+class CPUMergedLinearCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        int in_features = op_param["in_features"];
+        int part_num = op_param["part_num"];
+        vector<int> out_features;
+        for (int i = 0; i < part_num; ++i) {
+            out_features.push_back((int)op_param["out_features_" + std::to_string(i)]);
+        }
+        int bias = op_param["bias"];
+        return new CPUMergedLinear(bn, name, in_features, out_features, (bool)bias, threadCount);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPUMERGEDLINEAR_H
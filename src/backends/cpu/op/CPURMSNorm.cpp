@@ -3,6 +3,8 @@
 #include "Tensor.hpp"
 #include "Timing.hpp"
 #include "../compute/VecDot.hpp"
+#include "../compute/VecDotType.hpp"
+#include "../compute/Arithmetic.hpp"
 
 namespace mllm {
 
@@ -28,47 +30,53 @@ ErrorCode CPURMSNorm::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_p
 }
 
 ErrorCode CPURMSNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    // two inputs: normalize their sum and also write the sum to outputs[1] (a residual add fused by OpFusion).
+    // an output in a quantized dtype gets every row quantized right after it is normalized.
     auto input = inputs[0];
+    const bool residual = inputs.size() > 1;
+    auto &output = outputs[0];
+    const DataType out_dtype = output->dtype();
+    auto from_float = out_dtype == MLLM_TYPE_F32 ? nullptr : type_traits[out_dtype].from_float;
     int batch = input->batch();
     int dim = input->dimension();
     int seq = input->sequence();
     int head = input->head();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                double sum_squares = 0.0F;
-                // sum
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    sum_squares += (double)value * value;
-                }
-                const float mean = sum_squares / dim;
-                const float rms = 1.0f / sqrtf(mean + epsilon_);
-
-                memcpy(outputs[0]->ptrAt<float>(n, h, s, 0),
-                       inputs[0]->ptrAt<float>(n, h, s, 0),
-                       dim * sizeof(float));
-                vec_scale_f32(dim, outputs[0]->ptrAt<float>(n, h, s, 0), rms);
-            }
+    const float *weight = weight_.hostPtr<float>();
+    parallel_for((int64_t)head * batch * seq, thread_count, [&](int64_t i) {
+        const int h = (int)(i / (batch * seq));
+        const int n = (int)(i / seq % batch);
+        const int s = (int)(i % seq);
+        const float *x = input->ptrAt<float>(n, h, s, 0);
+        if (residual) {
+            float *sum = outputs[1]->ptrAt<float>(n, h, s, 0);
+            mllm_add_fp32(inputs[0]->ptrAt<float>(n, h, s, 0), inputs[1]->ptrAt<float>(n, h, s, 0), sum, dim);
+            x = sum;
         }
-    }
+        double sum_squares = 0.0F;
+        // sum
+        for (int d = 0; d < dim; d++) {
+            sum_squares += (double)x[d] * x[d];
+        }
+        const float mean = sum_squares / dim;
+        const float rms = 1.0f / sqrtf(mean + epsilon_);
 
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                for (int d = 0; d < dim; d++) {
-                    float weight = weight_.dataAt<float>(0, 0, 0, d);
-                    if (add_unit_offset_) {
-                        *outputs[0]->ptrAt<float>(n, h, s, d) *= (1 + weight);
-                    } else {
-                        *outputs[0]->ptrAt<float>(n, h, s, d) *= (weight);
-                    }
-                }
-            }
+        thread_local std::vector<float> row;
+        float *y;
+        if (from_float != nullptr) {
+            row.resize(dim);
+            y = row.data();
+        } else {
+            y = output->ptrAt<float>(n, h, s, 0);
         }
-    }
+        memcpy(y, x, dim * sizeof(float));
+        vec_scale_f32(dim, y, rms);
+        for (int d = 0; d < dim; d++) {
+            y[d] *= add_unit_offset_ ? (1 + weight[d]) : weight[d];
+        }
+        if (from_float != nullptr) {
+            from_float(y, (char *)output->rawHostPtr() + output->offset(n, h, s, 0) * type_size(out_dtype) / blck_size(out_dtype), dim);
+        }
+    });
     return Op::execute(inputs, outputs);
 }
 ErrorCode CPURMSNorm::load(AbstructLoader &loader) {
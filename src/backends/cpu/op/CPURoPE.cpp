@@ -120,28 +120,27 @@ ErrorCode CPURoPE::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
 void CPURoPE::rope_llama(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) { // sequance
-                for (int d = 0; d < partial_dimension; d += 2) {
-                    float in_value = input->dataAt<float>(n, h, s, d);
-                    float in_value_2 = input->dataAt<float>(n, h, s, d + 1);
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
-                    auto value = in_value * cos_value - in_value_2 * sin_value;
-                    auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                    if (out_dtype == MLLM_TYPE_F32) {
-                        output->setDataAt<float>(n, h, s, d, value);
-                        output->setDataAt<float>(n, h, s, d + 1, value2);
-                    } else if (out_dtype == MLLM_TYPE_F16) {
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d + 1, MLLM_FP32_TO_FP16(value2));
-                    }
-                }
+    const int64_t H = input->head(), S = input->sequence();
+    parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+        const int n = (int)(i / (H * S));
+        const int h = (int)(i / S % H);
+        const int s = (int)(i % S);
+        for (int d = 0; d < partial_dimension; d += 2) {
+            float in_value = input->dataAt<float>(n, h, s, d);
+            float in_value_2 = input->dataAt<float>(n, h, s, d + 1);
+            float sin_value = sin_[position(s)][d];
+            float cos_value = cos_[position(s)][d];
+            auto value = in_value * cos_value - in_value_2 * sin_value;
+            auto value2 = in_value * sin_value + in_value_2 * cos_value;
+            if (out_dtype == MLLM_TYPE_F32) {
+                output->setDataAt<float>(n, h, s, d, value);
+                output->setDataAt<float>(n, h, s, d + 1, value2);
+            } else if (out_dtype == MLLM_TYPE_F16) {
+                output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                output->setDataAt<mllm_fp16_t>(n, h, s, d + 1, MLLM_FP32_TO_FP16(value2));
             }
         }
-    }
+    });
 }
 void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
     auto out_dtype = output->dtype();
@@ -150,185 +149,178 @@ void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
     assert(partial_dimension % 2 == 0);
     if (output->ctype() == BSHD) {
         if (input->dtype() == MLLM_TYPE_F16) {
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-            for (int n = 0; n < input->batch(); ++n) {
-                for (int h = 0; h < input->head(); ++h) {
-                    for (int s = 0; s < input->sequence(); ++s) { // sequance
-                        for (int d = 0; d < partial_dimension / 2; ++d) {
-                            auto v = input->ptrAt<mllm_fp16_t>(n, h, s, d);
-                            auto o = output->ptrAt<mllm_fp16_t>(n, h, s, d);
-                            float in_value = static_cast<float>(v[0]);
-                            float in_value_2 = static_cast<float>(v[half]);
-                            float sin_value = sin_[s + h_cnt_][d];
-                            float cos_value = cos_[s + h_cnt_][d];
-                            auto value = in_value * cos_value - in_value_2 * sin_value;
-                            auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                            o[0] = MLLM_FP32_TO_FP16(value);
-                            o[half] = MLLM_FP32_TO_FP16(value2);
-                        }
-                    }
+            const int64_t H = input->head(), S = input->sequence();
+            parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+                const int n = (int)(i / (H * S));
+                const int h = (int)(i / S % H);
+                const int s = (int)(i % S);
+                for (int d = 0; d < partial_dimension / 2; ++d) {
+                    auto v = input->ptrAt<mllm_fp16_t>(n, h, s, d);
+                    auto o = output->ptrAt<mllm_fp16_t>(n, h, s, d);
+                    float in_value = static_cast<float>(v[0]);
+                    float in_value_2 = static_cast<float>(v[half]);
+                    float sin_value = sin_[position(s)][d];
+                    float cos_value = cos_[position(s)][d];
+                    auto value = in_value * cos_value - in_value_2 * sin_value;
+                    auto value2 = in_value * sin_value + in_value_2 * cos_value;
+                    o[0] = MLLM_FP32_TO_FP16(value);
+                    o[half] = MLLM_FP32_TO_FP16(value2);
                 }
-            }
+            });
 
         } else {
             if (out_dtype == MLLM_TYPE_F32) {
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-                for (int n = 0; n < input->batch(); ++n) {
-                    for (int h = 0; h < input->head(); ++h) {
-                        for (int s = 0; s < input->sequence(); ++s) { // sequance
-                            for (int d = 0; d < partial_dimension / 2; ++d) {
-                                auto v = input->ptrAt<float>(n, h, s, d);
-                                auto o = output->ptrAt<float>(n, h, s, d);
-                                float in_value = v[0];
-                                float in_value_2 = v[half];
-                                float sin_value = sin_[s + h_cnt_][d];
-                                float cos_value = cos_[s + h_cnt_][d];
-                                auto value = in_value * cos_value - in_value_2 * sin_value;
-                                auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                                o[0] = value;
-                                o[half] = value2;
-                            }
-                        }
+                const int64_t H = input->head(), S = input->sequence();
+                parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+                    const int n = (int)(i / (H * S));
+                    const int h = (int)(i / S % H);
+                    const int s = (int)(i % S);
+                    for (int d = 0; d < partial_dimension / 2; ++d) {
+                        auto v = input->ptrAt<float>(n, h, s, d);
+                        auto o = output->ptrAt<float>(n, h, s, d);
+                        float in_value = v[0];
+                        float in_value_2 = v[half];
+                        float sin_value = sin_[position(s)][d];
+                        float cos_value = cos_[position(s)][d];
+                        auto value = in_value * cos_value - in_value_2 * sin_value;
+                        auto value2 = in_value * sin_value + in_value_2 * cos_value;
+                        o[0] = value;
+                        o[half] = value2;
                     }
-                }
+                });
             } else if (out_dtype == MLLM_TYPE_F16) {
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-                for (int n = 0; n < input->batch(); ++n) {
-                    for (int h = 0; h < input->head(); ++h) {
-                        for (int s = 0; s < input->sequence(); ++s) { // sequance
-                            for (int d = 0; d < partial_dimension / 2; ++d) {
-                                auto v = input->ptrAt<float>(n, h, s, d);
-                                auto o = output->ptrAt<mllm_fp16_t>(n, h, s, d);
-                                float in_value = v[0];
-                                float in_value_2 = v[half];
-                                float sin_value = sin_[s + h_cnt_][d];
-                                float cos_value = cos_[s + h_cnt_][d];
-                                auto value = in_value * cos_value - in_value_2 * sin_value;
-                                auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                                o[0] = MLLM_FP32_TO_FP16(value);
-                                o[half] = MLLM_FP32_TO_FP16(value2);
-                            }
-                        }
+                const int64_t H = input->head(), S = input->sequence();
+                parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+                    const int n = (int)(i / (H * S));
+                    const int h = (int)(i / S % H);
+                    const int s = (int)(i % S);
+                    for (int d = 0; d < partial_dimension / 2; ++d) {
+                        auto v = input->ptrAt<float>(n, h, s, d);
+                        auto o = output->ptrAt<mllm_fp16_t>(n, h, s, d);
+                        float in_value = v[0];
+                        float in_value_2 = v[half];
+                        float sin_value = sin_[position(s)][d];
+                        float cos_value = cos_[position(s)][d];
+                        auto value = in_value * cos_value - in_value_2 * sin_value;
+                        auto value2 = in_value * sin_value + in_value_2 * cos_value;
+                        o[0] = MLLM_FP32_TO_FP16(value);
+                        o[half] = MLLM_FP32_TO_FP16(value2);
                     }
-                }
+                });
             }
         }
         return;
     }
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) { // sequance
-                for (int d = 0; d < partial_dimension / 2; ++d) {
-                    if (input->dtype() == MLLM_TYPE_F16) {
-                        float in_value = static_cast<float>(input->dataAt<mllm_fp16_t>(n, h, s, d));
-                        float in_value_2 = static_cast<float>(input->dataAt<mllm_fp16_t>(n, h, s, d + partial_dimension / 2));
-                        float sin_value = sin_[s + h_cnt_][d];
-                        float cos_value = cos_[s + h_cnt_][d];
-                        auto value = in_value * cos_value - in_value_2 * sin_value;
-                        auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                        if (out_dtype == MLLM_TYPE_F32) {
-                            output->setDataAt<float>(n, h, s, d, value);
-                            output->setDataAt<float>(n, h, s, d + partial_dimension / 2, value2);
-                        } else if (out_dtype == MLLM_TYPE_F16) {
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d + partial_dimension / 2, MLLM_FP32_TO_FP16(value2));
-                        }
+    const int64_t H = input->head(), S = input->sequence();
+    parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+        const int n = (int)(i / (H * S));
+        const int h = (int)(i / S % H);
+        const int s = (int)(i % S);
+        for (int d = 0; d < partial_dimension / 2; ++d) {
+            if (input->dtype() == MLLM_TYPE_F16) {
+                float in_value = static_cast<float>(input->dataAt<mllm_fp16_t>(n, h, s, d));
+                float in_value_2 = static_cast<float>(input->dataAt<mllm_fp16_t>(n, h, s, d + partial_dimension / 2));
+                float sin_value = sin_[position(s)][d];
+                float cos_value = cos_[position(s)][d];
+                auto value = in_value * cos_value - in_value_2 * sin_value;
+                auto value2 = in_value * sin_value + in_value_2 * cos_value;
+                if (out_dtype == MLLM_TYPE_F32) {
+                    output->setDataAt<float>(n, h, s, d, value);
+                    output->setDataAt<float>(n, h, s, d + partial_dimension / 2, value2);
+                } else if (out_dtype == MLLM_TYPE_F16) {
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d + partial_dimension / 2, MLLM_FP32_TO_FP16(value2));
+                }
 
-                    } else {
-                        float in_value = input->dataAt<float>(n, h, s, d);
-                        float in_value_2 = input->dataAt<float>(n, h, s, d + partial_dimension / 2);
-                        float sin_value = sin_[s + h_cnt_][d];
-                        float cos_value = cos_[s + h_cnt_][d];
-                        auto value = in_value * cos_value - in_value_2 * sin_value;
-                        auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                        if (out_dtype == MLLM_TYPE_F32) {
-                            output->setDataAt<float>(n, h, s, d, value);
-                            output->setDataAt<float>(n, h, s, d + partial_dimension / 2, value2);
-                        } else if (out_dtype == MLLM_TYPE_F16) {
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d + partial_dimension / 2, MLLM_FP32_TO_FP16(value2));
-                        }
-                    }
+            } else {
+                float in_value = input->dataAt<float>(n, h, s, d);
+                float in_value_2 = input->dataAt<float>(n, h, s, d + partial_dimension / 2);
+                float sin_value = sin_[position(s)][d];
+                float cos_value = cos_[position(s)][d];
+                auto value = in_value * cos_value - in_value_2 * sin_value;
+                auto value2 = in_value * sin_value + in_value_2 * cos_value;
+                if (out_dtype == MLLM_TYPE_F32) {
+                    output->setDataAt<float>(n, h, s, d, value);
+                    output->setDataAt<float>(n, h, s, d + partial_dimension / 2, value2);
+                } else if (out_dtype == MLLM_TYPE_F16) {
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d + partial_dimension / 2, MLLM_FP32_TO_FP16(value2));
                 }
             }
         }
-    }
+    });
 }
 void CPURoPE::rope_permission(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) { // sequance
-                for (int d = 0; d < partial_dimension; ++d) {
-                    float in_value = input->dataAt<float>(n, h, s, d);
-                    float in_value_2;
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
-                    if (d < partial_dimension / 4) {
-                        in_value_2 = -input->dataAt<float>(n, h, s, d + partial_dimension / 4);
-                        auto value = in_value * cos_value + in_value_2 * sin_value;
-                        if (out_dtype == MLLM_TYPE_F32) {
-                            output->setDataAt<float>(n, h, s, d, value);
-                        } else if (out_dtype == MLLM_TYPE_F16) {
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                        }
-                    } else if (d < (partial_dimension / 2)) {
-                        in_value_2 = input->dataAt<float>(n, h, s, d - partial_dimension / 4);
-                        auto value = in_value * cos_value + in_value_2 * sin_value;
-                        if (out_dtype == MLLM_TYPE_F32) {
-                            output->setDataAt<float>(n, h, s, d, value);
-                        } else if (out_dtype == MLLM_TYPE_F16) {
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                        }
-                    } else {
-                        if (out_dtype == MLLM_TYPE_F32) {
-                            output->setDataAt<float>(n, h, s, d, in_value);
-                        } else if (out_dtype == MLLM_TYPE_F16) {
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(in_value));
-                        }
-                    }
+    const int64_t H = input->head(), S = input->sequence();
+    parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+        const int n = (int)(i / (H * S));
+        const int h = (int)(i / S % H);
+        const int s = (int)(i % S);
+        for (int d = 0; d < partial_dimension; ++d) {
+            float in_value = input->dataAt<float>(n, h, s, d);
+            float in_value_2;
+            float sin_value = sin_[position(s)][d];
+            float cos_value = cos_[position(s)][d];
+            if (d < partial_dimension / 4) {
+                in_value_2 = -input->dataAt<float>(n, h, s, d + partial_dimension / 4);
+                auto value = in_value * cos_value + in_value_2 * sin_value;
+                if (out_dtype == MLLM_TYPE_F32) {
+                    output->setDataAt<float>(n, h, s, d, value);
+                } else if (out_dtype == MLLM_TYPE_F16) {
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                }
+            } else if (d < (partial_dimension / 2)) {
+                in_value_2 = input->dataAt<float>(n, h, s, d - partial_dimension / 4);
+                auto value = in_value * cos_value + in_value_2 * sin_value;
+                if (out_dtype == MLLM_TYPE_F32) {
+                    output->setDataAt<float>(n, h, s, d, value);
+                } else if (out_dtype == MLLM_TYPE_F16) {
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                }
+            } else {
+                if (out_dtype == MLLM_TYPE_F32) {
+                    output->setDataAt<float>(n, h, s, d, in_value);
+                } else if (out_dtype == MLLM_TYPE_F16) {
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(in_value));
                 }
             }
         }
-    }
+    });
 }
 void CPURoPE::rope_mla(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) { // sequance
-                for (int d = 0; d < partial_dimension; ++d) {
-                    int half_dim = input->dimension() / 2;
-                    float in_value = input->dataAt<float>(n, h, s, d);
-                    if (d < half_dim) {
-                        in_value = input->dataAt<float>(n, h, s, d * 2);
-                    } else {
-                        in_value = input->dataAt<float>(n, h, s, 2 * (d - half_dim) + 1);
-                    }
-                    float in_value_2;
-                    if (d < half_dim) {
-                        in_value_2 = -input->dataAt<float>(n, h, s, 2 * d + 1);
-                    } else {
-                        in_value_2 = input->dataAt<float>(n, h, s, 2 * (d - half_dim));
-                    }
-                    // no change
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
-                    auto value = in_value * cos_value + in_value_2 * sin_value;
-                    if (out_dtype == MLLM_TYPE_F32) {
-                        output->setDataAt<float>(n, h, s, d, value);
-                    } else if (out_dtype == MLLM_TYPE_F16) {
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                    }
-                }
-            }
+    const int64_t H = input->head(), S = input->sequence();
+    parallel_for(input->batch() * H * S * partial_dimension, thread_count, [&](int64_t i) {
+        const int n = (int)(i / (H * S * partial_dimension));
+        const int h = (int)(i / (S * partial_dimension) % H);
+        const int s = (int)(i / partial_dimension % S);
+        const int d = (int)(i % partial_dimension);
+        int half_dim = input->dimension() / 2;
+        float in_value = input->dataAt<float>(n, h, s, d);
+        if (d < half_dim) {
+            in_value = input->dataAt<float>(n, h, s, d * 2);
+        } else {
+            in_value = input->dataAt<float>(n, h, s, 2 * (d - half_dim) + 1);
         }
-    }
+        float in_value_2;
+        if (d < half_dim) {
+            in_value_2 = -input->dataAt<float>(n, h, s, 2 * d + 1);
+        } else {
+            in_value_2 = input->dataAt<float>(n, h, s, 2 * (d - half_dim));
+        }
+        // no change
+        float sin_value = sin_[position(s)][d];
+        float cos_value = cos_[position(s)][d];
+        auto value = in_value * cos_value + in_value_2 * sin_value;
+        if (out_dtype == MLLM_TYPE_F32) {
+            output->setDataAt<float>(n, h, s, d, value);
+        } else if (out_dtype == MLLM_TYPE_F16) {
+            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+        }
+    });
 }
 // TODO: Q8_0 KVCache can not use!!
 ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -345,17 +337,16 @@ ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
         tmp_out->setDtype(MLLM_TYPE_F32);
         tmp_out->alloc();
         doExecute(inputs, {tmp_out});
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int b = 0; b < tmp_out->batch(); b++) {
-            for (int h = 0; h < tmp_out->head(); h++) {
-                for (int s = 0; s < tmp_out->sequence(); s++) {
-                    quantize_row_q8_0(tmp_out->hostPtr<float>() + tmp_out->offset(b, h, s, 0),
-                                      (char *)outputs[0]->rawHostPtr()
-                                          + outputs[0]->offset(b, h, s, 0) * sizeof(block_q8_0) / QK8_0,
-                                      tmp_out->dimension());
-                }
-            }
-        }
+        const int64_t H = tmp_out->head(), S = tmp_out->sequence();
+        parallel_for(tmp_out->batch() * H * S, thread_count, [&](int64_t i) {
+            const int b = (int)(i / (H * S));
+            const int h = (int)(i / S % H);
+            const int s = (int)(i % S);
+            quantize_row_q8_0(tmp_out->hostPtr<float>() + tmp_out->offset(b, h, s, 0),
+                              (char *)outputs[0]->rawHostPtr()
+                                  + outputs[0]->offset(b, h, s, 0) * sizeof(block_q8_0) / QK8_0,
+                              tmp_out->dimension());
+        });
         return MLLM_NO_ERROR;
     } else {
         return doExecute(inputs, outputs);
@@ -367,6 +358,10 @@ ErrorCode CPURoPE::doExecute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
     // auto start_t = mllm_time_us();
+    auto cpu_backend = dynamic_cast<CPUBackend *>(backend());
+    const bool packed = cpu_backend != nullptr && !cpu_backend->sequenceBatch().empty()
+                        && cpu_backend->sequenceBatch().rows() == input->sequence();
+    row_positions_ = packed ? cpu_backend->sequenceBatch().positions.data() : nullptr;
     if (pose_type_ == LLAMAROPE) {
         rope_llama(input, output);
     } else if (pose_type_ == HFHUBROPE) {
@@ -378,27 +373,75 @@ ErrorCode CPURoPE::doExecute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
     } else {
         MLLM_LOG_ERROR_STREAM << "RoPE type error" << std::endl;
     }
-    h_cnt_ += input->sequence();
+    row_positions_ = nullptr;
+    if (!packed) { h_cnt_ += input->sequence(); }
     if (h_cnt_ >= pos_max_) {
         h_cnt_ = 0;
     }
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) {
-                for (int d = partial_dimension; d < input->dimension(); ++d) {
-                    if (out_dtype == MLLM_TYPE_F32) {
-                        output->setDataAt<float>(n, h, s, d, input->dataAt<float>(n, h, s, d));
-                    } else if (out_dtype == MLLM_TYPE_F16) {
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(input->dataAt<float>(n, h, s, d)));
-                    }
-                }
-            }
+    const int64_t H = input->head(), S = input->sequence(), D = input->dimension() - partial_dimension;
+    parallel_for(input->batch() * H * S * D, thread_count, [&](int64_t i) {
+        const int n = (int)(i / (H * S * D));
+        const int h = (int)(i / (S * D) % H);
+        const int s = (int)(i / D % S);
+        const int d = partial_dimension + (int)(i % D);
+        if (out_dtype == MLLM_TYPE_F32) {
+            output->setDataAt<float>(n, h, s, d, input->dataAt<float>(n, h, s, d));
+        } else if (out_dtype == MLLM_TYPE_F16) {
+            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(input->dataAt<float>(n, h, s, d)));
         }
-    }
+    });
     return Op::execute(inputs, outputs);
 }
 
+void CPURoPE::rotateRows(Tensor &t, int s_begin, int s_end, int delta) {
+    if (delta == 0 || s_end <= s_begin) { return; }
+    assert(std::abs(delta) < pos_max_ && !sin_.empty());
+    int partial_dimension = t.dimension() * partial_rotary_factor_;
+    // each rope type rotates (x[d], x[d + stride]) for d in [0, pairs) with the angle of table column d
+    int pairs, stride, step;
+    if (pose_type_ == LLAMAROPE) {
+        pairs = partial_dimension;
+        stride = 1;
+        step = 2;
+    } else if (pose_type_ == HFHUBROPE || pose_type_ == MLAROPE) {
+        pairs = partial_dimension / 2;
+        stride = partial_dimension / 2;
+        step = 1;
+    } else if (pose_type_ == PERSIMMONROPE) {
+        pairs = partial_dimension / 4;
+        stride = partial_dimension / 4;
+        step = 1;
+    } else {
+        MLLM_LOG_ERROR_STREAM << "RoPE type error" << std::endl;
+        return;
+    }
+    // R(delta) = R(|delta|) or its inverse
+    const float sign = delta > 0 ? 1.0F : -1.0F;
+    const auto &sin_row = sin_[std::abs(delta)];
+    const auto &cos_row = cos_[std::abs(delta)];
+    const int64_t H = t.head(), S = s_end - s_begin;
+    parallel_for(t.batch() * H * S, thread_count, [&](int64_t i) {
+        const int n = (int)(i / (H * S));
+        const int h = (int)(i / S % H);
+        const int s = s_begin + (int)(i % S);
+        for (int d = 0; d < pairs; d += step) {
+            float sin_value = sign * sin_row[d];
+            float cos_value = cos_row[d];
+            if (t.dtype() == MLLM_TYPE_F16) {
+                float x = MLLM_FP16_TO_FP32(t.dataAt<mllm_fp16_t>(n, h, s, d));
+                float y = MLLM_FP16_TO_FP32(t.dataAt<mllm_fp16_t>(n, h, s, d + stride));
+                t.setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(x * cos_value - y * sin_value));
+                t.setDataAt<mllm_fp16_t>(n, h, s, d + stride, MLLM_FP32_TO_FP16(x * sin_value + y * cos_value));
+            } else {
+                float x = t.dataAt<float>(n, h, s, d);
+                float y = t.dataAt<float>(n, h, s, d + stride);
+                t.setDataAt<float>(n, h, s, d, x * cos_value - y * sin_value);
+                t.setDataAt<float>(n, h, s, d + stride, x * sin_value + y * cos_value);
+            }
+        }
+    });
+}
+
 ErrorCode CPURoPE::load(AbstructLoader &loader) {
     return Op::load(loader);
 }
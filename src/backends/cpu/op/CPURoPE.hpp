@@ -18,6 +18,17 @@ public:
     virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     ErrorCode doExecute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs);
 
+    /**
+     * \brief move the position of the next tokens by delta, e.g. after a KVCache evicted -delta tokens.
+     */
+    void shiftPosition(int delta) {
+        h_cnt_ += delta;
+    }
+    /**
+     * \brief re-rotate rows [s_begin, s_end) of a tensor produced by this op as if their positions moved by delta.
+     */
+    void rotateRows(Tensor &t, int s_begin, int s_end, int delta);
+
 private:
     //    Tensor freq_;
     // static Tensor sin_;
@@ -33,6 +44,11 @@ private:
     int ishape;
     int thread_count = 4;
     float partial_rotary_factor_ = 1;
+    // per-row positions of a packed continuous-batching step, nullptr otherwise
+    const int *row_positions_ = nullptr;
+    int position(int s) const {
+        return row_positions_ != nullptr ? row_positions_[s] : s + h_cnt_;
+    }
 
     void rope_llama(shared_ptr<Tensor> input, shared_ptr<Tensor> output);
     void rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output);
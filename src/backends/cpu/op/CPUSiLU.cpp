@@ -27,22 +27,31 @@ ErrorCode CPUSiLU::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
     int n1 = input->head();
     int n2 = input->sequence();
     int n3 = input->dimension();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-    for (int n = 0; n < batch; n++) {
-        for (int h = 0; h < n2; h++) {
-            for (int c = 0; c < n1; c++) {
-                //                #pragma omp parallel for num_threads(thread_count)
-                //                for (int w = 0; w < n3; w++) {
-                //                    float value = input->dataAt<float>(n, c, h, w);
-                //                    outputs[0]->setDataAt<float>(n, c, h, w, value / (1 + std::exp(-value)));
-                //                }
-                mllm_vec_silu_f32(n3, outputs[0]->ptrAt<float>(n, c, h, 0),
-                                  inputs[0]->ptrAt<float>(n, c, h, 0));
-            }
-        }
-    }
+    parallel_for((int64_t)batch * n2 * n1, thread_count, [&](int64_t i) {
+        const int n = (int)(i / (n2 * n1));
+        const int h = (int)(i / n1 % n2);
+        const int c = (int)(i % n1);
+        //                #pragma omp parallel for num_threads(thread_count)
+        //                for (int w = 0; w < n3; w++) {
+        //                    float value = input->dataAt<float>(n, c, h, w);
+        //                    outputs[0]->setDataAt<float>(n, c, h, w, value / (1 + std::exp(-value)));
+        //                }
+        mllm_vec_silu_f32(n3, outputs[0]->ptrAt<float>(n, c, h, 0),
+                          inputs[0]->ptrAt<float>(n, c, h, 0));
+    });
 
     return Op::execute(inputs, outputs);
 }
 
+void CPUSiLU::executeGated(Tensor *gate, Tensor *up, Tensor *output) {
+    const int64_t H = output->head(), S = output->sequence();
+    parallel_for(output->batch() * H * S, thread_count, [&](int64_t i) {
+        const int n = (int)(i / (H * S));
+        const int c = (int)(i / S % H);
+        const int h = (int)(i % S);
+        mllm_vec_swiglu_f32(output->dimension(), output->ptrAt<float>(n, c, h, 0),
+                            gate->ptrAt<float>(n, c, h, 0), up->ptrAt<float>(n, c, h, 0));
+    });
+}
+
 } // namespace mllm
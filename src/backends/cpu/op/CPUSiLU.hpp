@@ -12,6 +12,10 @@ public:
     virtual ~CPUSiLU() = default;
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    /**
+     * \brief output = silu(gate) * up in one pass, for a SiLU followed by a multiplication (see OpFusion).
+     */
+    void executeGated(Tensor *gate, Tensor *up, Tensor *output);
 
 private:
     int thread_count = 4;
@@ -41,83 +41,97 @@ ErrorCode CPUSoftMax::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_p
         old_dim = input->dimension() - input->sequence();
 #endif
     }
+    // packed continuous-batching rows: row s attends to the first positions[s] + 1 keys of its own sequence
+    const int *row_positions = nullptr;
+    auto cpu_backend = dynamic_cast<CPUBackend *>(backend());
+    if (cpu_backend != nullptr && !cpu_backend->sequenceBatch().empty()
+        && cpu_backend->sequenceBatch().rows() == input->sequence() && input->batch() == 1) {
+        row_positions = cpu_backend->sequenceBatch().positions.data();
+    }
     memset(output->hostPtr<float>(), 0, output->count() * sizeof(float));
     if (axis_ == DIMENSION) {
         int num_classes = num_classes_in > 0 ? num_classes_in : input->dimension(); // 获取类别数量
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int n = 0; n < input->batch(); ++n) {
-            for (int h = 0; h < input->head(); ++h) {
-                for (int s = 0; s < input->sequence(); ++s) {
-                    int masked_num_classes = num_classes;
-                    if (do_causal_mask_ && input->sequence() > 1) {
-                        masked_num_classes = s + 1 + old_dim;
-                    }
-                    float max = -INFINITY;
-                    for (int j = 0; j < masked_num_classes; ++j) {
-                        max = MAX(max, input->dataAt<float>(n, h, s, j));
-                    }
-                    float *dp = output->ptrAt<float>(n, h, s, 0);
-                    float sum = mllm_vec_soft_max_f32(masked_num_classes, dp, input->ptrAt<float>(n, h, s, 0), max);
-                    sum = 1.0 / sum;
-                    vec_scale_f32(masked_num_classes, dp, sum);
-                }
+        const int64_t H = input->head(), S = input->sequence();
+        parallel_for(input->batch() * H * S, thread_count, [&](int64_t i) {
+            const int n = (int)(i / (H * S));
+            const int h = (int)(i / S % H);
+            const int s = (int)(i % S);
+            int masked_num_classes = num_classes;
+            if (row_positions != nullptr && do_causal_mask_) {
+                masked_num_classes = row_positions[s] + 1;
+            } else if (do_causal_mask_ && input->sequence() > 1) {
+                masked_num_classes = s + 1 + old_dim;
+            }
+            float max = -INFINITY;
+            for (int j = 0; j < masked_num_classes; ++j) {
+                max = MAX(max, input->dataAt<float>(n, h, s, j));
+            }
+            float *dp = output->ptrAt<float>(n, h, s, 0);
+            const float *sp = input->ptrAt<float>(n, h, s, 0);
+            if (scale_ != 1.0F) {
+                // the row is scaled in the output and exponentiated in place while it is still in cache
+                memcpy(dp, sp, masked_num_classes * sizeof(float));
+                vec_scale_f32(masked_num_classes, dp, scale_);
+                sp = dp;
+                max *= scale_;
             }
-        }
+            float sum = mllm_vec_soft_max_f32(masked_num_classes, dp, sp, max);
+            sum = 1.0 / sum;
+            vec_scale_f32(masked_num_classes, dp, sum);
+        });
     } else {
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-        for (int n = 0; n < input->batch(); ++n) {
-            for (int c = 0; c < input->head(); ++c) {
-                for (int h = 0; h < input->sequence(); ++h) {
-                    for (int w = 0; w < input->dimension(); ++w) {
-                        std::vector<int> index = {n, c, h, w};
-                        int num_classes = 0;
-                        switch (axis_) {
-                        case BATCH:
-                            num_classes = input->batch();
-                            break;
-                        case HEAD:
-                            num_classes = input->head();
-                            break;
-                        case SEQUENCE:
-                            num_classes = input->sequence();
-                            break;
-                        case DIMENSION:
-                            num_classes = input->dimension();
-                            break;
-                        }
-                        num_classes = num_classes_in > 0 ? num_classes_in : num_classes;
-                        float max = -INFINITY;
-                        for (int j = 0; j < num_classes; ++j) {
-                            index[axis_] = j;
-                            max = MAX(max, input->dataAt<float>(index));
-                        }
-                        vector<float> dp(num_classes);
-                        double sum = 0.0;
-                        uint16_t scvt;
-                        for (int i = 0; i < num_classes; i++) {
-                            if (input->dataAt<float>(index) == -INFINITY) {
-                                dp[i] = 0.0f;
-                            } else {
-                                mllm_fp16_t tmp = MLLM_FP32_TO_FP16(input->dataAt<float>(index) - max);
-                                memcpy(&scvt, &tmp, sizeof(scvt));
-                                const float val = MLLM_FP16_TO_FP32(table_exp_f16[scvt]);
-                                sum += (double)val;
-                                dp[i] = val;
-                            }
-                        }
-                        // 将 softmax 结果写入输出Tensor
-                        for (int i = 0; i < num_classes; i++) {
-                            index[axis_] = i;
-                            float softmax_value = dp[i] / sum;
-                            output->setDataAt<float>(index, softmax_value);
-                        }
-                        // for (int i = num_classes; i < input->dimension(); i++) {
-                        //     output->setDataAt<float>(index, 0);
-                        // }
-                    }
+        const int64_t H = input->head(), S = input->sequence(), D = input->dimension();
+        parallel_for(input->batch() * H * S * D, thread_count, [&](int64_t idx) {
+            const int n = (int)(idx / (H * S * D));
+            const int c = (int)(idx / (S * D) % H);
+            const int h = (int)(idx / D % S);
+            const int w = (int)(idx % D);
+            std::vector<int> index = {n, c, h, w};
+            int num_classes = 0;
+            switch (axis_) {
+            case BATCH:
+                num_classes = input->batch();
+                break;
+            case HEAD:
+                num_classes = input->head();
+                break;
+            case SEQUENCE:
+                num_classes = input->sequence();
+                break;
+            case DIMENSION:
+                num_classes = input->dimension();
+                break;
+            }
+            num_classes = num_classes_in > 0 ? num_classes_in : num_classes;
+            float max = -INFINITY;
+            for (int j = 0; j < num_classes; ++j) {
+                index[axis_] = j;
+                max = MAX(max, input->dataAt<float>(index));
+            }
+            vector<float> dp(num_classes);
+            double sum = 0.0;
+            uint16_t scvt;
+            for (int i = 0; i < num_classes; i++) {
+                if (input->dataAt<float>(index) == -INFINITY) {
+                    dp[i] = 0.0f;
+                } else {
+                    mllm_fp16_t tmp = MLLM_FP32_TO_FP16(input->dataAt<float>(index) - max);
+                    memcpy(&scvt, &tmp, sizeof(scvt));
+                    const float val = MLLM_FP16_TO_FP32(table_exp_f16[scvt]);
+                    sum += (double)val;
+                    dp[i] = val;
                 }
             }
-        }
+            // 将 softmax 结果写入输出Tensor
+            for (int i = 0; i < num_classes; i++) {
+                index[axis_] = i;
+                float softmax_value = dp[i] / sum;
+                output->setDataAt<float>(index, softmax_value);
+            }
+            // for (int i = num_classes; i < input->dimension(); i++) {
+            //     output->setDataAt<float>(index, 0);
+            // }
+        });
     }
     return Op::execute(inputs, outputs);
 }
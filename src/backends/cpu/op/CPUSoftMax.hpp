@@ -13,8 +13,20 @@ public:
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
 
+    int axis() const {
+        return axis_;
+    }
+    /**
+     * \brief multiply the input by `scale` (> 0) as it is read, used by OpFusion to fold `x / sqrt(d)` into the
+     * softmax along DIMENSION.
+     */
+    void setInputScale(float scale) {
+        scale_ = scale;
+    }
+
 private:
     int axis_ = 0;
+    float scale_ = 1.0F;
     int thread_count = 4;
     bool do_causal_mask_ = false;
 };
@@ -271,7 +271,9 @@ static inline int nearest_int(float fval) {
     return (i & 0x007fffff) - 0x00400000;
 }
 
-static float make_qx_quants(int n, int nmax, const float *__restrict x, int8_t *__restrict L, int rmse_type) {
+// qw, when given, weights each value's rounding error in place of the rmse_type weighting
+static float make_qx_quants(int n, int nmax, const float *__restrict x, int8_t *__restrict L, int rmse_type,
+                            const float *__restrict qw = nullptr) {
     float max = 0;
     float amax = 0;
     for (int i = 0; i < n; ++i) {
@@ -307,11 +309,11 @@ static float make_qx_quants(int n, int nmax, const float *__restrict x, int8_t *
         int l = nearest_int(iscale * x[i]);
         l = MAX(-nmax, MIN(nmax - 1, l));
         L[i] = l + nmax;
-        float w = weight_type == 1 ? x[i] * x[i] : 1;
+        float w = qw ? qw[i] : weight_type == 1 ? x[i] * x[i] : 1;
         sumlx += w * x[i] * l;
         suml2 += w * l * l;
     }
-    float scale = sumlx / suml2;
+    float scale = suml2 ? sumlx / suml2 : 0.F;
     if (return_early) return suml2 > 0 ? 0.5f * (scale + 1 / iscale) : 1 / iscale;
     float best = scale * sumlx;
     for (int is = -9; is <= 9; ++is) {
@@ -323,7 +325,7 @@ static float make_qx_quants(int n, int nmax, const float *__restrict x, int8_t *
         for (int i = 0; i < n; ++i) {
             int l = nearest_int(iscale * x[i]);
             l = MAX(-nmax, MIN(nmax - 1, l));
-            float w = weight_type == 1 ? x[i] * x[i] : 1;
+            float w = qw ? qw[i] : weight_type == 1 ? x[i] * x[i] : 1;
             sumlx += w * x[i] * l;
             suml2 += w * l * l;
         }
@@ -339,6 +341,92 @@ static float make_qx_quants(int n, int nmax, const float *__restrict x, int8_t *
     return scale;
 }
 
+// twice the mean square of x; added under the importance weights so that values of rarely active channels still
+// carry some weight
+static inline float importance_sigma2(const float *__restrict x, int n) {
+    float sum_x2 = 0;
+    for (int i = 0; i < n; ++i) sum_x2 += x[i] * x[i];
+    return 2 * sum_x2 / n;
+}
+
+static float make_qkx2_quants(int n, int nmax, const float * __restrict x, const float * __restrict weights,
+                              uint8_t * __restrict L, float * __restrict the_min, uint8_t * __restrict Laux,
+                              float rmin, float rdelta, int nstep, bool use_mad) {
+    float min = x[0];
+    float max = x[0];
+    float sum_w = weights[0];
+    float sum_x = sum_w * x[0];
+    for (int i = 1; i < n; ++i) {
+        if (x[i] < min) min = x[i];
+        if (x[i] > max) max = x[i];
+        float w = weights[i];
+        sum_w += w;
+        sum_x += w * x[i];
+    }
+    if (min > 0) min = 0;
+    if (max == min) {
+        for (int i = 0; i < n; ++i) L[i] = 0;
+        *the_min = -min;
+        return 0.F;
+    }
+    float iscale = nmax/(max - min);
+    float scale = 1/iscale;
+    float best_mad = 0;
+    for (int i = 0; i < n; ++i) {
+        int l = nearest_int(iscale*(x[i] - min));
+        L[i] = MAX(0, MIN(nmax, l));
+        float diff = scale * L[i] + min - x[i];
+        diff = use_mad ? fabsf(diff) : diff * diff;
+        float w = weights[i];
+        best_mad += w * diff;
+    }
+    if (nstep < 1) {
+        *the_min = -min;
+        return scale;
+    }
+    for (int is = 0; is <= nstep; ++is) {
+        iscale = (rmin + rdelta*is + nmax)/(max - min);
+        float sum_l = 0;
+        float sum_l2 = 0;
+        float sum_xl = 0;
+        for (int i = 0; i < n; ++i) {
+            int l = nearest_int(iscale*(x[i] - min));
+            l = MAX(0, MIN(nmax, l));
+            Laux[i] = l;
+            float w = weights[i];
+            sum_l += w*l;
+            sum_l2 += w*l*l;
+            sum_xl += w*l*x[i];
+        }
+        float D = sum_w * sum_l2 - sum_l * sum_l;
+        if (D > 0) {
+            float this_scale = (sum_w * sum_xl - sum_x * sum_l)/D;
+            float this_min   = (sum_l2 * sum_x - sum_l * sum_xl)/D;
+            if (this_min > 0) {
+                this_min = 0;
+                this_scale = sum_xl / sum_l2;
+            }
+            float mad = 0;
+            for (int i = 0; i < n; ++i) {
+                float diff = this_scale * Laux[i] + this_min - x[i];
+                diff = use_mad ? fabsf(diff) : diff * diff;
+                float w = weights[i];
+                mad += w * diff;
+            }
+            if (mad < best_mad) {
+                for (int i = 0; i < n; ++i) {
+                    L[i] = Laux[i];
+                }
+                best_mad = mad;
+                scale = this_scale;
+                min = this_min;
+            }
+        }
+    }
+    *the_min = -min;
+    return scale;
+}
+
 // FP32_FP16
 
 inline mllm_fp16_t mllm_fp32_to_fp16(float x) {
@@ -0,0 +1,153 @@
+/*
+ * This code is based on ggml(https://github.com/ggerganov/ggml),
+ * please see https://github.com/ggerganov/ggml/blob/master/src/ggml.c
+ * ggml is licensed under MIT Copyright (c) 2022 Georgi Gerganov:
+ *
+ * MIT License
+ * Copyright (c) 2022 Georgi Gerganov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "QuantizeQ2.hpp"
+
+// ====================== 2-bit (de)-quantization
+
+static void quantize_row_q2_K_reference(const float *__restrict x, block_q2_K *__restrict y, int k, const float *__restrict quant_weights) {
+    assert(k % QK_K == 0);
+    assert(QK_K == 256);
+    const int nb = k / QK_K;
+
+    uint8_t L[QK_K];
+    uint8_t Laux[16];
+    float weights[16];
+    float mins[QK_K / 16];
+    float scales[QK_K / 16];
+
+    const float q4scale = 15.F;
+
+    for (int i = 0; i < nb; i++) {
+        float max_scale = 0; // as we are deducting the min, scales are always positive
+        float max_min = 0;
+        const float sigma2 = quant_weights ? importance_sigma2(x, QK_K) : 0.F;
+        for (int j = 0; j < QK_K / 16; ++j) {
+            if (quant_weights) {
+                for (int l = 0; l < 16; ++l) weights[l] = quant_weights[16 * j + l] * sqrtf(sigma2 + x[16 * j + l] * x[16 * j + l]);
+            } else {
+                for (int l = 0; l < 16; ++l) weights[l] = fabsf(x[16 * j + l]);
+            }
+            scales[j] = make_qkx2_quants(16, 3, x + 16 * j, weights, L + 16 * j, &mins[j], Laux, -0.5F, 0.1F, 15, true);
+            float scale = scales[j];
+            if (scale > max_scale) {
+                max_scale = scale;
+            }
+            float min = mins[j];
+            if (min > max_min) {
+                max_min = min;
+            }
+        }
+
+        if (max_scale > 0) {
+            float iscale = q4scale / max_scale;
+            for (int j = 0; j < QK_K / 16; ++j) {
+                int l = nearest_int(iscale * scales[j]);
+                y[i].scales[j] = l;
+            }
+            y[i].d = MLLM_FP32_TO_FP16(max_scale / q4scale);
+        } else {
+            for (int j = 0; j < QK_K / 16; ++j) y[i].scales[j] = 0;
+            y[i].d = MLLM_FP32_TO_FP16(0.F);
+        }
+        if (max_min > 0) {
+            float iscale = q4scale / max_min;
+            for (int j = 0; j < QK_K / 16; ++j) {
+                int l = nearest_int(iscale * mins[j]);
+                y[i].scales[j] |= (l << 4);
+            }
+            y[i].dmin = MLLM_FP32_TO_FP16(max_min / q4scale);
+        } else {
+            y[i].dmin = MLLM_FP32_TO_FP16(0.F);
+        }
+        for (int j = 0; j < QK_K / 16; ++j) {
+            const float d = MLLM_FP16_TO_FP32(y[i].d) * (y[i].scales[j] & 0xF);
+            if (!d) continue;
+            const float dm = MLLM_FP16_TO_FP32(y[i].dmin) * (y[i].scales[j] >> 4);
+            for (int ii = 0; ii < 16; ++ii) {
+                int l = nearest_int((x[16 * j + ii] + dm) / d);
+                l = MAX(0, MIN(3, l));
+                L[16 * j + ii] = l;
+            }
+        }
+
+        for (int j = 0; j < QK_K; j += 128) {
+            for (int l = 0; l < 32; ++l) {
+                y[i].qs[j / 4 + l] = L[j + l] | (L[j + l + 32] << 2) | (L[j + l + 64] << 4) | (L[j + l + 96] << 6);
+            }
+        }
+
+        x += QK_K;
+        if (quant_weights) { quant_weights += QK_K; }
+    }
+}
+
+void quantize_row_q2_K(const float *__restrict x, void *__restrict vy, int k) {
+    assert(k % QK_K == 0);
+    block_q2_K *__restrict y = (block_q2_K *)vy;
+    quantize_row_q2_K_reference(x, y, k, nullptr);
+}
+
+void quantize_row_q2_K_weighted(const float *__restrict x, void *__restrict vy, int k, const float *__restrict quant_weights) {
+    assert(k % QK_K == 0);
+    block_q2_K *__restrict y = (block_q2_K *)vy;
+    quantize_row_q2_K_reference(x, y, k, quant_weights);
+}
+
+void dequantize_row_q2_K(const block_q2_K *__restrict x, float *__restrict y, int k) {
+    assert(k % QK_K == 0);
+    assert(QK_K == 256);
+    const int nb = k / QK_K;
+
+    for (int i = 0; i < nb; i++) {
+        const float d = MLLM_FP16_TO_FP32(x[i].d);
+        const float min = MLLM_FP16_TO_FP32(x[i].dmin);
+
+        const uint8_t *q = x[i].qs;
+
+        int is = 0;
+        float dl, ml;
+        for (int n = 0; n < QK_K; n += 128) {
+            int shift = 0;
+            for (int j = 0; j < 4; ++j) {
+                uint8_t sc = x[i].scales[is++];
+                dl = d * (sc & 0xF);
+                ml = min * (sc >> 4);
+                for (int l = 0; l < 16; ++l) *y++ = dl * ((int8_t)((q[l] >> shift) & 3)) - ml;
+
+                sc = x[i].scales[is++];
+                dl = d * (sc & 0xF);
+                ml = min * (sc >> 4);
+                for (int l = 0; l < 16; ++l) *y++ = dl * ((int8_t)((q[l + 16] >> shift) & 3)) - ml;
+
+                shift += 2;
+            }
+            q += 32;
+        }
+    }
+}
@@ -71,6 +71,26 @@ void quantize_row_q4_0(const float * __restrict x, void * __restrict y, int k) {
     quantize_row_q4_0_reference(x, (block_q4_0 *)y, k);
 }
 
+void quantize_row_q4_0_weighted(const float * __restrict x, void * __restrict vy, int k, const float * __restrict quant_weights) {
+    assert(k % QK4_0 == 0);
+    block_q4_0 * __restrict y = (block_q4_0 *)vy;
+    const int nb = k / QK4_0;
+    const float sigma2 = importance_sigma2(x, k);
+
+    float weight[QK4_0];
+    int8_t L[QK4_0];
+    for (int i = 0; i < nb; i++) {
+        const float * xb = x + QK4_0 * i;
+        const float * qw = quant_weights + QK4_0 * i;
+        for (int j = 0; j < QK4_0; ++j) weight[j] = qw[j] * sqrtf(sigma2 + xb[j] * xb[j]);
+        const float d = make_qx_quants(QK4_0, 8, xb, L, 1, weight);
+        y[i].d = MLLM_FP32_TO_FP16(d);
+        for (int j = 0; j < QK4_0 / 2; ++j) {
+            y[i].qs[j] = L[j] | (L[j + QK4_0 / 2] << 4);
+        }
+    }
+}
+
 void dequantize_row_q4_0(const void * __restrict vx, float * __restrict y, int k) {
     static const int Qk = QK4_0;
 
@@ -96,83 +116,6 @@ void dequantize_row_q4_0(const void * __restrict vx, float * __restrict y, int k
 
 // ====================== 4-bit (de)-quantization
 
-static float make_qkx2_quants(int n, int nmax, const float * __restrict x, const float * __restrict weights,
-                              uint8_t * __restrict L, float * __restrict the_min, uint8_t * __restrict Laux,
-                              float rmin, float rdelta, int nstep, bool use_mad) {
-    float min = x[0];
-    float max = x[0];
-    float sum_w = weights[0];
-    float sum_x = sum_w * x[0];
-    for (int i = 1; i < n; ++i) {
-        if (x[i] < min) min = x[i];
-        if (x[i] > max) max = x[i];
-        float w = weights[i];
-        sum_w += w;
-        sum_x += w * x[i];
-    }
-    if (min > 0) min = 0;
-    if (max == min) {
-        for (int i = 0; i < n; ++i) L[i] = 0;
-        *the_min = -min;
-        return 0.F;
-    }
-    float iscale = nmax/(max - min);
-    float scale = 1/iscale;
-    float best_mad = 0;
-    for (int i = 0; i < n; ++i) {
-        int l = nearest_int(iscale*(x[i] - min));
-        L[i] = MAX(0, MIN(nmax, l));
-        float diff = scale * L[i] + min - x[i];
-        diff = use_mad ? fabsf(diff) : diff * diff;
-        float w = weights[i];
-        best_mad += w * diff;
-    }
-    if (nstep < 1) {
-        *the_min = -min;
-        return scale;
-    }
-    for (int is = 0; is <= nstep; ++is) {
-        iscale = (rmin + rdelta*is + nmax)/(max - min);
-        float sum_l = 0;
-        float sum_l2 = 0;
-        float sum_xl = 0;
-        for (int i = 0; i < n; ++i) {
-            int l = nearest_int(iscale*(x[i] - min));
-            l = MAX(0, MIN(nmax, l));
-            Laux[i] = l;
-            float w = weights[i];
-            sum_l += w*l;
-            sum_l2 += w*l*l;
-            sum_xl += w*l*x[i];
-        }
-        float D = sum_w * sum_l2 - sum_l * sum_l;
-        if (D > 0) {
-            float this_scale = (sum_w * sum_xl - sum_x * sum_l)/D;
-            float this_min   = (sum_l2 * sum_x - sum_l * sum_xl)/D;
-            if (this_min > 0) {
-                this_min = 0;
-                this_scale = sum_xl / sum_l2;
-            }
-            float mad = 0;
-            for (int i = 0; i < n; ++i) {
-                float diff = this_scale * Laux[i] + this_min - x[i];
-                diff = use_mad ? fabsf(diff) : diff * diff;
-                float w = weights[i];
-                mad += w * diff;
-            }
-            if (mad < best_mad) {
-                for (int i = 0; i < n; ++i) {
-                    L[i] = Laux[i];
-                }
-                best_mad = mad;
-                scale = this_scale;
-                min = this_min;
-            }
-        }
-    }
-    *the_min = -min;
-    return scale;
-}
 #if QK_K == 256
 static inline void get_scale_min_k4(int j, const uint8_t * __restrict q, uint8_t * __restrict d, uint8_t * __restrict m) {
     if (j < 4) {
@@ -184,7 +127,7 @@ static inline void get_scale_min_k4(int j, const uint8_t * __restrict q, uint8_t
 }
 #endif
 
-void quantize_row_q4_K_reference(const float * __restrict x, block_q4_K * __restrict y, int k) {
+void quantize_row_q4_K_reference(const float * __restrict x, block_q4_K * __restrict y, int k, const float * __restrict quant_weights) {
     assert(k % QK_K == 0);
     const int nb = k / QK_K;
 
@@ -198,12 +141,16 @@ void quantize_row_q4_K_reference(const float * __restrict x, block_q4_K * __rest
 
         float max_scale = 0; // as we are deducting the min, scales are always positive
         float max_min = 0;
+        const float sigma2 = quant_weights ? importance_sigma2(x, QK_K) : 0.F;
         for (int j = 0; j < QK_K/32; ++j) {
             //scales[j] = make_qkx1_quants(32, 15, x + 32*j, L + 32*j, &mins[j], 9, 0.5f);
             float sum_x2 = 0;
             for (int l = 0; l < 32; ++l) sum_x2 += x[32*j + l] * x[32*j + l];
             float av_x = sqrtf(sum_x2/32);
             for (int l = 0; l < 32; ++l) weights[l] = av_x + fabsf(x[32*j + l]);
+            if (quant_weights) {
+                for (int l = 0; l < 32; ++l) weights[l] = quant_weights[32*j + l] * sqrtf(sigma2 + x[32*j + l] * x[32*j + l]);
+            }
             scales[j] = make_qkx2_quants(32, 15, x + 32*j, weights, L + 32*j, &mins[j], Laux, -1.F, 0.1F, 20, false);
             float scale = scales[j];
             if (scale > max_scale) {
@@ -288,7 +235,7 @@ void quantize_row_q4_K_reference(const float * __restrict x, block_q4_K * __rest
         }
 
         x += QK_K;
-
+        if (quant_weights) { quant_weights += QK_K; }
     }
 }
 
@@ -335,5 +282,11 @@ void dequantize_row_q4_K(const block_q4_K * __restrict x, float * __restrict y,
 void quantize_row_q4_K(const float * __restrict x, void * __restrict vy, int k) {
     assert(k % QK_K == 0);
     block_q4_K * __restrict y = (block_q4_K *)vy;
-    quantize_row_q4_K_reference(x, y, k);
+    quantize_row_q4_K_reference(x, y, k, nullptr);
+}
+
+void quantize_row_q4_K_weighted(const float * __restrict x, void * __restrict vy, int k, const float * __restrict quant_weights) {
+    assert(k % QK_K == 0);
+    block_q4_K * __restrict y = (block_q4_K *)vy;
+    quantize_row_q4_K_reference(x, y, k, quant_weights);
 }
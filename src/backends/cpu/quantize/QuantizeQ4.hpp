@@ -32,8 +32,11 @@
 
 void quantize_row_q4_0(const float * __restrict x, void * __restrict y, int k);
 void dequantize_row_q4_0(const void * __restrict vx, float * __restrict y, int k);
+// @param quant_weights importance of each value of x, see ImportanceMatrix
+void quantize_row_q4_0_weighted(const float * __restrict x, void * __restrict y, int k, const float * __restrict quant_weights);
 
 
 void quantize_row_q4_K(const float * __restrict x, void * __restrict vy, int k);
+void quantize_row_q4_K_weighted(const float * __restrict x, void * __restrict vy, int k, const float * __restrict quant_weights);
 void dequantize_row_q4_K(const block_q4_K * __restrict x, float * __restrict y, int k);
 #endif // MLLM_QUANTIZEQ4_HPP
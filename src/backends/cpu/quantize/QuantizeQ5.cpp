@@ -0,0 +1,282 @@
+/*
+ * This code is based on ggml(https://github.com/ggerganov/ggml),
+ * please see https://github.com/ggerganov/ggml/blob/master/src/ggml.c
+ * ggml is licensed under MIT Copyright (c) 2022 Georgi Gerganov:
+ *
+ * MIT License
+ * Copyright (c) 2022 Georgi Gerganov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "QuantizeQ5.hpp"
+
+// ====================== 5-bit (de)-quantization
+
+static void quantize_row_q5_0_reference(const float *__restrict x, block_q5_0 *__restrict y, int k) {
+    static const int qk = QK5_0;
+
+    assert(k % qk == 0);
+
+    const int nb = k / qk;
+
+    for (int i = 0; i < nb; i++) {
+        float amax = 0.0F; // absolute max
+        float max = 0.0F;
+
+        for (int j = 0; j < qk; j++) {
+            const float v = x[i * qk + j];
+            if (amax < fabsf(v)) {
+                amax = fabsf(v);
+                max = v;
+            }
+        }
+
+        const float d = max / -16;
+        const float id = d ? 1.0F / d : 0.0F;
+
+        y[i].d = MLLM_FP32_TO_FP16(d);
+
+        uint32_t qh = 0;
+
+        for (int j = 0; j < qk / 2; ++j) {
+            const float x0 = x[i * qk + 0 + j] * id;
+            const float x1 = x[i * qk + qk / 2 + j] * id;
+
+            const uint8_t xi0 = MIN(31, (int8_t)(x0 + 16.5F));
+            const uint8_t xi1 = MIN(31, (int8_t)(x1 + 16.5F));
+
+            y[i].qs[j] = (xi0 & 0x0F) | ((xi1 & 0x0F) << 4);
+
+            // get the 5-th bit and store it in qh at the right position
+            qh |= ((xi0 & 0x10u) >> 4) << (j + 0);
+            qh |= ((xi1 & 0x10u) >> 4) << (j + qk / 2);
+        }
+
+        memcpy(&y[i].qh, &qh, sizeof(qh));
+    }
+}
+
+void quantize_row_q5_0(const float *__restrict x, void *__restrict y, int k) {
+    quantize_row_q5_0_reference(x, (block_q5_0 *)y, k);
+}
+
+void quantize_row_q5_0_weighted(const float *__restrict x, void *__restrict vy, int k, const float *__restrict quant_weights) {
+    static const int qk = QK5_0;
+    assert(k % qk == 0);
+    block_q5_0 *__restrict y = (block_q5_0 *)vy;
+    const int nb = k / qk;
+    const float sigma2 = importance_sigma2(x, k);
+
+    float weight[qk];
+    int8_t L[qk];
+    for (int i = 0; i < nb; i++) {
+        const float *xb = x + qk * i;
+        const float *qw = quant_weights + qk * i;
+        for (int j = 0; j < qk; ++j) weight[j] = qw[j] * sqrtf(sigma2 + xb[j] * xb[j]);
+        const float d = make_qx_quants(qk, 16, xb, L, 1, weight);
+        y[i].d = MLLM_FP32_TO_FP16(d);
+
+        uint32_t qh = 0;
+        for (int j = 0; j < qk / 2; ++j) {
+            const uint8_t xi0 = L[j];
+            const uint8_t xi1 = L[j + qk / 2];
+            y[i].qs[j] = (xi0 & 0x0F) | ((xi1 & 0x0F) << 4);
+            qh |= ((xi0 & 0x10u) >> 4) << (j + 0);
+            qh |= ((xi1 & 0x10u) >> 4) << (j + qk / 2);
+        }
+        memcpy(&y[i].qh, &qh, sizeof(qh));
+    }
+}
+
+void dequantize_row_q5_0(const block_q5_0 *__restrict x, float *__restrict y, int k) {
+    static const int qk = QK5_0;
+
+    assert(k % qk == 0);
+
+    const int nb = k / qk;
+
+    for (int i = 0; i < nb; i++) {
+        const float d = MLLM_FP16_TO_FP32(x[i].d);
+
+        uint32_t qh;
+        memcpy(&qh, x[i].qh, sizeof(qh));
+
+        for (int j = 0; j < qk / 2; ++j) {
+            const uint8_t xh_0 = ((qh >> (j + 0)) << 4) & 0x10;
+            const uint8_t xh_1 = ((qh >> (j + 12))) & 0x10;
+
+            const int32_t x0 = ((x[i].qs[j] & 0x0F) | xh_0) - 16;
+            const int32_t x1 = ((x[i].qs[j] >> 4) | xh_1) - 16;
+
+            y[i * qk + j + 0] = x0 * d;
+            y[i * qk + j + qk / 2] = x1 * d;
+        }
+    }
+}
+
+static inline void get_scale_min_k4(int j, const uint8_t *__restrict q, uint8_t *__restrict d, uint8_t *__restrict m) {
+    if (j < 4) {
+        *d = q[j] & 63;
+        *m = q[j + 4] & 63;
+    } else {
+        *d = (q[j + 4] & 0xF) | ((q[j - 4] >> 6) << 4);
+        *m = (q[j + 4] >> 4) | ((q[j - 0] >> 6) << 4);
+    }
+}
+
+static void quantize_row_q5_K_reference(const float *__restrict x, block_q5_K *__restrict y, int k, const float *__restrict quant_weights) {
+    assert(k % QK_K == 0);
+    assert(QK_K == 256);
+    const int nb = k / QK_K;
+
+    uint8_t L[QK_K];
+    float mins[QK_K / 32];
+    float scales[QK_K / 32];
+    float weights[32];
+    uint8_t Laux[32];
+
+    for (int i = 0; i < nb; i++) {
+        float max_scale = 0; // as we are deducting the min, scales are always positive
+        float max_min = 0;
+        const float sigma2 = quant_weights ? importance_sigma2(x, QK_K) : 0.F;
+        for (int j = 0; j < QK_K / 32; ++j) {
+            float sum_x2 = 0;
+            for (int l = 0; l < 32; ++l) sum_x2 += x[32 * j + l] * x[32 * j + l];
+            float av_x = sqrtf(sum_x2 / 32);
+            for (int l = 0; l < 32; ++l) weights[l] = av_x + fabsf(x[32 * j + l]);
+            if (quant_weights) {
+                for (int l = 0; l < 32; ++l) weights[l] = quant_weights[32 * j + l] * sqrtf(sigma2 + x[32 * j + l] * x[32 * j + l]);
+            }
+            scales[j] = make_qkx2_quants(32, 31, x + 32 * j, weights, L + 32 * j, &mins[j], Laux, -0.5F, 0.1F, 15, false);
+            float scale = scales[j];
+            if (scale > max_scale) {
+                max_scale = scale;
+            }
+            float min = mins[j];
+            if (min > max_min) {
+                max_min = min;
+            }
+        }
+
+        float inv_scale = max_scale > 0 ? 63.F / max_scale : 0.F;
+        float inv_min = max_min > 0 ? 63.F / max_min : 0.F;
+        for (int j = 0; j < QK_K / 32; ++j) {
+            uint8_t ls = nearest_int(inv_scale * scales[j]);
+            uint8_t lm = nearest_int(inv_min * mins[j]);
+            ls = MIN(63, ls);
+            lm = MIN(63, lm);
+            if (j < 4) {
+                y[i].scales[j] = ls;
+                y[i].scales[j + 4] = lm;
+            } else {
+                y[i].scales[j + 4] = (ls & 0xF) | ((lm & 0xF) << 4);
+                y[i].scales[j - 4] |= ((ls >> 4) << 6);
+                y[i].scales[j - 0] |= ((lm >> 4) << 6);
+            }
+        }
+        y[i].d = MLLM_FP32_TO_FP16(max_scale / 63.F);
+        y[i].dmin = MLLM_FP32_TO_FP16(max_min / 63.F);
+
+        uint8_t sc, m;
+        for (int j = 0; j < QK_K / 32; ++j) {
+            get_scale_min_k4(j, y[i].scales, &sc, &m);
+            const float d = MLLM_FP16_TO_FP32(y[i].d) * sc;
+            if (!d) continue;
+            const float dm = MLLM_FP16_TO_FP32(y[i].dmin) * m;
+            for (int ii = 0; ii < 32; ++ii) {
+                int l = nearest_int((x[32 * j + ii] + dm) / d);
+                l = MAX(0, MIN(31, l));
+                L[32 * j + ii] = l;
+            }
+        }
+
+        uint8_t *__restrict qh = y[i].qh;
+        uint8_t *__restrict ql = y[i].qs;
+        memset(qh, 0, QK_K / 8);
+
+        uint8_t m1 = 1, m2 = 2;
+        for (int n = 0; n < QK_K; n += 64) {
+            for (int j = 0; j < 32; ++j) {
+                int l1 = L[n + j];
+                if (l1 > 15) {
+                    l1 -= 16;
+                    qh[j] |= m1;
+                }
+                int l2 = L[n + j + 32];
+                if (l2 > 15) {
+                    l2 -= 16;
+                    qh[j] |= m2;
+                }
+                ql[j] = l1 | (l2 << 4);
+            }
+            m1 <<= 2;
+            m2 <<= 2;
+            ql += 32;
+        }
+
+        x += QK_K;
+        if (quant_weights) { quant_weights += QK_K; }
+    }
+}
+
+void quantize_row_q5_K(const float *__restrict x, void *__restrict vy, int k) {
+    assert(k % QK_K == 0);
+    block_q5_K *__restrict y = (block_q5_K *)vy;
+    quantize_row_q5_K_reference(x, y, k, nullptr);
+}
+
+void quantize_row_q5_K_weighted(const float *__restrict x, void *__restrict vy, int k, const float *__restrict quant_weights) {
+    assert(k % QK_K == 0);
+    block_q5_K *__restrict y = (block_q5_K *)vy;
+    quantize_row_q5_K_reference(x, y, k, quant_weights);
+}
+
+void dequantize_row_q5_K(const block_q5_K *__restrict x, float *__restrict y, int k) {
+    assert(k % QK_K == 0);
+    assert(QK_K == 256);
+    const int nb = k / QK_K;
+
+    for (int i = 0; i < nb; i++) {
+        const uint8_t *ql = x[i].qs;
+        const uint8_t *qh = x[i].qh;
+
+        const float d = MLLM_FP16_TO_FP32(x[i].d);
+        const float min = MLLM_FP16_TO_FP32(x[i].dmin);
+
+        int is = 0;
+        uint8_t sc, m;
+        uint8_t u1 = 1, u2 = 2;
+        for (int j = 0; j < QK_K; j += 64) {
+            get_scale_min_k4(is + 0, x[i].scales, &sc, &m);
+            const float d1 = d * sc;
+            const float m1 = min * m;
+            get_scale_min_k4(is + 1, x[i].scales, &sc, &m);
+            const float d2 = d * sc;
+            const float m2 = min * m;
+            for (int l = 0; l < 32; ++l) *y++ = d1 * ((ql[l] & 0xF) + (qh[l] & u1 ? 16 : 0)) - m1;
+            for (int l = 0; l < 32; ++l) *y++ = d2 * ((ql[l] >> 4) + (qh[l] & u2 ? 16 : 0)) - m2;
+            ql += 32;
+            is += 2;
+            u1 <<= 2;
+            u2 <<= 2;
+        }
+    }
+}
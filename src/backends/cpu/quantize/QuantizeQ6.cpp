@@ -29,7 +29,7 @@
 
 // ====================== 6-bit (de)-quantization
 
-void quantize_row_q6_K_reference(const float *__restrict x, block_q6_K *__restrict y, int k) {
+void quantize_row_q6_K_reference(const float *__restrict x, block_q6_K *__restrict y, int k, const float *__restrict quant_weights) {
     assert(k % QK_K == 0);
     const int nb = k / QK_K;
 
@@ -41,7 +41,7 @@ void quantize_row_q6_K_reference(const float *__restrict x, block_q6_K *__restri
         float max_abs_scale = 0;
 
         for (int ib = 0; ib < QK_K / 16; ++ib) {
-            const float scale = make_qx_quants(16, 32, x + 16 * ib, L + 16 * ib, 1);
+            const float scale = make_qx_quants(16, 32, x + 16 * ib, L + 16 * ib, 1, quant_weights ? quant_weights + 16 * ib : nullptr);
             scales[ib] = scale;
 
             const float abs_scale = fabsf(scale);
@@ -55,6 +55,7 @@ void quantize_row_q6_K_reference(const float *__restrict x, block_q6_K *__restri
             memset(&y[i], 0, sizeof(block_q6_K));
             y[i].d = MLLM_FP32_TO_FP16(0.f);
             x += QK_K;
+            if (quant_weights) { quant_weights += QK_K; }
             continue;
         }
 
@@ -104,6 +105,7 @@ void quantize_row_q6_K_reference(const float *__restrict x, block_q6_K *__restri
 #endif
 
         x += QK_K;
+        if (quant_weights) { quant_weights += QK_K; }
     }
 }
 
@@ -155,5 +157,11 @@ void dequantize_row_q6_K(const block_q6_K *__restrict x, float *__restrict y, in
 void quantize_row_q6_K(const float *__restrict x, void *__restrict vy, int k) {
     assert(k % QK_K == 0);
     block_q6_K *__restrict y = (block_q6_K *)vy;
-    quantize_row_q6_K_reference(x, y, k);
+    quantize_row_q6_K_reference(x, y, k, nullptr);
+}
+
+void quantize_row_q6_K_weighted(const float *__restrict x, void *__restrict vy, int k, const float *__restrict quant_weights) {
+    assert(k % QK_K == 0);
+    block_q6_K *__restrict y = (block_q6_K *)vy;
+    quantize_row_q6_K_reference(x, y, k, quant_weights);
 }
\ No newline at end of file
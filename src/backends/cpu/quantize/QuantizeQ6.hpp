@@ -31,6 +31,8 @@
 #include "Quantize.hpp"
 
 void quantize_row_q6_K(const float * __restrict x, void * __restrict y, int k);
+// @param quant_weights importance of each value of x, see ImportanceMatrix
+void quantize_row_q6_K_weighted(const float * __restrict x, void * __restrict vy, int k, const float * __restrict quant_weights);
 void dequantize_row_q6_K(const block_q6_K * __restrict x, float * __restrict y, int k);
 
 #endif // MLLM_QUANTIZEQ6_HPP
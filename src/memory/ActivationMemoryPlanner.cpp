@@ -0,0 +1,211 @@
+#include "ActivationMemoryPlanner.hpp"
+#include "Backend.hpp"
+#include "Tensor.hpp"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <functional>
+
+namespace mllm {
+
+ActivationMemoryPlanner *ActivationMemoryPlanner::active_ = nullptr;
+
+static constexpr size_t ARENA_ALIGNMENT = 128;
+
+ActivationMemoryPlanner::ActivationMemoryPlanner(Backend *bn) :
+    backend_(bn) {
+}
+
+ActivationMemoryPlanner::~ActivationMemoryPlanner() {
+    if (active_ == this) { active_ = nullptr; }
+    if (arena_ != nullptr) { backend_->free(arena_); }
+}
+
+bool ActivationMemoryPlanner::ownsMemory(const Tensor *tensor) const {
+    auto *ptr = (char *)tensor->rawHostPtr();
+    return tensor->isExternalHostPtr() && ptr >= (char *)arena_ && ptr < (char *)arena_ + arena_bytes_;
+}
+
+void ActivationMemoryPlanner::begin(const std::map<std::string, std::shared_ptr<Tensor>> &tensors, const std::vector<std::string> &exclude) {
+    assert(active_ == nullptr);
+    active_ = this;
+    op_index_ = 0;
+    candidates_.clear();
+    by_name_.clear();
+    requests_.clear();
+    spans_.clear();
+    for (const auto &item : tensors) {
+        auto *tensor = item.second.get();
+        if (tensor->backend() != backend_ || std::find(exclude.begin(), exclude.end(), item.first) != exclude.end()) {
+            continue;
+        }
+        candidates_.insert(tensor);
+        by_name_[item.first] = tensor;
+        // memory from the previous plan is about to be reused
+        if (tensor->masterTensor() == nullptr && ownsMemory(tensor)) {
+            tensor->host_ptr_ = nullptr;
+            tensor->external_host_ptr_ = false;
+            tensor->allocated_ = 0;
+        }
+    }
+}
+
+bool ActivationMemoryPlanner::deferAlloc(Tensor *tensor) {
+    if (active_ == nullptr || active_->candidates_.find(tensor) == active_->candidates_.end()) {
+        return false;
+    }
+    if (tensor->host_ptr_ != nullptr && !tensor->external_host_ptr_) {
+        tensor->backend_->free(tensor->host_ptr_);
+    }
+    tensor->host_ptr_ = nullptr;
+    tensor->external_host_ptr_ = false;
+    tensor->allocated_ = 0;
+    active_->requests_.push_back(tensor); // duplicates are merged in finish()
+    active_->write(tensor);
+    return true;
+}
+
+Tensor *ActivationMemoryPlanner::resolve(Tensor *tensor) const {
+    if (candidates_.find(tensor) != candidates_.end()) {
+        return tensor;
+    }
+    auto it = by_name_.find(tensor->name());
+    return it == by_name_.end() ? tensor : it->second;
+}
+
+void ActivationMemoryPlanner::read(Tensor *tensor) {
+    auto &spans = spans_[resolve(tensor)];
+    if (spans.empty()) {
+        spans.push_back({op_index_, op_index_});
+    } else {
+        spans.back().last = op_index_;
+    }
+}
+
+void ActivationMemoryPlanner::write(Tensor *tensor) {
+    auto &spans = spans_[resolve(tensor)];
+    if (spans.empty() || spans.back().last < op_index_) {
+        spans.push_back({op_index_, op_index_});
+    }
+}
+
+void ActivationMemoryPlanner::recordUses(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs) {
+    if (active_ == nullptr) {
+        return;
+    }
+    for (auto *tensor : inputs) {
+        active_->read(tensor);
+    }
+    for (auto *tensor : outputs) {
+        active_->write(tensor);
+    }
+    active_->op_index_++;
+}
+
+void ActivationMemoryPlanner::finish(const std::vector<Tensor *> &outputs) {
+    assert(active_ == this);
+    active_ = nullptr;
+    auto root_of = [](Tensor *tensor) {
+        while (tensor->masterTensor() != nullptr) { tensor = tensor->masterTensor(); }
+        return tensor;
+    };
+    // visits `tensor` and every child that still views its memory
+    std::function<void(Tensor *, const std::function<void(Tensor *)> &)> for_subtree =
+        [&](Tensor *tensor, const std::function<void(Tensor *)> &visit) {
+            visit(tensor);
+            for (auto *child : tensor->childTensors()) {
+                if (child->masterTensor() == tensor) { for_subtree(child, visit); }
+            }
+        };
+
+    struct Block {
+        Tensor *root;
+        size_t bytes;
+        vector<Span> spans;
+        size_t offset = 0;
+    };
+    vector<Block> blocks;
+    std::unordered_map<Tensor *, size_t> block_of_root;
+    requested_bytes_ = 0;
+    for (auto *tensor : requests_) {
+        if (tensor->masterTensor() != nullptr || tensor->aggregated_ || tensor->count() == 0) {
+            continue; // became a view of another tensor, which owns the memory
+        }
+        if (block_of_root.count(tensor)) { continue; }
+        Block block{tensor, 0, {}};
+        if (tensor->childTensors().empty()) {
+            block.spans = spans_[tensor];
+        } else {
+            // children write parts of the root, so one of them writing does not end the root's other data
+            Span all{INT_MAX, -1};
+            for_subtree(tensor, [&](Tensor *t) {
+                for (auto &span : spans_[t]) {
+                    all.first = std::min(all.first, span.first);
+                    all.last = std::max(all.last, span.last);
+                }
+            });
+            block.spans = {all};
+        }
+        // same padding as Tensor::alloc
+        block.bytes = (tensor->cntSize() + 16 + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+        requested_bytes_ += block.bytes;
+        block_of_root[tensor] = blocks.size();
+        blocks.push_back(block);
+    }
+    for (auto *output : outputs) {
+        auto it = block_of_root.find(root_of(output));
+        if (it != block_of_root.end()) { blocks[it->second].spans.back().last = INT_MAX; }
+    }
+    auto overlap = [](const vector<Span> &a, const vector<Span> &b) {
+        // both are sorted and disjoint
+        size_t i = 0, j = 0;
+        while (i < a.size() && j < b.size()) {
+            if (a[i].first <= b[j].last && b[j].first <= a[i].last) { return true; }
+            if (a[i].last < b[j].last) {
+                ++i;
+            } else {
+                ++j;
+            }
+        }
+        return false;
+    };
+
+    // greedy by size: larger tensors first, each at the lowest offset free whenever it is live
+    vector<size_t> order(blocks.size());
+    for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return blocks[a].bytes > blocks[b].bytes; });
+    vector<size_t> placed;
+    planned_bytes_ = 0;
+    for (auto i : order) {
+        auto &block = blocks[i];
+        vector<std::pair<size_t, size_t>> busy;
+        for (auto j : placed) {
+            if (overlap(block.spans, blocks[j].spans)) { busy.emplace_back(blocks[j].offset, blocks[j].offset + blocks[j].bytes); }
+        }
+        std::sort(busy.begin(), busy.end());
+        size_t offset = 0;
+        for (auto &range : busy) {
+            if (range.first >= offset + block.bytes) { break; }
+            offset = std::max(offset, range.second);
+        }
+        block.offset = offset;
+        planned_bytes_ = std::max(planned_bytes_, offset + block.bytes);
+        placed.push_back(i);
+    }
+
+    if (planned_bytes_ > arena_bytes_) {
+        // grow geometrically, decoding lengthens the attention tensors a little every step
+        if (arena_ != nullptr) { backend_->free(arena_); }
+        arena_bytes_ = std::max(planned_bytes_, arena_bytes_ + arena_bytes_ / 2);
+        backend_->alloc(&arena_, arena_bytes_, ARENA_ALIGNMENT);
+    }
+    for (auto &block : blocks) {
+        void *ptr = (char *)arena_ + block.offset;
+        block.root->setExternalHostPtr(ptr);
+        for_subtree(block.root, [&](Tensor *t) {
+            if (t != block.root) { t->forceResetHostPointer(ptr); }
+        });
+    }
+}
+
+} // namespace mllm
@@ -0,0 +1,106 @@
+//
+// Liveness-based placement of activations in one arena.
+//
+
+#ifndef MLLM_ACTIVATIONMEMORYPLANNER_H
+#define MLLM_ACTIVATIONMEMORYPLANNER_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace mllm {
+class Backend;
+class Tensor;
+
+/**
+ * \brief Plans the memory of a Module's activations from their lifetimes during the TENSOR_STATIC_INIT forward.
+ *
+ * Between begin() and finish(), Tensor::alloc of a planned activation only records the request, and every op
+ * reports the tensors it reads and writes through recordUses(); copies of an activation (as passed around by
+ * Module::Forward) count as the activation of the same name. A tensor is live from each write to its last
+ * read before the next write; layers named with the same "X" share one tensor, which is then live once per
+ * layer. Tensors with child tensors are kept live from their first to their last use of any child. finish()
+ * places the tensors in a single arena (greedy by size) so that tensors which are never live at the same op
+ * share bytes. The TENSOR_STATIC_READY forward runs the ops in the same order, so a live tensor is never
+ * overwritten.
+ *
+ * Planned tensors see the arena as external memory: an op that grows a tensor during execute gets a fresh
+ * allocation from its backend as before. Only one planner is active at a time.
+ */
+class ActivationMemoryPlanner {
+public:
+    explicit ActivationMemoryPlanner(Backend *bn);
+    ~ActivationMemoryPlanner();
+    ActivationMemoryPlanner(const ActivationMemoryPlanner &) = delete;
+    ActivationMemoryPlanner &operator=(const ActivationMemoryPlanner &) = delete;
+
+    /**
+     * \brief start planning the tensors in `tensors` except those named in `exclude` (e.g. user inputs).
+     */
+    void begin(const std::map<std::string, std::shared_ptr<Tensor>> &tensors, const std::vector<std::string> &exclude = {});
+    /**
+     * \brief place the requested tensors, `outputs` stay live after the last op.
+     */
+    void finish(const std::vector<Tensor *> &outputs);
+
+    static bool planning() {
+        return active_ != nullptr;
+    }
+    /**
+     * \brief called by Tensor::alloc, true if the allocation is deferred to the active planner.
+     */
+    static bool deferAlloc(Tensor *tensor);
+    /**
+     * \brief called once per op during planning with the tensors it reads and writes.
+     */
+    static void recordUses(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs);
+
+    size_t arenaBytes() const {
+        return arena_bytes_;
+    }
+    /**
+     * \return bytes the last plan would have taken with one allocation per tensor.
+     */
+    size_t requestedBytes() const {
+        return requested_bytes_;
+    }
+    /**
+     * \return bytes of the arena actually used by the last plan.
+     */
+    size_t plannedBytes() const {
+        return planned_bytes_;
+    }
+
+private:
+    struct Span {
+        int first;
+        int last;
+    };
+
+    Backend *backend_;
+    void *arena_ = nullptr;
+    size_t arena_bytes_ = 0;
+    size_t requested_bytes_ = 0;
+    size_t planned_bytes_ = 0;
+    int op_index_ = 0;
+    std::unordered_set<Tensor *> candidates_;
+    std::unordered_map<std::string, Tensor *> by_name_;
+    std::vector<Tensor *> requests_;
+    std::unordered_map<Tensor *, std::vector<Span>> spans_; // live ranges in op order
+
+    static ActivationMemoryPlanner *active_;
+
+    bool ownsMemory(const Tensor *tensor) const;
+    Tensor *resolve(Tensor *tensor) const;
+    void read(Tensor *tensor);
+    void write(Tensor *tensor);
+};
+
+} // namespace mllm
+
+#endif // MLLM_ACTIVATIONMEMORYPLANNER_H
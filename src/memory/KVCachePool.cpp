@@ -0,0 +1,60 @@
+#include "KVCachePool.hpp"
+#include "Backend.hpp"
+#include <cassert>
+
+namespace mllm {
+
+std::map<std::pair<Backend *, size_t>, KVCachePool *> &KVCachePool::pools() {
+    static std::map<std::pair<Backend *, size_t>, KVCachePool *> pools;
+    return pools;
+}
+
+KVCachePool &KVCachePool::get(Backend *bn, size_t block_bytes) {
+    static std::mutex registry_mutex;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto &all = pools();
+    auto it = all.find({bn, block_bytes});
+    if (it == all.end()) {
+        // pools live as long as the process, blocks may still be referenced by caches at exit
+        it = all.emplace(std::make_pair(bn, block_bytes), new KVCachePool(bn, block_bytes)).first;
+    }
+    return *it->second;
+}
+
+KVCachePool::KVCachePool(Backend *bn, size_t block_bytes, int blocks_per_chunk) :
+    backend_(bn), block_bytes_(block_bytes), blocks_per_chunk_(blocks_per_chunk) {
+    assert(block_bytes_ > 0 && blocks_per_chunk_ > 0);
+}
+
+KVCachePool::~KVCachePool() {
+    for (auto *chunk : chunks_) {
+        backend_->free(chunk);
+    }
+}
+
+int KVCachePool::allocBlock() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_blocks_.empty()) {
+        void *chunk = nullptr;
+        backend_->alloc(&chunk, block_bytes_ * blocks_per_chunk_, 128);
+        int base = (int)chunks_.size() * blocks_per_chunk_;
+        chunks_.push_back(chunk);
+        // hand out low ids first
+        for (int i = blocks_per_chunk_ - 1; i >= 0; --i) {
+            free_blocks_.push_back(base + i);
+        }
+    }
+    int block_id = free_blocks_.back();
+    free_blocks_.pop_back();
+    used_blocks_++;
+    return block_id;
+}
+
+void KVCachePool::freeBlock(int block_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(block_id >= 0 && block_id < totalBlocks());
+    free_blocks_.push_back(block_id);
+    used_blocks_--;
+}
+
+} // namespace mllm
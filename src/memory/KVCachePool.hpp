@@ -0,0 +1,68 @@
+//
+// Paged storage for KV caches.
+//
+
+#ifndef MLLM_KVCACHEPOOL_H
+#define MLLM_KVCACHEPOOL_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mllm {
+class Backend;
+
+/**
+ * \brief A pool of fixed-size KV blocks shared by every paged KVCache of a Backend with the same block geometry.
+ *
+ * Blocks are carved out of chunks allocated through the Backend's memory manager, so the pool only
+ * grows when the live context grows. Freed blocks go back to a free list and are handed to the next
+ * caller, whichever layer or session that is. Blocks are identified by an int id; blockPtr(id) is
+ * stable for the lifetime of the pool.
+ */
+class KVCachePool {
+public:
+    /**
+     * \brief get the pool for blocks of `block_bytes` bytes, creating it on first use.
+     * \param bn backend used to allocate chunks.
+     * \param block_bytes size of one block in bytes.
+     */
+    static KVCachePool &get(Backend *bn, size_t block_bytes);
+
+    KVCachePool(Backend *bn, size_t block_bytes, int blocks_per_chunk = 64);
+    ~KVCachePool();
+    KVCachePool(const KVCachePool &) = delete;
+    KVCachePool &operator=(const KVCachePool &) = delete;
+
+    int allocBlock();
+    void freeBlock(int block_id);
+    void *blockPtr(int block_id) const {
+        return (char *)chunks_[block_id / blocks_per_chunk_] + (size_t)(block_id % blocks_per_chunk_) * block_bytes_;
+    }
+    size_t blockBytes() const {
+        return block_bytes_;
+    }
+    int usedBlocks() const {
+        return used_blocks_;
+    }
+    int totalBlocks() const {
+        return (int)chunks_.size() * blocks_per_chunk_;
+    }
+
+private:
+    Backend *backend_;
+    size_t block_bytes_;
+    int blocks_per_chunk_;
+    int used_blocks_ = 0;
+    std::vector<void *> chunks_;
+    std::vector<int> free_blocks_;
+    std::mutex mutex_;
+
+    static std::map<std::pair<Backend *, size_t>, KVCachePool *> &pools();
+};
+
+} // namespace mllm
+
+#endif // MLLM_KVCACHEPOOL_H
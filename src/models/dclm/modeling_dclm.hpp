@@ -179,6 +179,7 @@ public:
             x = layer({x})[0];
         }
 
+        x = logitsRows(x);
         x = norm(x);
         auto out = Tensor::mm(x, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
         return {out};
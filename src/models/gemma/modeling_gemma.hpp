@@ -121,6 +121,7 @@ public:
 
         // go through model
         auto outputs = model({x})[0];
+        outputs = logitsRows(outputs);
         outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
         return {outputs};
     }
@@ -71,6 +71,11 @@ public:
     int block_num{};
     RoPEType RoPE_type;
     int cache_limit{};
+    int kv_block_size = 0; // > 0: paged KV cache with blocks of this many tokens
+    int kv_sink_size = 4;  // tokens always kept when the KV cache evicts
+    int kv_evict_size = 0; // > 0: evict this many tokens at a time when the KV cache is full
+    DataType kv_k_dtype = MLLM_TYPE_F16; // Q8_0 / Q4_0: keys quantized on append, read through flash attention
+    DataType kv_v_dtype = MLLM_TYPE_F16;
     LLaMANameConfig names_config;
     float rope_theta;
     int max_position_embeddings;
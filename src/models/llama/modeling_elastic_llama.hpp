@@ -176,6 +176,7 @@ public:
         for (int id = 0; id < blocks.size(); id++) {
             x = blocks[id]({x}, activate_dims[id])[0];
         }
+        x = logitsRows(x);
         x = norm(x);
         x = lm_head(x);
         return {x};
@@ -17,6 +17,7 @@ class LLaMAMLP final : public Module {
     Layer silu;
     Layer up_proj;
     Layer down_proj;
+    MergedLinear gate_up_proj;
 
 public:
     LLaMAMLP() = default;
@@ -25,11 +26,22 @@ public:
         silu = SiLU(base_name + "act");
         up_proj = Linear(hidden_dim, ffn_hidden, false, base_name + names._up_proj_name);
         down_proj = Linear(ffn_hidden, hidden_dim, false, base_name + names._down_proj_name);
+        if (Module::merge_projections) {
+            gate_up_proj = MergedLinear(hidden_dim, {ffn_hidden, ffn_hidden}, false,
+                                        {base_name + names._gate_proj_name, base_name + names._up_proj_name});
+        }
     }
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
-        auto x = gate_proj(inputs[0]);
+        Tensor x, y;
+        if (gate_up_proj.ready()) {
+            auto gate_up = gate_up_proj(inputs[0]);
+            x = gate_up[0];
+            y = gate_up[1];
+        } else {
+            x = gate_proj(inputs[0]);
+            y = up_proj(inputs[0]);
+        }
         x = silu(x);
-        auto y = up_proj(inputs[0]);
         x = x * y;
         x = down_proj(x);
         return {x};
@@ -44,9 +56,12 @@ class LLaMABlock final : public Module {
 
 public:
     LLaMABlock() = default;
-    LLaMABlock(int hidden_dim, int head_size, int kv_head_size, int ffn_hidden, RoPEType RoPE_type, float rope_theta, int max_position_embeddings, int cache_limit, const LLaMANameConfig &names, const string &base_name) {
+    LLaMABlock(int hidden_dim, int head_size, int kv_head_size, int ffn_hidden, RoPEType RoPE_type, float rope_theta, int max_position_embeddings, int cache_limit, const LLaMANameConfig &names, const string &base_name) :
+        LLaMABlock(hidden_dim, head_size, kv_head_size, ffn_hidden, RoPE_type, rope_theta, max_position_embeddings, cache_limit, 0, names, base_name) {
+    }
+    LLaMABlock(int hidden_dim, int head_size, int kv_head_size, int ffn_hidden, RoPEType RoPE_type, float rope_theta, int max_position_embeddings, int cache_limit, int kv_block_size, const LLaMANameConfig &names, const string &base_name) {
         attention = MultiHeadAttention(hidden_dim, head_size, kv_head_size, hidden_dim / head_size, SPLIT_NONE, false, false,
-                                       RoPE_type, rope_theta, max_position_embeddings, cache_limit, true, false, names, base_name + names._attn_base_name);
+                                       RoPE_type, rope_theta, max_position_embeddings, cache_limit, true, false, names, base_name + names._attn_base_name, kv_block_size);
         mlp = LLaMAMLP(hidden_dim, ffn_hidden, names, base_name + names._ffn_base_name);
         norm1 = RMSNorm(hidden_dim, 1e-6, base_name + names._attn_norm_name);
         norm2 = RMSNorm(hidden_dim, 1e-6, base_name + names._ffn_norm_name);
@@ -76,12 +91,22 @@ public:
     explicit LLaMAModel(const LLaMAConfig &config) :
         LLaMAModel(config.vocab_size, config.hidden_dim, config.head_size, config.num_key_value_heads, config.ffn_hidden, config.block_num,
                    config.RoPE_type, config.rope_theta, config.max_position_embeddings, config.cache_limit,
-                   config.names_config, config.names_config.blk_name) {
+                   config.names_config, config.names_config.blk_name, config.kv_block_size) {
+        if (config.kv_evict_size > 0) {
+            for (auto &block : blocks) {
+                for (auto &cache : block.get_attention().get_cache()) { cache->setEviction(config.kv_sink_size, config.kv_evict_size); }
+            }
+        }
+        for (auto &block : blocks) {
+            auto caches = block.get_attention().get_cache();
+            caches[0]->setCacheDtype(config.kv_k_dtype);
+            caches[1]->setCacheDtype(config.kv_v_dtype);
+        }
     }
     LLaMAModel(int vocab_size, int hidden_dim, int head_size, int kv_head_size, int ffn_hidden, int block_num, RoPEType RoPE_type, float rope_theta, int max_position_embeddings, int cache_limit,
-               const LLaMANameConfig &names, const string &base_name) {
+               const LLaMANameConfig &names, const string &base_name, int kv_block_size = 0) {
         embedding = Embedding(vocab_size, hidden_dim, names.token_embd_name);
-        blocks = List<LLaMABlock>(block_num, hidden_dim, head_size, kv_head_size, ffn_hidden, RoPE_type, rope_theta, max_position_embeddings, cache_limit, names, base_name);
+        blocks = List<LLaMABlock>(block_num, hidden_dim, head_size, kv_head_size, ffn_hidden, RoPE_type, rope_theta, max_position_embeddings, cache_limit, kv_block_size, names, base_name);
         norm = RMSNorm(hidden_dim, 1e-6, names.post_norm_name);
         lm_head = Linear(hidden_dim, vocab_size, false, names.lm_head_name);
     }
@@ -90,6 +115,7 @@ public:
         for (auto &block : blocks) {
             x = block({x})[0];
         }
+        x = logitsRows(x);
         x = norm(x);
         x = lm_head(x);
         return {x};
@@ -103,6 +129,14 @@ public:
             for (auto &rope : ropes) { rope->clearCache(); }
         }
     }
+    vector<KVCache *> get_kvcache() override {
+        vector<KVCache *> caches;
+        for (auto &block : blocks) {
+            auto kvcache = block.get_attention().get_cache();
+            caches.insert(caches.end(), kvcache.begin(), kvcache.end());
+        }
+        return caches;
+    }
 };
 
 #endif // MODELING_LLAMA_HPP
\ No newline at end of file
@@ -121,6 +121,7 @@ public:
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
         auto x = embedding(inputs[0]) * scale_emb;
         auto outputs = model({x})[0];
+        outputs = logitsRows(outputs);
         outputs = outputs / (hidden_size / dim_model_base);
         outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
         return {outputs};
@@ -114,6 +114,7 @@ public:
 
         // go through model
         auto outputs = model({x})[0];
+        outputs = logitsRows(outputs);
         outputs = lm_head(outputs);
         return {outputs};
     }
@@ -210,6 +210,7 @@ public:
             hidden_states = it({hidden_states})[0];
         }
 
+        hidden_states = logitsRows(hidden_states);
         hidden_states = norm(hidden_states);
 
         // tied embeddings
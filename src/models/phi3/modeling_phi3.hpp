@@ -90,6 +90,7 @@ public:
         for (auto &block : blocks) {
             x = block({x})[0];
         }
+        x = logitsRows(x);
         x = norm(x);
         x = lm_head(x);
         return {x};
@@ -206,6 +206,7 @@ public:
 
         // go through model
         auto outputs = model({x})[0];
+        outputs = logitsRows(outputs);
         if (tie_embedding_words) {
             outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
         } else {
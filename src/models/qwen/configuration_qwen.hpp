@@ -157,6 +157,8 @@ struct QWenConfig : public TransformerConfig {
     bool tie_embedding_words = false;
 
     int cache_limit;
+    DataType kv_k_dtype = MLLM_TYPE_F16; // Q8_0 / Q4_0: KV cache quantized on append
+    DataType kv_v_dtype = MLLM_TYPE_F16;
     RoPEType RoPE_type = RoPEType::HFHUBROPE;
     QWenNameConfig names_config;
 };
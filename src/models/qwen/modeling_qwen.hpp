@@ -75,9 +75,9 @@ public:
                       base_name + "k_rope");
         k_cache = KVCache(num_key_value_groups, config.cache_limit, base_name + "k_cache");
         v_cache = KVCache(num_key_value_groups, config.cache_limit, base_name + "v_cache");
-        // mask = SlidingWindowMask(config.sliding_window, base_name + "mask");
-        mask = Causalmask(base_name + "mask");
-        softmax = Softmax(DIMENSION, base_name + "softmax");
+        k_cache.setCacheDtype(config.kv_k_dtype);
+        v_cache.setCacheDtype(config.kv_v_dtype);
+        sdpa = ScaledDotProductAttention(true, base_name + "sdpa");
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
@@ -95,18 +95,12 @@ public:
         key_states = k_rope(key_states);
 
         // kv cache
+        k_cache.bindRoPE(k_rope, {&q_rope});
         key_states = k_cache(key_states);
         value_states = v_cache(value_states);
 
-        // attention weight
-        auto atten_weight =
-            Tensor::mm(query_states, key_states.transpose(Chl::SEQUENCE, Chl::DIMENSION))
-            / std::sqrt(head_dim);
-        atten_weight = mask(atten_weight, k_cache.getCacheSeqLen());
-        atten_weight = softmax(atten_weight, k_cache.getCacheSeqLen());
-
-        // attention output
-        auto atten_output = Tensor::mm(atten_weight, value_states);
+        // attention output, fused softmax(q k^T / sqrt(d)) v
+        auto atten_output = sdpa(query_states, key_states, value_states, k_cache.getCacheSeqLen());
         atten_output = atten_output.view(-1, 1, -1, head_dim * num_heads);
         atten_output = o_proj(atten_output);
         return {atten_output};
@@ -133,8 +127,7 @@ private:
     RoPE k_rope;
     KVCache k_cache;
     KVCache v_cache;
-    Causalmask mask;
-    Softmax softmax;
+    ScaledDotProductAttention sdpa;
 };
 
 // Copied from GemmaDecoder with Gemma->Qwen and set RmsNorm(without add_unit_offset)
@@ -196,6 +189,14 @@ public:
             for (auto &rope : ropes) { rope->clearCache(); }
         }
     }
+    vector<KVCache *> get_kvcache() override {
+        vector<KVCache *> caches;
+        for (auto &block : blocks) {
+            auto kvcache = block.get_attention().get_cache();
+            caches.insert(caches.end(), kvcache.begin(), kvcache.end());
+        }
+        return caches;
+    }
 
 private:
     std::vector<QWenDecoder> blocks;
@@ -227,6 +228,7 @@ public:
 
         // go through model
         auto outputs = model({x})[0];
+        outputs = logitsRows(outputs);
         if (tie_embedding_words) {
             outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
         } else {
@@ -237,6 +239,9 @@ public:
     void clear_kvcache() override {
         model.clear_kvcache();
     }
+    vector<KVCache *> get_kvcache() override {
+        return model.get_kvcache();
+    }
 
 private:
     int hidden_size;
@@ -97,6 +97,7 @@ public:
         for (auto &block : blocks) {
             x = block({x})[0];
         }
+        x = logitsRows(x);
         x = norm(x);
         x = Tensor::mm(x, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
         return {x};
@@ -147,6 +147,7 @@ public:
             x = block({x})[0];
         }
 
+        x = logitsRows(x);
         x = norm(x);
         x = lm_head(x);
         return {x};
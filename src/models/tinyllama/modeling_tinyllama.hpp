@@ -36,6 +36,10 @@ public:
         x = x + tmp;
         return {x};
     }
+
+    MultiHeadAttention &get_attention() {
+        return attention;
+    }
 };
 
 class TinyLLaMAModel final : public Module {
@@ -63,10 +67,28 @@ public:
         for (auto &block : blocks) {
             x = block({x})[0];
         }
+        x = logitsRows(x);
         x = norm(x);
         x = lm_head(x);
         return {x};
     }
+
+    void clear_kvcache() override {
+        for (auto &block : blocks) {
+            auto kvcache = block.get_attention().get_cache();
+            for (auto &cache : kvcache) { cache->clearCache(); }
+            auto ropes = block.get_attention().get_rope();
+            for (auto &rope : ropes) { rope->clearCache(); }
+        }
+    }
+    vector<KVCache *> get_kvcache() override {
+        vector<KVCache *> caches;
+        for (auto &block : blocks) {
+            auto kvcache = block.get_attention().get_cache();
+            caches.insert(caches.end(), kvcache.begin(), kvcache.end());
+        }
+        return caches;
+    }
 };
 
 #endif // MODELING_TINYLLAMA_HPP
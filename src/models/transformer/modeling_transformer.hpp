@@ -17,6 +17,7 @@ class MultiHeadAttention final : public Module {
     Layer q_proj;
     Layer k_proj;
     Layer v_proj;
+    MergedLinear qkv_merged;
     RoPE q_rope;
     RoPE k_rope;
     Layer q_norm;
@@ -24,6 +25,7 @@ class MultiHeadAttention final : public Module {
     KVCache k_cache;
     KVCache v_cache;
     Softmax softmax;
+    ScaledDotProductAttention sdpa;
     Layer o_proj;
     Parameter bias_k;
     Parameter bias_v;
@@ -31,14 +33,18 @@ class MultiHeadAttention final : public Module {
     int kv_head_size_{};
     int attn_hidden_dim_{};
     Chl split_chl_{};
+    bool paged_kv_ = false;
 
 public:
+    // fused tiled attention (SDPA op) instead of mm + softmax + mm; the score matrix is never materialized
+    static inline bool use_flash_attention = true;
+
     MultiHeadAttention() = default;
     MultiHeadAttention(int hidden_dim, int head_size, int kv_head_size, int attn_hidden_dim,
                        AttnQKVSplitType do_qkv_proj, bool post_qkv_norm, bool bias_kv_cat,
                        RoPEType RoPE_type, float rope_theta, int max_position_embeddings,
                        int cache_limit, bool do_mask, bool bias,
-                       const TransformerNameConfig &names, const string &base_name) {
+                       const TransformerNameConfig &names, const string &base_name, int kv_block_size = 0) {
         attn_hidden_dim_ = attn_hidden_dim;
         head_size_ = head_size;
         kv_head_size_ = kv_head_size;
@@ -49,6 +55,10 @@ public:
             q_proj = Linear(hidden_dim, head_size * attn_hidden_dim, bias, base_name + names._q_proj_name);
             k_proj = Linear(hidden_dim, kv_head_size * attn_hidden_dim, bias, base_name + names._k_proj_name);
             v_proj = Linear(hidden_dim, kv_head_size * attn_hidden_dim, bias, base_name + names._v_proj_name);
+            if (Module::merge_projections) {
+                qkv_merged = MergedLinear(hidden_dim, {head_size * attn_hidden_dim, kv_head_size * attn_hidden_dim, kv_head_size * attn_hidden_dim}, bias,
+                                          {base_name + names._q_proj_name, base_name + names._k_proj_name, base_name + names._v_proj_name});
+            }
         }
         if (post_qkv_norm) {
             q_norm = LayerNorm(attn_hidden_dim, true, 1e-6, base_name + names._q_norm_name);
@@ -58,11 +68,16 @@ public:
             q_rope = RoPE(RoPE_type, rope_theta, max_position_embeddings, base_name + "q_rope");
             k_rope = RoPE(RoPE_type, rope_theta, max_position_embeddings, base_name + "k_rope");
         }
-        if (cache_limit > 0) {
+        if (cache_limit > 0 && kv_block_size > 0) {
+            k_cache = KVCache(head_size / kv_head_size, cache_limit, kv_block_size, base_name + "k_cache");
+            v_cache = KVCache(head_size / kv_head_size, cache_limit, kv_block_size, base_name + "v_cache");
+            paged_kv_ = true;
+        } else if (cache_limit > 0) {
             k_cache = KVCache(head_size / kv_head_size, cache_limit, base_name + "k_cache");
             v_cache = KVCache(head_size / kv_head_size, cache_limit, base_name + "v_cache");
         }
         softmax = Softmax(DIMENSION, do_mask, base_name + "softmax");
+        sdpa = ScaledDotProductAttention(do_mask, base_name + "sdpa");
         o_proj = Linear(head_size * attn_hidden_dim, hidden_dim, bias, base_name + names._o_proj_name);
         if (bias_kv_cat) {
             bias_k = Parameter(1, 1, head_size, attn_hidden_dim, base_name + "bias_k");
@@ -78,9 +93,17 @@ public:
             k = qkv_sp[1];
             v = qkv_sp[2];
         } else {
-            q = q_proj(inputs[0]);
-            k = k_proj(inputs[1]);
-            v = v_proj(inputs[2]);
+            // self-attention only, the separate projections are never run (or loaded) then
+            if (qkv_merged.ready() && inputs[1].name() == inputs[0].name() && inputs[2].name() == inputs[0].name()) {
+                auto qkv = qkv_merged(inputs[0]);
+                q = qkv[0];
+                k = qkv[1];
+                v = qkv[2];
+            } else {
+                q = q_proj(inputs[0]);
+                k = k_proj(inputs[1]);
+                v = v_proj(inputs[2]);
+            }
             q = q.view(-1, head_size_, -1, attn_hidden_dim_);
             k = k.view(-1, kv_head_size_, -1, attn_hidden_dim_);
             v = v.view(-1, kv_head_size_, -1, attn_hidden_dim_);
@@ -98,11 +121,30 @@ public:
             k = k_rope(k);
         }
         if (k_cache.ready() && v_cache.ready()) {
+            if (q_rope.ready() && k_rope.ready()) {
+                k_cache.bindRoPE(k_rope, {&q_rope});
+            }
             k = k_cache(k);
             v = v_cache(v);
         }
-        k = k.transpose(SEQUENCE, DIMENSION);
-        auto qk = Tensor::mm(q, k);
+        if (use_flash_attention || k_cache.quantized() || v_cache.quantized()) {
+            Tensor o;
+            if (k_cache.ready() && v_cache.ready()) {
+                o = sdpa(q, k, v, k_cache.getCacheSeqLen());
+            } else {
+                o = sdpa(q, k, v);
+            }
+            o = o.view(-1, 1, -1, attn_hidden_dim_ * head_size_);
+            o = o_proj(o);
+            return {o};
+        }
+        Tensor qk;
+        if (paged_kv_) {
+            qk = Tensor::mm(q, k, true);
+        } else {
+            k = k.transpose(SEQUENCE, DIMENSION);
+            qk = Tensor::mm(q, k);
+        }
         qk = qk / std::sqrt(attn_hidden_dim_);
         if (k_cache.ready() && v_cache.ready()) {
             qk = softmax(qk, k_cache.getCacheSeqLen());
@@ -35,24 +35,40 @@ void ParamWriter::writeIndex() {
 }
 
 void ParamWriter::writeParam(string name, DataType type, void *data, uint64_t size) {
+    beginParam(std::move(name), type);
+    writeParamData(data, size);
+    auto foff_size = endParam();
+    if (foff_size != size) {
+        std::cout << "Assertion failed: foff_size (" << foff_size << ") != size (" << size << ")" << std::endl;
+    }
+    assert(foff_size == size);
+}
+void ParamWriter::beginParam(string name, DataType type) {
     auto &param = param_info_[index_];
     param.name = std::move(name);
     param.type = type;
+    // pad so that the weights can be used in place when the file is mmap-ed.
+    auto pos = ftell(fp_);
+    auto padding = (MLLM_PARAM_ALIGNMENT - pos % MLLM_PARAM_ALIGNMENT) % MLLM_PARAM_ALIGNMENT;
+    if (padding > 0) {
+        char zeros[MLLM_PARAM_ALIGNMENT] = {0};
+        fwrite(zeros, sizeof(char), padding, fp_);
+    }
     param.offset = ftell(fp_);
+}
+void ParamWriter::writeParamData(const void *data, uint64_t size) {
     auto status = fwrite(data, sizeof(char), size, fp_);
-    fflush(fp_);  // make sure the data is written to the file immediately
     if (status != size) {
         // if write failed, print the error message and exit
         std::cout<<"fwrite error"<<status<<"!="<<size<<std::endl;
     }
-    auto foff_size_after = ftell(fp_);
-    auto foff_size = foff_size_after - param.offset;
-    if (foff_size != size) {
-        std::cout << "Assertion failed: foff_size (" << foff_size << ") != size (" << size << ")" << std::endl;
-    }
-    assert(foff_size == size);
-    param.size = foff_size;
+}
+uint64_t ParamWriter::endParam() {
+    fflush(fp_);  // make sure the data is written to the file immediately
+    auto &param = param_info_[index_];
+    param.size = ftell(fp_) - param.offset;
     index_++;
+    return param.size;
 }
 void ParamWriter::paddingIndex(const vector<string> names) {
     param_info_.resize(names.size());
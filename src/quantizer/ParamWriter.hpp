@@ -33,6 +33,10 @@ public:
     int calcIndexSize(vector<string> names);
     void writeIndex();
     virtual void writeParam(string name, DataType type, void *data, uint64_t size);
+    // write one param in pieces: beginParam, any number of writeParamData, then endParam
+    void beginParam(string name, DataType type);
+    void writeParamData(const void *data, uint64_t size);
+    uint64_t endParam();
     void paddingIndex(vector<string> names);
 
 private:
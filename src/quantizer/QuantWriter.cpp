@@ -5,11 +5,20 @@
 #include "backends/cpu/quantize/QuantizeQ8.hpp"
 #include <string>
 #include "QuantWriter.hpp"
+#include "backends/cpu/quantize/QuantizeQ2.hpp"
+#include "backends/cpu/quantize/QuantizeQ3.hpp"
+#include "backends/cpu/quantize/QuantizeQ5.hpp"
 #include "backends/cpu/quantize/QuantizeQ6.hpp"
 #include "backends/cpu/compute/GEMM_AArch64.hpp"
+#include "ImportanceMatrix.hpp"
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <thread>
 namespace mllm {
 QuantWriter::QuantWriter(std::string output_path, std::string input_path) :
     ParamWriter(output_path), output_path_(output_path) {
+    thread_count_ = std::max(1u, std::thread::hardware_concurrency());
     param_loader_ = new mllm::ParamLoader(std::move(input_path));
     if (param_loader_ == nullptr) {
         __exit(-1);
@@ -73,157 +82,343 @@ vector<string> q6_layers = {
     "down_proj",
 };
 
+// k-quant type used for q6_layers: Q6_K for Q4_K and up, one step above the requested type below that
+static DataType q6_layer_type(DataType dataType) {
+    switch (dataType) {
+    case MLLM_TYPE_Q2_K: return MLLM_TYPE_Q4_K;
+    case MLLM_TYPE_Q3_K: return MLLM_TYPE_Q5_K;
+    case MLLM_TYPE_Q4_K:
+    case MLLM_TYPE_Q5_K:
+    case MLLM_TYPE_Q6_K: return MLLM_TYPE_Q6_K;
+    default: return dataType;
+    }
+}
+
+static bool is_k_quant(DataType dataType) {
+    return dataType == MLLM_TYPE_Q2_K || dataType == MLLM_TYPE_Q3_K || dataType == MLLM_TYPE_Q4_K
+           || dataType == MLLM_TYPE_Q5_K || dataType == MLLM_TYPE_Q6_K;
+}
+
+// quantize functions, dequantize function and block size of every type the streaming path can produce
+struct RowQuantizer {
+    void (*quantize)(const float *__restrict x, void *__restrict y, int k);
+    // importance-weighted rounding, nullptr where the type has none
+    void (*quantize_weighted)(const float *__restrict x, void *__restrict y, int k, const float *__restrict quant_weights);
+    void (*dequantize)(const void *x, float *y, int k);
+    int blck_size;
+};
+static RowQuantizer row_quantizer(DataType type) {
+    switch (type) {
+    case MLLM_TYPE_Q4_0:
+        return {quantize_row_q4_0, quantize_row_q4_0_weighted, dequantize_row_q4_0, QK4_0};
+    case MLLM_TYPE_Q5_0:
+        return {quantize_row_q5_0, quantize_row_q5_0_weighted,
+                [](const void *x, float *y, int k) { dequantize_row_q5_0((const block_q5_0 *)x, y, k); }, QK5_0};
+    case MLLM_TYPE_Q8_0:
+        return {quantize_row_q8_0, nullptr, dequantize_row_q8_0, QK8_0};
+    case MLLM_TYPE_Q2_K:
+        return {quantize_row_q2_K, quantize_row_q2_K_weighted,
+                [](const void *x, float *y, int k) { dequantize_row_q2_K((const block_q2_K *)x, y, k); }, QK_K};
+    case MLLM_TYPE_Q3_K:
+        return {quantize_row_q3_K, quantize_row_q3_K_weighted,
+                [](const void *x, float *y, int k) { dequantize_row_q3_K((const block_q3_K *)x, y, k); }, QK_K};
+    case MLLM_TYPE_Q4_K:
+        return {quantize_row_q4_K, quantize_row_q4_K_weighted,
+                [](const void *x, float *y, int k) { dequantize_row_q4_K((const block_q4_K *)x, y, k); }, QK_K};
+    case MLLM_TYPE_Q5_K:
+        return {quantize_row_q5_K, quantize_row_q5_K_weighted,
+                [](const void *x, float *y, int k) { dequantize_row_q5_K((const block_q5_K *)x, y, k); }, QK_K};
+    case MLLM_TYPE_Q6_K:
+        return {quantize_row_q6_K, quantize_row_q6_K_weighted,
+                [](const void *x, float *y, int k) { dequantize_row_q6_K((const block_q6_K *)x, y, k); }, QK_K};
+    case MLLM_TYPE_Q8_K:
+        return {quantize_row_q8_K, nullptr,
+                [](const void *x, float *y, int k) { dequantize_row_q8_K((const block_q8_K *)x, y, k); }, QK_K};
+    default: return {nullptr, nullptr, nullptr, 1};
+    }
+}
+
+// quantize `count` floats, one row of importance->size() at a time when importance weights are given
+static void quantize_rows(const RowQuantizer &q, DataType type, const float *src, char *dst, uint64_t count,
+                          const std::vector<float> *importance) {
+    if (importance == nullptr) {
+        q.quantize(src, dst, (int)count);
+        return;
+    }
+    const uint64_t cols = importance->size();
+    for (uint64_t off = 0; off < count; off += cols) {
+        q.quantize_weighted(src + off, dst + DataTypeSize(type, (int)off), (int)cols, importance->data());
+    }
+}
+
+// split `count` floats into ranges of whole `unit`s (blocks, or rows when weighted) and quantize them on `n_threads` threads
+static void quantize_rows_parallel(const RowQuantizer &q, DataType type, const float *src, char *dst, uint64_t count,
+                                   uint64_t unit, const std::vector<float> *importance, int n_threads) {
+    const uint64_t nb = count / unit;
+    const int nth = (int)std::min<uint64_t>(std::max(n_threads, 1), nb);
+    if (nth <= 1) {
+        quantize_rows(q, type, src, dst, count, importance);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(nth);
+    for (int t = 0; t < nth; ++t) {
+        const uint64_t b0 = nb * t / nth;
+        const uint64_t b1 = nb * (t + 1) / nth;
+        const uint64_t off = b0 * unit;
+        workers.emplace_back([&q, src, dst, type, off, b0, b1, unit, importance] {
+            quantize_rows(q, type, src + off, dst + DataTypeSize(type, (int)off), (b1 - b0) * unit, importance);
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+bool QuantWriter::loadImportance(const std::string &path) {
+    if (!ImportanceMatrix::load(path, importance_)) {
+        return false;
+    }
+    // channels the calibration never activated keep a small weight, so their blocks are not rounded to zero
+    for (auto &item : importance_) {
+        auto &values = item.second;
+        double mean = 0;
+        for (float v : values) mean += v;
+        mean = values.empty() ? 0 : mean / values.size();
+        const float floor = (float)(mean * 1e-3);
+        for (auto &v : values) v = std::max(v, floor);
+    }
+    std::cout << "Loaded importance of " << importance_.size() << " weights from " << path << "\n";
+    return true;
+}
+
+const std::vector<float> *QuantWriter::importanceFor(const string &name, uint64_t count, int blck_size) const {
+    auto it = importance_.find(name);
+    if (it == importance_.end() || it->second.empty()) {
+        return nullptr;
+    }
+    const uint64_t cols = it->second.size();
+    if (count % cols != 0 || cols % blck_size != 0) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+uint64_t QuantWriter::streamParam(const string &name, DataType type) {
+    const RowQuantizer q = row_quantizer(type);
+    if (type != MLLM_TYPE_F32 && q.quantize == nullptr) {
+        NOT_IMPLEMENTED(type);
+    }
+    const uint64_t count = param_loader_->offsets_[name].second / sizeof(float);
+    if (count % q.blck_size != 0) {
+        std::cout << "param " << name << " has " << count << " elements, not a multiple of the "
+                  << DataTypeName(type) << " block size " << q.blck_size << "\n";
+        __exit(-1);
+    }
+    const std::vector<float> *importance = q.quantize_weighted ? importanceFor(name, count, q.blck_size) : nullptr;
+    // weighted rounding needs whole rows, so chunks and per-thread ranges are then made of rows
+    const uint64_t unit = importance ? importance->size() : q.blck_size;
+    const uint64_t chunk = std::min<uint64_t>(count, std::max<uint64_t>(unit, chunk_size_ / unit * unit));
+    std::vector<float> input[2] = {std::vector<float>(chunk), std::vector<float>(count > chunk ? chunk : 0)};
+    std::vector<char> output(type == MLLM_TYPE_F32 ? 0 : DataTypeSize(type, (int)chunk));
+    auto read_chunk = [this, &name, &input, chunk, count](int buf, uint64_t start) {
+        const uint64_t n = std::min(chunk, count - start);
+        return param_loader_->loadRange(name, start * sizeof(float), input[buf].data(), n * sizeof(float));
+    };
+    beginParam(name, type);
+    // the next chunk is read while the current one is quantized and written
+    std::future<bool> next = std::async(std::launch::async, read_chunk, 0, 0);
+    int buf = 0;
+    for (uint64_t start = 0; start < count; start += chunk, buf ^= 1) {
+        const uint64_t n = std::min(chunk, count - start);
+        if (!next.get()) {
+            std::cout << "Failed to read param " << name << "\n";
+            __exit(-1);
+        }
+        if (start + n < count) {
+            next = std::async(std::launch::async, read_chunk, buf ^ 1, start + n);
+        }
+        if (type == MLLM_TYPE_F32) {
+            writeChunk(input[buf].data(), n * sizeof(float));
+        } else {
+            quantize_rows_parallel(q, type, input[buf].data(), output.data(), n, unit, importance, thread_count_);
+            writeChunk(output.data(), DataTypeSize(type, (int)n));
+        }
+    }
+    const uint64_t size = endParam();
+#ifdef TEST
+    auto *data = new char[size];
+    memcpy(data, streamed_.data(), size);
+    delete[] data_[name];
+    data_[name] = data;
+    streamed_.clear();
+#endif
+    return size;
+}
+
+void QuantWriter::writeChunk(const void *data, uint64_t size) {
+#ifdef TEST
+    streamed_.insert(streamed_.end(), (const char *)data, (const char *)data + size);
+#endif
+    writeParamData(data, size);
+}
+
 int tmp_hidden_dim = -1;
+// type of `name` when quantizing to `dataType` without a size budget; params must be visited in file order
+static DataType default_param_type(const string &name, uint64_t size, DataType dataType) {
+    if (find_names(name, {"input_layernorm"})) {
+        tmp_hidden_dim = size;
+    }
+    if (find_names(name, q6_layers) && is_k_quant(dataType)
+        && tmp_hidden_dim > 0 && (size / tmp_hidden_dim) % 256 != 0) {
+        return MLLM_TYPE_F32;
+    }
+    if (find_names(name, fp32_layers)) {
+        return MLLM_TYPE_F32;
+    }
+    if (find_names(name, q6_layers)) {
+        return q6_layer_type(dataType);
+    }
+    return dataType;
+}
+
+double QuantWriter::quantError(const string &name, DataType type) {
+    const RowQuantizer q = row_quantizer(type);
+    const uint64_t count = param_loader_->offsets_[name].second / sizeof(float);
+    // types without weighted rounding are still measured against the calibrated importance
+    const std::vector<float> *importance = importanceFor(name, count, q.blck_size);
+    uint64_t segment = importance ? importance->size() : count;
+    if (importance == nullptr && count > 4096 && 4096 % q.blck_size == 0) {
+        segment = 4096;
+    }
+    const uint64_t n_segments = count / segment;
+    const uint64_t n_samples = std::min<uint64_t>(n_segments, 16);
+    std::vector<float> x(segment), y(segment);
+    std::vector<char> block(DataTypeSize(type, (int)segment));
+    const bool weighted = importance != nullptr && q.quantize_weighted != nullptr;
+    double error = 0;
+    for (uint64_t s = 0; s < n_samples; ++s) {
+        const uint64_t start = (n_segments * s / n_samples) * segment;
+        if (!param_loader_->loadRange(name, start * sizeof(float), x.data(), segment * sizeof(float))) {
+            std::cout << "Failed to read param " << name << "\n";
+            __exit(-1);
+        }
+        if (weighted) {
+            q.quantize_weighted(x.data(), block.data(), (int)segment, importance->data());
+        } else {
+            q.quantize(x.data(), block.data(), (int)segment);
+        }
+        q.dequantize(block.data(), y.data(), (int)segment);
+        for (uint64_t i = 0; i < segment; ++i) {
+            const double diff = x[i] - y[i];
+            error += (importance ? (*importance)[i] : 1.0) * diff * diff;
+        }
+    }
+    return n_samples > 0 ? error * (double)n_segments / (double)n_samples : 0;
+}
+
+std::unordered_map<string, DataType> QuantWriter::assignBudgetTypes(DataType dataType) {
+    static const std::vector<DataType> k_types = {MLLM_TYPE_Q2_K, MLLM_TYPE_Q3_K, MLLM_TYPE_Q4_K, MLLM_TYPE_Q5_K, MLLM_TYPE_Q6_K};
+    static const std::vector<DataType> legacy_types = {MLLM_TYPE_Q4_0, MLLM_TYPE_Q5_0, MLLM_TYPE_Q8_0};
+    const auto &types = is_k_quant(dataType) ? k_types : legacy_types;
+    struct Candidate {
+        string name;
+        std::vector<uint64_t> bytes;
+        std::vector<double> error;
+        size_t level = 0;
+    };
+    std::vector<Candidate> candidates;
+    uint64_t elements = 0;
+    const int saved_hidden_dim = tmp_hidden_dim;
+    for (const auto &name : param_names_) {
+        const uint64_t count = param_loader_->offsets_[name].second / sizeof(float);
+        const DataType type = default_param_type(name, count, dataType);
+        if (std::find(types.begin(), types.end(), type) == types.end() || count % QK_K != 0) {
+            continue;
+        }
+        Candidate candidate{name};
+        for (auto t : types) {
+            candidate.bytes.push_back(DataTypeSize(t, (int)count));
+            candidate.error.push_back(quantError(name, t));
+        }
+        candidates.push_back(std::move(candidate));
+        elements += count;
+    }
+    tmp_hidden_dim = saved_hidden_dim;
+
+    // start everything at the smallest type and repeatedly upgrade the param that removes the most
+    // importance-weighted error per extra byte, while the total still fits the budget
+    const auto budget = (uint64_t)(bits_per_weight_ * (double)elements / 8);
+    uint64_t used = 0;
+    for (auto &candidate : candidates) used += candidate.bytes[0];
+    if (used > budget) {
+        std::cout << "Size budget of " << bits_per_weight_ << " bits per weight is below " << DataTypeName(types[0]) << "\n";
+    }
+    while (true) {
+        Candidate *best = nullptr;
+        double best_gain = 0;
+        for (auto &candidate : candidates) {
+            const size_t l = candidate.level;
+            if (l + 1 >= types.size()) continue;
+            const uint64_t extra = candidate.bytes[l + 1] - candidate.bytes[l];
+            if (used + extra > budget) continue;
+            const double gain = (candidate.error[l] - candidate.error[l + 1]) / (double)extra;
+            if (best == nullptr || gain > best_gain) {
+                best = &candidate;
+                best_gain = gain;
+            }
+        }
+        if (best == nullptr) break;
+        used += best->bytes[best->level + 1] - best->bytes[best->level];
+        best->level++;
+    }
+    std::unordered_map<string, DataType> assigned;
+    for (auto &candidate : candidates) {
+        assigned[candidate.name] = types[candidate.level];
+    }
+    std::cout << "Size budget " << bits_per_weight_ << " bits per weight: " << candidates.size() << " params at "
+              << (elements ? 8.0 * (double)used / (double)elements : 0) << " bits per weight\n";
+    return assigned;
+}
+
 void QuantWriter::quantParams(DataType dataType) {
     quant_type_ = dataType;
+    if (dataType == MLLM_TYPE_F32) {
+        std::cout << "No need to quantize FP32 params\n";
+        __exit(-1);
+    }
     for (const auto &name : param_names_) {
-        //        int force_quant_type = -1;
-        auto *param = getParam(name);
-        if (param == nullptr) {
+        if (param_loader_->data_type_[name] != MLLM_TYPE_F32) {
             __exit(-1);
         }
+    }
+    std::unordered_map<string, DataType> budget_types;
+    if (bits_per_weight_ > 0) {
+        budget_types = assignBudgetTypes(dataType);
+    }
+    for (const auto &name : param_names_) {
         auto size = param_loader_->offsets_[name].second / sizeof(float);
-        if (find_names(name, {"input_layernorm"})) {
-            tmp_hidden_dim = size;
-        }
-        void *quant_ptr = nullptr;
-        std::pair<void *, uint64_t> block_t;
-        if (find_names(name, q6_layers) && (dataType == MLLM_TYPE_Q6_K || dataType == MLLM_TYPE_Q4_K)) {
-            if (tmp_hidden_dim > 0 && (size / tmp_hidden_dim) % 256 != 0) {
-                std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_F32) << "\t";
-                const auto s = param_loader_->offsets_[name].second / sizeof(float);
-                const auto tsize = alloc_quant_block(s, MLLM_TYPE_F32).second;
-                writeParam(name, MLLM_TYPE_F32, param, tsize);
-                std::cout << "  size:" << tsize << std::endl;
-                continue;
-            }
+        DataType type = default_param_type(name, size, dataType);
+        auto budget_type = budget_types.find(name);
+        if (budget_type != budget_types.end()) {
+            type = budget_type->second;
         }
-        if (find_names(name, fp32_layers)) {
-            std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_F32) << "\t";
-            const auto s = param_loader_->offsets_[name].second / sizeof(float);
-            const auto tsize = alloc_quant_block(s, MLLM_TYPE_F32).second;
-            writeParam(name, MLLM_TYPE_F32, param, tsize);
-            std::cout << "  size:" << tsize << std::endl;
-        } else if (find_names(name, q6_layers)) {
-            switch (dataType) {
-            case MLLM_TYPE_F32:
-                std::cout << "No need to quantize FP32 params\n";
-                __exit(-1);
-                break;
-            case MLLM_TYPE_Q4_0:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_K:
-            case MLLM_TYPE_Q6_K:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_Q6_K) << "\t";
-                block_t = alloc_quant_block(size, MLLM_TYPE_Q6_K);
-                quant_ptr = block_t.first;
-                quantize_row_q6_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_0:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_K:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_0_4_4:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0_4x4(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            default:
-                break;
-            }
-            if (quant_ptr != nullptr) {
-                if ((dataType == MLLM_TYPE_Q4_K) | (dataType == MLLM_TYPE_Q6_K)) {
-                    writeParam(name, MLLM_TYPE_Q6_K, quant_ptr, size);
-                    std::cout << "  size:" << size << " type:" << DataTypeName(MLLM_TYPE_Q6_K) << std::endl;
-                } else {
-                    writeParam(name, quant_type_, quant_ptr, size);
-                    std::cout << "  size:" << size << " type:" << DataTypeName(quant_type_) << std::endl;
-                }
-            }
-        } else {
-            std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-            switch (dataType) {
-            case MLLM_TYPE_F32:
-                std::cout << "No need to quantize FP32 params\n";
-                __exit(-1);
-                break;
-            case MLLM_TYPE_Q4_0:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_0:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_K:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q6_K:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q6_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_K:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_0_4_4:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0_4x4(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_I8:
-            case MLLM_TYPE_Q4_1:
-            case MLLM_TYPE_Q8_1:
-            case MLLM_TYPE_I16:
-            case MLLM_TYPE_I32:
-            case MLLM_TYPE_F16:
-                NOT_IMPLEMENTED(dataType);
-                break;
-            case MLLM_TYPE_COUNT:
-                UNREACHABLE()
-                break;
-            default:
-                break;
-            }
-            if (quant_ptr != nullptr) {
-                writeParam(name, quant_type_, quant_ptr, size);
-                std::cout << "  size:" << size << std::endl;
-            }
-            // writeParam(name, quant_type_, quant_ptr, size);
+        std::cout << "Quantize param " << name << " to " << DataTypeName(type) << "\t";
+        if (type == MLLM_TYPE_Q4_0_4_4) {
+            // rows are interleaved in groups of four, so this type is quantized from the whole tensor
+            auto *param = getParam(name);
+            auto block_t = alloc_quant_block(size, type);
+            quantize_row_q4_0_4x4(param, block_t.first, size);
+            writeParam(name, type, block_t.first, block_t.second);
+            size = block_t.second;
+            delete[] (uint8_t *)param;
 #ifndef TEST
-            delete[] (char *)quant_ptr;
+            delete[] (char *)block_t.first;
 #endif
+        } else {
+            size = streamParam(name, type);
         }
+        std::cout << "  size:" << size << " type:" << DataTypeName(type) << std::endl;
     }
     writeIndex();
 }
@@ -249,48 +444,36 @@ void QuantWriter::quantParams_q4_(DataType dataType) {
     }
     quant_type_ = dataType;
     for (const auto &name : param_names_) {
-        auto *param = getParam(name);
-        if (param == nullptr) {
+        if (param_loader_->data_type_[name] != MLLM_TYPE_F32) {
             __exit(-1);
         }
         auto size = param_loader_->offsets_[name].second / sizeof(float);
         if (find_names(name, {"norm"})) {
             tmp_hidden_dim = size;
         }
-        void *quant_ptr = nullptr;
-        std::pair<void *, uint64_t> block_t;
         if (find_names(name, fp32_layers)) {
             std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_F32) << "\t";
-            const auto s = param_loader_->offsets_[name].second / sizeof(float);
-            const auto tsize = alloc_quant_block(s, MLLM_TYPE_F32).second;
-            writeParam(name, MLLM_TYPE_F32, param, tsize);
-            std::cout << "  size:" << tsize << std::endl;
+            size = streamParam(name, MLLM_TYPE_F32);
+            std::cout << "  size:" << size << std::endl;
         } else if (find_names(name, q4x4_2_q4_layers)) {
             std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_Q4_0) << "\t";
-            block_t = alloc_quant_block(size, MLLM_TYPE_Q4_0);
-            quant_ptr = block_t.first;
-            quantize_row_q4_0(param, quant_ptr, size);
-            size = block_t.second;
-            if (quant_ptr != nullptr) {
-                writeParam(name, MLLM_TYPE_Q4_0, quant_ptr, size);
-                std::cout << "  size:" << size << " type:" << DataTypeName(MLLM_TYPE_Q4_0) << std::endl;
-            }
+            size = streamParam(name, MLLM_TYPE_Q4_0);
+            std::cout << "  size:" << size << " type:" << DataTypeName(MLLM_TYPE_Q4_0) << std::endl;
         } else {
             std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-            block_t = alloc_quant_block(size, dataType);
-            quant_ptr = block_t.first;
+            auto *param = getParam(name);
+            auto block_t = alloc_quant_block(size, dataType);
             int tmp_hidden_dim_q4 = tmp_hidden_dim;
             if (find_names(name, {"w2", "down_proj"}) || (dclm_flag && find_names(name, {"w3"}))) {
                 tmp_hidden_dim_q4 = (size / tmp_hidden_dim);
             }
-            quantize_row_q4_0_4x4(param, quant_ptr, size, tmp_hidden_dim_q4);
+            quantize_row_q4_0_4x4(param, block_t.first, size, tmp_hidden_dim_q4);
             size = block_t.second;
-            if (quant_ptr != nullptr) {
-                writeParam(name, quant_type_, quant_ptr, size);
-                std::cout << "  size:" << size << std::endl;
-            }
+            writeParam(name, quant_type_, block_t.first, size);
+            std::cout << "  size:" << size << std::endl;
+            delete[] (uint8_t *)param;
 #ifndef TEST
-            delete[] (char *)quant_ptr;
+            delete[] (char *)block_t.first;
 #endif
         }
     }
@@ -2,6 +2,7 @@
 #include "ParamLoader.hpp"
 #include "backends/cpu/quantize/QuantizeQ4.hpp"
 #include "backends/cpu/quantize/QuantizeQ8.hpp"
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 #ifndef MLLM_QUANTWRITER_HPP
@@ -36,9 +37,25 @@ public:
     int readParams();
     void quantParams(DataType dataType);
     void quantParams_q4_(DataType dataType);
+    // threads used to quantize each chunk, defaults to the number of hardware threads
+    void setThreadCount(int thread_count) {
+        thread_count_ = std::max(thread_count, 1);
+    }
+    // elements read and quantized at a time; peak memory is about two F32 chunks plus one quantized chunk
+    void setChunkSize(uint64_t chunk_size) {
+        chunk_size_ = chunk_size;
+    }
+    // per-channel importance written by ImportanceMatrix, used for weighted rounding of the weights it covers
+    bool loadImportance(const std::string &path);
+    // choose a type per param from the requested type's family (Q2_K..Q6_K, or Q4_0/Q5_0/Q8_0) so that the
+    // quantized params average `bits_per_weight`, spending the bits where they remove the most weighted error
+    void setSizeBudget(double bits_per_weight) {
+        bits_per_weight_ = bits_per_weight;
+    }
 
 #ifdef TEST
     std::unordered_map<string, char *> data_;
+    std::vector<char> streamed_;
 
 #endif
 private:
@@ -46,7 +63,19 @@ private:
     mllm::ParamLoader *param_loader_;
     DataType quant_type_;
     std::vector<std::string> param_names_;
+    int thread_count_ = 1;
+    uint64_t chunk_size_ = 16 * 1024 * 1024;
+    std::unordered_map<string, std::vector<float>> importance_;
+    double bits_per_weight_ = 0;
     float *getParam(std::string param_name);
+    // read, quantize and write `name` chunk by chunk as `type`, return the bytes written
+    uint64_t streamParam(const string &name, DataType type);
+    void writeChunk(const void *data, uint64_t size);
+    // importance of `name` if it has one whose rows fit `count` values and blocks of `blck_size`
+    const std::vector<float> *importanceFor(const string &name, uint64_t count, int blck_size) const;
+    // importance-weighted squared error of quantizing `name` to `type`, estimated from up to 16 sampled rows
+    double quantError(const string &name, DataType type);
+    std::unordered_map<string, DataType> assignBudgetTypes(DataType dataType);
     void writeParam(string name, DataType type, void *data, uint64_t size) override;
 };
 } // namespace mllm
@@ -10,14 +10,31 @@
 
 
 int main(int argc, char **argv) {
-    if (argc != 4) {
-        std::cout << "Usage: ./quantize <input_path> <output_path> <quant_type>\n";
+    if (argc < 4) {
+        std::cout << "Usage: ./quantize <input_path> <output_path> <quant_type> [threads] [--imatrix <path>] [--bpw <bits>]\n"
+                  << "  --imatrix  importance collected by running a model with MLLM_IMATRIX=<path>\n"
+                  << "  --bpw      average bits per weight; picks a type per param from the quant_type family\n";
         return -1;
     }
     auto input_path = std::string(argv[1]);
     auto output_path = std::string(argv[2]);
     auto quant_type = std::string(argv[3]);
     mllm::QuantWriter quant_writer(output_path, input_path);
+    for (int i = 4; i < argc; i++) {
+        auto arg = std::string(argv[i]);
+        if (arg == "--imatrix" && i + 1 < argc) {
+            if (!quant_writer.loadImportance(argv[++i])) {
+                return -1;
+            }
+        } else if (arg == "--bpw" && i + 1 < argc) {
+            quant_writer.setSizeBudget(std::stod(argv[++i]));
+        } else if (i == 4 && arg.rfind("--", 0) != 0) {
+            quant_writer.setThreadCount(std::stoi(arg));
+        } else {
+            std::cout << "Unknown argument " << arg << "\n";
+            return -1;
+        }
+    }
     int param_count = quant_writer.readParams();
     if (param_count <= 0) {
         std::cout << "No params to quantize\n";
@@ -28,8 +45,16 @@ int main(int argc, char **argv) {
         quant_writer.quantParams(MLLM_TYPE_Q4_0);
     } else if (quant_type == "Q8_0") {
         quant_writer.quantParams(MLLM_TYPE_Q8_0);
+    } else if (quant_type == "Q5_0") {
+        quant_writer.quantParams(MLLM_TYPE_Q5_0);
+    } else if (quant_type == "Q2_K") {
+        quant_writer.quantParams(MLLM_TYPE_Q2_K);
+    } else if (quant_type == "Q3_K") {
+        quant_writer.quantParams(MLLM_TYPE_Q3_K);
     } else if (quant_type == "Q4_K") {
         quant_writer.quantParams(MLLM_TYPE_Q4_K);
+    } else if (quant_type == "Q5_K") {
+        quant_writer.quantParams(MLLM_TYPE_Q5_K);
     } else if (quant_type == "Q6_K") {
         quant_writer.quantParams(MLLM_TYPE_Q6_K);
     } else if (quant_type == "Q8_K") {
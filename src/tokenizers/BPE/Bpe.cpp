@@ -4,7 +4,7 @@
 
 #include "Bpe.hpp"
 #include <iostream>
-#include <regex>
+#include <cstring>
 #include <codecvt>
 #include <unordered_map>
 
@@ -13,84 +13,152 @@ static size_t utf8_len(char src) {
     uint8_t highbits = static_cast<uint8_t>(src) >> 4;
     return lookup[highbits];
 }
-static std::vector<std::pair<string, string>> get_pairs(vector<string> word) {
-    std::vector<std::pair<string, string>> pairs;
-    for (int i = 1; i < word.size(); ++i) {
-        pairs.emplace_back(word[i - 1], word[i]);
-    }
-    return pairs;
-}
 vector<std::string> mllm::BPETokenizer::bpe(const std::string &token, std::string end_symbol) {
-    std::wstring_convert<std::codecvt_utf8_utf16<char32_t>, char32_t> converter;
-    std::u32string u32_token = converter.from_bytes(token);
-
+    if (token.empty()) {
+        return {};
+    }
+    // 0xff never appears in utf-8, so it separates the word from its end symbol
+    std::string key = token + '\xff' + end_symbol;
+    if (word_cache_capacity_ > 0) {
+        std::lock_guard<std::mutex> lock(word_cache_mutex_);
+        auto it = word_cache_.find(key);
+        if (it != word_cache_.end()) {
+            word_cache_lru_.splice(word_cache_lru_.begin(), word_cache_lru_, it->second);
+            return it->second->second;
+        }
+    }
+    // the parts of a word always cover it in order, so each one is a range of `word`
+    struct Part {
+        int offset;
+        int length;
+        int id; // -1 if the part is in no merge
+        int prev;
+        int next;
+    };
+    const std::string word = token + end_symbol;
+    std::vector<Part> parts;
+    for (size_t offset = 0; offset < token.size();) {
+        const int length = (int)std::min(token.size() - offset, utf8_len(token[offset]));
+        parts.push_back({(int)offset, length, -1, (int)parts.size() - 1, (int)parts.size() + 1});
+        offset += length;
+    }
+    parts.back().length += (int)end_symbol.size();
+    parts.back().next = -1;
+    if (parts.size() == 1) {
+        return {word};
+    }
+    for (auto &part : parts) {
+        auto it = symbol_ids_.find(word.substr(part.offset, part.length));
+        part.id = it == symbol_ids_.end() ? -1 : it->second;
+    }
+    struct Merge {
+        unsigned rank;
+        int left;
+        int right;
+        int left_id;
+        int right_id;
+        int merged_id;
+        bool operator<(const Merge &other) const { // lowest rank first, then leftmost
+            return rank > other.rank || (rank == other.rank && left > other.left);
+        }
+    };
+    std::priority_queue<Merge> merges;
+    auto try_merge = [&](int left, int right) {
+        if (left < 0 || right < 0 || parts[left].id < 0 || parts[right].id < 0) {
+            return;
+        }
+        auto it = pair_rank_.find((uint64_t)parts[left].id << 32 | (uint32_t)parts[right].id);
+        if (it != pair_rank_.end()) {
+            merges.push({it->second.first, left, right, parts[left].id, parts[right].id, it->second.second});
+        }
+    };
+    for (int i = 1; i < (int)parts.size(); ++i) {
+        try_merge(i - 1, i);
+    }
+    while (!merges.empty()) {
+        const Merge merge = merges.top();
+        merges.pop();
+        Part &left = parts[merge.left];
+        Part &right = parts[merge.right];
+        // stale if either side has been merged since
+        if (left.length == 0 || right.length == 0 || left.next != merge.right || left.id != merge.left_id || right.id != merge.right_id) {
+            continue;
+        }
+        left.id = merge.merged_id;
+        left.length += right.length;
+        right.length = 0;
+        left.next = right.next;
+        if (right.next != -1) {
+            parts[right.next].prev = merge.left;
+        }
+        try_merge(left.prev, merge.left);
+        try_merge(merge.left, left.next);
+    }
     std::vector<std::string> word_splits;
-    for (char32_t c : u32_token) {
-        word_splits.push_back(converter.to_bytes(c));
+    for (int i = 0; i != -1; i = parts[i].next) {
+        word_splits.push_back(word.substr(parts[i].offset, parts[i].length));
     }
-    std::string last_str = word_splits.back();
-    word_splits.pop_back();
-    // word_splits.push_back(last_str + "</w>");
-    word_splits.push_back(last_str + end_symbol);
-
-    auto pairs = get_pairs(word_splits);
-    if (pairs.empty()) {
-        // return {token + "</w>"};
-        return {token + end_symbol};
+    if (word_cache_capacity_ > 0) {
+        std::lock_guard<std::mutex> lock(word_cache_mutex_);
+        if (word_cache_.find(key) == word_cache_.end()) {
+            word_cache_lru_.emplace_front(key, word_splits);
+            word_cache_[key] = word_cache_lru_.begin();
+            while (word_cache_lru_.size() > word_cache_capacity_) {
+                word_cache_.erase(word_cache_lru_.back().first);
+                word_cache_lru_.pop_back();
+            }
+        }
     }
+    return word_splits;
+}
 
-    while (true) {
-        auto bigram = *std::min_element(pairs.begin(), pairs.end(), [this](const auto &a, const auto &b) {
-            auto string_a = std::string(a.first) + " " + std::string(a.second);
-            auto string_b = std::string(b.first) + " " + std::string(b.second);
-            auto rank_a = merge_rank.count(string_a) ? merge_rank.at(string_a) : INFINITY;
-            auto rank_b = merge_rank.count(string_b) ? merge_rank.at(string_b) : INFINITY;
-            return rank_a < rank_b;
-        });
-        auto bigram_string = std::string(bigram.first) + " " + std::string(bigram.second);
-        if (merge_rank.find(bigram_string) == merge_rank.end()) {
-            break;
+void mllm::BPETokenizer::preTokenize(const std::string &text, std::vector<std::string> &words) {
+    // the std::regex this replaces matched ASCII classes only: bytes of multi-byte characters are \S, never \w
+    auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; };
+    auto is_word = [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; };
+    static const char *const specials[] = {"<|startoftext|>", "<|endoftext|>"};
+    static const char *const contractions[] = {"s", "t", "re", "ve", "m", "ll", "d"};
+    const size_t n = text.size();
+    size_t pos = 0;
+    while (pos < n) {
+        const char c = text[pos];
+        if (is_space(c)) {
+            pos++;
+            continue;
         }
-
-        string first = bigram.first, second = bigram.second;
-        vector<std::string> new_word;
-        int i = 0;
-        int j = 0;
-        while (i < word_splits.size()) {
-            // find first at word_splits[i:]
-            bool found = false;
-            for (j = i; j < word_splits.size(); ++j) {
-                if (word_splits[j] == first) {
-                    found = true;
-                    for (int k = i; k < j; ++k) {
-                        new_word.emplace_back(word_splits[k]);
-                    }
-                    i = j;
-                    break;
-                }
-            }
-            if (!found) {
-                new_word.insert(new_word.end(), word_splits.begin() + i, word_splits.end());
+        size_t end = pos;
+        for (const char *special : specials) {
+            if (text.compare(pos, strlen(special), special) == 0) {
+                end = pos + strlen(special);
                 break;
             }
-            if (word_splits[i] == first && i < word_splits.size() - 1 && word_splits[i + 1] == second) {
-                new_word.emplace_back(first + second);
-                i += 2;
-            } else {
-                new_word.emplace_back(word_splits[i]);
-                i++;
+        }
+        if (end == pos && c == '\'') {
+            for (const char *contraction : contractions) {
+                if (text.compare(pos + 1, strlen(contraction), contraction) == 0) {
+                    end = pos + 1 + strlen(contraction);
+                    break;
+                }
             }
         }
-        word_splits = new_word;
-        if (word_splits.size() == 1) {
-            break;
-        } else {
-            pairs = get_pairs(word_splits);
+        if (end == pos && is_word(c)) {
+            while (end < n && is_word(text[end])) { end++; }
+        }
+        if (end == pos) {
+            while (end < n && !is_space(text[end])) { end++; }
         }
+        words.push_back(text.substr(pos, end - pos));
+        pos = end;
     }
+}
 
-    // cache[token] = word_splits;
-    return word_splits;
+void mllm::BPETokenizer::setWordCacheCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(word_cache_mutex_);
+    word_cache_capacity_ = capacity;
+    while (word_cache_lru_.size() > word_cache_capacity_) {
+        word_cache_.erase(word_cache_lru_.back().first);
+        word_cache_lru_.pop_back();
+    }
 }
 
 void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, std::vector<std::string> &special_tokens, bool byte_fallback) {
@@ -113,23 +181,14 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
         MLLM_LOG_ERROR_STREAM << "The vocab map is empty!" << std::endl;
         return;
     }
-    symbols_.clear();
-    while (!queue_.empty()) queue_.pop();
     size_t offset = 0;
     int idx = 0;
     if (bos) {
         tokens.emplace_back(mllm::BPETokenizer::TokenBos);
     }
-    if (!merge_rank.empty()) {
+    if (!pair_rank_.empty()) {
         std::vector<std::string> words;
-        std::regex pattern("<\\|startoftext\\|>|<\\|endoftext\\|>|'s|'t|'re|'ve|'m|'ll|'d|\\w+|\\d+|\\S+");
-        std::smatch match;
-
-        std::string::const_iterator searchStart(text.cbegin());
-        while (std::regex_search(searchStart, text.cend(), match, pattern)) {
-            words.push_back(match.str());
-            searchStart = match.suffix().first;
-        }
+        preTokenize(text, words);
 
         for (const auto &word : words) {
             auto word_splits = bpe(word, end_symbol);
@@ -154,6 +213,8 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
         }
         return;
     }
+    std::vector<CharSymbol> symbols;
+    MergeQueue queue;
     while (offset < text.size()) {
         CharSymbol symbol;
         symbol.ch = text.c_str() + offset;
@@ -161,17 +222,17 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
         symbol.last = idx - 1;
         symbol.next = text.size() - offset - symbol.length > 0 ? idx + 1 : -1;
         offset += symbol.length;
-        symbols_.emplace_back(symbol);
+        symbols.emplace_back(symbol);
         idx++;
     }
-    for (int i = 1; i < symbols_.size(); ++i) {
-        tryMergeSymbol(i - 1, i);
+    for (int i = 1; i < symbols.size(); ++i) {
+        tryMergeSymbol(symbols, queue, i - 1, i);
     }
-    while (!queue_.empty()) {
-        auto item = queue_.top();
-        queue_.pop();
-        auto &first = symbols_[item.start];
-        auto &last = symbols_[item.end];
+    while (!queue.empty()) {
+        auto item = queue.top();
+        queue.pop();
+        auto &first = symbols[item.start];
+        auto &last = symbols[item.end];
         if (first.length == 0 || last.length == 0) {
             continue;
         }
@@ -184,17 +245,17 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
         last.length = 0;
         first.next = last.next;
         if (last.next != -1) {
-            symbols_[last.next].last = item.start;
+            symbols[last.next].last = item.start;
         }
         // Keep Merging!
-        tryMergeSymbol(first.last, item.start);
-        tryMergeSymbol(item.start, first.next);
+        tryMergeSymbol(symbols, queue, first.last, item.start);
+        tryMergeSymbol(symbols, queue, item.start, first.next);
     }
     // auto result = this->vocab_map_.find("<image>");
     // auto t = result->second;
-    for (int i = 0; i < symbols_.size(); ++i) {
-        if (symbols_[i].length > 0) {
-            auto token_text = std::string(symbols_[i].ch, symbols_[i].length);
+    for (int i = 0; i < symbols.size(); ++i) {
+        if (symbols[i].length > 0) {
+            auto token_text = std::string(symbols[i].ch, symbols[i].length);
             auto result = this->vocab_map_.find(token_text);
             if (result != this->vocab_map_.end()) {
                 tokens.emplace_back(result->second);
@@ -202,8 +263,8 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
                 if (!byte_fallback) {
                     tokens.emplace_back(mllm::BPETokenizer::TokenUnk);
                 } else {
-                    for (int j = 0; j < (int)symbols_[i].length; ++j) {
-                        token_id_t token_id = static_cast<uint8_t>(symbols_[i].ch[j]) + 3;
+                    for (int j = 0; j < (int)symbols[i].length; ++j) {
+                        token_id_t token_id = static_cast<uint8_t>(symbols[i].ch[j]) + 3;
                         tokens.emplace_back(token_id);
                     }
                 }
@@ -213,14 +274,34 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
 }
 
 void mllm::BPETokenizer::setMergeRank(const std::unordered_map<string, unsigned> &merge_rank) {
-    this->merge_rank = merge_rank;
+    symbol_ids_.clear();
+    pair_rank_.clear();
+    pair_rank_.reserve(merge_rank.size());
+    auto intern = [this](const std::string &symbol) {
+        return symbol_ids_.emplace(symbol, (int)symbol_ids_.size()).first->second;
+    };
+    for (const auto &[merge, rank] : merge_rank) {
+        // "left right"
+        const size_t space = merge.find(' ');
+        if (space == std::string::npos) {
+            continue;
+        }
+        const std::string left = merge.substr(0, space);
+        const std::string right = merge.substr(space + 1);
+        const int left_id = intern(left);
+        const int right_id = intern(right);
+        pair_rank_[(uint64_t)left_id << 32 | (uint32_t)right_id] = {rank, intern(left + right)};
+    }
+    std::lock_guard<std::mutex> lock(word_cache_mutex_);
+    word_cache_.clear();
+    word_cache_lru_.clear();
 }
 
-void mllm::BPETokenizer::tryMergeSymbol(size_t start, size_t end) {
+void mllm::BPETokenizer::tryMergeSymbol(const std::vector<CharSymbol> &symbols, MergeQueue &queue, size_t start, size_t end) const {
     if (start == -1 || end == -1) {
         return;
     }
-    std::string merge_str = std::string(symbols_[start].ch, symbols_[end].ch + symbols_[end].length);
+    std::string merge_str = std::string(symbols[start].ch, symbols[end].ch + symbols[end].length);
     auto result = this->vocab_map_.find(merge_str);
     if (result != this->vocab_map_.end() && result->second < id_token_.size()) {
         auto token = this->id_token_[result->second];
@@ -229,7 +310,7 @@ void mllm::BPETokenizer::tryMergeSymbol(size_t start, size_t end) {
         item.end = end;
         item.score = token.score;
         item.length = merge_str.size();
-        queue_.emplace(item);
+        queue.emplace(item);
     }
 }
 void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos) {
@@ -6,6 +6,9 @@
 #define MLLM_BPE_HPP
 #include <queue>
 #include "tokenizers/Tokenizer.hpp"
+#include <cstdint>
+#include <list>
+#include <mutex>
 #include <unordered_map>
 namespace mllm {
 class BPETokenizer : public Tokenizer {
@@ -26,10 +29,19 @@ class BPETokenizer : public Tokenizer {
         int last;
         int next;
     };
-    std::unordered_map<string, unsigned> merge_rank;
-    std::vector<CharSymbol> symbols_;
-    std::priority_queue<TokenItem, std::vector<TokenItem>, TokenItem::Compare> queue_;
-    void tryMergeSymbol(size_t start, size_t end);
+    // merges: every string taking part in one is interned as a symbol id, and pair_rank_ maps the pair
+    // (left id << 32 | right id) to its rank and the id of the merged symbol
+    std::unordered_map<string, int> symbol_ids_;
+    std::unordered_map<uint64_t, std::pair<unsigned, int>> pair_rank_;
+    // bounded LRU of bpe() results, keyed by the word and its end symbol
+    using WordCacheEntry = std::pair<std::string, std::vector<std::string>>;
+    size_t word_cache_capacity_ = 16384;
+    std::list<WordCacheEntry> word_cache_lru_;
+    std::unordered_map<std::string, std::list<WordCacheEntry>::iterator> word_cache_;
+    std::mutex word_cache_mutex_;
+    using MergeQueue = std::priority_queue<TokenItem, std::vector<TokenItem>, TokenItem::Compare>;
+    // the symbols and queue are per call, so tokenize can run on several threads at once
+    void tryMergeSymbol(const std::vector<CharSymbol> &symbols, MergeQueue &queue, size_t start, size_t end) const;
     std::unordered_map<unsigned char, std::string> bytes_to_unicode_;
 
 public:
@@ -37,7 +49,20 @@ public:
         return vocab_map_;
     }
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos) override;
+    /**
+     * \brief split `token` into its utf-8 characters (`end_symbol` appended to the last one) and apply the merges
+     * by rank, lowest first and left to right.
+     */
     vector<std::string> bpe(const std::string &token, std::string end_symbol);
+    /**
+     * \brief the words the merges are applied to, same as matching
+     * `<\|startoftext\|>|<\|endoftext\|>|'s|'t|'re|'ve|'m|'ll|'d|\w+|\d+|\S+` over `text`.
+     */
+    static void preTokenize(const std::string &text, std::vector<std::string> &words);
+    /**
+     * \brief number of words whose bpe() result is kept, 0 disables the cache.
+     */
+    void setWordCacheCapacity(size_t capacity);
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, std::vector<std::string> &special_tokens, bool byte_fallback = false);
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, bool byte_fallback, std::string end_symbol);
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, const std::vector<std::string> &special);
@@ -4,6 +4,9 @@
 #include "ParamLoader.hpp"
 #include "Tokenizer.hpp"
 #include <Net.hpp>
+#include "backends/cpu/CPUBackend.hpp"
+#include "backends/cpu/compute/ThreadPool.hpp"
+#include <cctype>
 /* Vocab Structure
  * ┌──────┬──────┬─────┬────────┬──────┬──────┬───────┐
  * │      │      │     │        │      │      │       │
@@ -187,4 +190,56 @@ void Tokenizer::setSpecialToken(const string &bos, const string &eos, const stri
         }
     }
 }
-} // namespace mllm
\ No newline at end of file
+
+void Tokenizer::tokenizeBatch(const std::vector<std::string> &texts, std::vector<std::vector<token_id_t>> &tokens, bool bos, int thread_count) {
+    tokens.assign(texts.size(), {});
+    // one text at a time, their lengths differ too much for larger chunks
+    parallel_for((int64_t)texts.size(), thread_count > 0 ? thread_count : CPUBackend::cpu_threads, [&](int64_t i) {
+        this->tokenize(texts[i], tokens[i], bos);
+    }, 1);
+}
+
+// length of the utf-8 sequence starting with `lead`, 0 for a continuation byte
+static size_t utf8SequenceLength(unsigned char lead) {
+    if (lead < 0x80) return 1;
+    if ((lead & 0xE0) == 0xC0) return 2;
+    if ((lead & 0xF0) == 0xE0) return 3;
+    if ((lead & 0xF8) == 0xF0) return 4;
+    return 0;
+}
+
+bool StreamingDetokenizer::put(token_id_t token, std::string &text) {
+    auto piece = tokenizer_.detokenize({token});
+    auto [not_end, output] = tokenizer_.postprocess(piece);
+    if (!not_end) {
+        return false;
+    }
+    // sentencepiece byte fallback
+    if (output.size() == 6 && output.compare(0, 3, "<0x") == 0 && output[5] == '>' && isxdigit(output[3]) && isxdigit(output[4])) {
+        output = std::string(1, (char)std::stoi(output.substr(3, 2), nullptr, 16));
+    }
+    pending_ += output;
+    // find where the last, possibly unfinished, character starts
+    size_t end = pending_.size();
+    for (size_t back = 1; back <= std::min<size_t>(4, pending_.size()); ++back) {
+        const size_t start = pending_.size() - back;
+        const size_t length = utf8SequenceLength((unsigned char)pending_[start]);
+        if (length == 0) {
+            continue;
+        }
+        if (length > back) {
+            end = start;
+        }
+        break;
+    }
+    text.append(pending_, 0, end);
+    pending_.erase(0, end);
+    return true;
+}
+
+std::string StreamingDetokenizer::flush() {
+    std::string rest;
+    rest.swap(pending_);
+    return rest;
+}
+} // namespace mllm
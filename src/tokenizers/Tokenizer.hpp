@@ -75,24 +75,47 @@ public:
         tensor1.setName(name);
         Tensor::tensor_status = TENSOR_STATIC_INIT;
         tensor1.setTtype(INPUT_TENSOR);
+        // [1, 1, S, 1] is contiguous along the sequence
+        auto *data = tensor1.hostPtr<float>();
         for (int idx = 0; idx < tokens_id.size(); ++idx) {
-            tensor1.setDataAt<float>(0, 0, idx, 0, tokens_id[idx]);
+            data[idx] = (float)tokens_id[idx];
         }
         return tensor1;
     }
-    static Tensor tokens2Input(vector<vector<token_id_t>> tokens, string name = "input", BackendType type = MLLM_CPU) {
+    /**
+     * \brief a [B, 1, S, 1] input, S being the longest sequence; the shorter ones are padded with `pad` at the end.
+     */
+    static Tensor tokens2Input(vector<vector<token_id_t>> tokens, string name = "input", BackendType type = MLLM_CPU, token_id_t pad = 0) {
         const auto bsize = static_cast<int>(tokens.size());
-        Tensor tensor1(bsize, 1, static_cast<int>(tokens[0].size()), 1, Backend::global_backends[type], true);
+        size_t seq = 0;
+        for (const auto &sequence : tokens) {
+            seq = std::max(seq, sequence.size());
+        }
+        Tensor tensor1(bsize, 1, static_cast<int>(seq), 1, Backend::global_backends[type], true);
         tensor1.setName(name);
         Tensor::tensor_status = TENSOR_STATIC_INIT;
         tensor1.setTtype(INPUT_TENSOR);
         for (int b = 0; b < bsize; ++b) {
-            for (int idx = 0; idx < tokens[b].size(); ++idx) {
-                tensor1.setDataAt<float>(b, 0, idx, 0, tokens[b][idx]);
+            auto *row = tensor1.ptrAt<float>(b, 0, 0, 0);
+            for (size_t idx = 0; idx < seq; ++idx) {
+                row[idx] = (float)(idx < tokens[b].size() ? tokens[b][idx] : pad);
             }
         }
         return tensor1;
     }
+    /**
+     * \brief tokenize(texts[i], tokens[i], bos) for every text, spread over `thread_count` threads of the CPU thread pool
+     * (0: CPUBackend::cpu_threads). The texts are taken as they are, model specific templates have to be applied before.
+     */
+    void tokenizeBatch(const std::vector<std::string> &texts, std::vector<std::vector<token_id_t>> &tokens, bool bos, int thread_count = 0);
+    /**
+     * \brief tokenizeBatch straight into a [B, 1, S, 1] input, see tokens2Input.
+     */
+    Tensor tokenizeBatch(const std::vector<std::string> &texts, bool bos, string name = "input", BackendType type = MLLM_CPU, token_id_t pad = 0) {
+        std::vector<std::vector<token_id_t>> tokens;
+        tokenizeBatch(texts, tokens, bos);
+        return tokens2Input(tokens, std::move(name), type, pad);
+    }
 
     std::vector<std::string> _splitWithDelimiters(const std::string &str, const std::vector<std::string> &delimiters) {
         std::string s = str;
@@ -182,6 +205,36 @@ public:
     }
 };
 
+/**
+ * \brief Detokenizes generated tokens one at a time for streaming output.
+ *
+ * A character may be split over several tokens (byte level BPE, `<0xE4>` style byte fallback tokens), so the
+ * bytes of an unfinished utf-8 character are held back until the token completing it arrives, and every
+ * returned string is valid utf-8 on its own.
+ */
+class StreamingDetokenizer {
+public:
+    explicit StreamingDetokenizer(Tokenizer &tokenizer) :
+        tokenizer_(tokenizer) {
+    }
+    /**
+     * \brief detokenize and postprocess `token`, appending the completed characters to `text`.
+     * \return false when the tokenizer's postprocess ends the text, `text` is left untouched then.
+     */
+    bool put(token_id_t token, std::string &text);
+    /**
+     * \brief the bytes held back so far, for the end of the text.
+     */
+    std::string flush();
+    void reset() {
+        pending_.clear();
+    }
+
+private:
+    Tokenizer &tokenizer_;
+    std::string pending_;
+};
+
 } // namespace mllm
 
 #endif // MLLM_TOKENIZER_HPP
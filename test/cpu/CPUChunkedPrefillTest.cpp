@@ -0,0 +1,72 @@
+#include "CPUTest.hpp"
+#include "models/llama/modeling_llama.hpp"
+#include <cmath>
+
+namespace {
+// deterministic F32 weights
+class ChunkedPrefillTestLoader : public AbstructLoader {
+public:
+    bool load(Tensor *tensor) override {
+        const int rows = tensor->batch() * tensor->head() * tensor->sequence();
+        const int cols = tensor->dimension();
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) {
+                const float value = 0.1F * std::sin(0.29F * (float)(r * cols + c) + (float)tensor->name().size());
+                // the norm weights stay around 1
+                tensor->setDataAt<float>(0, 0, r, c, tensor->name().find("norm") != string::npos ? 1.0F + value : value);
+            }
+        }
+        return true;
+    }
+    bool load(std::shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override {
+        return MLLM_TYPE_F32;
+    }
+};
+} // namespace
+
+TEST_F(CPUTest, CPUChunkedPrefill) {
+    // a prompt prefilled in chunks gives the logits of a prompt prefilled at once, also for the next decode step
+    const int vocab = 96, hidden_dim = 64, seq = 11, next_token = 5;
+    Module::initBackend(MLLM_CPU);
+    LLaMANameConfig names;
+    names.init(LLAMAROPE);
+    ChunkedPrefillTestLoader loader;
+    auto run = [&](int chunk_size, vector<float> &result) {
+        LLaMAModel model(vocab, hidden_dim, 2, 2, 128, 2, LLAMAROPE, 10000, 128, 32, names, names.blk_name);
+        model.load(loader);
+        Tensor input(1, 1, seq, 1, Backend::global_backends[MLLM_CPU], true);
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        for (int s = 0; s < seq; s++) { input.setDataAt<float>(0, 0, s, 0, (float)(s * 7 % vocab)); }
+        auto out = model.prefill(input, chunk_size)[0];
+        result.clear();
+        for (int d = 0; d < vocab; d++) { result.push_back(out.dataAt<float>(0, 0, out.sequence() - 1, d)); }
+        input.reshape(1, 1, 1, 1);
+        input.alloc();
+        input.setDataAt<float>(0, 0, 0, 0, (float)next_token);
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        out = model({input})[0];
+        for (int d = 0; d < vocab; d++) { result.push_back(out.dataAt<float>(0, 0, 0, d)); }
+        input.free();
+        // one prefill step of the whole prompt and one decode step: load time, prefill and decode speed
+        const auto speeds = model.profiling();
+        EXPECT_EQ(speeds.size(), 3) << chunk_size;
+    };
+    for (bool flash : {true, false}) {
+        MultiHeadAttention::use_flash_attention = flash;
+        vector<float> whole, chunked;
+        run(0, whole);
+        for (int chunk_size : {4, 5}) {
+            run(chunk_size, chunked);
+            ASSERT_EQ(chunked.size(), whole.size());
+            for (size_t i = 0; i < whole.size(); i++) {
+                ASSERT_NEAR(chunked[i], whole[i], 1e-4F * std::max(1.0F, std::abs(whole[i]))) << flash << " " << chunk_size << " " << i;
+            }
+        }
+    }
+    MultiHeadAttention::use_flash_attention = true;
+}
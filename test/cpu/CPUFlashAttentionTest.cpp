@@ -0,0 +1,196 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/op/CPUFlashAttention.hpp"
+#include "backends/cpu/op/CPUKVCache.hpp"
+#include "backends/cpu/quantize/QuantizeQ8.hpp"
+#include "backends/cpu/quantize/QuantizeQ4.hpp"
+#include <cmath>
+
+// softmax(q k^T / sqrt(d)) v for one (b, h, s), over keys [0, keys)
+static vector<float> referenceAttention(Tensor *q, Tensor *k, Tensor *v, int b, int h, int s, int keys) {
+    const int D = q->dimension();
+    const int kv_h = h / (q->head() / k->head());
+    auto value = [](Tensor *t, int b, int h, int n, int d) {
+        return t->dtype() == MLLM_TYPE_F16 ? MLLM_FP16_TO_FP32(t->dataAt<mllm_fp16_t>(b, h, n, d)) : t->dataAt<float>(b, h, n, d);
+    };
+    vector<float> scores(keys);
+    float max = -INFINITY;
+    for (int n = 0; n < keys; ++n) {
+        float dot = 0;
+        for (int d = 0; d < D; ++d) { dot += q->dataAt<float>(b, h, s, d) * value(k, b, kv_h, n, d); }
+        scores[n] = dot / std::sqrt((float)D);
+        max = std::max(max, scores[n]);
+    }
+    float sum = 0;
+    for (auto &score : scores) {
+        score = std::exp(score - max);
+        sum += score;
+    }
+    vector<float> out(D, 0);
+    for (int n = 0; n < keys; ++n) {
+        for (int d = 0; d < D; ++d) { out[d] += scores[n] / sum * value(v, b, kv_h, n, d); }
+    }
+    return out;
+}
+
+TEST_F(CPUTest, CPUFlashAttention1) {
+    // causal prefill over a padded F16 cache: 8 q heads on 2 kv heads, 70 valid keys of 80, 9 new tokens
+    const int B = 1, H = 8, H_kv = 2, S = 9, N = 80, D = 16, kv_len = 70;
+    auto op = new CPUFlashAttention(bn_, "sdpa", true, 4);
+    TENSOR(q);
+    TENSOR(k);
+    TENSOR(v);
+    TENSOR(output);
+    q->reshape(B, H, S, D);
+    q->alloc();
+    for (auto &t : {k, v}) {
+        t->setDtype(MLLM_TYPE_F16);
+        t->reshape(B, H_kv, N, D);
+        t->alloc();
+    }
+    for (int h = 0; h < H; ++h) {
+        for (int s = 0; s < S; ++s) {
+            for (int d = 0; d < D; ++d) { q->setDataAt<float>(0, h, s, d, std::sin((float)(h * 31 + s * 7 + d))); }
+        }
+    }
+    for (int h = 0; h < H_kv; ++h) {
+        for (int n = 0; n < N; ++n) {
+            for (int d = 0; d < D; ++d) {
+                k->setDataAt<mllm_fp16_t>(0, h, n, d, MLLM_FP32_TO_FP16(std::cos((float)(h * 13 + n * 3 + d))));
+                v->setDataAt<mllm_fp16_t>(0, h, n, d, MLLM_FP32_TO_FP16(std::sin((float)(h * 5 + n + d * 2))));
+            }
+        }
+    }
+    auto kv_len_tensor = std::make_shared<Tensor>(kv_len, bn_);
+    TEST_RESHAPE({q, k, v, kv_len_tensor}, {output});
+    output->alloc();
+    TEST_EXCUTE({q, k, v, kv_len_tensor}, {output});
+    for (int h = 0; h < H; ++h) {
+        for (int s = 0; s < S; ++s) {
+            auto ref = referenceAttention(q.get(), k.get(), v.get(), 0, h, s, kv_len - S + s + 1);
+            for (int d = 0; d < D; ++d) {
+                ASSERT_NEAR(output->dataAt<float>(0, h, s, d), ref[d], 1e-2);
+            }
+        }
+    }
+    delete op;
+}
+
+TEST_F(CPUTest, CPUFlashAttention2) {
+    // bidirectional F32 attention, e.g. a vision encoder
+    const int B = 2, H = 3, S = 37, D = 8;
+    auto op = new CPUFlashAttention(bn_, "sdpa", false, 4);
+    TENSOR(q);
+    TENSOR(k);
+    TENSOR(v);
+    TENSOR(output);
+    for (auto &t : {q, k, v}) {
+        t->reshape(B, H, S, D);
+        t->alloc();
+    }
+    for (int b = 0; b < B; ++b) {
+        for (int h = 0; h < H; ++h) {
+            for (int s = 0; s < S; ++s) {
+                for (int d = 0; d < D; ++d) {
+                    q->setDataAt<float>(b, h, s, d, std::sin((float)(b + h * 3 + s + d * 5)));
+                    k->setDataAt<float>(b, h, s, d, std::cos((float)(b * 7 + h + s * 2 + d)));
+                    v->setDataAt<float>(b, h, s, d, (float)((s + d) % 5) - 2.0F);
+                }
+            }
+        }
+    }
+    TEST_RESHAPE({q, k, v}, {output});
+    output->alloc();
+    TEST_EXCUTE({q, k, v}, {output});
+    for (int b = 0; b < B; ++b) {
+        for (int h = 0; h < H; ++h) {
+            for (int s = 0; s < S; ++s) {
+                auto ref = referenceAttention(q.get(), k.get(), v.get(), b, h, s, S);
+                for (int d = 0; d < D; ++d) {
+                    ASSERT_NEAR(output->dataAt<float>(b, h, s, d), ref[d], 1e-4);
+                }
+            }
+        }
+    }
+    delete op;
+}
+
+TEST_F(CPUTest, CPUFlashAttentionQuantizedCache) {
+    // Q8_0 keys and Q4_0 values quantized on append by contiguous and paged caches, 8 q heads on 2 kv heads
+    const int B = 1, H = 8, H_kv = 2, D = 32, N = 16;
+    for (int block_size : {0, 4}) {
+        auto k_cache = new CPUKVCache(bn_, "k_cache", H / H_kv, 64, 4, block_size);
+        auto v_cache = new CPUKVCache(bn_, "v_cache", H / H_kv, 64, 4, block_size);
+        k_cache->setCacheDtype(MLLM_TYPE_Q8_0);
+        v_cache->setCacheDtype(MLLM_TYPE_Q4_0);
+        auto op = new CPUFlashAttention(bn_, "sdpa", true, 4);
+        TENSOR(k_ref);
+        TENSOR(v_ref);
+        for (auto &t : {k_ref, v_ref}) {
+            t->reshape(B, H_kv, N, D);
+            t->alloc();
+        }
+        int total = 0;
+        for (int S : {7, 1, 1}) {
+            TENSOR(q);
+            TENSOR(k);
+            TENSOR(v);
+            TENSOR(k_out);
+            TENSOR(v_out);
+            TENSOR(output);
+            q->reshape(B, H, S, D);
+            q->alloc();
+            for (auto &t : {k, v}) {
+                t->reshape(B, H_kv, S, D);
+                t->alloc();
+            }
+            for (int s = 0; s < S; ++s) {
+                for (int h = 0; h < H; ++h) {
+                    for (int d = 0; d < D; ++d) { q->setDataAt<float>(0, h, s, d, std::sin((float)(h * 31 + (total + s) * 7 + d))); }
+                }
+                for (int h = 0; h < H_kv; ++h) {
+                    for (int d = 0; d < D; ++d) {
+                        k->setDataAt<float>(0, h, s, d, std::cos((float)(h * 13 + (total + s) * 3 + d)));
+                        v->setDataAt<float>(0, h, s, d, std::sin((float)(h * 5 + total + s + d * 2)));
+                    }
+                    // the reference sees what the caches keep
+                    block_q8_0 k_q8[D / QK8_0];
+                    block_q4_0 v_q4[D / QK4_0];
+                    quantize_row_q8_0(k->ptrAt<float>(0, h, s, 0), k_q8, D);
+                    dequantize_row_q8_0(k_q8, k_ref->ptrAt<float>(0, h, total + s, 0), D);
+                    quantize_row_q4_0(v->ptrAt<float>(0, h, s, 0), v_q4, D);
+                    dequantize_row_q4_0(v_q4, v_ref->ptrAt<float>(0, h, total + s, 0), D);
+                }
+            }
+            for (auto &cache : {std::make_pair(k_cache, std::make_pair(k, k_out)), std::make_pair(v_cache, std::make_pair(v, v_out))}) {
+                auto &in = cache.second.first;
+                auto &out = cache.second.second;
+                ASSERT_FALSE(cache.first->reshape({in}, {out}));
+                ASSERT_FALSE(cache.first->setUp({in}, {out}));
+                ASSERT_FALSE(cache.first->execute({in}, {out}));
+            }
+            total += S;
+            ASSERT_EQ(k_out->head(), H_kv);
+            ASSERT_EQ(k_out->sequence(), total);
+            auto kv_len_tensor = std::make_shared<Tensor>(total, bn_);
+            TEST_RESHAPE({q, k_out, v_out, kv_len_tensor}, {output});
+            output->alloc();
+            TEST_EXCUTE({q, k_out, v_out, kv_len_tensor}, {output});
+            for (int h = 0; h < H; ++h) {
+                for (int s = 0; s < S; ++s) {
+                    auto ref = referenceAttention(q.get(), k_ref.get(), v_ref.get(), 0, h, s, total - S + s + 1);
+                    for (int d = 0; d < D; ++d) {
+                        ASSERT_NEAR(output->dataAt<float>(0, h, s, d), ref[d], 1e-2);
+                    }
+                }
+            }
+        }
+        if (block_size == 0) {
+            // kv heads only, about a quarter of the bytes of the replicated F16 cache
+            ASSERT_EQ(k_cache->cache_.head(), H_kv);
+            ASSERT_EQ(k_cache->cache_.cntSize(), DataTypeSize(MLLM_TYPE_Q8_0, B * H_kv * k_cache->cache_.sequence() * D));
+        }
+        delete op;
+        delete k_cache;
+        delete v_cache;
+    }
+}
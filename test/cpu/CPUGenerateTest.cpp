@@ -0,0 +1,119 @@
+#include "CPUTest.hpp"
+#include "Module.hpp"
+#include <cmath>
+#include <numeric>
+#include <set>
+
+namespace {
+Tensor makeLogits(const vector<float> &values) {
+    Tensor logits(1, 1, 1, (int)values.size(), Backend::global_backends[MLLM_CPU], true);
+    for (size_t i = 0; i < values.size(); i++) { logits.setDataAt<float>(0, 0, 0, (int)i, values[i]); }
+    return logits;
+}
+
+// ids of the values in descending order, the reference the sampler is checked against
+vector<unsigned> sortedIds(const vector<float> &values) {
+    vector<unsigned> ids(values.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    std::stable_sort(ids.begin(), ids.end(), [&](unsigned a, unsigned b) { return values[a] > values[b]; });
+    return ids;
+}
+} // namespace
+
+TEST_F(CPUTest, CPUGenerateSampling) {
+    Module::initBackend(MLLM_CPU);
+    const int vocab = 50000;
+    vector<float> values(vocab);
+    for (int i = 0; i < vocab; i++) { values[i] = 4.0F * std::sin(0.013F * (float)i * (float)(i % 97)); }
+    const auto order = sortedIds(values);
+    auto logits = makeLogits(values);
+
+    LlmTextGeneratorOpts opt;
+    opt.seed = 7;
+    LlmTextGenerator greedy(LLmTextGeneratorType::kGreedySearch, opt);
+    EXPECT_EQ(greedy.generate(logits), order[0]);
+
+    // top-k only ever returns one of the k largest, and with the same seed the same ones
+    opt.top_k = 8;
+    opt.temperature = 1.0F;
+    LlmTextGenerator topk(LLmTextGeneratorType::kTopkSampling, opt);
+    LlmTextGenerator topk_again(LLmTextGeneratorType::kTopkSampling, opt);
+    const std::set<unsigned> top8(order.begin(), order.begin() + 8);
+    std::set<unsigned> seen;
+    for (int i = 0; i < 200; i++) {
+        const auto token = topk.generate(logits);
+        EXPECT_TRUE(top8.count(token)) << token;
+        EXPECT_EQ(topk_again.generate(logits), token);
+        seen.insert(token);
+    }
+    EXPECT_GT(seen.size(), 1);
+
+    // top-p returns one of the fewest largest probabilities reaching p
+    vector<float> probs(vocab);
+    const float max_value = values[order[0]];
+    double sum = 0;
+    for (int i = 0; i < vocab; i++) { sum += probs[i] = std::exp(2.0F * (values[i] - max_value)); }
+    for (auto &p : probs) { p = (float)(p / sum); }
+    opt.top_k = 0;
+    opt.top_p = 0.5F;
+    LlmTextGenerator topp(LLmTextGeneratorType::kToppSampling, opt);
+    const auto prob_order = sortedIds(probs);
+    std::set<unsigned> nucleus;
+    float mass = 0.F;
+    for (size_t i = 0; mass < opt.top_p; i++) {
+        mass += probs[prob_order[i]];
+        nucleus.insert(prob_order[i]);
+    }
+    auto prob_tensor = makeLogits(probs);
+    for (int i = 0; i < 50; i++) {
+        const auto token = topp.generate(prob_tensor);
+        EXPECT_TRUE(nucleus.count(token)) << token;
+    }
+    logits.free();
+    prob_tensor.free();
+}
+
+TEST_F(CPUTest, CPUGeneratePenalties) {
+    Module::initBackend(MLLM_CPU);
+    vector<float> values = {1.0F, 3.0F, 2.9F, -1.0F, 2.6F};
+    LlmTextGeneratorOpts opt;
+    opt.repetition_penalty = 1.2F;
+    LlmTextGenerator greedy(LLmTextGeneratorType::kGreedySearch, opt);
+    // 3.0 / 1.2 = 2.5 falls below 2.9
+    greedy.reset(opt, {1});
+    auto logits = makeLogits(values);
+    EXPECT_EQ(greedy.generate(logits), 2);
+    logits.free();
+    // 2.9 / 1.2 and 3.0 / 1.2 now both fall below 2.6
+    logits = makeLogits(values);
+    EXPECT_EQ(greedy.generate(logits), 4);
+    logits.free();
+
+    // the frequency penalty counts generated tokens only
+    opt.repetition_penalty = 1.0F;
+    opt.frequency_penalty = 0.3F;
+    greedy.reset(opt, {2});
+    logits = makeLogits(values);
+    EXPECT_EQ(greedy.generate(logits), 1);
+    logits.free();
+    logits = makeLogits(values);
+    EXPECT_EQ(greedy.generate(logits), 2);
+    // the penalties do not touch the logits themselves
+    for (size_t i = 0; i < values.size(); i++) { EXPECT_EQ(logits.dataAt<float>(0, 0, 0, (int)i), values[i]); }
+    logits.free();
+
+    // for top-p the penalties scale the probabilities, which stay a distribution
+    vector<float> probs = {0.5F, 0.3F, 0.1F, 0.06F, 0.04F};
+    opt.top_k = 0;
+    opt.top_p = 0.5F;
+    opt.frequency_penalty = 2.0F;
+    opt.seed = 3;
+    LlmTextGenerator topp(LLmTextGeneratorType::kToppSampling, opt);
+    topp.reset(opt, {});
+    auto prob_tensor = makeLogits(probs);
+    EXPECT_EQ(topp.generate(prob_tensor), 0);
+    // 0.5 * exp(-2) renormalised is about 0.12, and 0.3 alone now reaches p
+    EXPECT_EQ(topp.generate(prob_tensor), 1);
+    for (size_t i = 0; i < probs.size(); i++) { EXPECT_EQ(prob_tensor.dataAt<float>(0, 0, 0, (int)i), probs[i]); }
+    prob_tensor.free();
+}
@@ -0,0 +1,350 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/op/CPUKVCache.hpp"
+#include "backends/cpu/op/CPURoPE.hpp"
+#include "backends/cpu/compute/Matmul.hpp"
+#include "memory/KVCachePool.hpp"
+#include "PrefixCache.hpp"
+#include <cmath>
+
+TEST_F(CPUTest, CPUKVCachePaged) {
+    const int head = 2;
+    const int dim = 8;
+    const int block_size = 4;
+    auto op = new CPUKVCache(bn_, "k_cache", 2, 64, 4, block_size);
+    TENSOR(input);
+    TENSOR(output);
+    auto &pool = KVCachePool::get(bn_, block_size * head * dim * sizeof(mllm_fp16_t));
+    const int used_before = pool.usedBlocks();
+
+    vector<float> history; // [pos][head][dim]
+    int total = 0;
+    for (int seq : {5, 1, 1, 4}) {
+        input->reshape(1, head, seq, dim);
+        input->alloc();
+        for (int s = 0; s < seq; ++s) {
+            for (int h = 0; h < head; ++h) {
+                for (int d = 0; d < dim; ++d) {
+                    float v = std::sin((float)(total + s) * 0.7F + (float)h + (float)d * 0.1F);
+                    input->setDataAt<float>(0, h, s, d, v);
+                }
+            }
+        }
+        for (int s = 0; s < seq; ++s) {
+            for (int h = 0; h < head; ++h) {
+                for (int d = 0; d < dim; ++d) {
+                    history.push_back(input->dataAt<float>(0, h, s, d));
+                }
+            }
+        }
+        TEST_RESHAPE({input}, {output});
+        TEST_SETUP({input}, {output});
+        TEST_EXCUTE({input}, {output});
+        total += seq;
+        ASSERT_TRUE(output->aggregated());
+        ASSERT_EQ(output->sequence(), total);
+        ASSERT_EQ(op->getCacheSeqLen(), total);
+        ASSERT_EQ((int)output->aggregatedTensors().size(), (total + block_size - 1) / block_size);
+        for (int s = 0; s < total; ++s) {
+            for (int h = 0; h < head; ++h) {
+                for (int d = 0; d < dim; ++d) {
+                    float cached = MLLM_FP16_TO_FP32(output->dataAt<mllm_fp16_t>(0, h, s, d));
+                    ASSERT_NEAR(cached, history[(s * head + h) * dim + d], 1e-2);
+                }
+            }
+        }
+    }
+    ASSERT_EQ(pool.usedBlocks() - used_before, (total + block_size - 1) / block_size);
+
+    // q * k^T and p * v over the blocks, 4 query heads share 2 kv heads
+    const int q_head = 4;
+    TENSOR(q);
+    q->reshape(1, q_head, 1, dim);
+    q->alloc();
+    for (int h = 0; h < q_head; ++h) {
+        for (int d = 0; d < dim; ++d) {
+            q->setDataAt<float>(0, h, 0, d, std::cos((float)h + (float)d));
+        }
+    }
+    TENSOR(qk);
+    qk->reshape(1, q_head, 1, total);
+    qk->alloc();
+    mat_mul_paged(q.get(), output.get(), qk.get(), true, 4);
+    TENSOR(o);
+    o->reshape(1, q_head, 1, dim);
+    o->alloc();
+    mat_mul_paged(qk.get(), output.get(), o.get(), false, 4);
+    for (int h = 0; h < q_head; ++h) {
+        const int kv_h = h / (q_head / head);
+        vector<float> ref_o(dim, 0);
+        for (int s = 0; s < total; ++s) {
+            float ref = 0;
+            for (int d = 0; d < dim; ++d) {
+                ref += q->dataAt<float>(0, h, 0, d) * history[(s * head + kv_h) * dim + d];
+            }
+            ASSERT_NEAR(qk->dataAt<float>(0, h, 0, s), ref, 5e-2);
+            for (int d = 0; d < dim; ++d) {
+                ref_o[d] += qk->dataAt<float>(0, h, 0, s) * history[(s * head + kv_h) * dim + d];
+            }
+        }
+        for (int d = 0; d < dim; ++d) {
+            ASSERT_NEAR(o->dataAt<float>(0, h, 0, d), ref_o[d], 5e-2);
+        }
+    }
+
+    op->clearCache();
+    ASSERT_EQ(pool.usedBlocks(), used_before);
+    delete op;
+}
+
+TEST_F(CPUTest, CPUKVCacheEviction) {
+    const int dim = 4;
+    const int sink = 2;
+    const int limit = 16;
+    auto op = new CPUKVCache(bn_, "k_cache", 1, limit, 4);
+    op->setEviction(sink, 4);
+    TENSOR(input);
+    TENSOR(output);
+    const int tokens = 40;
+    for (int token = 0; token < tokens; ++token) {
+        input->reshape(1, 1, 1, dim);
+        TEST_RESHAPE({input}, {output});
+        TEST_SETUP({input}, {output});
+        for (int d = 0; d < dim; ++d) {
+            if (input->dtype() == MLLM_TYPE_F16) {
+                input->setDataAt<mllm_fp16_t>(0, 0, 0, d, MLLM_FP32_TO_FP16((float)token));
+            } else {
+                input->setDataAt<float>(0, 0, 0, d, (float)token);
+            }
+        }
+        TEST_EXCUTE({input}, {output});
+        ASSERT_LE(op->getCacheSeqLen(), limit);
+    }
+    // the sink tokens stay, the rest are the latest tokens in order
+    const int len = op->getCacheSeqLen();
+    for (int s = 0; s < len; ++s) {
+        float expected = s < sink ? (float)s : (float)(tokens - len + s);
+        ASSERT_EQ(MLLM_FP16_TO_FP32(op->cache_.dataAt<mllm_fp16_t>(0, 0, s, 0)), expected);
+    }
+    delete op;
+}
+
+TEST_F(CPUTest, CPURoPERotateRows) {
+    const int seq = 8;
+    const int dim = 16;
+    const int delta = 3;
+    for (int pose_type : {LLAMAROPE, HFHUBROPE}) {
+        auto op = new CPURoPE(bn_, "rope", pose_type, 10000, 64, 4);
+        TENSOR(input);
+        TENSOR(output);
+        input->reshape(1, 1, seq, dim);
+        input->alloc();
+        // identical rows, so row s of the output is the input rotated to position s
+        for (int s = 0; s < seq; ++s) {
+            for (int d = 0; d < dim; ++d) {
+                input->setDataAt<float>(0, 0, s, d, std::sin((float)d + 1.0F));
+            }
+        }
+        TEST_RESHAPE({input}, {output});
+        TEST_SETUP({input}, {output});
+        TEST_EXCUTE({input}, {output});
+        vector<float> rotated(output->hostPtr<float>(), output->hostPtr<float>() + seq * dim);
+        op->rotateRows(*output, delta, seq, -delta);
+        for (int s = delta; s < seq; ++s) {
+            for (int d = 0; d < dim; ++d) {
+                ASSERT_NEAR(output->dataAt<float>(0, 0, s, d), rotated[(s - delta) * dim + d], 1e-4);
+            }
+        }
+        delete op;
+    }
+}
+
+TEST_F(CPUTest, CPUKVCacheContinuousBatching) {
+    const int head = 1;
+    const int dim = 4;
+    const int block_size = 2;
+    auto cpu_backend = dynamic_cast<CPUBackend *>(bn_);
+    auto op = new CPUKVCache(bn_, "k_cache", 1, 64, 4, block_size);
+    TENSOR(input);
+    TENSOR(output);
+    auto &pool = KVCachePool::get(bn_, block_size * head * dim * sizeof(mllm_fp16_t));
+    const int used_before = pool.usedBlocks();
+    auto key = [](int slot, int pos, int d) { return (float)(slot * 100 + pos) + (float)d * 0.25F; };
+
+    // slot 0 prefills 3 tokens; then slot 0 decodes while slot 1 prefills 5; then slot 0 has finished
+    vector<SequenceBatch> steps(3);
+    steps[0].slots = {0, 0, 0};
+    steps[0].positions = {0, 1, 2};
+    steps[1].slots = {0, 1, 1, 1, 1, 1};
+    steps[1].positions = {3, 0, 1, 2, 3, 4};
+    steps[2].slots = {1};
+    steps[2].positions = {5};
+    for (auto &step : steps) {
+        cpu_backend->setSequenceBatch(step);
+        input->reshape(1, head, step.rows(), dim);
+        input->alloc();
+        for (int r = 0; r < step.rows(); ++r) {
+            for (int d = 0; d < dim; ++d) {
+                input->setDataAt<float>(0, 0, r, d, key(step.slots[r], step.positions[r], d));
+            }
+        }
+        TEST_RESHAPE({input}, {output});
+        TEST_SETUP({input}, {output});
+        TEST_EXCUTE({input}, {output});
+        // the slots of the step, one after the other
+        int s = 0;
+        for (auto &slot : step.slotLengths()) {
+            for (int pos = 0; pos < slot.second; ++pos, ++s) {
+                for (int d = 0; d < dim; ++d) {
+                    ASSERT_NEAR(MLLM_FP16_TO_FP32(output->dataAt<mllm_fp16_t>(0, 0, s, d)), key(slot.first, pos, d), 1e-1);
+                }
+            }
+        }
+        ASSERT_EQ(output->sequence(), s);
+    }
+    // slot 0 left the batch, only the 6 tokens of slot 1 are still cached
+    ASSERT_EQ(pool.usedBlocks() - used_before, 3);
+
+    // q * k^T over the packed rows of step 1: each row only sees its own slot up to its position
+    auto &step = steps[1];
+    cpu_backend->setSequenceBatch(step);
+    input->reshape(1, head, step.rows(), dim);
+    input->alloc();
+    for (int r = 0; r < step.rows(); ++r) {
+        for (int d = 0; d < dim; ++d) {
+            input->setDataAt<float>(0, 0, r, d, key(step.slots[r], step.positions[r], d));
+        }
+    }
+    TEST_RESHAPE({input}, {output});
+    TEST_SETUP({input}, {output});
+    TEST_EXCUTE({input}, {output});
+    TENSOR(q);
+    q->reshape(1, head, step.rows(), dim);
+    q->alloc();
+    for (int r = 0; r < step.rows(); ++r) {
+        for (int d = 0; d < dim; ++d) {
+            q->setDataAt<float>(0, 0, r, d, 0.01F * (float)(r + d));
+        }
+    }
+    TENSOR(qk);
+    qk->reshape(1, head, step.rows(), step.maxLength());
+    qk->alloc();
+    mat_mul_paged(q.get(), output.get(), qk.get(), true, 4, &cpu_backend->sequenceBatch());
+    for (int r = 0; r < step.rows(); ++r) {
+        for (int n = 0; n < step.maxLength(); ++n) {
+            if (n > step.positions[r]) {
+                ASSERT_EQ(qk->dataAt<float>(0, 0, r, n), -INFINITY);
+                continue;
+            }
+            float ref = 0;
+            for (int d = 0; d < dim; ++d) {
+                ref += q->dataAt<float>(0, 0, r, d) * key(step.slots[r], n, d);
+            }
+            ASSERT_NEAR(qk->dataAt<float>(0, 0, r, n), ref, 5e-2);
+        }
+    }
+    cpu_backend->setSequenceBatch({});
+    op->clearCache();
+    ASSERT_EQ(pool.usedBlocks(), used_before);
+    delete op;
+}
+
+TEST_F(CPUTest, CPUKVCachePrefixReuse) {
+    const int dim = 4;
+    const int chunk = 4;
+    // a contiguous and a paged cache, as two layers of one model
+    vector<CPUKVCache *> ops = {new CPUKVCache(bn_, "k_cache", 1, 64, 4), new CPUKVCache(bn_, "v_cache", 1, 64, 4, 2)};
+    vector<Op *> caches(ops.begin(), ops.end());
+    auto value = [](int layer, int pos, int d) { return (float)(layer * 100 + pos) + (float)d * 0.25F; };
+    auto prefill = [&](int begin, int end) {
+        for (int l = 0; l < (int)ops.size(); ++l) {
+            auto op = ops[l];
+            TENSOR(input);
+            TENSOR(output);
+            input->reshape(1, 1, end - begin, dim);
+            TEST_RESHAPE({input}, {output});
+            TEST_SETUP({input}, {output});
+            input->alloc();
+            for (int s = 0; s < end - begin; ++s) {
+                for (int d = 0; d < dim; ++d) {
+                    if (input->dtype() == MLLM_TYPE_F16) {
+                        input->setDataAt<mllm_fp16_t>(0, 0, s, d, MLLM_FP32_TO_FP16(value(l, begin + s, d)));
+                    } else {
+                        input->setDataAt<float>(0, 0, s, d, value(l, begin + s, d));
+                    }
+                }
+            }
+            TEST_EXCUTE({input}, {output});
+        }
+    };
+    vector<unsigned> prompt = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    prefill(0, (int)prompt.size());
+    PrefixCache prefix_cache(chunk);
+    prefix_cache.store(caches, prompt);
+    ASSERT_EQ(prefix_cache.size(), 2);
+
+    // same 8 leading tokens, different tail
+    vector<unsigned> next = {1, 2, 3, 4, 5, 6, 7, 8, 42, 43, 44};
+    for (auto op : ops) { op->clearCache(); }
+    ASSERT_EQ(prefix_cache.restore(caches, next), 8);
+    for (int l = 0; l < (int)ops.size(); ++l) {
+        ASSERT_EQ(ops[l]->getCacheSeqLen(), 8);
+        Tensor rows(bn_);
+        ops[l]->copyCacheTo(0, 8, rows);
+        for (int s = 0; s < 8; ++s) {
+            for (int d = 0; d < dim; ++d) {
+                ASSERT_NEAR(MLLM_FP16_TO_FP32(rows.dataAt<mllm_fp16_t>(0, 0, s, d)), value(l, s, d), 1e-1);
+            }
+        }
+    }
+    // the first chunk differs: nothing to reuse
+    for (auto op : ops) { op->clearCache(); }
+    ASSERT_EQ(prefix_cache.restore(caches, {9, 2, 3, 4, 5, 6, 7, 8, 9}), 0);
+    for (auto op : ops) { delete op; }
+}
+
+TEST_F(CPUTest, CPUKVCacheRollback) {
+    const int dim = 4;
+    const int block_size = 2;
+    // a contiguous and a paged cache, rolled back after a rejected speculative step
+    vector<CPUKVCache *> ops = {new CPUKVCache(bn_, "k_cache", 1, 64, 4), new CPUKVCache(bn_, "v_cache", 1, 64, 4, block_size)};
+    auto &pool = KVCachePool::get(bn_, block_size * dim * sizeof(mllm_fp16_t));
+    const int used_before = pool.usedBlocks();
+    auto feed = [&](vector<float> values) {
+        for (auto op : ops) {
+            TENSOR(input);
+            TENSOR(output);
+            input->reshape(1, 1, (int)values.size(), dim);
+            TEST_RESHAPE({input}, {output});
+            TEST_SETUP({input}, {output});
+            input->alloc();
+            for (int s = 0; s < (int)values.size(); ++s) {
+                for (int d = 0; d < dim; ++d) {
+                    if (input->dtype() == MLLM_TYPE_F16) {
+                        input->setDataAt<mllm_fp16_t>(0, 0, s, d, MLLM_FP32_TO_FP16(values[s]));
+                    } else {
+                        input->setDataAt<float>(0, 0, s, d, values[s]);
+                    }
+                }
+            }
+            TEST_EXCUTE({input}, {output});
+        }
+    };
+    feed({0, 1, 2});
+    feed({3, 4, 5, 6});
+    for (auto op : ops) { op->rollbackCache(3); }
+    ASSERT_EQ(ops[1]->getCacheSeqLen(), 4);
+    ASSERT_EQ(pool.usedBlocks() - used_before, 2);
+    // the rolled back rows are overwritten by the next step
+    feed({7, 8});
+    vector<float> expected = {0, 1, 2, 3, 7, 8};
+    for (auto op : ops) {
+        ASSERT_EQ(op->getCacheSeqLen(), 6);
+        Tensor rows(bn_);
+        op->copyCacheTo(0, 6, rows);
+        for (int s = 0; s < 6; ++s) {
+            ASSERT_NEAR(MLLM_FP16_TO_FP32(rows.dataAt<mllm_fp16_t>(0, 0, s, 0)), expected[s], 1e-2);
+        }
+    }
+    for (auto op : ops) { delete op; }
+    ASSERT_EQ(pool.usedBlocks(), used_before);
+}
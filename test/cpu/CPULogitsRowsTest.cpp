@@ -0,0 +1,107 @@
+#include "CPUTest.hpp"
+#include "models/llama/modeling_llama.hpp"
+#include "SpeculativeDecoding.hpp"
+#include <cmath>
+
+namespace {
+// deterministic F32 weights
+class LogitsRowsTestLoader : public AbstructLoader {
+public:
+    float phase = 0.F;
+    bool load(Tensor *tensor) override {
+        const int rows = tensor->batch() * tensor->head() * tensor->sequence();
+        const int cols = tensor->dimension();
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) {
+                const float value = 0.1F * std::sin(0.37F * (float)(r * cols + c) + (float)tensor->name().size() + phase);
+                // the norm weights stay around 1
+                tensor->setDataAt<float>(0, 0, r, c, tensor->name().find("norm") != string::npos ? 1.0F + value : value);
+            }
+        }
+        return true;
+    }
+    bool load(std::shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override {
+        return MLLM_TYPE_F32;
+    }
+};
+} // namespace
+
+TEST_F(CPUTest, CPULogitsRows) {
+    // the logits of the kept positions match those computed for the whole prompt
+    const int vocab = 96, hidden_dim = 64, seq = 6;
+    Module::initBackend(MLLM_CPU);
+    LLaMANameConfig names;
+    names.init(LLAMAROPE);
+    LogitsRowsTestLoader loader;
+    auto run = [&](int logits_rows, Tensor &logits) {
+        Module::logits_rows = logits_rows;
+        LLaMAModel model(vocab, hidden_dim, 2, 2, 128, 2, LLAMAROPE, 10000, 128, 32, names, names.blk_name);
+        model.load(loader);
+        Tensor input(1, 1, seq, 1, Backend::global_backends[MLLM_CPU], true);
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        for (int s = 0; s < seq; s++) { input.setDataAt<float>(0, 0, s, 0, (float)(s * 7 % vocab)); }
+        auto out = model({input})[0];
+        Module::logits_rows = 0;
+        logits.reshape(out.batch(), out.head(), out.sequence(), out.dimension());
+        logits.alloc();
+        logits.copyFrom(out);
+    };
+    Tensor all(Backend::global_backends[MLLM_CPU]);
+    run(0, all);
+    ASSERT_EQ(all.sequence(), seq);
+    for (int rows : {1, 2}) {
+        Tensor kept(Backend::global_backends[MLLM_CPU]);
+        run(rows, kept);
+        ASSERT_EQ(kept.sequence(), rows);
+        ASSERT_EQ(kept.dimension(), vocab);
+        for (int s = 0; s < rows; s++) {
+            for (int d = 0; d < vocab; d++) {
+                const float e = all.dataAt<float>(0, 0, seq - rows + s, d);
+                ASSERT_NEAR(kept.dataAt<float>(0, 0, s, d), e, 1e-5F * std::max(1.0F, std::abs(e))) << rows << " " << s << " " << d;
+            }
+        }
+        kept.free();
+    }
+    all.free();
+}
+
+TEST_F(CPUTest, CPULogitsRowsSpeculative) {
+    // speculative decoding samples every verified row, whatever logits_rows the caller set
+    const int vocab = 96, hidden_dim = 64, seq = 6;
+    Module::initBackend(MLLM_CPU);
+    LLaMANameConfig names;
+    names.init(LLAMAROPE);
+    LogitsRowsTestLoader target_loader, draft_loader;
+    draft_loader.phase = 0.2F;
+    LlmTextGeneratorOpts opt;
+    opt.max_new_tokens = 10;
+    opt.do_sample = false;
+    auto run = [&](int logits_rows, vector<unsigned> &tokens, double &acceptance) {
+        LLaMAModel target(vocab, hidden_dim, 2, 2, 128, 2, LLAMAROPE, 10000, 128, 32, names, names.blk_name);
+        LLaMAModel draft(vocab, hidden_dim, 2, 2, 128, 1, LLAMAROPE, 10000, 128, 32, names, names.blk_name);
+        target.load(target_loader);
+        draft.load(draft_loader);
+        Tensor input(1, 1, seq, 1, Backend::global_backends[MLLM_CPU], true);
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        for (int s = 0; s < seq; s++) { input.setDataAt<float>(0, 0, s, 0, (float)(s * 7 % vocab)); }
+        Module::logits_rows = logits_rows;
+        SpeculativeDecoder decoder(target, draft, 3);
+        tokens = decoder.generate(input, opt, [](unsigned) { return true; });
+        acceptance = decoder.acceptanceRate();
+        EXPECT_EQ(Module::logits_rows, logits_rows);
+        Module::logits_rows = 0;
+        input.free();
+    };
+    vector<unsigned> all, last;
+    double all_acceptance = 0, last_acceptance = 0;
+    run(0, all, all_acceptance);
+    run(1, last, last_acceptance);
+    ASSERT_EQ(all.size(), opt.max_new_tokens);
+    EXPECT_EQ(last, all);
+    EXPECT_EQ(last_acceptance, all_acceptance);
+}
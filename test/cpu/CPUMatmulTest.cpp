@@ -3,6 +3,12 @@
 //
 #include "CPUTest.hpp"
 #include "backends/cpu/op/CPUMatmul.hpp"
+#include "backends/cpu/compute/GEMM_AArch64.hpp"
+#include "backends/cpu/compute/VecDotType.hpp"
+#include "backends/cpu/compute/CPUFeatures.hpp"
+#include "backends/cpu/compute/SGEMM.hpp"
+#include "backends/cpu/quantize/QuantizeQ6.hpp"
+#include <cmath>
 // TEST_F(CPUTest, CPUMatmul1) {
 //     SETUP_OP(CPUMatmul, false, false, 4);
 //     TENSOR(input0);
@@ -51,4 +57,187 @@ TEST_F(CPUTest, CPUMatmul1) {
 //     TEST_EXCUTE({input0, input1}, {c_output});
 ////     c_output->printData<float>();
 //     COMPARE_TENSOR(c_output.get(), output.get(), true);
-// }
\ No newline at end of file
+// }
+TEST_F(CPUTest, CPUMatmulQ4_0Interleaved) {
+    // repacked Q4_0 gemv / gemm against the plain Q4_0 x Q8_0 dot product, with and without bias
+    const int K = 256, N = 16, M = 8;
+    vector<float> w(N * K), x(M * K), bias(N);
+    for (int i = 0; i < N * K; ++i) { w[i] = std::sin((float)i * 0.37F); }
+    for (int i = 0; i < M * K; ++i) { x[i] = std::cos((float)i * 0.11F); }
+    for (int j = 0; j < N; ++j) { bias[j] = (float)j * 0.5F; }
+    vector<block_q4_0> w_q4(N * K / QK4_0);
+    vector<block_q8_0> x_q8(M * K / QK8_0);
+    for (int j = 0; j < N; ++j) { quantize_row_q4_0(w.data() + j * K, w_q4.data() + j * K / QK4_0, K); }
+    for (int m = 0; m < M; ++m) { quantize_row_q8_0(x.data() + m * K, x_q8.data() + m * K / QK8_0, K); }
+    vector<float> ref(M * N);
+    for (int m = 0; m < M; ++m) {
+        for (int j = 0; j < N; ++j) {
+            vec_dot_q4_0_q8_0(K, &ref[m * N + j], w_q4.data() + j * K / QK4_0, x_q8.data() + m * K / QK8_0);
+        }
+    }
+    for (auto type : {MLLM_TYPE_Q4_0_4_4, MLLM_TYPE_Q4_0_4_8, MLLM_TYPE_Q4_0_8_8}) {
+        vector<block_q4_0> w_packed(N * K / QK4_0);
+        if (type == MLLM_TYPE_Q4_0_4_4) {
+            quantize_row_q4_0_4x4(w.data(), w_packed.data(), N * K, K);
+        } else if (type == MLLM_TYPE_Q4_0_4_8) {
+            quantize_q4_0_4x8(w.data(), w_packed.data(), N, K, nullptr);
+        } else {
+            quantize_q4_0_8x8(w.data(), w_packed.data(), N, K, nullptr);
+        }
+        vector<block_q8_0> x_mat(M * K / QK8_0);
+        for (int m = 0; m < M; m += 4) {
+            quantize_mat_q8_0(x.data() + m * K, x_mat.data() + m * K / QK8_0, 4, K, type_traits[type].blck_size_interleave);
+        }
+        for (const float *b : {(const float *)nullptr, (const float *)bias.data()}) {
+            vector<float> gemv_out(M * N), gemm_out(M * N);
+            for (int m = 0; m < M; ++m) {
+                type_traits[type].gemv(K, gemv_out.data() + m * N, N, w_packed.data(), x_q8.data() + m * K / QK8_0, 1, N, b);
+            }
+            type_traits[type].gemm(K, gemm_out.data(), N, w_packed.data(), x_mat.data(), M, N, b);
+            for (int i = 0; i < M * N; ++i) {
+                const float expected = ref[i] + (b != nullptr ? b[i % N] : 0.0F);
+                ASSERT_NEAR(gemv_out[i], expected, 1e-3 * (1.0F + std::fabs(expected)));
+                ASSERT_NEAR(gemm_out[i], expected, 2e-2 * (1.0F + std::fabs(expected)));
+            }
+        }
+    }
+}
+TEST_F(CPUTest, CPUKernelDispatch) {
+    // every kernel set the host supports gives the baseline results
+#if defined(__AVX2__)
+    EXPECT_TRUE(cpuFeatures().avx2);
+#endif
+    const int K = 256, N = 16, M = 4;
+    vector<float> w(N * K), x(M * K), bias(N);
+    for (int i = 0; i < N * K; ++i) { w[i] = std::sin((float)i * 0.29F); }
+    for (int i = 0; i < M * K; ++i) { x[i] = std::cos((float)i * 0.13F); }
+    for (int j = 0; j < N; ++j) { bias[j] = (float)j * 0.25F; }
+    vector<block_q4_0> w_q4(N * K / QK4_0), w_44(N * K / QK4_0), w_48(N * K / QK4_0), w_88(N * K / QK4_0);
+    vector<block_q8_0> w_q8(N * K / QK8_0), x_q8(M * K / QK8_0), x_44(M * K / QK8_0), x_48(M * K / QK8_0);
+    for (int j = 0; j < N; ++j) {
+        quantize_row_q4_0(w.data() + j * K, w_q4.data() + j * K / QK4_0, K);
+        quantize_row_q8_0(w.data() + j * K, w_q8.data() + j * K / QK8_0, K);
+    }
+    for (int m = 0; m < M; ++m) { quantize_row_q8_0(x.data() + m * K, x_q8.data() + m * K / QK8_0, K); }
+    quantize_row_q4_0_4x4(w.data(), w_44.data(), N * K, K);
+    quantize_q4_0_4x8(w.data(), w_48.data(), N, K, nullptr);
+    quantize_q4_0_8x8(w.data(), w_88.data(), N, K, nullptr);
+    quantize_mat_q8_0(x.data(), x_44.data(), M, K, 4);
+    quantize_mat_q8_0(x.data(), x_48.data(), M, K, 8);
+    auto run = [&]() {
+        vector<float> out;
+        for (int m = 0; m < M; ++m) {
+            for (int j = 0; j < N; ++j) {
+                float v;
+                type_traits[MLLM_TYPE_Q4_0].vec_dot(K, &v, w_q4.data() + j * K / QK4_0, x_q8.data() + m * K / QK8_0);
+                out.push_back(v);
+                type_traits[MLLM_TYPE_Q8_0].vec_dot(K, &v, w_q8.data() + j * K / QK8_0, x_q8.data() + m * K / QK8_0);
+                out.push_back(v);
+            }
+        }
+        const std::pair<DataType, std::pair<const block_q4_0 *, const block_q8_0 *>> cases[] = {
+            {MLLM_TYPE_Q4_0_4_4, {w_44.data(), x_44.data()}},
+            {MLLM_TYPE_Q4_0_4_8, {w_48.data(), x_48.data()}},
+            {MLLM_TYPE_Q4_0_8_8, {w_88.data(), x_48.data()}},
+        };
+        for (const auto &c : cases) {
+            vector<float> gemv_out(N), gemm_out(M * N);
+            type_traits[c.first].gemv(K, gemv_out.data(), N, c.second.first, x_q8.data(), 1, N, bias.data());
+            type_traits[c.first].gemm(K, gemm_out.data(), N, c.second.first, c.second.second, M, N, nullptr);
+            out.insert(out.end(), gemv_out.begin(), gemv_out.end());
+            out.insert(out.end(), gemm_out.begin(), gemm_out.end());
+        }
+        return out;
+    };
+    ASSERT_EQ(dispatchCPUKernels(CPU_ISA_BASELINE), CPU_ISA_BASELINE);
+    const vector<float> ref = run();
+    for (auto isa : {CPU_ISA_AVXVNNI, CPU_ISA_AVX512VNNI}) {
+        if (dispatchCPUKernels(isa) != isa) { continue; }
+        const vector<float> out = run();
+        ASSERT_EQ(out.size(), ref.size());
+        for (size_t i = 0; i < ref.size(); ++i) {
+            ASSERT_NEAR(out[i], ref[i], 1e-4 * (1.0F + std::fabs(ref[i]))) << cpuKernelISAName(isa) << " at " << i;
+        }
+    }
+    dispatchCPUKernels();
+}
+TEST_F(CPUTest, CPUMatmulKQuantTiled) {
+    // tiled Q4_K/Q6_K x Q8_K sgemm against the per-row dot products, on edge tiles and split over threads
+    const int K = 512, N = 13, M = 7, nth = 3;
+    const int nb = K / QK_K;
+    vector<float> w(N * K), x(M * K), bias(N);
+    for (int i = 0; i < N * K; ++i) { w[i] = std::sin((float)i * 0.31F) * (1.0F + (float)(i % 97) / 50.0F); }
+    for (int i = 0; i < M * K; ++i) { x[i] = std::cos((float)i * 0.17F); }
+    for (int j = 0; j < N; ++j) { bias[j] = (float)j * 0.1F - 0.5F; }
+    vector<block_q8_K> x_q8(M * nb);
+    for (int m = 0; m < M; ++m) { quantize_row_q8_K(x.data() + m * K, x_q8.data() + m * nb, K); }
+    for (auto type : {MLLM_TYPE_Q4_K, MLLM_TYPE_Q6_K}) {
+        vector<char> w_q(N * nb * type_size(type));
+        for (int j = 0; j < N; ++j) {
+            type_traits[type].from_float(w.data() + j * K, w_q.data() + j * nb * type_size(type), K);
+        }
+        ASSERT_TRUE(check_llamafile_sgemm(N, M, nb, type, MLLM_TYPE_Q8_K, MLLM_TYPE_F32, nb, nb, N));
+        ASSERT_FALSE(check_llamafile_sgemm(N, 1, nb, type, MLLM_TYPE_Q8_K, MLLM_TYPE_F32, nb, nb, N));
+        for (float *b : {(float *)nullptr, bias.data()}) {
+            vector<float> out(M * N, -1.0F);
+            for (int ith = 0; ith < nth; ++ith) {
+                ASSERT_TRUE(llamafile_sgemm(N, M, nb, w_q.data(), nb, x_q8.data(), nb, out.data(), N, ith, nth,
+                                            type, MLLM_TYPE_Q8_K, MLLM_TYPE_F32, b, MLLM_TYPE_F32));
+            }
+            for (int m = 0; m < M; ++m) {
+                for (int j = 0; j < N; ++j) {
+                    float expected;
+                    type_traits[type].vec_dot(K, &expected, w_q.data() + j * nb * type_size(type), x_q8.data() + m * nb);
+                    if (b != nullptr) { expected += b[j]; }
+                    ASSERT_NEAR(out[m * N + j], expected, 1e-3 * (1.0F + std::fabs(expected))) << m << " " << j;
+                }
+            }
+        }
+    }
+}
+TEST_F(CPUTest, CPUMatmulLowBitQuant) {
+    // Q5_0/Q2_K/Q3_K/Q5_K: round trip within their bit-width's error, and vec_dot/add_row_to agree with the dequantized row
+    const int K = 512;
+    vector<float> w(K), x(K);
+    for (int i = 0; i < K; ++i) {
+        w[i] = std::sin((float)i * 0.37F) * (1.0F + (float)(i % 7) * 0.1F);
+        x[i] = std::cos((float)i * 0.11F);
+    }
+    const std::pair<DataType, double> cases[] = {
+        {MLLM_TYPE_Q5_0, 0.05},
+        {MLLM_TYPE_Q2_K, 0.3},
+        {MLLM_TYPE_Q3_K, 0.16},
+        {MLLM_TYPE_Q5_K, 0.04},
+    };
+    for (const auto &c : cases) {
+        const auto &traits = type_traits[c.first];
+        ASSERT_EQ(DataTypeSize(c.first, K), traits.size * K / traits.blck_size) << DataTypeName(c.first);
+        vector<char> w_q(DataTypeSize(c.first, K));
+        vector<float> w_d(K);
+        traits.from_float(w.data(), w_q.data(), K);
+        traits.to_float(w_q.data(), w_d.data(), K);
+        double err = 0, norm = 0;
+        for (int i = 0; i < K; ++i) {
+            err += (w_d[i] - w[i]) * (w_d[i] - w[i]);
+            norm += w[i] * w[i];
+        }
+        EXPECT_LT(std::sqrt(err / norm), c.second) << DataTypeName(c.first);
+
+        const auto &x_traits = type_traits[traits.vec_dot_type];
+        vector<char> x_q(DataTypeSize(traits.vec_dot_type, K));
+        vector<float> x_d(K);
+        x_traits.from_float(x.data(), x_q.data(), K);
+        x_traits.to_float(x_q.data(), x_d.data(), K);
+        double expect = 0;
+        for (int i = 0; i < K; ++i) { expect += w_d[i] * x_d[i]; }
+        float dot;
+        traits.vec_dot(K, &dot, w_q.data(), x_q.data());
+        EXPECT_NEAR(dot, expect, 1e-3 * (1.0 + std::fabs(expect))) << DataTypeName(c.first);
+
+        vector<float> acc(K, 1.0F);
+        traits.add_row_to(K, w_q.data(), acc.data(), 0.5F);
+        for (int i = 0; i < K; ++i) {
+            ASSERT_NEAR(acc[i], 1.0F + 0.5F * w_d[i], 1e-5) << DataTypeName(c.first) << " at " << i;
+        }
+    }
+}
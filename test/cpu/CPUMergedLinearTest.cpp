@@ -0,0 +1,116 @@
+#include "CPUTest.hpp"
+#include "models/llama/modeling_llama.hpp"
+#include "backends/cpu/op/CPULinear.hpp"
+#include "backends/cpu/op/CPUMergedLinear.hpp"
+#include "backends/cpu/compute/VecDotType.hpp"
+#include <cmath>
+
+namespace {
+// deterministic weights and biases, the dtype of each weight picked by name
+class MergedLinearTestLoader : public AbstructLoader {
+public:
+    map<string, DataType> dtypes;
+    bool load(Tensor *tensor) override {
+        const int rows = tensor->sequence();
+        const int cols = tensor->dimension();
+        vector<float> row(cols);
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) { row[c] = 0.05F * std::sin(0.37F * (float)(r * cols + c) + (float)tensor->name().size()); }
+            auto *dst = (char *)tensor->rawHostPtr() + (size_t)r * cols / blck_size(tensor->dtype()) * type_size(tensor->dtype());
+            if (tensor->dtype() == MLLM_TYPE_F32) {
+                memcpy(dst, row.data(), cols * sizeof(float));
+            } else {
+                type_traits[tensor->dtype()].from_float(row.data(), dst, cols);
+            }
+        }
+        return true;
+    }
+    bool load(std::shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override {
+        auto it = dtypes.find(name);
+        return it == dtypes.end() ? MLLM_TYPE_F32 : it->second;
+    }
+};
+} // namespace
+
+TEST_F(CPUTest, CPUMergedLinear) {
+    const int in_features = 256;
+    const vector<int> out_features = {256, 128, 128};
+    const vector<string> names = {"q_proj", "k_proj", "v_proj"};
+    TENSOR(input0);
+    input0->reshape(1, 1, 5, in_features);
+    input0->alloc();
+    for (int s = 0; s < 5; s++) {
+        for (int d = 0; d < in_features; d++) { input0->setDataAt<float>(0, 0, s, d, std::cos(0.11F * (float)(s * in_features + d))); }
+    }
+    // all parts Q4_K are concatenated, a Q6_K part keeps the weights apart; k_proj has no bias
+    for (auto v_type : {MLLM_TYPE_Q4_K, MLLM_TYPE_Q6_K}) {
+        MergedLinearTestLoader loader;
+        loader.dtypes = {{"q_proj.weight", MLLM_TYPE_Q4_K}, {"k_proj.weight", MLLM_TYPE_Q4_K}, {"v_proj.weight", v_type},
+                         {"k_proj.bias", MLLM_TYPE_COUNT}};
+        auto op = std::make_shared<CPUMergedLinear>(bn_, "q_proj+k_proj+v_proj", in_features, out_features, true, 4);
+        vector<shared_ptr<Tensor>> outputs;
+        for (int i = 0; i < 3; i++) {
+            outputs.push_back(std::make_shared<Tensor>(bn_));
+            outputs.back()->setName("merged-" + std::to_string(i));
+        }
+        ASSERT_FALSE(op->load(loader));
+        ASSERT_EQ(op->merged(), v_type == MLLM_TYPE_Q4_K);
+        ASSERT_EQ(op->quantizedInputType(), MLLM_TYPE_Q8_K);
+        ASSERT_FALSE(op->reshape({input0}, outputs));
+        ASSERT_FALSE(op->setUp({input0}, outputs));
+        ASSERT_FALSE(op->execute({input0}, outputs));
+        for (int i = 0; i < 3; i++) {
+            CPULinear linear(bn_, names[i], in_features, out_features[i], i != 1, 4);
+            TENSOR(expected);
+            ASSERT_FALSE(linear.load(loader));
+            ASSERT_FALSE(linear.reshape({input0}, {expected}));
+            ASSERT_FALSE(linear.setUp({input0}, {expected}));
+            ASSERT_FALSE(linear.execute({input0}, {expected}));
+            ASSERT_EQ(outputs[i]->shapeString(), expected->shapeString());
+            for (int s = 0; s < 5; s++) {
+                for (int d = 0; d < out_features[i]; d++) {
+                    const float e = expected->dataAt<float>(0, 0, s, d);
+                    ASSERT_NEAR(outputs[i]->dataAt<float>(0, 0, s, d), e, 1e-5F * std::max(1.0F, std::abs(e))) << names[i] << " " << s << " " << d;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(CPUTest, CPUMergedLinearModule) {
+    // LLaMAMLP with gate/up as one MergedLinear gives the same result as with two Linears
+    const int hidden_dim = 256, seq = 5;
+    Module::initBackend(MLLM_CPU);
+    LLaMANameConfig names;
+    names.init(LLAMAROPE);
+    MergedLinearTestLoader loader;
+    loader.dtypes = {{"mlp.w1.weight", MLLM_TYPE_Q4_K}, {"mlp.w3.weight", MLLM_TYPE_Q4_K}, {"mlp.w2.weight", MLLM_TYPE_Q4_K}};
+    auto run = [&](bool merge, vector<float> &result) {
+        Module::merge_projections = merge;
+        LLaMAMLP mlp(hidden_dim, 512, names, "mlp.");
+        Module::merge_projections = false;
+        mlp.load(loader);
+        Tensor input(1, 1, seq, hidden_dim, Backend::global_backends[MLLM_CPU], true);
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        for (int s = 0; s < seq; s++) {
+            for (int d = 0; d < hidden_dim; d++) { input.setDataAt<float>(0, 0, s, d, std::cos(0.11F * (float)(s * hidden_dim + d))); }
+        }
+        auto out = mlp({input})[0];
+        result.clear();
+        for (int s = 0; s < seq; s++) {
+            for (int d = 0; d < hidden_dim; d++) { result.push_back(out.dataAt<float>(0, 0, s, d)); }
+        }
+        ASSERT_EQ(mlp.activation_tensors.count("out-mlp.w1+mlp.w3-0"), merge ? 1 : 0);
+    };
+    vector<float> merged, separate;
+    run(false, separate);
+    run(true, merged);
+    ASSERT_EQ(merged.size(), separate.size());
+    for (size_t i = 0; i < merged.size(); i++) {
+        ASSERT_NEAR(merged[i], separate[i], 1e-5F * std::max(1.0F, std::abs(separate[i]))) << i;
+    }
+}
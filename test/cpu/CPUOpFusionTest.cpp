@@ -0,0 +1,105 @@
+#include "CPUTest.hpp"
+#include "Layer.hpp"
+#include "Module.hpp"
+#include "OpFusion.hpp"
+#include "backends/cpu/compute/VecDotType.hpp"
+#include <cmath>
+
+namespace {
+// deterministic weights: F32 norms, Q4_K projections
+class FusionTestLoader : public AbstructLoader {
+public:
+    bool load(Tensor *tensor) override {
+        const int rows = tensor->batch() * tensor->head() * tensor->sequence();
+        const int cols = tensor->dimension();
+        vector<float> row(cols);
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) { row[c] = 0.05F * std::sin(0.37F * (float)(r * cols + c) + (float)tensor->name().size()); }
+            if (tensor->dtype() == MLLM_TYPE_F32) {
+                for (int c = 0; c < cols; c++) { tensor->setDataAt<float>(0, 0, r, c, 1.0F + row[c]); }
+            } else {
+                auto *dst = (char *)tensor->rawHostPtr() + (size_t)r * cols / type_traits[tensor->dtype()].blck_size * type_traits[tensor->dtype()].size;
+                type_traits[tensor->dtype()].from_float(row.data(), dst, cols);
+            }
+        }
+        return true;
+    }
+    bool load(std::shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override {
+        return name.find("proj") != string::npos ? MLLM_TYPE_Q4_K : MLLM_TYPE_F32;
+    }
+};
+
+class FusionTestModel final : public Module {
+    Layer norm;
+    Layer gate_proj;
+    Layer silu;
+    Layer up_proj;
+    Layer down_proj;
+    Layer softmax;
+
+public:
+    FusionTestModel(int hidden_dim, int ffn_hidden) {
+        norm = RMSNorm(hidden_dim, 1e-6, "norm");
+        gate_proj = Linear(hidden_dim, ffn_hidden, false, "gate_proj");
+        silu = SiLU("act");
+        up_proj = Linear(hidden_dim, ffn_hidden, false, "up_proj");
+        down_proj = Linear(ffn_hidden, hidden_dim, false, "down_proj");
+        softmax = Softmax(DIMENSION, "softmax");
+    }
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        auto tmp = inputs[0] + inputs[1];
+        auto x = norm(tmp);
+        auto g = silu(gate_proj(x));
+        auto u = up_proj(x);
+        x = down_proj(g * u);
+        x = x + tmp;
+        x = softmax(x / 4.0F);
+        return {x};
+    }
+};
+} // namespace
+
+TEST_F(CPUTest, CPUOpFusion) {
+    const int hidden_dim = 256;
+    const int seq = 5;
+    Module::initBackend(MLLM_CPU);
+    FusionTestLoader loader;
+    auto run = [&](bool fuse, vector<float> &result) {
+        Module::use_op_fusion = fuse;
+        FusionTestModel model(hidden_dim, 512);
+        model.load(loader);
+        vector<Tensor> inputs;
+        for (int i = 0; i < 2; i++) {
+            Tensor input(1, 1, seq, hidden_dim, Backend::global_backends[MLLM_CPU], true);
+            Tensor::tensor_status = TENSOR_STATIC_INIT;
+            input.setTtype(INPUT_TENSOR);
+            for (int s = 0; s < seq; s++) {
+                for (int d = 0; d < hidden_dim; d++) { input.setDataAt<float>(0, 0, s, d, std::cos(0.11F * (float)(s * hidden_dim + d + i))); }
+            }
+            inputs.push_back(input);
+        }
+        auto out = model(inputs)[0];
+        result.clear();
+        for (int s = 0; s < seq; s++) {
+            for (int d = 0; d < hidden_dim; d++) { result.push_back(out.dataAt<float>(0, 0, s, d)); }
+        }
+        if (fuse) {
+            ASSERT_NE(model.opFusion(), nullptr);
+            EXPECT_EQ(model.opFusion()->count(OpFusion::SWIGLU), 1);
+            EXPECT_EQ(model.opFusion()->count(OpFusion::SCALED_SOFTMAX), 1);
+            EXPECT_EQ(model.opFusion()->count(OpFusion::RESIDUAL_NORM), 1);
+            EXPECT_EQ(model.opFusion()->count(OpFusion::QUANTIZED_NORM), 1);
+        }
+    };
+    vector<float> fused, plain;
+    run(false, plain);
+    run(true, fused);
+    ASSERT_EQ(fused.size(), plain.size());
+    for (size_t i = 0; i < fused.size(); i++) {
+        // the scaled softmax multiplies by 1/c instead of dividing by c
+        ASSERT_NEAR(fused[i], plain[i], 1e-4F * std::abs(plain[i])) << i;
+    }
+}
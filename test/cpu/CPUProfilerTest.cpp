@@ -0,0 +1,55 @@
+#include "CPUTest.hpp"
+#include "Profiler.hpp"
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+TEST_F(CPUTest, CPUProfiler) {
+    OpProfiler::clear();
+    TENSOR(input);
+    TENSOR(output);
+    input->reshape(1, 2, 3, 4);
+    input->alloc();
+    output->reshape(1, 2, 3, 4);
+    output->alloc();
+    auto start = mllm_time_us();
+    OpProfiler::record("model.layers.0.mlp.act", "SiLU", {input.get()}, {output.get()}, bn_, start);
+    // events from another thread land in their own buffer
+    std::thread worker([] {
+        OpProfiler::Event event;
+        event.name = "model.layers.0.self_attn.q_proj";
+        event.type = "Linear";
+        event.start_us = 1;
+        event.dur_us = 1000;
+        event.bytes = 4096;
+        OpProfiler::record(event);
+        event.name = "model.layers.1.self_attn.q_proj";
+        event.start_us = 2;
+        OpProfiler::record(event);
+    });
+    worker.join();
+
+    auto events = OpProfiler::events();
+    ASSERT_EQ(events.size(), 3);
+    ASSERT_EQ(events[0].type, "Linear");
+    ASSERT_NE(events[0].tid, events[2].tid);
+    ASSERT_EQ(events[2].input_shapes, "[1,2,3,4]");
+    ASSERT_EQ(events[2].bytes, 2 * input->cntSize());
+    ASSERT_EQ(events[2].threads, CPUBackend::cpu_threads);
+
+    auto summary = OpProfiler::summary();
+    ASSERT_EQ(summary.size(), 2);
+    ASSERT_EQ(summary[0].type, "Linear");
+    ASSERT_EQ(summary[0].count, 2);
+    ASSERT_EQ(summary[0].total_us, 2000);
+    ASSERT_EQ(summary[0].bytes, 8192);
+
+    ASSERT_TRUE(OpProfiler::exportChromeTrace("op_trace_test.json"));
+    std::ifstream trace("op_trace_test.json");
+    std::stringstream content;
+    content << trace.rdbuf();
+    ASSERT_NE(content.str().find("\"name\":\"model.layers.1.self_attn.q_proj\",\"cat\":\"Linear\",\"ph\":\"X\""), std::string::npos);
+    std::remove("op_trace_test.json");
+    OpProfiler::clear();
+    ASSERT_TRUE(OpProfiler::events().empty());
+}
@@ -0,0 +1,55 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/compute/ThreadPool.hpp"
+#include <chrono>
+#include <set>
+#include <thread>
+
+TEST_F(CPUTest, CPUThreadPool) {
+    auto *cpu_backend = dynamic_cast<CPUBackend *>(bn_);
+    ASSERT_NE(cpu_backend, nullptr);
+    ASSERT_EQ(&ThreadPool::current(), &cpu_backend->threadPool());
+
+    // every index exactly once, whatever the chunking
+    for (int64_t n : {1, 3, 17, 1000, 100003}) {
+        std::vector<std::atomic<int>> hits(n);
+        parallel_for(n, 4, [&](int64_t i) { hits[i].fetch_add(1); });
+        for (int64_t i = 0; i < n; ++i) { ASSERT_EQ(hits[i].load(), 1); }
+    }
+
+    // the pool grows to the thread count asked for, and the jobs run on distinct threads
+    std::mutex mutex;
+    std::set<std::thread::id> ids;
+    parallel_for(8, 8, [&](int64_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::lock_guard<std::mutex> lock(mutex);
+        ids.insert(std::this_thread::get_id());
+    }, 1);
+    ASSERT_GE(cpu_backend->threadPool().size(), 8);
+    ASSERT_GT(ids.size(), 1);
+
+    // a job started inside a job runs inline
+    std::atomic<int64_t> sum{0};
+    parallel_for(16, 4, [&](int64_t i) {
+        parallel_for(16, 4, [&](int64_t j) { sum.fetch_add(i * 16 + j); });
+    });
+    ASSERT_EQ(sum.load(), 255 * 256 / 2);
+
+    // workers that went to sleep are woken by the next job
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::atomic<int> count{0};
+    parallel_for(64, 4, [&](int64_t) { count.fetch_add(1); });
+    ASSERT_EQ(count.load(), 64);
+
+    // jobs from several threads are serialised
+    std::vector<std::thread> callers;
+    std::atomic<int64_t> total{0};
+    for (int t = 0; t < 3; ++t) {
+        callers.emplace_back([&] {
+            for (int r = 0; r < 200; ++r) {
+                parallel_for(32, 4, [&](int64_t i) { total.fetch_add(i); });
+            }
+        });
+    }
+    for (auto &caller : callers) { caller.join(); }
+    ASSERT_EQ(total.load(), 3 * 200 * (31 * 32 / 2));
+}
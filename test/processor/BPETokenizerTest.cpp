@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+#include "TokenizorTest.hpp"
+#include "tokenizers/BPE/Bpe.hpp"
+#include <cstdio>
+
+namespace {
+// a vocab file in the mllm format, the score of each token is its id
+std::string writeVocab(const std::vector<std::string> &tokens) {
+    std::string path = ::testing::TempDir() + "bpe_test_vocab.mllm";
+    FILE *fp = fopen(path.c_str(), "wb");
+    auto write_int = [fp](int v) { fwrite(&v, sizeof(int), 1, fp); };
+    write_int(mllm::VocabMagicNumber);
+    write_int((int)tokens.size());
+    for (int id = 0; id < (int)tokens.size(); ++id) {
+        write_int(id);
+        write_int((int)tokens[id].size());
+        fwrite(tokens[id].data(), 1, tokens[id].size(), fp);
+        float score = (float)id;
+        fwrite(&score, sizeof(float), 1, fp);
+    }
+    fclose(fp);
+    return path;
+}
+} // namespace
+
+TEST_F(TokenizerTest, BPEPreTokenize) {
+    std::vector<std::string> words;
+    mllm::BPETokenizer::preTokenize("Hello, world's  <|endoftext|>x_1 a,b 'x \xc3\xbc+a\n", words);
+    std::vector<std::string> expected = {"Hello", ",", "world", "'s", "<|endoftext|>", "x_1", "a", ",b", "'x", "\xc3\xbc+a"};
+    EXPECT_EQ(words, expected);
+}
+
+TEST_F(TokenizerTest, BPEMerges) {
+    std::vector<std::string> vocab = {"<unk>", "<s>", "</s>", "l", "o", "w", "e", "r", "lo", "low", "er", "lower", "a", "aa", "lo</w>"};
+    mllm::BPETokenizer bpe(writeVocab(vocab));
+    bpe.setMergeRank({{"l o", 0}, {"lo w", 1}, {"e r", 2}, {"low er", 3}, {"a a", 4}, {"l o</w>", 5}});
+    EXPECT_EQ(bpe.bpe("lower", ""), std::vector<std::string>({"lower"}));
+    EXPECT_EQ(bpe.bpe("lowr", ""), std::vector<std::string>({"low", "r"}));
+    // the leftmost pair of the same rank is merged first
+    EXPECT_EQ(bpe.bpe("aaa", ""), std::vector<std::string>({"aa", "a"}));
+    EXPECT_EQ(bpe.bpe("aaaa", ""), std::vector<std::string>({"aa", "aa"}));
+    // the end symbol belongs to the last character
+    EXPECT_EQ(bpe.bpe("lo", "</w>"), std::vector<std::string>({"lo</w>"}));
+    EXPECT_EQ(bpe.bpe("a\xf0\x9f\x98\x80", ""), std::vector<std::string>({"a", "\xf0\x9f\x98\x80"}));
+    // cached words come back unchanged, also once they have been evicted
+    bpe.setWordCacheCapacity(1);
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ(bpe.bpe("lower", ""), std::vector<std::string>({"lower"}));
+        EXPECT_EQ(bpe.bpe("lowr", ""), std::vector<std::string>({"low", "r"}));
+    }
+    bpe.setWordCacheCapacity(0);
+    EXPECT_EQ(bpe.bpe("lowr", ""), std::vector<std::string>({"low", "r"}));
+
+    std::vector<mllm::token_id_t> tokens;
+    bpe.tokenize("lower lowr aaa", tokens, false, false, "");
+    EXPECT_EQ(tokens, std::vector<mllm::token_id_t>({11, 9, 7, 13, 12, 2}));
+}
+
+TEST_F(TokenizerTest, BPETokenizeBatch) {
+    std::vector<std::string> vocab = {"<unk>", "<s>", "</s>", "l", "o", "w", "e", "r", "lo", "low", "er", "lower", "a", "aa"};
+    mllm::BPETokenizer bpe(writeVocab(vocab));
+    bpe.setMergeRank({{"l o", 0}, {"lo w", 1}, {"e r", 2}, {"low er", 3}, {"a a", 4}});
+    mllm::Module::initBackend(MLLM_CPU);
+    std::vector<std::string> texts;
+    for (int i = 0; i < 64; ++i) {
+        texts.push_back(i % 3 == 0 ? "lower lowr aaa" : std::string(i, 'a') + " lower");
+    }
+    std::vector<std::vector<mllm::token_id_t>> batch;
+    bpe.tokenizeBatch(texts, batch, false, 4);
+    ASSERT_EQ(batch.size(), texts.size());
+    size_t longest = 0;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        std::vector<mllm::token_id_t> tokens;
+        bpe.tokenize(texts[i], tokens, false);
+        EXPECT_EQ(batch[i], tokens) << i;
+        longest = std::max(longest, tokens.size());
+    }
+    auto input = bpe.tokenizeBatch(texts, false, "input", MLLM_CPU, 1);
+    ASSERT_EQ(input.batch(), (int)texts.size());
+    ASSERT_EQ(input.sequence(), (int)longest);
+    for (size_t b = 0; b < texts.size(); ++b) {
+        for (size_t s = 0; s < longest; ++s) {
+            EXPECT_EQ(input.dataAt<float>(b, 0, s, 0), s < batch[b].size() ? (float)batch[b][s] : 1.0F) << b << " " << s;
+        }
+    }
+    input.free();
+}
+
+TEST_F(TokenizerTest, StreamingDetokenize) {
+    // "你" is e4 bd a0, "é" is c3 a9
+    std::vector<std::string> vocab = {"<unk>", "<s>", "</s>", "a", "<0xE4>", "<0xBD>", "<0xA0>", "\xc3", "\xa9" "b", "\xe4\xbd"};
+    mllm::BPETokenizer bpe(writeVocab(vocab));
+    mllm::StreamingDetokenizer streamer(bpe);
+    std::vector<std::string> pieces;
+    for (mllm::token_id_t token : {3, 4, 5, 6, 3, 7, 8, 9}) {
+        std::string text;
+        ASSERT_TRUE(streamer.put(token, text));
+        pieces.push_back(text);
+    }
+    EXPECT_EQ(pieces, std::vector<std::string>({"a", "", "", "\xe4\xbd\xa0", "a", "", "\xc3\xa9" "b", ""}));
+    EXPECT_EQ(streamer.flush(), "\xe4\xbd");
+    EXPECT_EQ(streamer.flush(), "");
+}
@@ -2,12 +2,28 @@
 // Created by Xiang Li on 23-11-2.
 //
 #include "gtest/gtest.h"
+#include <cmath>
+#include <cstdio>
 #include <unordered_map>
 #include "ParamLoader.hpp"
+#include "GGUFParamLoader.hpp"
 #include "ParamWriter.hpp"
 #include "QuantWriter.hpp"
 #include "QuantTest.hpp"
+#include "ImportanceMatrix.hpp"
 #include "Types.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+#include "memory/SystemMemoryManager.hpp"
+#include "models/llama/configuration_llama.hpp"
+namespace {
+// deletes the files a test writes once it ends, also when an ASSERT returns early
+struct ScopedTestFiles {
+    std::vector<std::string> paths;
+    ~ScopedTestFiles() {
+        for (const auto &path : paths) { std::remove(path.c_str()); }
+    }
+};
+} // namespace
 namespace mllm {
 TEST_F(QuantTest, ReadTest) {
     auto loader = ParamLoader("../bin/quant_test.mllm");
@@ -57,4 +73,313 @@ TEST_F(QuantTest, QuantTest) {
     auto *ori_data = quant->data_["weight_f1"];
     ASSERT_TRUE(compare_eq(reinterpret_cast<block_q4_0 *>(ori_data), reinterpret_cast<block_q4_0 *>(data)));
 }
+TEST_F(QuantTest, MmapLoadTest) {
+    ScopedTestFiles files{{"../bin/mmap_test.mllm"}};
+    const int rows = 3, cols = 37;
+    std::vector<string> names = {"mmap_w0", "mmap_w1"};
+    std::vector<std::vector<float>> ori_data(2, std::vector<float>(rows * cols));
+    for (int i = 0; i < rows * cols; i++) {
+        ori_data[0][i] = (float)i;
+        ori_data[1][i] = -(float)i * 0.5F;
+    }
+    auto *writer = new ParamWriter("../bin/mmap_test.mllm");
+    writer->paddingIndex(names);
+    for (int i = 0; i < names.size(); i++) {
+        writer->writeParam(names[i], DataType::MLLM_TYPE_F32, ori_data[i].data(), ori_data[i].size() * sizeof(float));
+    }
+    writer->writeIndex();
+    delete writer;
+
+    shared_ptr<MemoryManager> mm = std::make_shared<SystemMemoryManager>();
+    CPUBackend bn(mm);
+    auto loader = ParamLoader("../bin/mmap_test.mllm", true);
+    ASSERT_TRUE(loader.isMmaped());
+    for (int i = 0; i < names.size(); i++) {
+        Tensor weight(&bn);
+        weight.setName(names[i]);
+        weight.reshape(1, 1, rows, cols);
+        weight.setDtype(loader.getDataType(names[i]));
+        weight.alloc();
+        ASSERT_TRUE(loader.load(&weight));
+        // ParamWriter aligns every weight, so the mapping is used in place.
+        ASSERT_TRUE(weight.isExternalHostPtr());
+        for (int s = 0; s < rows; s++) {
+            for (int d = 0; d < cols; d++) {
+                ASSERT_EQ(weight.dataAt<float>(0, 0, s, d), ori_data[i][s * cols + d]);
+            }
+        }
+        weight.free();
+    }
+}
+TEST_F(QuantTest, StreamQuantTest) {
+    ScopedTestFiles files{{"../bin/stream_test.mllm", "../bin/stream_quant.mllm"}};
+    const int rows = 8, cols = 512;
+    std::vector<string> names = {"model.layers.0.w1.weight", "model.layers.0.norm.weight"};
+    std::vector<std::vector<float>> ori_data = {std::vector<float>(rows * cols), std::vector<float>(cols)};
+    for (auto &param : ori_data) {
+        for (int i = 0; i < param.size(); i++) {
+            param[i] = std::sin(i * 0.37F) * (1.0F + (i % 17) * 0.1F);
+        }
+    }
+    auto *writer = new ParamWriter("../bin/stream_test.mllm");
+    writer->paddingIndex(names);
+    for (int i = 0; i < names.size(); i++) {
+        writer->writeParam(names[i], DataType::MLLM_TYPE_F32, ori_data[i].data(), ori_data[i].size() * sizeof(float));
+    }
+    writer->writeIndex();
+    delete writer;
+
+    // chunks of three Q4_K blocks with a partial last chunk, each split over several threads
+    auto *quant = new QuantWriter("../bin/stream_quant.mllm", "../bin/stream_test.mllm");
+    ASSERT_EQ(quant->readParams(), 2);
+    quant->setChunkSize(1000);
+    quant->setThreadCount(3);
+    quant->quantParams(DataType::MLLM_TYPE_Q4_K);
+
+    auto ref = alloc_quant_block(rows * cols, MLLM_TYPE_Q4_K);
+    quantize_row_q4_K(ori_data[0].data(), ref.first, rows * cols);
+    auto loader = ParamLoader("../bin/stream_quant.mllm");
+    ASSERT_EQ(loader.getDataType(names[0]), DataType::MLLM_TYPE_Q4_K);
+    ASSERT_EQ(loader.getDataType(names[1]), DataType::MLLM_TYPE_F32);
+    auto [data, size] = loader.load(names[0]);
+    ASSERT_EQ(size, ref.second);
+    ASSERT_EQ(memcmp(data, ref.first, size), 0);
+    ASSERT_EQ(memcmp(quant->data_[names[0]], ref.first, size), 0);
+    auto [norm, norm_size] = loader.load(names[1]);
+    ASSERT_EQ(norm_size, cols * sizeof(float));
+    ASSERT_EQ(memcmp(norm, ori_data[1].data(), norm_size), 0);
+    delete[] data;
+    delete[] norm;
+    delete[] (char *)ref.first;
+    delete quant;
+}
+static void writeF32Params(const string &path, const std::vector<string> &names, const std::vector<std::vector<float>> &params) {
+    auto *writer = new ParamWriter(path);
+    writer->paddingIndex(names);
+    for (int i = 0; i < names.size(); i++) {
+        writer->writeParam(names[i], DataType::MLLM_TYPE_F32, (void *)params[i].data(), params[i].size() * sizeof(float));
+    }
+    writer->writeIndex();
+    delete writer;
+}
+// importance-weighted squared error of the Q4_K param `name` in `path` against `ori`
+static double weightedQ4KError(const string &path, const string &name, const std::vector<float> &ori, const std::vector<float> &importance) {
+    auto loader = ParamLoader(path);
+    EXPECT_EQ(loader.getDataType(name), DataType::MLLM_TYPE_Q4_K);
+    auto [data, size] = loader.load(name);
+    std::vector<float> deq(ori.size());
+    dequantize_row_q4_K((block_q4_K *)data, deq.data(), ori.size());
+    delete[] data;
+    double error = 0;
+    for (int i = 0; i < ori.size(); i++) {
+        error += importance[i % importance.size()] * (ori[i] - deq[i]) * (ori[i] - deq[i]);
+    }
+    return error;
+}
+TEST_F(QuantTest, ImportanceQuantTest) {
+    ScopedTestFiles files{{"../bin/imatrix_test.mllm", "../bin/imatrix_test.imat", "../bin/imatrix_plain.mllm", "../bin/imatrix_weighted.mllm"}};
+    const int rows = 16, cols = 512;
+    const string name = "model.layers.0.mlp.up_proj.weight";
+    std::vector<float> weight(rows * cols);
+    for (int i = 0; i < weight.size(); i++) {
+        weight[i] = std::sin(i * 0.61F) * (1.0F + (i % 13) * 0.2F);
+    }
+    writeF32Params("../bin/imatrix_test.mllm", {name}, {weight});
+
+    // every eighth input channel carries large activations
+    ImportanceMatrix::clear();
+    std::vector<float> activations(4 * cols);
+    for (int i = 0; i < activations.size(); i++) {
+        activations[i] = (i % cols) % 8 == 0 ? 10.0F : 0.5F * std::cos(i * 0.3F);
+    }
+    ImportanceMatrix::record(name, activations.data(), 4, cols, cols);
+    ASSERT_TRUE(ImportanceMatrix::save("../bin/imatrix_test.imat"));
+    ImportanceMatrix::clear();
+    std::unordered_map<string, std::vector<float>> importance;
+    ASSERT_TRUE(ImportanceMatrix::load("../bin/imatrix_test.imat", importance));
+    ASSERT_EQ(importance[name].size(), cols);
+    ASSERT_FLOAT_EQ(importance[name][0], 100.0F);
+
+    auto *plain = new QuantWriter("../bin/imatrix_plain.mllm", "../bin/imatrix_test.mllm");
+    plain->readParams();
+    plain->quantParams(DataType::MLLM_TYPE_Q4_K);
+    delete plain;
+    auto *weighted = new QuantWriter("../bin/imatrix_weighted.mllm", "../bin/imatrix_test.mllm");
+    weighted->readParams();
+    ASSERT_TRUE(weighted->loadImportance("../bin/imatrix_test.imat"));
+    weighted->setThreadCount(3);
+    weighted->setChunkSize(3 * cols);
+    weighted->quantParams(DataType::MLLM_TYPE_Q4_K);
+    delete weighted;
+
+    const double plain_error = weightedQ4KError("../bin/imatrix_plain.mllm", name, weight, importance[name]);
+    const double weighted_error = weightedQ4KError("../bin/imatrix_weighted.mllm", name, weight, importance[name]);
+    ASSERT_LT(weighted_error, 0.8 * plain_error);
+}
+TEST_F(QuantTest, SizeBudgetTest) {
+    ScopedTestFiles files{{"../bin/budget_test.mllm", "../bin/budget_quant.mllm"}};
+    const int rows = 8, cols = 512;
+    std::vector<string> names = {"model.layers.0.mlp.up_proj.weight", "model.layers.0.mlp.gate_proj.weight",
+                                 "model.layers.0.self_attn.q_proj.weight"};
+    std::vector<std::vector<float>> params(names.size(), std::vector<float>(rows * cols));
+    for (int p = 0; p < params.size(); p++) {
+        for (int i = 0; i < params[p].size(); i++) {
+            // the last param has a much larger spread, so upgrading it removes the most error
+            params[p][i] = std::sin(i * 0.37F + p) * (p == 2 ? 8.0F : 1.0F);
+        }
+    }
+    writeF32Params("../bin/budget_test.mllm", names, params);
+
+    auto *quant = new QuantWriter("../bin/budget_quant.mllm", "../bin/budget_test.mllm");
+    quant->readParams();
+    quant->setSizeBudget(4.0);
+    quant->quantParams(DataType::MLLM_TYPE_Q4_K);
+    delete quant;
+
+    auto loader = ParamLoader("../bin/budget_quant.mllm");
+    uint64_t bytes = 0;
+    for (auto &name : names) {
+        auto [data, size] = loader.load(name);
+        bytes += size;
+        delete[] data;
+    }
+    ASSERT_LE(8.0 * bytes / (names.size() * rows * cols), 4.0);
+    ASSERT_GT(DataTypeSize(loader.getDataType(names[2]), QK_K), DataTypeSize(loader.getDataType(names[0]), QK_K));
+}
 } // namespace mllm
+
+namespace {
+// minimal GGUF v3 writer: the metadata and tensor infos, then the tensor data at 32 byte aligned offsets
+struct GGUFTestTensor {
+    string name;
+    std::vector<uint64_t> ne;
+    uint32_t ggml_type;
+    std::vector<uint8_t> data;
+};
+void ggufString(FILE *fp, const string &s) {
+    const uint64_t len = s.size();
+    fwrite(&len, sizeof(len), 1, fp);
+    fwrite(s.data(), 1, len, fp);
+}
+void writeGGUF(const string &path, const std::vector<GGUFTestTensor> &tensors) {
+    FILE *fp = fopen(path.c_str(), "wb");
+    const uint32_t version = 3, u32 = 4, str = 8, arr = 9, f32 = 6;
+    const uint64_t n_tensors = tensors.size(), n_kv = 5;
+    fwrite("GGUF", 1, 4, fp);
+    fwrite(&version, sizeof(version), 1, fp);
+    fwrite(&n_tensors, sizeof(n_tensors), 1, fp);
+    fwrite(&n_kv, sizeof(n_kv), 1, fp);
+    ggufString(fp, "general.architecture");
+    fwrite(&str, sizeof(str), 1, fp);
+    ggufString(fp, "llama");
+    ggufString(fp, "llama.block_count");
+    const uint32_t blocks = 1;
+    fwrite(&u32, sizeof(u32), 1, fp);
+    fwrite(&blocks, sizeof(blocks), 1, fp);
+    ggufString(fp, "general.alignment");
+    const uint32_t alignment = 32;
+    fwrite(&u32, sizeof(u32), 1, fp);
+    fwrite(&alignment, sizeof(alignment), 1, fp);
+    ggufString(fp, "llama.rope.freq_base");
+    const float freq_base = 10000.0F;
+    fwrite(&f32, sizeof(f32), 1, fp);
+    fwrite(&freq_base, sizeof(freq_base), 1, fp);
+    ggufString(fp, "tokenizer.ggml.tokens");
+    const std::vector<string> tokens = {"<s>", "</s>", "hello"};
+    const uint64_t n_tokens = tokens.size();
+    fwrite(&arr, sizeof(arr), 1, fp);
+    fwrite(&str, sizeof(str), 1, fp);
+    fwrite(&n_tokens, sizeof(n_tokens), 1, fp);
+    for (auto &token : tokens) { ggufString(fp, token); }
+    uint64_t offset = 0;
+    for (auto &t : tensors) {
+        ggufString(fp, t.name);
+        const uint32_t n_dims = t.ne.size();
+        fwrite(&n_dims, sizeof(n_dims), 1, fp);
+        fwrite(t.ne.data(), sizeof(uint64_t), n_dims, fp);
+        fwrite(&t.ggml_type, sizeof(t.ggml_type), 1, fp);
+        fwrite(&offset, sizeof(offset), 1, fp);
+        offset = (offset + t.data.size() + alignment - 1) / alignment * alignment;
+    }
+    const std::vector<uint8_t> zeros(alignment, 0);
+    fwrite(zeros.data(), 1, (alignment - ftell(fp) % alignment) % alignment, fp);
+    for (auto &t : tensors) {
+        fwrite(t.data.data(), 1, t.data.size(), fp);
+        fwrite(zeros.data(), 1, (alignment - t.data.size() % alignment) % alignment, fp);
+    }
+    fclose(fp);
+}
+std::vector<uint8_t> testBytes(size_t size, int seed) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++) { bytes[i] = (uint8_t)(i * 7 + seed); }
+    return bytes;
+}
+} // namespace
+
+TEST_F(QuantTest, GGUFLoadTest) {
+    ScopedTestFiles files{{"../bin/gguf_test.gguf"}};
+    const std::vector<GGUFTestTensor> tensors = {
+        {"token_embd.weight", {8, 4}, 0, testBytes(8 * 4 * sizeof(float), 1)},
+        {"blk.0.attn_q.weight", {64, 2}, 2, testBytes(4 * sizeof(block_q4_0), 2)},
+        {"output_norm.weight", {8}, 0, testBytes(8 * sizeof(float), 3)},
+        {"blk.0.ffn_up.weight", {32, 1}, 3, testBytes(20, 4)}, // Q4_1, which mllm does not run
+    };
+    writeGGUF("../bin/gguf_test.gguf", tensors);
+
+    GGUFParamLoader loader("../bin/gguf_test.gguf", true);
+    ASSERT_TRUE(loader.isAvailible());
+    ASSERT_TRUE(loader.isMmaped());
+    EXPECT_EQ(loader.getString("general.architecture"), "llama");
+    EXPECT_EQ(loader.getInt("llama.block_count"), 1);
+    EXPECT_FLOAT_EQ(loader.getFloat("llama.rope.freq_base"), 10000.0F);
+    EXPECT_EQ(loader.getStringArray("tokenizer.ggml.tokens"), std::vector<string>({"<s>", "</s>", "hello"}));
+    EXPECT_FALSE(loader.hasKey("llama.context_length"));
+    EXPECT_EQ(loader.getInt("llama.context_length", 2048), 2048);
+
+    EXPECT_EQ(loader.getDataType("layers.0.attention.wq.weight"), MLLM_TYPE_Q4_0);
+    EXPECT_EQ(loader.getTensorSize("layers.0.attention.wq.weight"), 4 * sizeof(block_q4_0));
+    EXPECT_EQ(loader.getDataType("tok_embeddings.weight"), MLLM_TYPE_F32);
+    EXPECT_EQ(loader.getDataType("norm.weight"), MLLM_TYPE_F32);
+    EXPECT_EQ(loader.getDataType("layers.0.feed_forward.w3.weight"), MLLM_TYPE_COUNT);
+    // no output.weight: the lm head is tied to the embedding
+    EXPECT_EQ(loader.getDataType("output.weight"), MLLM_TYPE_F32);
+    EXPECT_EQ(loader.getParamNames().size(), 4);
+
+    shared_ptr<MemoryManager> mm = std::make_shared<SystemMemoryManager>();
+    CPUBackend bn(mm);
+    auto check = [&](const string &name, int rows, int cols, const std::vector<uint8_t> &expected) {
+        Tensor weight(&bn);
+        weight.setName(name);
+        weight.reshape(1, 1, rows, cols);
+        weight.setDtype(loader.getDataType(name));
+        weight.alloc();
+        ASSERT_TRUE(loader.load(&weight));
+        ASSERT_TRUE(weight.isExternalHostPtr());
+        ASSERT_EQ(weight.cntSize(), expected.size());
+        ASSERT_EQ(memcmp(weight.rawHostPtr(), expected.data(), expected.size()), 0);
+        weight.free();
+    };
+    check("layers.0.attention.wq.weight", 2, 64, tensors[1].data);
+    check("norm.weight", 1, 8, tensors[2].data);
+    check("output.weight", 4, 8, tensors[0].data);
+
+    LLaMANameConfig names;
+    names.init(HFHUBROPE);
+    GGUFParamLoader hf_loader("../bin/gguf_test.gguf", false, GGUFNameMap::from(names));
+    ASSERT_FALSE(hf_loader.isMmaped());
+    EXPECT_EQ(hf_loader.getDataType("model.layers.0.self_attn.q_proj.weight"), MLLM_TYPE_Q4_0);
+    EXPECT_EQ(hf_loader.getDataType("model.embed_tokens.weight"), MLLM_TYPE_F32);
+    EXPECT_EQ(hf_loader.getDataType("lm_head.weight"), MLLM_TYPE_F32);
+    Tensor q(&bn);
+    q.setName("model.layers.0.self_attn.q_proj.weight");
+    q.reshape(1, 1, 2, 64);
+    q.setDtype(MLLM_TYPE_Q4_0);
+    q.alloc();
+    ASSERT_TRUE(hf_loader.load(&q));
+    ASSERT_FALSE(q.isExternalHostPtr());
+    ASSERT_EQ(memcmp(q.rawHostPtr(), tensors[1].data.data(), tensors[1].data.size()), 0);
+    q.free();
+
+    GGUFParamLoader missing("gguf_missing.gguf");
+    EXPECT_FALSE(missing.isAvailible());
+}
@@ -68,6 +68,10 @@ class Writer:
     def write_tensor(self, tensor: torch.Tensor, name: str) -> [int, int]:
         tensor_idx = Tensor(name=name, dtype=self.__torch_dtype_to_int(tensor.dtype))
         self.tensors_map[name] = tensor_idx
+        # align to 128 bytes so that mllm can use the weights in place when the file is mmap-ed
+        padding = -self.writer.tell() % 128
+        if padding:
+            self.writer.write(b"\x00" * padding)
         offset = self.writer.tell()
         if tensor.dtype == torch.bfloat16:  # to float 16
             tensor_numpy = tensor.detach().to(torch.float32).numpy()
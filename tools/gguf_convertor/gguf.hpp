@@ -98,14 +98,14 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
     {"q4_1", 0, 0, false, false},   // GGML_TYPE_Q4_1
     {"DEPRECATED", 0, 0, false, false},   // Placeholder for missing GGML_TYPE_4 and GGML_TYPE_5
     {"DEPRECATED", 0, 0, false, false},   // Placeholder for missing GGML_TYPE_4 and GGML_TYPE_5
-    {"q5_0", 0, 0, false, false},   // GGML_TYPE_Q5_0
+    {"q5_0", QK5_0, sizeof(block_q5_0), true}, // GGML_TYPE_Q5_0
     {"q5_1", 0, 0, false, false},   // GGML_TYPE_Q5_1
     {"q8_0", QK8_0, sizeof(block_q8_0), true}, // GGML_TYPE_Q8_0
     {"q8_1", 0, 0, false, false},   // GGML_TYPE_Q8_1
-    {"q2_K", 0, 0, false, false},   // GGML_TYPE_Q2_K
-    {"q3_K", 0, 0, false, false},   // GGML_TYPE_Q3_K
+    {"q2_K", QK_K, sizeof(block_q2_K), true},   // GGML_TYPE_Q2_K
+    {"q3_K", QK_K, sizeof(block_q3_K), true},   // GGML_TYPE_Q3_K
     {"q4_K", QK_K, sizeof(block_q4_K), true},   // GGML_TYPE_Q4_K
-    {"q5_K", 0, 0, false, false},   // GGML_TYPE_Q5_K
+    {"q5_K", QK_K, sizeof(block_q5_K), true},   // GGML_TYPE_Q5_K
     {"q6_K", QK_K, sizeof(block_q6_K), true},   // GGML_TYPE_Q6_K
     {"q8_K", QK_K, sizeof(block_q8_K), true},   // GGML_TYPE_Q8_K
     {"i8", 1, sizeof(int8_t), false},   // GGML_TYPE_I8
@@ -474,6 +474,10 @@ static string convert_tensor_models(string name) {
     }
     return name;
 }
+// ggml and mllm share type ids except Q2_K, whose ggml id is mllm's Q8_PER_TENSOR
+static DataType to_mllm_type(enum ggml_type type) {
+    return type == GGML_TYPE_Q2_K ? MLLM_TYPE_Q2_K : (DataType)type;
+}
 static size_t get_tensor_size(const struct gguf_tensor_info *info) {
     ggml_type_traits_t type = type_traits[info->type];
     if (!type.is_available) {
@@ -696,7 +700,7 @@ static void from_gguf(std::string fname, ParamWriter *writer) {
                     fclose(file);
                     exit(-1);
                 }
-                writer->writeParam(std::string(info.name.data), (DataType)info.type, data, size);
+                writer->writeParam(std::string(info.name.data), to_mllm_type(info.type), data, size);
                 printf("name: %s,   types:%d  offset: %lu, size: %lu\n", info.name.data, info.type, info.offset, get_tensor_size(&info));
                 free(data);
             }